@@ -44,6 +44,21 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 #include <string.h> // CBC mode, for memset
 #include "aes.h"
 
+// AES-NI is used when the compiler can target it and the CPU reports it at
+// run time; everything else goes through the table-driven software cipher.
+// Define AES_USE_AESNI to 0 to build without it.
+#ifndef AES_USE_AESNI
+  #if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define AES_USE_AESNI 1
+  #else
+    #define AES_USE_AESNI 0
+  #endif
+#endif
+#if AES_USE_AESNI
+  #include <wmmintrin.h>
+  #define AESNI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
 /*****************************************************************************/
 /* Defines:                                                                  */
 /*****************************************************************************/
@@ -261,72 +276,11 @@ static void AddRoundKey(uint8_t round,state_t* state,uint8_t* RoundKey)
   }
 }
 
-// The SubBytes Function Substitutes the values in the
-// state matrix with values in an S-box.
-static void SubBytes(state_t* state)
-{
-  uint8_t i, j;
-  for (i = 0; i < 4; ++i)
-  {
-    for (j = 0; j < 4; ++j)
-    {
-      (*state)[j][i] = getSBoxValue((*state)[j][i]);
-    }
-  }
-}
-
-// The ShiftRows() function shifts the rows in the state to the left.
-// Each row is shifted with different offset.
-// Offset = Row number. So the first row is not shifted.
-static void ShiftRows(state_t* state)
-{
-  uint8_t temp;
-
-  // Rotate first row 1 columns to left  
-  temp           = (*state)[0][1];
-  (*state)[0][1] = (*state)[1][1];
-  (*state)[1][1] = (*state)[2][1];
-  (*state)[2][1] = (*state)[3][1];
-  (*state)[3][1] = temp;
-
-  // Rotate second row 2 columns to left  
-  temp           = (*state)[0][2];
-  (*state)[0][2] = (*state)[2][2];
-  (*state)[2][2] = temp;
-
-  temp           = (*state)[1][2];
-  (*state)[1][2] = (*state)[3][2];
-  (*state)[3][2] = temp;
-
-  // Rotate third row 3 columns to left
-  temp           = (*state)[0][3];
-  (*state)[0][3] = (*state)[3][3];
-  (*state)[3][3] = (*state)[2][3];
-  (*state)[2][3] = (*state)[1][3];
-  (*state)[1][3] = temp;
-}
-
 static uint8_t xtime(uint8_t x)
 {
   return ((x<<1) ^ (((x>>7) & 1) * 0x1b));
 }
 
-// MixColumns function mixes the columns of the state matrix
-static void MixColumns(state_t* state)
-{
-  uint8_t i;
-  uint8_t Tmp, Tm, t;
-  for (i = 0; i < 4; ++i)
-  {  
-    t   = (*state)[i][0];
-    Tmp = (*state)[i][0] ^ (*state)[i][1] ^ (*state)[i][2] ^ (*state)[i][3] ;
-    Tm  = (*state)[i][0] ^ (*state)[i][1] ; Tm = xtime(Tm);  (*state)[i][0] ^= Tm ^ Tmp ;
-    Tm  = (*state)[i][1] ^ (*state)[i][2] ; Tm = xtime(Tm);  (*state)[i][1] ^= Tm ^ Tmp ;
-    Tm  = (*state)[i][2] ^ (*state)[i][3] ; Tm = xtime(Tm);  (*state)[i][2] ^= Tm ^ Tmp ;
-    Tm  = (*state)[i][3] ^ t ;              Tm = xtime(Tm);  (*state)[i][3] ^= Tm ^ Tmp ;
-  }
-}
-
 // Multiply is used to multiply numbers in the field GF(2^8)
 // Note: The last call to xtime() is unneeded, but often ends up generating a smaller binary
 //       The compiler seems to be able to vectorize the operation better this way.
@@ -416,30 +370,148 @@ static void InvShiftRows(state_t* state)
 }
 #endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
 
+// Te0[x] packs the MixColumns column (2*S[x], S[x], S[x], 3*S[x]) of one
+// state byte into a little-endian word; the tables for the other three rows
+// are byte rotations of it, so a full round is 16 lookups and some XORs.
+static const uint32_t Te0[256] = {
+  0xa56363c6U, 0x847c7cf8U, 0x997777eeU, 0x8d7b7bf6U, 0x0df2f2ffU, 0xbd6b6bd6U,
+  0xb16f6fdeU, 0x54c5c591U, 0x50303060U, 0x03010102U, 0xa96767ceU, 0x7d2b2b56U,
+  0x19fefee7U, 0x62d7d7b5U, 0xe6abab4dU, 0x9a7676ecU, 0x45caca8fU, 0x9d82821fU,
+  0x40c9c989U, 0x877d7dfaU, 0x15fafaefU, 0xeb5959b2U, 0xc947478eU, 0x0bf0f0fbU,
+  0xecadad41U, 0x67d4d4b3U, 0xfda2a25fU, 0xeaafaf45U, 0xbf9c9c23U, 0xf7a4a453U,
+  0x967272e4U, 0x5bc0c09bU, 0xc2b7b775U, 0x1cfdfde1U, 0xae93933dU, 0x6a26264cU,
+  0x5a36366cU, 0x413f3f7eU, 0x02f7f7f5U, 0x4fcccc83U, 0x5c343468U, 0xf4a5a551U,
+  0x34e5e5d1U, 0x08f1f1f9U, 0x937171e2U, 0x73d8d8abU, 0x53313162U, 0x3f15152aU,
+  0x0c040408U, 0x52c7c795U, 0x65232346U, 0x5ec3c39dU, 0x28181830U, 0xa1969637U,
+  0x0f05050aU, 0xb59a9a2fU, 0x0907070eU, 0x36121224U, 0x9b80801bU, 0x3de2e2dfU,
+  0x26ebebcdU, 0x6927274eU, 0xcdb2b27fU, 0x9f7575eaU, 0x1b090912U, 0x9e83831dU,
+  0x742c2c58U, 0x2e1a1a34U, 0x2d1b1b36U, 0xb26e6edcU, 0xee5a5ab4U, 0xfba0a05bU,
+  0xf65252a4U, 0x4d3b3b76U, 0x61d6d6b7U, 0xceb3b37dU, 0x7b292952U, 0x3ee3e3ddU,
+  0x712f2f5eU, 0x97848413U, 0xf55353a6U, 0x68d1d1b9U, 0x00000000U, 0x2cededc1U,
+  0x60202040U, 0x1ffcfce3U, 0xc8b1b179U, 0xed5b5bb6U, 0xbe6a6ad4U, 0x46cbcb8dU,
+  0xd9bebe67U, 0x4b393972U, 0xde4a4a94U, 0xd44c4c98U, 0xe85858b0U, 0x4acfcf85U,
+  0x6bd0d0bbU, 0x2aefefc5U, 0xe5aaaa4fU, 0x16fbfbedU, 0xc5434386U, 0xd74d4d9aU,
+  0x55333366U, 0x94858511U, 0xcf45458aU, 0x10f9f9e9U, 0x06020204U, 0x817f7ffeU,
+  0xf05050a0U, 0x443c3c78U, 0xba9f9f25U, 0xe3a8a84bU, 0xf35151a2U, 0xfea3a35dU,
+  0xc0404080U, 0x8a8f8f05U, 0xad92923fU, 0xbc9d9d21U, 0x48383870U, 0x04f5f5f1U,
+  0xdfbcbc63U, 0xc1b6b677U, 0x75dadaafU, 0x63212142U, 0x30101020U, 0x1affffe5U,
+  0x0ef3f3fdU, 0x6dd2d2bfU, 0x4ccdcd81U, 0x140c0c18U, 0x35131326U, 0x2fececc3U,
+  0xe15f5fbeU, 0xa2979735U, 0xcc444488U, 0x3917172eU, 0x57c4c493U, 0xf2a7a755U,
+  0x827e7efcU, 0x473d3d7aU, 0xac6464c8U, 0xe75d5dbaU, 0x2b191932U, 0x957373e6U,
+  0xa06060c0U, 0x98818119U, 0xd14f4f9eU, 0x7fdcdca3U, 0x66222244U, 0x7e2a2a54U,
+  0xab90903bU, 0x8388880bU, 0xca46468cU, 0x29eeeec7U, 0xd3b8b86bU, 0x3c141428U,
+  0x79dedea7U, 0xe25e5ebcU, 0x1d0b0b16U, 0x76dbdbadU, 0x3be0e0dbU, 0x56323264U,
+  0x4e3a3a74U, 0x1e0a0a14U, 0xdb494992U, 0x0a06060cU, 0x6c242448U, 0xe45c5cb8U,
+  0x5dc2c29fU, 0x6ed3d3bdU, 0xefacac43U, 0xa66262c4U, 0xa8919139U, 0xa4959531U,
+  0x37e4e4d3U, 0x8b7979f2U, 0x32e7e7d5U, 0x43c8c88bU, 0x5937376eU, 0xb76d6ddaU,
+  0x8c8d8d01U, 0x64d5d5b1U, 0xd24e4e9cU, 0xe0a9a949U, 0xb46c6cd8U, 0xfa5656acU,
+  0x07f4f4f3U, 0x25eaeacfU, 0xaf6565caU, 0x8e7a7af4U, 0xe9aeae47U, 0x18080810U,
+  0xd5baba6fU, 0x887878f0U, 0x6f25254aU, 0x722e2e5cU, 0x241c1c38U, 0xf1a6a657U,
+  0xc7b4b473U, 0x51c6c697U, 0x23e8e8cbU, 0x7cdddda1U, 0x9c7474e8U, 0x211f1f3eU,
+  0xdd4b4b96U, 0xdcbdbd61U, 0x868b8b0dU, 0x858a8a0fU, 0x907070e0U, 0x423e3e7cU,
+  0xc4b5b571U, 0xaa6666ccU, 0xd8484890U, 0x05030306U, 0x01f6f6f7U, 0x120e0e1cU,
+  0xa36161c2U, 0x5f35356aU, 0xf95757aeU, 0xd0b9b969U, 0x91868617U, 0x58c1c199U,
+  0x271d1d3aU, 0xb99e9e27U, 0x38e1e1d9U, 0x13f8f8ebU, 0xb398982bU, 0x33111122U,
+  0xbb6969d2U, 0x70d9d9a9U, 0x898e8e07U, 0xa7949433U, 0xb69b9b2dU, 0x221e1e3cU,
+  0x92878715U, 0x20e9e9c9U, 0x49cece87U, 0xff5555aaU, 0x78282850U, 0x7adfdfa5U,
+  0x8f8c8c03U, 0xf8a1a159U, 0x80898909U, 0x170d0d1aU, 0xdabfbf65U, 0x31e6e6d7U,
+  0xc6424284U, 0xb86868d0U, 0xc3414182U, 0xb0999929U, 0x772d2d5aU, 0x110f0f1eU,
+  0xcbb0b07bU, 0xfc5454a8U, 0xd6bbbb6dU, 0x3a16162cU
+};
+
+#define ROTL8(x)  (((x) << 8) | ((x) >> 24))
+#define ROTL16(x) (((x) << 16) | ((x) >> 16))
+#define ROTL24(x) (((x) << 24) | ((x) >> 8))
+
+// Number of blocks the software cipher runs side by side. The rounds of
+// independent blocks interleave, keeping several table lookups in flight.
+#define SOFT_LANES 4
+
+static uint32_t load32(const uint8_t* p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store32(uint8_t* p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static void RoundKeyWords(uint32_t* rk, const uint8_t* RoundKey)
+{
+  int i;
+  for (i = 0; i < 4 * (Nr + 1); ++i)
+  {
+    rk[i] = load32(RoundKey + 4 * i);
+  }
+}
+
+// Encrypts 'n' (at most SOFT_LANES) blocks held as column words in place.
+static inline void EncryptLanes(const uint32_t* rk, uint32_t s[][4], int n)
+{
+  uint32_t t[SOFT_LANES][4];
+  int round, b, c;
+
+  for (b = 0; b < n; ++b)
+  {
+    for (c = 0; c < 4; ++c)
+    {
+      s[b][c] ^= rk[c];
+    }
+  }
+  for (round = 1; round < Nr; ++round)
+  {
+    rk += 4;
+    for (b = 0; b < n; ++b)
+    {
+      for (c = 0; c < 4; ++c)
+      {
+        t[b][c] = Te0[s[b][c] & 0xff]
+                ^ ROTL8(Te0[(s[b][(c + 1) & 3] >> 8) & 0xff])
+                ^ ROTL16(Te0[(s[b][(c + 2) & 3] >> 16) & 0xff])
+                ^ ROTL24(Te0[s[b][(c + 3) & 3] >> 24])
+                ^ rk[c];
+      }
+    }
+    memcpy(s, t, n * sizeof(t[0]));
+  }
+  // The last round has no MixColumns: plain S-box bytes.
+  rk += 4;
+  for (b = 0; b < n; ++b)
+  {
+    for (c = 0; c < 4; ++c)
+    {
+      t[b][c] = ((uint32_t)getSBoxValue(s[b][c] & 0xff)
+              | ((uint32_t)getSBoxValue((s[b][(c + 1) & 3] >> 8) & 0xff) << 8)
+              | ((uint32_t)getSBoxValue((s[b][(c + 2) & 3] >> 16) & 0xff) << 16)
+              | ((uint32_t)getSBoxValue(s[b][(c + 3) & 3] >> 24) << 24))
+              ^ rk[c];
+    }
+  }
+  memcpy(s, t, n * sizeof(t[0]));
+}
+
 // Cipher is the main function that encrypts the PlainText.
 static void Cipher(state_t* state, uint8_t* RoundKey)
 {
-  uint8_t round = 0;
+  uint32_t rk[4 * (Nr + 1)];
+  uint32_t s[1][4];
+  uint8_t* buf = (uint8_t*)state;
+  int c;
 
-  // Add the First round key to the state before starting the rounds.
-  AddRoundKey(0, state, RoundKey); 
-  
-  // There will be Nr rounds.
-  // The first Nr-1 rounds are identical.
-  // These Nr-1 rounds are executed in the loop below.
-  for (round = 1; round < Nr; ++round)
+  RoundKeyWords(rk, RoundKey);
+  for (c = 0; c < 4; ++c)
   {
-    SubBytes(state);
-    ShiftRows(state);
-    MixColumns(state);
-    AddRoundKey(round, state, RoundKey);
+    s[0][c] = load32(buf + 4 * c);
+  }
+  EncryptLanes(rk, s, 1);
+  for (c = 0; c < 4; ++c)
+  {
+    store32(buf + 4 * c, s[0][c]);
   }
-  
-  // The last round is given below.
-  // The MixColumns function is not here in the last round.
-  SubBytes(state);
-  ShiftRows(state);
-  AddRoundKey(Nr, state, RoundKey);
 }
 
 #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
@@ -469,6 +541,197 @@ static void InvCipher(state_t* state,uint8_t* RoundKey)
 }
 #endif // #if (defined(CBC) && CBC == 1) || (defined(ECB) && ECB == 1)
 
+#if (defined(CBC) && (CBC == 1)) || (defined(CTR) && (CTR == 1))
+// Increments the counter block as one big-endian 128-bit number.
+static void IncrementIv(uint8_t* Iv)
+{
+  int bi;
+  for (bi = (AES_BLOCKLEN - 1); bi >= 0; --bi)
+  {
+    /* inc will overflow */
+    if (Iv[bi] == 255)
+    {
+      Iv[bi] = 0;
+      continue;
+    }
+    Iv[bi] += 1;
+    break;
+  }
+}
+#endif
+
+#if AES_USE_AESNI
+
+// Blocks kept in flight by the AES-NI loops; aesenc has a latency of several
+// cycles but issues every cycle, so independent blocks hide it.
+#define AESNI_LANES 8
+
+static int HaveAESNI(void)
+{
+  return __builtin_cpu_supports("aes") != 0;
+}
+
+#if defined(CTR) && (CTR == 1)
+AESNI_TARGET
+static void CTR_aesni(struct AES_ctx* ctx, uint8_t* buf, size_t nblocks)
+{
+  __m128i rk[Nr + 1], b[AESNI_LANES];
+  uint64_t hi, lo;
+  int i, r;
+
+  for (r = 0; r <= Nr; ++r)
+  {
+    rk[r] = _mm_loadu_si128((const __m128i*)(ctx->RoundKey + r * AES_BLOCKLEN));
+  }
+  // The counter lives in two native words for the loop and goes back to
+  // its big-endian bytes at the end.
+  memcpy(&hi, ctx->Iv, 8);
+  memcpy(&lo, ctx->Iv + 8, 8);
+  hi = __builtin_bswap64(hi);
+  lo = __builtin_bswap64(lo);
+  while (nblocks > 0)
+  {
+    int n = nblocks < AESNI_LANES ? (int)nblocks : AESNI_LANES;
+    for (i = 0; i < n; ++i)
+    {
+      b[i] = _mm_set_epi64x((long long)__builtin_bswap64(lo), (long long)__builtin_bswap64(hi));
+      b[i] = _mm_xor_si128(b[i], rk[0]);
+      if (++lo == 0)
+        ++hi;
+    }
+    for (r = 1; r < Nr; ++r)
+    {
+      for (i = 0; i < n; ++i)
+      {
+        b[i] = _mm_aesenc_si128(b[i], rk[r]);
+      }
+    }
+    for (i = 0; i < n; ++i)
+    {
+      __m128i* p = (__m128i*)(buf + i * AES_BLOCKLEN);
+      b[i] = _mm_aesenclast_si128(b[i], rk[Nr]);
+      _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), b[i]));
+    }
+    buf += n * AES_BLOCKLEN;
+    nblocks -= n;
+  }
+  hi = __builtin_bswap64(hi);
+  lo = __builtin_bswap64(lo);
+  memcpy(ctx->Iv, &hi, 8);
+  memcpy(ctx->Iv + 8, &lo, 8);
+}
+#endif // #if defined(CTR) && (CTR == 1)
+
+#if defined(CBC) && (CBC == 1)
+AESNI_TARGET
+static void CBC_encrypt_aesni(struct AES_ctx* ctx, uint8_t* buf, size_t nblocks)
+{
+  __m128i rk[Nr + 1], v = _mm_loadu_si128((const __m128i*)ctx->Iv);
+  int r;
+
+  for (r = 0; r <= Nr; ++r)
+  {
+    rk[r] = _mm_loadu_si128((const __m128i*)(ctx->RoundKey + r * AES_BLOCKLEN));
+  }
+  // Each block depends on the previous ciphertext: no lanes here.
+  for (; nblocks > 0; --nblocks, buf += AES_BLOCKLEN)
+  {
+    v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)buf), v);
+    v = _mm_xor_si128(v, rk[0]);
+    for (r = 1; r < Nr; ++r)
+    {
+      v = _mm_aesenc_si128(v, rk[r]);
+    }
+    v = _mm_aesenclast_si128(v, rk[Nr]);
+    _mm_storeu_si128((__m128i*)buf, v);
+  }
+  _mm_storeu_si128((__m128i*)ctx->Iv, v);
+}
+
+AESNI_TARGET
+static void CBC_decrypt_aesni(struct AES_ctx* ctx, uint8_t* buf, size_t nblocks)
+{
+  __m128i dk[Nr + 1], b[AESNI_LANES], c[AESNI_LANES];
+  __m128i v = _mm_loadu_si128((const __m128i*)ctx->Iv);
+  int i, r;
+
+  // Equivalent inverse cipher: reversed round keys, InvMixColumns applied
+  // to all but the first and last.
+  dk[0] = _mm_loadu_si128((const __m128i*)(ctx->RoundKey + Nr * AES_BLOCKLEN));
+  for (r = 1; r < Nr; ++r)
+  {
+    dk[r] = _mm_aesimc_si128(_mm_loadu_si128((const __m128i*)(ctx->RoundKey + (Nr - r) * AES_BLOCKLEN)));
+  }
+  dk[Nr] = _mm_loadu_si128((const __m128i*)ctx->RoundKey);
+  while (nblocks > 0)
+  {
+    int n = nblocks < AESNI_LANES ? (int)nblocks : AESNI_LANES;
+    for (i = 0; i < n; ++i)
+    {
+      c[i] = _mm_loadu_si128((const __m128i*)(buf + i * AES_BLOCKLEN));
+      b[i] = _mm_xor_si128(c[i], dk[0]);
+    }
+    for (r = 1; r < Nr; ++r)
+    {
+      for (i = 0; i < n; ++i)
+      {
+        b[i] = _mm_aesdec_si128(b[i], dk[r]);
+      }
+    }
+    for (i = 0; i < n; ++i)
+    {
+      b[i] = _mm_aesdeclast_si128(b[i], dk[Nr]);
+      _mm_storeu_si128((__m128i*)(buf + i * AES_BLOCKLEN), _mm_xor_si128(b[i], i == 0 ? v : c[i - 1]));
+    }
+    v = c[n - 1];
+    buf += n * AES_BLOCKLEN;
+    nblocks -= n;
+  }
+  _mm_storeu_si128((__m128i*)ctx->Iv, v);
+}
+#endif // #if defined(CBC) && (CBC == 1)
+
+#endif // #if AES_USE_AESNI
+
+#if defined(CTR) && (CTR == 1)
+static void CTR_soft(struct AES_ctx* ctx, uint8_t* buf, size_t nblocks)
+{
+  uint32_t rk[4 * (Nr + 1)];
+  uint32_t s[SOFT_LANES][4];
+  int b, c;
+
+  RoundKeyWords(rk, ctx->RoundKey);
+  while (nblocks > 0)
+  {
+    int n = nblocks < SOFT_LANES ? (int)nblocks : SOFT_LANES;
+    for (b = 0; b < n; ++b)
+    {
+      for (c = 0; c < 4; ++c)
+      {
+        s[b][c] = load32(ctx->Iv + 4 * c);
+      }
+      IncrementIv(ctx->Iv);
+    }
+    // A constant lane count lets the compiler unroll the common case.
+    if (n == SOFT_LANES)
+      EncryptLanes(rk, s, SOFT_LANES);
+    else
+      EncryptLanes(rk, s, n);
+    for (b = 0; b < n; ++b)
+    {
+      for (c = 0; c < 4; ++c)
+      {
+        uint8_t* p = buf + b * AES_BLOCKLEN + 4 * c;
+        store32(p, load32(p) ^ s[b][c]);
+      }
+    }
+    buf += n * AES_BLOCKLEN;
+    nblocks -= n;
+  }
+}
+#endif // #if defined(CTR) && (CTR == 1)
+
+
 /*****************************************************************************/
 /* Public functions:                                                         */
 /*****************************************************************************/
@@ -510,6 +773,13 @@ void AES_CBC_encrypt_buffer(struct AES_ctx *ctx,uint8_t* buf, uint32_t length)
 {
   uintptr_t i;
   uint8_t *Iv = ctx->Iv;
+#if AES_USE_AESNI
+  if (HaveAESNI())
+  {
+    CBC_encrypt_aesni(ctx, buf, length / AES_BLOCKLEN);
+    return;
+  }
+#endif
   for (i = 0; i < length; i += AES_BLOCKLEN)
   {
     XorWithIv(buf, Iv);
@@ -526,6 +796,13 @@ void AES_CBC_decrypt_buffer(struct AES_ctx* ctx, uint8_t* buf,  uint32_t length)
 {
   uintptr_t i;
   uint8_t storeNextIv[AES_BLOCKLEN];
+#if AES_USE_AESNI
+  if (HaveAESNI())
+  {
+    CBC_decrypt_aesni(ctx, buf, length / AES_BLOCKLEN);
+    return;
+  }
+#endif
   for (i = 0; i < length; i += AES_BLOCKLEN)
   {
     memcpy(storeNextIv, buf, AES_BLOCKLEN);
@@ -543,37 +820,37 @@ void AES_CBC_decrypt_buffer(struct AES_ctx* ctx, uint8_t* buf,  uint32_t length)
 
 #if defined(CTR) && (CTR == 1)
 
+void AES_CTR_xcrypt_blocks(struct AES_ctx* ctx, uint8_t* buf, size_t nblocks)
+{
+#if AES_USE_AESNI
+  if (HaveAESNI())
+  {
+    CTR_aesni(ctx, buf, nblocks);
+    return;
+  }
+#endif
+  CTR_soft(ctx, buf, nblocks);
+}
+
 /* Symmetrical operation: same function for encrypting as for decrypting. Note any IV/nonce should never be reused with the same key */
 void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t length)
 {
   uint8_t buffer[AES_BLOCKLEN];
-  
+  uint32_t whole = length / AES_BLOCKLEN;
   unsigned i;
-  int bi;
-  for (i = 0, bi = AES_BLOCKLEN; i < length; ++i, ++bi)
+
+  AES_CTR_xcrypt_blocks(ctx, buf, whole);
+  buf += whole * AES_BLOCKLEN;
+  length -= whole * AES_BLOCKLEN;
+  if (length > 0)
   {
-    if (bi == AES_BLOCKLEN) /* we need to regen xor compliment in buffer */
+    /* the keystream of a partial block is the counter's encryption */
+    memset(buffer, 0, AES_BLOCKLEN);
+    AES_CTR_xcrypt_blocks(ctx, buffer, 1);
+    for (i = 0; i < length; ++i)
     {
-      
-      memcpy(buffer, ctx->Iv, AES_BLOCKLEN);
-      Cipher((state_t*)buffer,ctx->RoundKey);
-
-      /* Increment Iv and handle overflow */
-      for (bi = (AES_BLOCKLEN - 1); bi >= 0; --bi)
-      {
-	/* inc will owerflow */
-        if (ctx->Iv[bi] == 255)
-	{
-          ctx->Iv[bi] = 0;
-          continue;
-        } 
-        ctx->Iv[bi] += 1;
-        break;   
-      }
-      bi = 0;
+      buf[i] ^= buffer[i];
     }
-
-    buf[i] = (buf[i] ^ buffer[bi]);
   }
 }
 
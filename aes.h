@@ -1,6 +1,7 @@
 #ifndef _AES_H_
 #define _AES_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -130,6 +131,17 @@ void AES_CBC_decrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t length);
  */
 void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t length);
 
+/**
+ * @brief Encrypts/decrypts whole blocks in CTR mode.
+ * @param ctx Pointer to the AES context; its counter advances by nblocks.
+ * @param buf Pointer to the data buffer (nblocks * AES_BLOCKLEN bytes).
+ * @param nblocks Number of blocks.
+ * @note Runs several blocks at a time, on AES-NI when the CPU has it.
+ *       Consecutive calls continue one keystream, so a stream can be
+ *       processed in pieces as long as each piece is whole blocks.
+ */
+void AES_CTR_xcrypt_blocks(struct AES_ctx* ctx, uint8_t* buf, size_t nblocks);
+
 #endif // #if defined(CTR) && (CTR == 1)
 
 
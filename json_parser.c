@@ -1,430 +1,910 @@
+/**
+ * @file json_parser.c
+ * @brief Native JSON library.
+ *
+ * The decoder is a single-pass recursive descent scanner that builds Lua
+ * values directly on the stack. Array elements and object members are
+ * parked on the stack in batches, so most tables are created with their
+ * exact size. String and whitespace runs are scanned 16 bytes at a time
+ * with SSE2 where available, 8 bytes at a time otherwise. The encoder
+ * walks tables and appends to a growable buffer.
+ */
+
+#define json_parser_c
+#define LUA_LIB
+
+#include "lprefix.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "lua.h"
+
 #include "lauxlib.h"
-#include <string.h>
-#include <stdio.h>
+#include "lualib.h"
+#include "json_parser.h"
+
 
 #define MAX_DEPTH 512
-#define SAFE_CHECK(n) if ((q + (n) + 2) > (out + outlen)) return 0
 
-/**
- * @file json_parser.c
- * @brief Simple JSON parser for Lua.
- */
+/* values parked on the stack before an array/object is created */
+#define JSON_BATCH 64
 
-/**
- * @brief Converts JSON to a Lua table.
- * Supports strings, numbers, booleans, nested objects, and arrays.
- */
-int json_to_lua(lua_State *L, const char *json, size_t len, char *out, size_t outlen) {
-  const char *p = json;
-  char *q = out;
-  const char *end = json + len;
-
-  /* 状态变量 */
-  int depth = 0;
-  int in_string = 0;
-  int escape = 0;
-  int in_array = 0;
-  int array_index = 1;
-  int need_comma = 0;
-  int parsing_key = 1; /* 1: 解析键名, 0: 解析值 */
-  int after_colon = 0;
-
-  /* 跳过所有空白字符，找到第一个非空白字符 */
-  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+/* metatable marking decoded (or json.array-tagged) arrays */
+#define JSON_ARRAY_MT "json.array"
+#define JSON_BUFFER_MT "json.buffer"
+
+#define json_null(L) lua_pushlightuserdata(L, NULL)
+
+
+/*
+** {======================================================
+** Scanning
+** =======================================================
+*/
+
+#define SWAR_ONES   0x0101010101010101ULL
+#define SWAR_HIGHS  0x8080808080808080ULL
+#define swar_haszero(v)    (((v) - SWAR_ONES) & ~(v) & SWAR_HIGHS)
+#define swar_hasless(v,n)  (((v) - SWAR_ONES * (n)) & ~(v) & SWAR_HIGHS)
+
+#define isjsonspace(c)  ((c) == ' ' || (c) == '\n' || (c) == '\r' || (c) == '\t')
+
+
+/*
+** Returns the first byte in [p, end) that ends a plain string run: a
+** quote, a backslash or a control character.
+*/
+static const char *scan_string (const char *p, const char *end) {
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  const __m128i ctrl = _mm_set1_epi8(0x1F);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+    int mask = _mm_movemask_epi8(m);
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#else
+  while (end - p >= 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    if (swar_haszero(w ^ (SWAR_ONES * '"')) | swar_haszero(w ^ (SWAR_ONES * '\\')) |
+        swar_hasless(w, 0x20))
+      break;  /* the byte-wise loop finds it */
+    p += 8;
+  }
+#endif
+  while (p < end) {
+    unsigned char c = (unsigned char)*p;
+    if (c == '"' || c == '\\' || c < 0x20)
+      break;
+    p++;
+  }
+  return p;
+}
+
+
+static const char *skip_space (const char *p, const char *end) {
+  if (p < end && !isjsonspace(*p))  /* common case: already on a token */
+    return p;
+#if defined(__SSE2__)
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    int mask = _mm_movemask_epi8(m) ^ 0xFFFF;
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && isjsonspace(*p))
     p++;
+  return p;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Buffers
+** =======================================================
+*/
+
+/*
+** Growable byte buffer kept in a userdata box, so memory is released by
+** the collector if decoding or encoding raises. (A luaL_Buffer needs its
+** box on top of the stack for every append, which neither parked decoder
+** values nor table traversal can guarantee.)
+*/
+typedef struct JsonBuffer {
+  char *s;
+  size_t n;
+  size_t size;
+} JsonBuffer;
+
+
+static void jsonbuf_free (lua_State *L, JsonBuffer *jb) {
+  void *ud;
+  lua_Alloc allocf = lua_getallocf(L, &ud);
+  if (jb->s != NULL)
+    allocf(ud, jb->s, jb->size, 0);
+  jb->s = NULL;
+  jb->n = jb->size = 0;
+}
+
+
+static int jsonbuf_gc (lua_State *L) {
+  jsonbuf_free(L, (JsonBuffer *)luaL_checkudata(L, 1, JSON_BUFFER_MT));
+  return 0;
+}
+
+
+static char *jsonbuf_prep (lua_State *L, JsonBuffer *jb, size_t sz) {
+  if (jb->size - jb->n < sz) {
+    void *ud;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+    size_t newsize = jb->size * 2;
+    char *ns;
+    if (newsize < jb->n + sz)
+      newsize = jb->n + sz;
+    if (newsize < 256)
+      newsize = 256;
+    ns = (char *)allocf(ud, jb->s, jb->size, newsize);
+    if (ns == NULL)
+      luaL_error(L, "json: not enough memory");
+    jb->s = ns;
+    jb->size = newsize;
+  }
+  return jb->s + jb->n;
+}
+
+
+
+static JsonBuffer *jsonbuf_new (lua_State *L) {
+  JsonBuffer *jb = (JsonBuffer *)lua_newuserdatauv(L, sizeof(JsonBuffer), 0);
+  jb->s = NULL;
+  jb->n = jb->size = 0;
+  luaL_setmetatable(L, JSON_BUFFER_MT);
+  return jb;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Decoder
+** =======================================================
+*/
+
+typedef struct JsonReader {
+  lua_State *L;
+  const char *start;
+  const char *p;  /* current position */
+  const char *end;
+  JsonBuffer *scratch;  /* unescaped string contents */
+  int depth;
+} JsonReader;
+
+
+static int json_error (JsonReader *r, const char *msg) {
+  return luaL_error(r->L, "json: %s at position %d", msg,
+                    (int)(r->p - r->start) + 1);
+}
+
+
+static void read_value (JsonReader *r);
+
+
+static int hexdigit (int c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+
+static unsigned read_hex4 (JsonReader *r) {
+  unsigned v = 0;
+  int i;
+  if (r->end - r->p < 4)
+    json_error(r, "truncated unicode escape");
+  for (i = 0; i < 4; i++) {
+    int d = hexdigit((unsigned char)r->p[i]);
+    if (d < 0)
+      json_error(r, "invalid unicode escape");
+    v = (v << 4) | (unsigned)d;
+  }
+  r->p += 4;
+  return v;
+}
+
+
+static int utf8_encode (char *buf, unsigned x) {
+  if (x < 0x80) {
+    buf[0] = (char)x;
+    return 1;
+  }
+  if (x < 0x800) {
+    buf[0] = (char)(0xC0 | (x >> 6));
+    buf[1] = (char)(0x80 | (x & 0x3F));
+    return 2;
+  }
+  if (x < 0x10000) {
+    buf[0] = (char)(0xE0 | (x >> 12));
+    buf[1] = (char)(0x80 | ((x >> 6) & 0x3F));
+    buf[2] = (char)(0x80 | (x & 0x3F));
+    return 3;
+  }
+  buf[0] = (char)(0xF0 | (x >> 18));
+  buf[1] = (char)(0x80 | ((x >> 12) & 0x3F));
+  buf[2] = (char)(0x80 | ((x >> 6) & 0x3F));
+  buf[3] = (char)(0x80 | (x & 0x3F));
+  return 4;
+}
+
+
+static void scratch_add (JsonReader *r, const char *s, size_t l) {
+  JsonBuffer *jb = r->scratch;
+  if (l == 0) return;  /* 's' and the buffer may both be NULL */
+  memcpy(jsonbuf_prep(r->L, jb, l), s, l);
+  jb->n += l;
+}
+
+
+static void scratch_addchar (JsonReader *r, char c) {
+  JsonBuffer *jb = r->scratch;
+  *jsonbuf_prep(r->L, jb, 1) = c;
+  jb->n++;
+}
+
+
+/* reads a string whose opening quote was already consumed */
+static void read_string (JsonReader *r) {
+  const char *s = r->p;
+  const char *q = scan_string(s, r->end);
+  if (q < r->end && *q == '"') {  /* no escapes: push straight from input */
+    lua_pushlstring(r->L, s, (size_t)(q - s));
+    r->p = q + 1;
+    return;
   }
+  r->scratch->n = 0;
+  for (;;) {
+    scratch_add(r, s, (size_t)(q - s));
+    r->p = q;
+    if (q >= r->end)
+      json_error(r, "unterminated string");
+    if (*q == '"')
+      break;
+    if ((unsigned char)*q < 0x20)
+      json_error(r, "control character in string");
+    r->p = ++q;  /* skip backslash */
+    if (q >= r->end)
+      json_error(r, "unterminated string");
+    r->p++;
+    switch (*q) {
+      case '"': case '\\': case '/': scratch_addchar(r, *q); break;
+      case 'b': scratch_addchar(r, '\b'); break;
+      case 'f': scratch_addchar(r, '\f'); break;
+      case 'n': scratch_addchar(r, '\n'); break;
+      case 'r': scratch_addchar(r, '\r'); break;
+      case 't': scratch_addchar(r, '\t'); break;
+      case 'u': {
+        char utf[4];
+        unsigned x = read_hex4(r);
+        if (x >= 0xD800 && x <= 0xDBFF && r->end - r->p >= 6 &&
+            r->p[0] == '\\' && r->p[1] == 'u') {  /* surrogate pair? */
+          const char *save = r->p;
+          unsigned lo;
+          r->p += 2;
+          lo = read_hex4(r);
+          if (lo >= 0xDC00 && lo <= 0xDFFF)
+            x = 0x10000 + ((x - 0xD800) << 10) + (lo - 0xDC00);
+          else
+            r->p = save;  /* not a pair: encode both halves separately */
+        }
+        scratch_add(r, utf, (size_t)utf8_encode(utf, x));
+        break;
+      }
+      default:
+        r->p = q;
+        json_error(r, "invalid escape sequence");
+    }
+    s = r->p;
+    q = scan_string(s, r->end);
+  }
+  r->p = q + 1;
+  lua_pushlstring(r->L, r->scratch->s, r->scratch->n);
+}
+
 
-  /* 检查第一个非空白字符是否为{或[ */
-  if (p >= end || (*p != '{' && *p != '[')) {
-    return 0; /* 不是JSON对象或数组 */
-  }
-
-  /* 写入Lua表的开始 */
-  if (q + 2 >= out + outlen) return 0;
-  *q++ = '{';
-  *q++ = '\n';
-  depth = 1;
-  p++;
-  
-  /* 如果是数组，初始化数组相关状态 */
-  if (p[-1] == '[') {
-    in_array = 1;
-    array_index = 1;
-    parsing_key = 0;
-    after_colon = 0;
-  }
-
-  /* 确保有足够的空间写入，每次循环检查 */
-  while (p < end && depth > 0) {
-    SAFE_CHECK(32);
-    /* 跳过空白字符 */
-    while (p < end && !in_string && !escape && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
-      p++;
+static void read_number (JsonReader *r) {
+  lua_State *L = r->L;
+  const char *s = r->p;
+  const char *p = s;
+  const char *end = r->end;
+  lua_Unsigned u = 0;
+  int neg = 0, isfloat = 0, overflow = 0;
+  if (*p == '-') {
+    neg = 1;
+    p++;
+  }
+  if (p >= end || *p < '0' || *p > '9')
+    json_error(r, "invalid number");
+  if (*p == '0')
+    p++;
+  else {
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      unsigned d = (unsigned)(*p - '0');
+      if (u > (~(lua_Unsigned)0 - d) / 10)
+        overflow = 1;
+      u = u * 10 + d;
+    }
+  }
+  if (p < end && *p == '.') {
+    isfloat = 1;
+    if (++p >= end || *p < '0' || *p > '9')
+      json_error(r, "invalid number");
+    while (p < end && *p >= '0' && *p <= '9') p++;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    isfloat = 1;
+    p++;
+    if (p < end && (*p == '+' || *p == '-')) p++;
+    if (p >= end || *p < '0' || *p > '9')
+      json_error(r, "invalid number");
+    while (p < end && *p >= '0' && *p <= '9') p++;
+  }
+  r->p = p;
+  if (!isfloat && !overflow) {
+    if (!neg && u <= (lua_Unsigned)LUA_MAXINTEGER) {
+      lua_pushinteger(L, (lua_Integer)u);
+      return;
+    }
+    if (neg && u <= (lua_Unsigned)LUA_MAXINTEGER + 1u) {
+      lua_pushinteger(L, (lua_Integer)(0u - u));
+      return;
+    }
+  }
+  {  /* floats and integers out of range go through Lua's own conversion */
+    char buff[64];
+    size_t len = (size_t)(p - s);
+    if (len < sizeof(buff)) {
+      memcpy(buff, s, len);
+      buff[len] = '\0';
+      if (lua_stringtonumber(L, buff) == 0)
+        json_error(r, "invalid number");
+    }
+    else {
+      lua_pushlstring(L, s, len);
+      if (lua_stringtonumber(L, lua_tostring(L, -1)) == 0)
+        json_error(r, "invalid number");
+      lua_remove(L, -2);
     }
+  }
+}
+
+
+static void read_literal (JsonReader *r, const char *lit, size_t len) {
+  if ((size_t)(r->end - r->p) < len || memcmp(r->p, lit, len) != 0)
+    json_error(r, "invalid literal");
+  r->p += len;
+}
+
+
+static void enter (JsonReader *r) {
+  if (++r->depth > MAX_DEPTH)
+    json_error(r, "too deeply nested");
+  luaL_checkstack(r->L, 2 * JSON_BATCH + LUA_MINSTACK, "json: too deeply nested");
+  r->p++;  /* skip '[' or '{' */
+}
+
+
+/* moves the 'n' elements above the array at 't' into it, after 'count' */
+static void flush_array (lua_State *L, int t, int n, lua_Integer count) {
+  int i;
+  for (i = n; i >= 1; i--)
+    lua_rawseti(L, t, count + i);
+}
 
-    if (escape) {
-      /* 处理转义字符 */
-      *q++ = *p++;
-      escape = 0;
+
+static void read_array (JsonReader *r) {
+  lua_State *L = r->L;
+  int t = 0;  /* stack index of the table, once created */
+  int n = 0;  /* elements parked above it */
+  lua_Integer count = 0;  /* elements already stored */
+  enter(r);
+  r->p = skip_space(r->p, r->end);
+  if (r->p < r->end && *r->p == ']') {  /* empty array keeps its kind */
+    r->p++;
+    r->depth--;
+    lua_createtable(L, 0, 0);
+    luaL_setmetatable(L, JSON_ARRAY_MT);
+    return;
+  }
+  for (;;) {
+    read_value(r);
+    if (++n == JSON_BATCH) {
+      if (t == 0) {
+        lua_createtable(L, 2 * JSON_BATCH, 0);
+        lua_insert(L, -(n + 1));
+        t = lua_gettop(L) - n;
+      }
+      flush_array(L, t, n, count);
+      count += n;
+      n = 0;
+    }
+    r->p = skip_space(r->p, r->end);
+    if (r->p >= r->end)
+      json_error(r, "unterminated array");
+    if (*r->p == ',') {
+      r->p = skip_space(r->p + 1, r->end);
       continue;
     }
+    if (*r->p != ']')
+      json_error(r, "expected ',' or ']'");
+    r->p++;
+    break;
+  }
+  if (t == 0) {  /* everything fit in one batch: exact size */
+    lua_createtable(L, n, 0);
+    lua_insert(L, -(n + 1));
+    t = lua_gettop(L) - n;
+  }
+  flush_array(L, t, n, count);
+  r->depth--;
+}
 
-    if (in_string) {
-      /* 处理字符串内容 */
-      if (*p == '\\') {
-        escape = 1;
-        *q++ = *p++;
-      } else if (*p == '"') {
-        /* 字符串结束 */
-        *q++ = *p++;
-        in_string = 0;
-        
-        if (parsing_key) {
-          /* 键名结束，写入键值分隔符 */
-          *q++ = ']';
-          *q++ = '\t';
-          *q++ = '\t';
-          *q++ = '\t';
-          *q++ = '=';
-          *q++ = ' ';
-          parsing_key = 0;
-          after_colon = 1;
-        } else {
-          /* 值结束 */
-          parsing_key = 1;
-          need_comma = 1;
-          after_colon = 0;
-        }
-      } else {
-        /* 普通字符 */
-        *q++ = *p++;
+
+/* moves the 'n' key/value pairs above the object at 't' into it, in order */
+static void flush_object (lua_State *L, int t, int n) {
+  int i;
+  for (i = 1; i <= n; i++) {  /* in order, so later duplicates win */
+    lua_pushvalue(L, t + 2 * i - 1);
+    lua_pushvalue(L, t + 2 * i);
+    lua_rawset(L, t);
+  }
+  lua_settop(L, t);
+}
+
+
+static void read_object (JsonReader *r) {
+  lua_State *L = r->L;
+  int t = 0;  /* stack index of the table, once created */
+  int n = 0;  /* pairs parked above it */
+  enter(r);
+  r->p = skip_space(r->p, r->end);
+  if (r->p < r->end && *r->p == '}') {
+    r->p++;
+    r->depth--;
+    lua_createtable(L, 0, 0);
+    return;
+  }
+  for (;;) {
+    if (r->p >= r->end || *r->p != '"')
+      json_error(r, "expected string key");
+    r->p++;
+    read_string(r);  /* short keys are interned, so repeats share one string */
+    r->p = skip_space(r->p, r->end);
+    if (r->p >= r->end || *r->p != ':')
+      json_error(r, "expected ':'");
+    r->p = skip_space(r->p + 1, r->end);
+    read_value(r);
+    if (++n == JSON_BATCH) {
+      if (t == 0) {
+        lua_createtable(L, 0, 2 * JSON_BATCH);
+        lua_insert(L, -(2 * n + 1));
+        t = lua_gettop(L) - 2 * n;
       }
-    } else {
-      /* 不在字符串中 */
-      switch (*p) {
-        case '{': {
-          /* 对象开始 */
-          if (need_comma) {
-            *q++ = ',';
-            *q++ = '\n';
-            need_comma = 0;
-          }
-          if (in_array) {
-            /* 写入数组索引 */
-            SAFE_CHECK(depth + 32);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-            *q++ = '[';
-            /* 使用sprintf将数组索引转换为字符串，支持任意大小的数字 */
-          char idx_str[32];
-          int idx_len = sprintf(idx_str, "%d", array_index);
-          SAFE_CHECK(idx_len);
-          memcpy(q, idx_str, idx_len);
-          q += idx_len;
-            *q++ = ']';
-            *q++ = ' ';
-            *q++ = '=';
-            *q++ = ' ';
-            array_index++;
-          } else if (after_colon) {
-            /* 写入缩进 */
-            SAFE_CHECK(depth);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-          }
-          *q++ = '{';
-          *q++ = '\n';
-          if (depth >= MAX_DEPTH) return 0;
-          depth++;
-          parsing_key = 1;
-          after_colon = 0;
-          p++;
-          break;
-        }
-        case '}': {
-          /* 对象结束 */
-          if (depth <= 0) return 0;
-          depth--;
-          p++;
-          *q++ = '\n';
-          /* 写入缩进 */
-          SAFE_CHECK(depth);
-          for (int i = 0; i < depth; i++) {
-            *q++ = '\t';
-          }
-          *q++ = '}';
-          need_comma = 1;
-          parsing_key = 1;
-          after_colon = 0;
-          break;
-        }
-        case '[': {
-          /* 数组开始 */
-          if (need_comma) {
-            *q++ = ',';
-            *q++ = '\n';
-            need_comma = 0;
-          }
-          if (in_array) {
-            /* 写入数组索引 */
-            SAFE_CHECK(depth + 32);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-            *q++ = '[';
-            /* 使用sprintf将数组索引转换为字符串，支持任意大小的数字 */
-            char idx_str[32];
-            int idx_len = sprintf(idx_str, "%d", array_index);
-            SAFE_CHECK(idx_len);
-            memcpy(q, idx_str, idx_len);
-            q += idx_len;
-            *q++ = ']';
-            *q++ = ' ';
-            *q++ = '=';
-            *q++ = ' ';
-            array_index++;
-          } else if (after_colon) {
-            /* 写入缩进 */
-            SAFE_CHECK(depth);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-          }
-          *q++ = '{';
-          *q++ = '\n';
-          if (depth >= MAX_DEPTH) return 0;
-          depth++;
-          in_array = 1;
-          array_index = 1;
-          parsing_key = 0;
-          after_colon = 0;
-          p++;
-          break;
-        }
-        case ']': {
-          /* 数组结束 */
-          if (depth <= 0) return 0;
-          depth--;
-          p++;
-          *q++ = '\n';
-          /* 写入缩进 */
-          SAFE_CHECK(depth);
-          for (int i = 0; i < depth; i++) {
-            *q++ = '\t';
-          }
-          *q++ = '}';
-          in_array = 0;
-          need_comma = 1;
-          parsing_key = 1;
-          after_colon = 0;
-          break;
-        }
-        case '"': {
-          /* 字符串开始 */
-          if (need_comma) {
-            *q++ = ',';
-            *q++ = '\n';
-            need_comma = 0;
-          }
-          if (in_array) {
-            /* 写入数组索引 */
-            SAFE_CHECK(depth + 32);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-            *q++ = '[';
-            /* 使用sprintf将数组索引转换为字符串，支持任意大小的数字 */
-            char idx_str[32];
-            int idx_len = sprintf(idx_str, "%d", array_index);
-            SAFE_CHECK(idx_len);
-            memcpy(q, idx_str, idx_len);
-            q += idx_len;
-            *q++ = ']';
-            *q++ = ' ';
-            *q++ = '=';
-            *q++ = ' ';
-            array_index++;
-          } else if (parsing_key) {
-            /* 写入缩进 */
-            SAFE_CHECK(depth);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-            *q++ = '[';
-          } else if (after_colon) {
-            /* 写入缩进 */
-            SAFE_CHECK(depth);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-          }
-          *q++ = *p++;
-          in_string = 1;
-          break;
-        }
-        case ':': {
-          /* 冒号，不需要处理，因为我们在字符串结束时已经处理了 */
-          p++;
-          break;
-        }
-        case ',': {
-          /* 逗号，准备下一个键值对或数组元素 */
-          p++;
-          if (in_array) {
-            parsing_key = 0;
-          } else {
-            parsing_key = 1;
-          }
-          after_colon = 0;
-          break;
-        }
-        case 't': {
-          /* true值 */
-          if (need_comma) {
-            *q++ = ',';
-            *q++ = '\n';
-            need_comma = 0;
-          }
-          if (in_array) {
-            /* 写入数组索引 */
-            SAFE_CHECK(depth + 32);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-            *q++ = '[';
-            /* 使用sprintf将数组索引转换为字符串，支持任意大小的数字 */
-            char idx_str[32];
-            int idx_len = sprintf(idx_str, "%d", array_index);
-            SAFE_CHECK(idx_len);
-            memcpy(q, idx_str, idx_len);
-            q += idx_len;
-            *q++ = ']';
-            *q++ = ' ';
-            *q++ = '=';
-            *q++ = ' ';
-            array_index++;
-          } else if (after_colon) {
-            /* 写入缩进 */
-            SAFE_CHECK(depth);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-          }
-          SAFE_CHECK(4);
-          memcpy(q, "true", 4);
-          q += 4;
-          p += 4;
-          need_comma = 1;
-          parsing_key = 1;
-          after_colon = 0;
-          break;
-        }
-        case 'f': {
-          /* false值 */
-          if (need_comma) {
-            *q++ = ',';
-            *q++ = '\n';
-            need_comma = 0;
-          }
-          if (in_array) {
-            /* 写入数组索引 */
-            SAFE_CHECK(depth + 32);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-            *q++ = '[';
-            /* 使用sprintf将数组索引转换为字符串，支持任意大小的数字 */
-            char idx_str[32];
-            int idx_len = sprintf(idx_str, "%d", array_index);
-            SAFE_CHECK(idx_len);
-            memcpy(q, idx_str, idx_len);
-            q += idx_len;
-            *q++ = ']';
-            *q++ = ' ';
-            *q++ = '=';
-            *q++ = ' ';
-            array_index++;
-          } else if (after_colon) {
-            /* 写入缩进 */
-            SAFE_CHECK(depth);
-            for (int i = 0; i < depth; i++) {
-              *q++ = '\t';
-            }
-          }
-          SAFE_CHECK(5);
-          memcpy(q, "false", 5);
-          q += 5;
-          p += 5;
-          need_comma = 1;
-          parsing_key = 1;
-          after_colon = 0;
+      flush_object(L, t, n);
+      n = 0;
+    }
+    r->p = skip_space(r->p, r->end);
+    if (r->p >= r->end)
+      json_error(r, "unterminated object");
+    if (*r->p == ',') {
+      r->p = skip_space(r->p + 1, r->end);
+      continue;
+    }
+    if (*r->p != '}')
+      json_error(r, "expected ',' or '}'");
+    r->p++;
+    break;
+  }
+  if (t == 0) {
+    lua_createtable(L, 0, n);
+    lua_insert(L, -(2 * n + 1));
+    t = lua_gettop(L) - 2 * n;
+  }
+  flush_object(L, t, n);
+  r->depth--;
+}
+
+
+static void read_value (JsonReader *r) {
+  r->p = skip_space(r->p, r->end);
+  if (r->p >= r->end)
+    json_error(r, "unexpected end of input");
+  switch (*r->p) {
+    case '{': read_object(r); break;
+    case '[': read_array(r); break;
+    case '"': r->p++; read_string(r); break;
+    case 't': read_literal(r, "true", 4); lua_pushboolean(r->L, 1); break;
+    case 'f': read_literal(r, "false", 5); lua_pushboolean(r->L, 0); break;
+    case 'n': read_literal(r, "null", 4); json_null(r->L); break;
+    default:
+      if (*r->p == '-' || (*r->p >= '0' && *r->p <= '9'))
+        read_number(r);
+      else
+        json_error(r, "unexpected character");
+  }
+}
+
+
+/*
+** Decodes one complete document and pushes it; raises an error on
+** malformed input.
+*/
+static void json_decode_doc (lua_State *L, const char *s, size_t len) {
+  JsonReader r;
+  r.L = L;
+  r.start = r.p = s;
+  r.end = s + len;
+  r.depth = 0;
+  r.scratch = jsonbuf_new(L);  /* stays below every parked value */
+  read_value(&r);
+  r.p = skip_space(r.p, r.end);
+  if (r.p != r.end)
+    json_error(&r, "trailing characters");
+  jsonbuf_free(L, r.scratch);  /* release the buffer right away */
+  lua_remove(L, -2);  /* remove scratch box */
+}
+
+
+/**
+ * @brief Decodes a JSON text.
+ *
+ * Objects become tables with string keys, arrays become sequences, and
+ * null becomes json.null. Empty arrays carry the json.array metatable so
+ * that they encode back to "[]".
+ *
+ * Usage: json.decode(s)
+ *
+ * @param L The Lua state.
+ * @return 1 (the decoded value).
+ */
+static int json_decode (lua_State *L) {
+  size_t len;
+  const char *s = luaL_checklstring(L, 1, &len);
+  lua_settop(L, 1);  /* keep the source anchored while decoding */
+  json_decode_doc(L, s, len);
+  return 1;
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Encoder
+** =======================================================
+*/
+
+typedef struct JsonWriter {
+  lua_State *L;
+  JsonBuffer *buf;
+  int depth;
+} JsonWriter;
+
+
+static void put_lstring (JsonWriter *w, const char *s, size_t l) {
+  memcpy(jsonbuf_prep(w->L, w->buf, l), s, l);
+  w->buf->n += l;
+}
+
+
+#define put_literal(w, s)  put_lstring(w, "" s, sizeof(s) - 1)
+
+
+static void put_char (JsonWriter *w, char c) {
+  *jsonbuf_prep(w->L, w->buf, 1) = c;
+  w->buf->n++;
+}
+
+
+static void put_string (JsonWriter *w, const char *s, size_t l) {
+  static const char hex[] = "0123456789abcdef";
+  const char *end = s + l;
+  put_char(w, '"');
+  while (s < end) {
+    const char *q = scan_string(s, end);
+    put_lstring(w, s, (size_t)(q - s));
+    if (q >= end)
+      break;
+    switch (*q) {
+      case '"': put_literal(w, "\\\""); break;
+      case '\\': put_literal(w, "\\\\"); break;
+      case '\b': put_literal(w, "\\b"); break;
+      case '\f': put_literal(w, "\\f"); break;
+      case '\n': put_literal(w, "\\n"); break;
+      case '\r': put_literal(w, "\\r"); break;
+      case '\t': put_literal(w, "\\t"); break;
+      default: {
+        char u[6] = {'\\', 'u', '0', '0', 0, 0};
+        u[4] = hex[((unsigned char)*q) >> 4];
+        u[5] = hex[((unsigned char)*q) & 0xF];
+        put_lstring(w, u, 6);
+      }
+    }
+    s = q + 1;
+  }
+  put_char(w, '"');
+}
+
+
+static void put_number (JsonWriter *w, int idx) {
+  char buff[64];
+  int len;
+  if (lua_isinteger(w->L, idx))
+    len = snprintf(buff, sizeof(buff), LUA_INTEGER_FMT,
+                   (LUAI_UACINT)lua_tointeger(w->L, idx));
+  else {
+    lua_Number n = lua_tonumber(w->L, idx);
+    if (!isfinite(n))
+      luaL_error(w->L, "json: cannot encode NaN or infinity");
+    len = snprintf(buff, sizeof(buff), "%.14g", (double)n);
+    if (strtod(buff, NULL) != (double)n)  /* needs more digits to round-trip */
+      len = snprintf(buff, sizeof(buff), "%.17g", (double)n);
+    if (strspn(buff, "-0123456789") == (size_t)len) {  /* looks like an int? */
+      buff[len++] = '.';  /* keep it a float when decoded back */
+      buff[len++] = '0';
+    }
+  }
+  put_lstring(w, buff, (size_t)len);
+}
+
+
+static void write_value (JsonWriter *w, int idx);
+
+
+/* returns the array length of the table at 'idx', or -1 if it is not one */
+static lua_Integer array_length (lua_State *L, int idx) {
+  lua_Integer n, keys = 0;
+  if (lua_getmetatable(L, idx)) {
+    int isarray;
+    luaL_getmetatable(L, JSON_ARRAY_MT);
+    isarray = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+    if (isarray)
+      return (lua_Integer)lua_rawlen(L, idx);
+  }
+  n = (lua_Integer)lua_rawlen(L, idx);
+  if (n == 0)
+    return -1;
+  lua_pushnil(L);
+  while (lua_next(L, idx)) {
+    lua_pop(L, 1);
+    if (!lua_isinteger(L, -1) || ++keys > n) {
+      lua_pop(L, 1);
+      return -1;
+    }
+  }
+  return (keys == n) ? n : -1;
+}
+
+
+static void write_table (JsonWriter *w, int idx) {
+  lua_State *L = w->L;
+  lua_Integer n, i;
+  int first = 1;
+  if (++w->depth > MAX_DEPTH)
+    luaL_error(L, "json: table too deeply nested or cyclic");
+  luaL_checkstack(L, LUA_MINSTACK, "json: table too deeply nested");
+  n = array_length(L, idx);
+  if (n >= 0) {
+    put_char(w, '[');
+    for (i = 1; i <= n; i++) {
+      if (i > 1) put_char(w, ',');
+      lua_rawgeti(L, idx, i);
+      write_value(w, lua_gettop(L));
+      lua_pop(L, 1);
+    }
+    put_char(w, ']');
+  }
+  else {
+    put_char(w, '{');
+    lua_pushnil(L);
+    while (lua_next(L, idx)) {
+      int top = lua_gettop(L);
+      if (!first) put_char(w, ',');
+      first = 0;
+      switch (lua_type(L, top - 1)) {
+        case LUA_TSTRING: {
+          size_t l;
+          const char *k = lua_tolstring(L, top - 1, &l);
+          put_string(w, k, l);
           break;
         }
-        default: {
-          /* 数字值 */
-          if (*p >= '0' && *p <= '9') {
-            if (need_comma) {
-              *q++ = ',';
-              *q++ = '\n';
-              need_comma = 0;
-            }
-            if (in_array) {
-              /* 写入数组索引 */
-              SAFE_CHECK(depth + 32);
-              for (int i = 0; i < depth; i++) {
-                *q++ = '\t';
-              }
-              *q++ = '[';
-              /* 使用sprintf将数组索引转换为字符串，支持任意大小的数字 */
-            char idx_str[32];
-            int idx_len = sprintf(idx_str, "%d", array_index);
-            SAFE_CHECK(idx_len);
-            memcpy(q, idx_str, idx_len);
-            q += idx_len;
-              *q++ = ']';
-              *q++ = ' ';
-              *q++ = '=';
-              *q++ = ' ';
-              array_index++;
-            } else if (after_colon) {
-              /* 写入缩进 */
-              SAFE_CHECK(depth);
-              for (int i = 0; i < depth; i++) {
-                *q++ = '\t';
-              }
-            }
-            /* 复制数字 */
-            while (p < end && (*p >= '0' && *p <= '9' || *p == '.' || *p == '-' || *p == 'e' || *p == 'E')) {
-              SAFE_CHECK(1);
-              *q++ = *p++;
-            }
-            need_comma = 1;
-            parsing_key = 1;
-            after_colon = 0;
-          } else {
-            /* 跳过其他字符 */
-            p++;
-          }
+        case LUA_TNUMBER: {
+          char buff[64];
+          int len;
+          if (lua_isinteger(L, top - 1))
+            len = snprintf(buff, sizeof(buff), LUA_INTEGER_FMT,
+                           (LUAI_UACINT)lua_tointeger(L, top - 1));
+          else
+            len = snprintf(buff, sizeof(buff), "%.17g",
+                           (double)lua_tonumber(L, top - 1));
+          put_string(w, buff, (size_t)len);
           break;
         }
+        default:
+          luaL_error(L, "json: table key must be a string or a number, got %s",
+                     luaL_typename(L, top - 1));
       }
+      put_char(w, ':');
+      write_value(w, top);
+      lua_pop(L, 1);
     }
+    put_char(w, '}');
   }
+  w->depth--;
+}
 
-  /* 检查是否成功解析 */
-  if (depth != 0) {
-    return 0; /* 解析失败 */
+
+static void write_value (JsonWriter *w, int idx) {
+  lua_State *L = w->L;
+  switch (lua_type(L, idx)) {
+    case LUA_TNIL: put_literal(w, "null"); break;
+    case LUA_TBOOLEAN:
+      if (lua_toboolean(L, idx)) put_literal(w, "true");
+      else put_literal(w, "false");
+      break;
+    case LUA_TNUMBER: put_number(w, idx); break;
+    case LUA_TSTRING: {
+      size_t l;
+      const char *s = lua_tolstring(L, idx, &l);
+      put_string(w, s, l);
+      break;
+    }
+    case LUA_TTABLE: write_table(w, idx); break;
+    case LUA_TLIGHTUSERDATA:
+      if (lua_touserdata(L, idx) == NULL) {  /* json.null */
+        put_literal(w, "null");
+        break;
+      }
+      /* FALLTHROUGH */
+    default:
+      luaL_error(L, "json: cannot encode a %s", luaL_typename(L, idx));
   }
+}
+
+
+/**
+ * @brief Encodes a value as compact JSON text.
+ *
+ * Tables whose keys are exactly 1..n, and tables tagged with json.array,
+ * become arrays; other tables become objects with string or number keys.
+ * nil and json.null encode as null.
+ *
+ * Usage: json.encode(value)
+ *
+ * @param L The Lua state.
+ * @return 1 (the JSON string).
+ */
+static int json_encode (lua_State *L) {
+  JsonWriter w;
+  luaL_checkany(L, 1);
+  lua_settop(L, 1);
+  w.L = L;
+  w.depth = 0;
+  w.buf = jsonbuf_new(L);
+  write_value(&w, 1);
+  lua_pushlstring(L, w.buf->s, w.buf->n);
+  jsonbuf_free(L, w.buf);  /* release the buffer right away */
+  return 1;
+}
+
+/* }====================================================== */
+
 
-  /* 只写入分号，不需要再写入结束符 */
-  if ((q + 2) < out + outlen) {
-    *q++ = ';';
-    *q = '\0';
+/**
+ * @brief Tags a table as a JSON array, so that it encodes as "[...]"
+ * even when empty.
+ *
+ * Usage: json.array([t])
+ *
+ * @param L The Lua state.
+ * @return 1 (the table).
+ */
+static int json_array (lua_State *L) {
+  if (lua_isnoneornil(L, 1)) {
+    lua_settop(L, 0);
+    lua_newtable(L);
+  }
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_settop(L, 1);
+  luaL_setmetatable(L, JSON_ARRAY_MT);
+  return 1;
+}
+
+
+/*
+** Each call of a loaded JSON chunk returns a fresh document. The one
+** decoded at load time (upvalue 3) is handed out by the first call;
+** later calls decode the source text (upvalue 2) again.
+*/
+static int json_chunk (lua_State *L) {
+  size_t len;
+  const char *s;
+  if (!lua_isnil(L, lua_upvalueindex(3))) {
+    lua_pushvalue(L, lua_upvalueindex(3));
+    lua_pushnil(L);
+    lua_replace(L, lua_upvalueindex(3));
     return 1;
-  } else {
-    return 0; /* 缓冲区不足 */
   }
-}
\ No newline at end of file
+  s = lua_tolstring(L, lua_upvalueindex(2), &len);
+  json_decode_doc(L, s, len);
+  return 1;
+}
+
+
+static int json_loadchunk (lua_State *L) {
+  const char *s = (const char *)lua_touserdata(L, 1);
+  size_t len = (size_t)lua_tointeger(L, 2);
+  lua_settop(L, 0);
+  luaL_requiref(L, LUA_JSONLIBNAME, luaopen_json, 0);  /* metatables */
+  lua_pop(L, 1);
+  lua_pushnil(L);  /* upvalue 1 stands in for _ENV, as 'load' may set it */
+  lua_pushlstring(L, s, len);
+  json_decode_doc(L, s, len);
+  lua_pushcclosure(L, json_chunk, 3);
+  return 1;
+}
+
+
+int json_loadbuffer (lua_State *L, const char *s, size_t len) {
+  lua_pushcfunction(L, json_loadchunk);
+  lua_pushlightuserdata(L, (void *)s);
+  lua_pushinteger(L, (lua_Integer)len);
+  return lua_pcall(L, 2, 1, 0);
+}
+
+
+static const luaL_Reg json_funcs[] = {
+  {"decode", json_decode},
+  {"encode", json_encode},
+  {"array", json_array},
+  {"null", NULL},
+  {NULL, NULL}
+};
+
+
+LUAMOD_API int luaopen_json (lua_State *L) {
+  luaL_newmetatable(L, JSON_ARRAY_MT);
+  lua_pop(L, 1);
+  if (luaL_newmetatable(L, JSON_BUFFER_MT)) {
+    lua_pushcfunction(L, jsonbuf_gc);
+    lua_setfield(L, -2, "__gc");
+  }
+  lua_pop(L, 1);
+  luaL_newlib(L, json_funcs);
+  json_null(L);
+  lua_setfield(L, -2, "null");
+  return 1;
+}
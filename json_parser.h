@@ -4,15 +4,17 @@
 #include "lua.h"
 
 /**
- * @brief Converts JSON to a Lua table.
- * 
+ * @brief Loads a JSON document as a chunk.
+ *
+ * Decodes the text directly into Lua values and pushes a function that
+ * returns the decoded value, so that loadfile/dofile accept JSON files.
+ *
  * @param L Lua state.
- * @param json JSON string.
- * @param len JSON string length.
- * @param out Output buffer.
- * @param outlen Output buffer length.
- * @return 1 on success, 0 on failure.
+ * @param json JSON text.
+ * @param len JSON text length.
+ * @return LUA_OK with the chunk pushed, or an error status with the error
+ *         message pushed.
  */
-int json_to_lua(lua_State *L, const char *json, size_t len, char *out, size_t outlen);
+int json_loadbuffer(lua_State *L, const char *json, size_t len);
 
 #endif /* JSON_PARSER_H */
@@ -1056,16 +1056,16 @@ l_sinline int auxgetstr (lua_State *L, const TValue *t, const char *k) {
   TString *str = luaS_new(L, k);
   if (ttistable(t)) {
      Table *h = hvalue(t);
-     l_rwlock_rdlock(&h->lock);
+     l_rwlock_t *hlk = luaH_rdlock(h);
      const TValue *res = luaH_getstr(h, str);
      if (!isempty(res)) {
         setobj2s(L, L->top.p, res);
-        l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         api_incr_top(L);
         lua_unlock(L);
         return ttype(s2v(L->top.p - 1));
      }
-     l_rwlock_unlock(&h->lock);
+     luaH_unlock(hlk);
   }
   setsvalue2s(L, L->top.p, str);
   api_incr_top(L);
@@ -1118,15 +1118,15 @@ LUA_API int lua_gettable (lua_State *L, int idx) {
   t = index2value(L, idx);
   if (ttistable(t)) {
      Table *h = hvalue(t);
-     l_rwlock_rdlock(&h->lock);
+     l_rwlock_t *hlk = luaH_rdlock(h);
      const TValue *res = luaH_get(h, s2v(L->top.p - 1));
      if (!isempty(res)) {
         setobj2s(L, L->top.p - 1, res);
-        l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         lua_unlock(L);
         return ttype(s2v(L->top.p - 1));
      }
-     l_rwlock_unlock(&h->lock);
+     luaH_unlock(hlk);
   }
   luaV_finishget(L, t, s2v(L->top.p - 1), L->top.p - 1, NULL);
   lua_unlock(L);
@@ -1162,16 +1162,16 @@ LUA_API int lua_geti (lua_State *L, int idx, lua_Integer n) {
   t = index2value(L, idx);
   if (ttistable(t)) {
      Table *h = hvalue(t);
-     l_rwlock_rdlock(&h->lock);
+     l_rwlock_t *hlk = luaH_rdlock(h);
      const TValue *res = luaH_getint(h, n);
      if (!isempty(res)) {
         setobj2s(L, L->top.p, res);
-        l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         api_incr_top(L);
         lua_unlock(L);
         return ttype(s2v(L->top.p - 1));
      }
-     l_rwlock_unlock(&h->lock);
+     luaH_unlock(hlk);
   }
   TValue aux;
   setivalue(&aux, n);
@@ -1212,14 +1212,14 @@ LUA_API int lua_rawget (lua_State *L, int idx) {
   lua_lock(L);
   api_checknelems(L, 1);
   t = gettable(L, idx);
-  l_rwlock_rdlock(&t->lock);
+  l_rwlock_t *tlk = luaH_rdlock(t);
   const TValue *val = luaH_get(t, s2v(L->top.p - 1));
   if (isempty(val)) {
      setnilvalue(s2v(L->top.p - 1));
   } else {
      setobj2s(L, L->top.p - 1, val);
   }
-  l_rwlock_unlock(&t->lock);
+  luaH_unlock(tlk);
   // Stack top is already updated (we overwrote key)
   // finishrawget did api_incr_top and unlock.
   // We overwrote key at top-1. We don't need to push.
@@ -1251,14 +1251,14 @@ LUA_API int lua_rawgeti (lua_State *L, int idx, lua_Integer n) {
   Table *t;
   lua_lock(L);
   t = gettable(L, idx);
-  l_rwlock_rdlock(&t->lock);
+  l_rwlock_t *tlk = luaH_rdlock(t);
   const TValue *val = luaH_getint(t, n);
   if (isempty(val)) {
      setnilvalue(s2v(L->top.p));
   } else {
      setobj2s(L, L->top.p, val);
   }
-  l_rwlock_unlock(&t->lock);
+  luaH_unlock(tlk);
   api_incr_top(L);
   lua_unlock(L);
   return ttype(s2v(L->top.p - 1));
@@ -1279,14 +1279,14 @@ LUA_API int lua_rawgetp (lua_State *L, int idx, const void *p) {
   lua_lock(L);
   t = gettable(L, idx);
   setpvalue(&k, cast_voidp(p));
-  l_rwlock_rdlock(&t->lock);
+  l_rwlock_t *tlk = luaH_rdlock(t);
   const TValue *val = luaH_get(t, &k);
   if (isempty(val)) {
      setnilvalue(s2v(L->top.p));
   } else {
      setobj2s(L, L->top.p, val);
   }
-  l_rwlock_unlock(&t->lock);
+  luaH_unlock(tlk);
   api_incr_top(L);
   lua_unlock(L);
   return ttype(s2v(L->top.p - 1));
@@ -1391,17 +1391,17 @@ static void auxsetstr (lua_State *L, const TValue *t, const char *k) {
   api_checknelems(L, 1);
   if (ttistable(t)) {
      Table *h = hvalue(t);
-     l_rwlock_wrlock(&h->lock);
+     l_rwlock_t *hlk = luaH_wrlock(h);
      const TValue *res = luaH_getstr(h, str);
      if (!isempty(res) && !isabstkey(res)) {
         setobj2t(L, cast(TValue *, res), s2v(L->top.p - 1));
         luaC_barrierback(L, obj2gco(h), s2v(L->top.p - 1));
-        l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         L->top.p--;
         lua_unlock(L);
         return;
      }
-     l_rwlock_unlock(&h->lock);
+     luaH_unlock(hlk);
   }
   setsvalue2s(L, L->top.p, str);  /* push 'str' (to make it a TValue) */
   api_incr_top(L);
@@ -1438,17 +1438,17 @@ LUA_API void lua_settable (lua_State *L, int idx) {
   t = index2value(L, idx);
   if (ttistable(t)) {
      Table *h = hvalue(t);
-     l_rwlock_wrlock(&h->lock);
+     l_rwlock_t *hlk = luaH_wrlock(h);
      const TValue *res = luaH_get(h, s2v(L->top.p - 2));
      if (!isempty(res) && !isabstkey(res)) {
         setobj2t(L, cast(TValue *, res), s2v(L->top.p - 1));
         luaC_barrierback(L, obj2gco(h), s2v(L->top.p - 1));
-        l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         L->top.p -= 2;
         lua_unlock(L);
         return;
      }
-     l_rwlock_unlock(&h->lock);
+     luaH_unlock(hlk);
   }
   luaV_finishset(L, t, s2v(L->top.p - 2), s2v(L->top.p - 1), NULL);
   L->top.p -= 2;  /* pop index and value */
@@ -1483,17 +1483,17 @@ LUA_API void lua_seti (lua_State *L, int idx, lua_Integer n) {
   t = index2value(L, idx);
   if (ttistable(t)) {
      Table *h = hvalue(t);
-     l_rwlock_wrlock(&h->lock);
+     l_rwlock_t *hlk = luaH_wrlock(h);
      const TValue *res = luaH_getint(h, n);
      if (!isempty(res) && !isabstkey(res)) {
         setobj2t(L, cast(TValue *, res), s2v(L->top.p - 1));
         luaC_barrierback(L, obj2gco(h), s2v(L->top.p - 1));
-        l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         L->top.p--;
         lua_unlock(L);
         return;
      }
-     l_rwlock_unlock(&h->lock);
+     luaH_unlock(hlk);
   }
   TValue aux;
   setivalue(&aux, n);
@@ -1508,11 +1508,11 @@ static void aux_rawset (lua_State *L, int idx, TValue *key, int n) {
   lua_lock(L);
   api_checknelems(L, n);
   t = gettable(L, idx);
-  l_rwlock_wrlock(&t->lock);
+  l_rwlock_t *tlk = luaH_wrlock(t);
   luaH_set(L, t, key, s2v(L->top.p - 1));
   invalidateTMcache(t);
   luaC_barrierback(L, obj2gco(t), s2v(L->top.p - 1));
-  l_rwlock_unlock(&t->lock);
+  luaH_unlock(tlk);
   L->top.p -= n;
   lua_unlock(L);
 }
@@ -1579,10 +1579,10 @@ LUA_API void lua_rawseti (lua_State *L, int idx, lua_Integer n) {
   lua_lock(L);
   api_checknelems(L, 1);
   t = gettable(L, idx);
-  l_rwlock_wrlock(&t->lock);
+  l_rwlock_t *tlk = luaH_wrlock(t);
   luaH_setint(L, t, n, s2v(L->top.p - 1));
   luaC_barrierback(L, obj2gco(t), s2v(L->top.p - 1));
-  l_rwlock_unlock(&t->lock);
+  luaH_unlock(tlk);
   L->top.p--;
   lua_unlock(L);
 }
@@ -1604,7 +1604,7 @@ LUA_API void lua_table_iextend (lua_State *L, int idx, int n) {
   lua_lock(L);
   api_check(L, n >= 0, "negative n in lua_table_iextend");
   t = gettable(L, idx);
-  l_rwlock_wrlock(&t->lock);
+  l_rwlock_t *tlk = luaH_wrlock(t);
   if (n > 0) {
     unsigned int old_size = t->alimit;
     unsigned int new_size = old_size + n;
@@ -1615,7 +1615,7 @@ LUA_API void lua_table_iextend (lua_State *L, int idx, int n) {
     }
     luaC_barrierback(L, obj2gco(t), s2v(L->top.p - 1));
   }
-  l_rwlock_unlock(&t->lock);
+  luaH_unlock(tlk);
   lua_unlock(L);
 }
 
@@ -1642,13 +1642,13 @@ LUA_API int lua_setmetatable (lua_State *L, int objindex) {
   switch (ttype(obj)) {
     case LUA_TTABLE: {
       Table *h = hvalue(obj);
-      l_rwlock_wrlock(&h->lock);
+      l_rwlock_t *hlk = luaH_wrlock(h);
       h->metatable = mt;
       if (mt) {
         luaC_objbarrier(L, gcvalue(obj), mt);
         luaC_checkfinalizer(L, gcvalue(obj), mt);
       }
-      l_rwlock_unlock(&h->lock);
+      luaH_unlock(hlk);
       break;
     }
     case LUA_TUSERDATA: {
@@ -1906,6 +1906,37 @@ LUA_API int lua_dump_obfuscated (lua_State *L, lua_Writer writer, void *data,
 }
 
 
+/**
+ * @brief Dumps a function in the fast-loading container format.
+ *
+ * The chunk shares one set of opcode/string maps and is verified by a
+ * single SHA-256 digest, so loading costs one hash pass over the chunk.
+ *
+ * @param L Lua state.
+ * @param writer Writer function.
+ * @param data Writer data.
+ * @param strip Whether to strip debug info.
+ * @param obfuscate_flags Obfuscation flags (as for lua_dump_obfuscated).
+ * @param seed Random seed (0 for time-based).
+ * @return 0 on success, non-zero on failure.
+ */
+LUA_API int lua_dump_fast (lua_State *L, lua_Writer writer, void *data,
+                           int strip, int obfuscate_flags, unsigned int seed) {
+  int status;
+  TValue *o;
+  lua_lock(L);
+  api_checknelems(L, 1);
+  o = s2v(L->top.p - 1);
+  if (isLfunction(o))
+    status = luaU_dump_fast(L, getproto(o), writer, data, strip,
+                            obfuscate_flags, seed);
+  else
+    status = 1;
+  lua_unlock(L);
+  return status;
+}
+
+
 /**
  * @brief Returns the status of the thread `L`.
  *
@@ -2524,19 +2555,7 @@ LUA_API int lua_is (lua_State *L, int idx, const char *type_name) {
 LUA_API void lua_checktype (lua_State *L, int idx, const char *type_name) {
   lua_lock(L);
   TValue *val = index2value(L, idx);
-  int res = 0;
-
-  if (strcmp(type_name, "any") == 0) res = 1;
-  else if (strcmp(type_name, "int") == 0 || strcmp(type_name, "integer") == 0) res = ttisinteger(val);
-  else if (strcmp(type_name, "number") == 0 || strcmp(type_name, "float") == 0) res = ttisnumber(val);
-  else if (strcmp(type_name, "string") == 0) res = ttisstring(val);
-  else if (strcmp(type_name, "boolean") == 0) res = ttisboolean(val);
-  else if (strcmp(type_name, "table") == 0) res = ttistable(val);
-  else if (strcmp(type_name, "function") == 0) res = ttisfunction(val);
-  else if (strcmp(type_name, "thread") == 0) res = ttisthread(val);
-  else if (strcmp(type_name, "userdata") == 0) res = checktype(val, LUA_TUSERDATA);
-  else if (strcmp(type_name, "nil") == 0 || strcmp(type_name, "void") == 0) res = ttisnil(val);
-
+  int res = (luaV_typemask(luaV_typecode(type_name)) & luaV_typebits(val)) != 0;
   lua_unlock(L);
 
   if (!res) {
@@ -2562,6 +2581,7 @@ LUA_API void lua_linknamespace (lua_State *L, int idx1, int idx2) {
      Namespace *target = nsvalue(o2);
      ns->using_next = target;
      luaC_objbarrier(L, ns, target);
+     luaN_invalidate(L);
   } else if (ttistable(o1) && ttisnamespace(o2)) {
      Table *t = hvalue(o1);
      Namespace *target = nsvalue(o2);
@@ -2705,10 +2725,10 @@ LUA_API void lua_getcmds (lua_State *L) {
     sethvalue2s(L, L->top.p, t);
     TValue val; sethvalue(L, &val, t);
     TValue k; setsvalue(L, &k, key);
-    if (reg->is_shared) l_rwlock_wrlock(&reg->lock);
+    l_rwlock_t *reglk = luaH_wrlock(reg);
     luaH_set(L, reg, &k, &val);
     luaC_barrierback(L, obj2gco(reg), &val);
-    if (reg->is_shared) l_rwlock_unlock(&reg->lock);
+    luaH_unlock(reglk);
   }
   api_incr_top(L);
   lua_unlock(L);
@@ -2726,10 +2746,10 @@ LUA_API void lua_getops (lua_State *L) {
     sethvalue2s(L, L->top.p, t);
     TValue val; sethvalue(L, &val, t);
     TValue k; setsvalue(L, &k, key);
-    if (reg->is_shared) l_rwlock_wrlock(&reg->lock);
+    l_rwlock_t *reglk = luaH_wrlock(reg);
     luaH_set(L, reg, &k, &val);
     luaC_barrierback(L, obj2gco(reg), &val);
-    if (reg->is_shared) l_rwlock_unlock(&reg->lock);
+    luaH_unlock(reglk);
   }
   api_incr_top(L);
   lua_unlock(L);
@@ -2747,15 +2767,18 @@ LUA_API void lua_errnnil (lua_State *L, int idx, const char *msg) {
 LUA_API void lua_locktable (lua_State *L, int idx) {
   Table *t;
   t = gettable(L, idx);
-  if (t != NULL && t->is_shared) {
-    l_rwlock_wrlock(&t->lock);
-  }
+  if (t != NULL)
+    luaH_wrlock(t);
 }
 
 LUA_API void lua_unlocktable (lua_State *L, int idx) {
   Table *t;
   t = gettable(L, idx);
-  if (t != NULL && t->is_shared) {
-    l_rwlock_unlock(&t->lock);
+  if (t != NULL) {
+    /* the table may have been shared since 'lua_locktable'; only release
+       a lock this thread actually holds */
+    l_rwlock_t *tlk = luaH_lockof(t);
+    if (tlk && atomic_load(&tlk->writer_thread_id) == l_thread_selfid())
+      l_rwlock_unlock(tlk);
   }
 }
@@ -756,11 +756,16 @@ typedef struct LoadF {
 
 
 /* Nirithy== Shell Implementation */
-static const char* nirithy_b64 = "9876543210zyxwvutsrqponmlkjihgfedcbaZYXWVUTSRQPONMLKJIHGFEDCBA-_";
-
+/*
+** Value of 'c' in the envelope's base64 alphabet,
+** "9876543210zyxwvutsrqponmlkjihgfedcbaZYXWVUTSRQPONMLKJIHGFEDCBA-_".
+*/
 static int nirithy_b64_val(char c) {
-  const char *p = strchr(nirithy_b64, c);
-  if (p) return (int)(p - nirithy_b64);
+  if (c >= '0' && c <= '9') return '9' - c;
+  if (c >= 'a' && c <= 'z') return 10 + ('z' - c);
+  if (c >= 'A' && c <= 'Z') return 36 + ('Z' - c);
+  if (c == '-') return 62;
+  if (c == '_') return 63;
   return -1;
 }
 
@@ -1019,35 +1024,17 @@ LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
     size_t content_len = fread(json_content, 1, file_size, lf.f);
     json_content[content_len] = '\0';
     
-    /* Allocate a large enough output buffer */
-    char *lua_buffer = (char *)malloc(file_size * 2 + 1024);
-    if (!lua_buffer) {
-      free(json_content);
-      if (filename) fclose(lf.f);
-      return errfile(L, "allocate", fnameindex);
-    }
-    
-    /* Convert JSON to Lua table */
-    if (json_to_lua(L, json_content, content_len, lua_buffer, file_size * 2 + 1024)) {
-      /* Use luaL_loadbuffer to load the converted Lua code */
-      status = luaL_loadbuffer(L, lua_buffer, strlen(lua_buffer), lua_tostring(L, -1));
+    /* Decode straight into Lua values */
+    if (json_loadbuffer(L, json_content, content_len) == LUA_OK) {
       readstatus = 0;
-      
-      /* Close file */
       if (filename) fclose(lf.f);
-      
-      /* Free buffers */
       free(json_content);
-      free(lua_buffer);
-      
-      /* Remove filename and return status */
       lua_remove(L, fnameindex);
-      return status;
+      return LUA_OK;
     }
-    
-    /* Free buffers */
+    lua_pop(L, 1);  /* not JSON after all: parse it as Lua */
+
     free(json_content);
-    free(lua_buffer);
   }
   
   /* Not JSON format or JSON conversion failed, reset file pointer */
@@ -2717,13 +2717,95 @@ static int luaB_isgeneric(lua_State *L) {
   return 1;
 }
 
+/*
+** State of a generic function wrapper: for each argument, the generic
+** parameter (1-based) its annotation names, or 0; and the counters of
+** its specialization cache.
+*/
+typedef struct GenericInfo {
+  lua_Unsigned hits;  /* calls served by an instantiated function */
+  lua_Unsigned misses;  /* calls that had to run the factory */
+  int nparams;  /* number of generic parameters */
+  int nslots;  /* number of entries in 'slot' */
+  int slot[1];
+} GenericInfo;
+
+
+/*
+** Push what inference binds a generic parameter to for argument 'arg':
+** the definition of a struct, or the type tag of anything else. The
+** tag is turned into a type name only when the factory must run.
+*/
+static void pushgenerickey (lua_State *L, int arg) {
+  if (lua_type(L, arg) == LUA_TSTRUCT) {
+    lua_pushvalue(L, arg);
+    lua_lock(L);
+    sethvalue(L, s2v(L->top.p - 1), structvalue(s2v(L->top.p - 1))->def);
+    lua_unlock(L);
+  }
+  else
+    lua_pushinteger(L, lua_type(L, arg));
+}
+
+
+/*
+** Specializations are kept in a trie of weak-keyed tables, one level
+** per generic parameter, rooted at upvalue 5. A function without
+** generic parameters keeps its only instance under 'true'.
+*/
+static int getspecialization (lua_State *L, int keys, int np) {
+  int j;
+  lua_pushvalue(L, lua_upvalueindex(5));
+  if (np == 0) {
+    lua_pushboolean(L, 1);
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+  }
+  for (j = 0; j < np && lua_istable(L, -1); j++) {
+    lua_pushvalue(L, keys + j);
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+  }
+  if (j < np) {  /* trie ends before the last level */
+    lua_pop(L, 1);
+    lua_pushnil(L);
+  }
+  return !lua_isnil(L, -1);
+}
+
+
+static void setspecialization (lua_State *L, int keys, int np, int impl) {
+  int j;
+  lua_pushvalue(L, lua_upvalueindex(5));
+  for (j = 0; j < np - 1; j++) {
+    lua_pushvalue(L, keys + j);
+    if (lua_rawget(L, -2) != LUA_TTABLE) {
+      lua_pop(L, 1);
+      lua_newtable(L);
+      lua_getmetatable(L, lua_upvalueindex(5));  /* {__mode = "k"} */
+      lua_setmetatable(L, -2);
+      lua_pushvalue(L, keys + j);
+      lua_pushvalue(L, -2);
+      lua_rawset(L, -4);
+    }
+    lua_remove(L, -2);
+  }
+  if (np == 0)
+    lua_pushboolean(L, 1);
+  else
+    lua_pushvalue(L, keys + np - 1);
+  lua_pushvalue(L, impl);
+  lua_rawset(L, -3);
+  lua_pop(L, 1);
+}
+
+
 static int generic_call (lua_State *L) {
-    /* Upvalues: 1:factory, 2:params, 3:mapping */
+    /* Upvalues: 1:factory, 2:params, 3:mapping, 4:GenericInfo, 5:cache */
     /* Called as __call(self, args...) */
     int nargs = lua_gettop(L) - 1;
     int base = 2;
     int is_specialization = 0;
-
     if (nargs >= 1) {
         int t = lua_type(L, base);
         if (t == LUA_TSTRING) {
@@ -2764,79 +2846,50 @@ static int generic_call (lua_State *L) {
     }
 
     /* Inference */
-    lua_newtable(L); /* inferred map */
-    int inferred_idx = lua_gettop(L);
-
-    int nmapping = luaL_len(L, lua_upvalueindex(3));
-    for (int i = 0; i < nargs && i < nmapping; i++) {
-        lua_rawgeti(L, lua_upvalueindex(3), i + 1);
-        const char *param_type_name = lua_tostring(L, -1);
-        lua_pop(L, 1);
-
-        if (param_type_name) {
-            int nparams = luaL_len(L, lua_upvalueindex(2));
-            int is_generic = 0;
-            for (int j = 1; j <= nparams; j++) {
-                lua_rawgeti(L, lua_upvalueindex(2), j);
-                const char *gp = lua_tostring(L, -1);
-                lua_pop(L, 1);
-                if (gp && strcmp(gp, param_type_name) == 0) {
-                    is_generic = 1;
-                    break;
-                }
-            }
-
-            if (is_generic) {
-                lua_pushvalue(L, base + i);
-                if (lua_type(L, -1) == LUA_TSTRUCT) {
-                    const TValue *o = s2v(L->top.p - 1);
-                    Struct *s = structvalue(o);
-                    lua_lock(L);
-                    sethvalue(L, s2v(L->top.p), s->def);
-                    L->top.p++;
-                    lua_unlock(L);
-                    lua_remove(L, -2);
-                } else {
-                    lua_pushstring(L, luaL_typename(L, -1));
-                    lua_remove(L, -2);
-                }
-
-                lua_pushstring(L, param_type_name);
-                lua_rawget(L, inferred_idx);
-                if (!lua_isnil(L, -1)) {
-                    if (!lua_compare(L, -1, -2, LUA_OPEQ)) {
-                        return luaL_error(L, "type inference failed: inconsistent types for '%s'", param_type_name);
-                    }
-                    lua_pop(L, 2);
-                } else {
-                    lua_pop(L, 1);
-                    lua_pushstring(L, param_type_name);
-                    lua_pushvalue(L, -2);
-                    lua_rawset(L, inferred_idx);
-                    lua_pop(L, 1);
-                }
-            }
+    GenericInfo *gi = (GenericInfo *)lua_touserdata(L, lua_upvalueindex(4));
+    int np = gi->nparams;
+    int keys = lua_gettop(L) + 1;
+    luaL_checkstack(L, np + LUA_MINSTACK, "too many generic parameters");
+    lua_settop(L, keys + np - 1);  /* one (nil) binding per generic parameter */
+    for (int i = 0; i < nargs && i < gi->nslots; i++) {
+        int j = gi->slot[i];
+        if (j == 0) continue;
+        pushgenerickey(L, base + i);
+        if (lua_isnil(L, keys + j - 1))
+            lua_replace(L, keys + j - 1);
+        else if (lua_rawequal(L, -1, keys + j - 1))
+            lua_pop(L, 1);
+        else {
+            lua_rawgeti(L, lua_upvalueindex(2), j);
+            return luaL_error(L, "type inference failed: inconsistent types for '%s'",
+                              lua_tostring(L, -1));
+        }
+    }
+    for (int j = 0; j < np; j++) {
+        if (lua_isnil(L, keys + j)) {
+            lua_rawgeti(L, lua_upvalueindex(2), j + 1);
+            return luaL_error(L, "could not infer type for '%s'", lua_tostring(L, -1));
         }
     }
 
-    int nparams = luaL_len(L, lua_upvalueindex(2));
-    lua_pushvalue(L, lua_upvalueindex(1));
-
-    for (int j = 1; j <= nparams; j++) {
-        lua_rawgeti(L, lua_upvalueindex(2), j);
-        const char *gp = lua_tostring(L, -1);
+    int impl_idx = keys + np;
+    if (getspecialization(L, keys, np))
+        gi->hits++;
+    else {
         lua_pop(L, 1);
-
-        lua_pushstring(L, gp);
-        lua_rawget(L, inferred_idx);
-        if (lua_isnil(L, -1)) {
-            return luaL_error(L, "could not infer type for '%s'", gp);
+        gi->misses++;
+        lua_pushvalue(L, lua_upvalueindex(1));
+        for (int j = 0; j < np; j++) {
+            if (lua_isinteger(L, keys + j))
+                lua_pushstring(L, lua_typename(L, (int)lua_tointeger(L, keys + j)));
+            else
+                lua_pushvalue(L, keys + j);
         }
+        lua_call(L, np, 1); /* impl */
+        if (!lua_isnil(L, impl_idx))
+            setspecialization(L, keys, np, impl_idx);
     }
 
-    lua_call(L, nparams, 1); /* impl */
-
-    int impl_idx = lua_gettop(L);
     lua_pushvalue(L, impl_idx);
     for (int i = 0; i < nargs; i++) {
        lua_pushvalue(L, base + i);
@@ -2850,13 +2903,43 @@ static int luaB_generic_wrap(lua_State *L) {
     luaL_checktype(L, 2, LUA_TTABLE);
     luaL_checktype(L, 3, LUA_TTABLE);
 
+    int nparams = (int)luaL_len(L, 2);
+    int nslots = (int)luaL_len(L, 3);
+    GenericInfo *gi = (GenericInfo *)lua_newuserdatauv(L,
+        offsetof(GenericInfo, slot) + (nslots + 1) * sizeof(int), 0);
+    gi->hits = gi->misses = 0;
+    gi->nparams = nparams;
+    gi->nslots = nslots;
+    for (int i = 1; i <= nslots; i++) {  /* resolve annotations once */
+        gi->slot[i - 1] = 0;
+        if (lua_rawgeti(L, 3, i) == LUA_TSTRING) {
+            for (int j = 1; j <= nparams; j++) {
+                lua_rawgeti(L, 2, j);
+                int found = lua_rawequal(L, -1, -2);
+                lua_pop(L, 1);
+                if (found) {
+                    gi->slot[i - 1] = j;
+                    break;
+                }
+            }
+        }
+        lua_pop(L, 1);
+    }
+    int info = lua_gettop(L);
+
     lua_newtable(L); /* wrapper table */
     lua_newtable(L); /* metatable */
 
     lua_pushvalue(L, 1);
     lua_pushvalue(L, 2);
     lua_pushvalue(L, 3);
-    lua_pushcclosure(L, generic_call, 3);
+    lua_pushvalue(L, info);
+    lua_newtable(L); /* specialization cache */
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_pushcclosure(L, generic_call, 5);
     lua_setfield(L, -2, "__call");
 
     lua_pushboolean(L, 1);
@@ -2866,6 +2949,23 @@ static int luaB_generic_wrap(lua_State *L) {
     return 1;
 }
 
+/*
+** genericstats(f): hits and misses of the specialization cache of the
+** generic function 'f'.
+*/
+static int luaB_genericstats(lua_State *L) {
+    GenericInfo *gi = NULL;
+    if (lua_getmetatable(L, 1) &&
+        lua_getfield(L, -1, "__call") == LUA_TFUNCTION &&
+        lua_tocfunction(L, -1) == generic_call &&
+        lua_getupvalue(L, -1, 4) != NULL)
+        gi = (GenericInfo *)lua_touserdata(L, -1);
+    luaL_argexpected(L, gi != NULL, 1, "generic function");
+    lua_pushinteger(L, (lua_Integer)gi->hits);
+    lua_pushinteger(L, (lua_Integer)gi->misses);
+    return 2;
+}
+
 static const luaL_Reg base_funcs[] = {
   {"__async_wrap", luaB_async_wrap},
   {"__generic_wrap", luaB_generic_wrap},
@@ -2875,6 +2975,7 @@ static const luaL_Reg base_funcs[] = {
   {"typeof", luaB_typeof},
   {"issubtype", luaB_issubtype},
   {"isgeneric", luaB_isgeneric},
+  {"genericstats", luaB_genericstats},
   {"assert", luaB_assert},
   {"collectgarbage", luaB_collectgarbage},
   {"defer", luaB_defer},
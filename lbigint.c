@@ -1,385 +1,1014 @@
+/*
+** Arbitrary-precision integers.
+** Integer '+', '-' and '*' that overflow in the VM continue here, and
+** any result that fits in a lua_Integer goes back to a plain integer.
+**
+** Magnitudes are little-endian arrays of 64-bit limbs. Products are
+** schoolbook below KARATSUBA_THRESHOLD limbs and Karatsuba above it;
+** division is Knuth's algorithm D; decimal conversion splits the number
+** by powers 10^(19*2^k) and divides with Newton reciprocals, so it costs
+** O(M(n) log n) instead of one pass over the number per digit.
+*/
+
 #define lbigint_c
 #define LUA_CORE
 
 #include "lprefix.h"
 
+#include <limits.h>
+#include <math.h>
 #include <string.h>
-#include <stdlib.h>
-#include <stdio.h>
 
 #include "lua.h"
-#include "lobject.h"
-#include "lstate.h"
+
+#include "lbigint.h"
+#include "ldebug.h"
 #include "lgc.h"
 #include "lmem.h"
-#include "lbigint.h"
+#include "lobject.h"
+#include "lstate.h"
 #include "lstring.h"
 #include "lvm.h"
-#include "ldebug.h"
 
-#define BIGINT_BASE_BITS 32
-#define BIGINT_BASE ((l_uint64)1 << BIGINT_BASE_BITS)
 
-TBigInt *luaB_new(lua_State *L, unsigned int len) {
-  size_t size = sizeof(TBigInt) + (len > 0 ? (len - 1) : 0) * sizeof(l_uint32);
-  GCObject *o = luaC_newobj(L, LUA_VNUMBIG, size);
-  TBigInt *b = gco2big(o);
-  b->len = len;
-  b->sign = 1;
-  memset(b->buff, 0, len * sizeof(l_uint32));
-  return b;
+typedef l_uint64 Limb;
+
+#define LIMBBITS	64
+
+/* smallest operand length (in limbs) multiplied with Karatsuba */
+#define KARATSUBA_THRESHOLD	32
+
+/* largest power of 10 that fits in a limb, and its number of digits */
+#define DECBASE		((Limb)10000000000000000000u)
+#define DECDIGITS	19
+
+/* decimal conversion of numbers up to this many limbs goes limb by limb */
+#define TOSTR_THRESHOLD	4
+
+/* results up to this many limbs are built on the C stack */
+#define SMALLBIG	4
+
+/* largest magnitude, in limbs, that an operation may produce */
+#define MAXBIGLEN	(INT_MAX / (int)sizeof(Limb) / 16)
+
+
+/*
+** {======================================================
+** Double-width limb operations
+** =======================================================
+*/
+
+#if defined(__GNUC__)
+#define limbclz(x)	__builtin_clzll(x)
+#else
+static int limbclz (Limb x) {
+  int n = 0;
+  while (!(x & ((Limb)1 << (LIMBBITS - 1)))) { x <<= 1; n++; }
+  return n;
+}
+#endif
+
+
+#if defined(__SIZEOF_INT128__)
+
+typedef unsigned __int128 DLimb;
+
+#define mulwide(a,b,hi,lo)  \
+  { DLimb p_ = (DLimb)(a) * (b); (hi) = (Limb)(p_ >> LIMBBITS); (lo) = (Limb)p_; }
+
+/* (hi:lo) / d for hi < d; the remainder goes to '*r' */
+static Limb divwide (Limb hi, Limb lo, Limb d, Limb *r) {
+  Limb q = (Limb)((((DLimb)hi << LIMBBITS) | lo) / d);
+  *r = lo - q * d;
+  return q;
+}
+
+#else  /* no 128-bit type: work on 32-bit halves */
+
+#define HALF(x)		((x) & 0xffffffffu)
+
+static void mulwide_ (Limb a, Limb b, Limb *hi, Limb *lo) {
+  Limb ll = HALF(a) * HALF(b), lh = HALF(a) * (b >> 32);
+  Limb hl = (a >> 32) * HALF(b), hh = (a >> 32) * (b >> 32);
+  Limb mid = (ll >> 32) + HALF(lh) + HALF(hl);
+  *lo = (mid << 32) | HALF(ll);
+  *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
 }
 
-static void big_normalize(TBigInt *b) {
-  while (b->len > 0 && b->buff[b->len - 1] == 0) {
-    b->len--;
+#define mulwide(a,b,hi,lo)	mulwide_(a, b, &(hi), &(lo))
+
+/* (hi:lo) / d for hi < d (Hacker's Delight, 'divlu') */
+static Limb divwide (Limb hi, Limb lo, Limb d, Limb *r) {
+  const Limb b = (Limb)1 << 32;
+  Limb dn1, dn0, un32, un21, un10, un1, un0, q1, q0, rhat;
+  int s = limbclz(d);
+  d <<= s;
+  dn1 = d >> 32; dn0 = HALF(d);
+  un32 = (hi << s) | (s == 0 ? 0 : lo >> (LIMBBITS - s));
+  un10 = lo << s;
+  un1 = un10 >> 32; un0 = HALF(un10);
+  q1 = un32 / dn1; rhat = un32 - q1 * dn1;
+  while (q1 >= b || q1 * dn0 > b * rhat + un1) {
+    q1--; rhat += dn1;
+    if (rhat >= b) break;
+  }
+  un21 = un32 * b + un1 - q1 * d;
+  q0 = un21 / dn1; rhat = un21 - q0 * dn1;
+  while (q0 >= b || q0 * dn0 > b * rhat + un0) {
+    q0--; rhat += dn1;
+    if (rhat >= b) break;
   }
-  if (b->len == 0) b->sign = 1; /* Zero is always positive */
+  *r = (un21 * b + un0 - q0 * d) >> s;
+  return q1 * b + q0;
 }
 
-/* Copies src to dst (allocated). dst must be large enough. */
-static void big_copy(TBigInt *dst, const TBigInt *src) {
-  dst->sign = src->sign;
-  dst->len = src->len;
-  if (src->len > 0)
-    memcpy(dst->buff, src->buff, src->len * sizeof(l_uint32));
+#endif
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Magnitudes (arrays of limbs)
+** =======================================================
+*/
+
+/* length of 'a' without its leading zero limbs */
+static int normlen (const Limb *a, int n) {
+  while (n > 0 && a[n - 1] == 0) n--;
+  return n;
 }
 
-void luaB_fromint(lua_State *L, lua_Integer i, TValue *res) {
-  TBigInt *b = luaB_new(L, 2); /* 64-bit int fits in 2 32-bit limbs */
-  if (i < 0) {
-    b->sign = -1;
-    /* Handle min integer specially or just negate */
-    if (i == LUA_MININTEGER) {
-        /* -(-2^63) = 2^63. 0x8000...000 */
-        /* 2^63 in base 2^32 is: low=0, high=0x80000000 */
-        b->buff[0] = 0;
-        b->buff[1] = 0x80000000;
-        b->len = 2;
-        setbigvalue(L, res, b);
-        return;
-    }
-    i = -i;
-  } else {
-    b->sign = 1;
+
+/* compare magnitudes; leading zero limbs are ignored */
+static int cmpmag (const Limb *a, int an, const Limb *b, int bn) {
+  an = normlen(a, an);
+  bn = normlen(b, bn);
+  if (an != bn) return an < bn ? -1 : 1;
+  while (an-- > 0) {
+    if (a[an] != b[an]) return a[an] < b[an] ? -1 : 1;
   }
+  return 0;
+}
 
-  l_uint64 ui = (l_uint64)i;
-  b->buff[0] = (l_uint32)(ui & 0xFFFFFFFF);
-  b->buff[1] = (l_uint32)(ui >> 32);
-  big_normalize(b);
-  setbigvalue(L, res, b);
+
+/* r = a + b, all 'n' limbs long; returns the carry */
+static Limb addn (Limb *r, const Limb *a, const Limb *b, int n) {
+  Limb c = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    Limb s = a[i] + c;
+    c = (s < c);
+    s += b[i];
+    c += (s < b[i]);
+    r[i] = s;
+  }
+  return c;
 }
 
-/* Helper: Get a BigInt view of a TValue.
-   If it's an integer, allocate a temporary BigInt, push it to stack, and return it.
-   Returns NULL if conversion fails.
-   'pushes' is incremented if a value is pushed to stack.
-*/
-static TBigInt *to_bigint(lua_State *L, TValue *v, int *pushes) {
-  if (ttisbigint(v)) {
-    return bigvalue(v);
-  } else if (ttisinteger(v)) {
-    TBigInt *b = luaB_new(L, 2);
-    setbigvalue(L, s2v(L->top.p), b);
-    L->top.p++; /* anchor */
-    (*pushes)++;
-
-    lua_Integer i = ivalue(v);
-    if (i < 0) {
-      b->sign = -1;
-      if (i == LUA_MININTEGER) {
-        b->buff[0] = 0; b->buff[1] = 0x80000000; b->len = 2;
-        return b;
-      }
-      i = -i;
-    } else {
-      b->sign = 1;
-    }
-    b->buff[0] = (l_uint32)((l_uint64)i & 0xFFFFFFFF);
-    b->buff[1] = (l_uint32)((l_uint64)i >> 32);
-    big_normalize(b);
-    return b;
+
+/* r = a - b, all 'n' limbs long; returns the borrow */
+static Limb subn (Limb *r, const Limb *a, const Limb *b, int n) {
+  Limb c = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    Limb x = a[i], y = b[i] + c;
+    c = (y < c) | (x < y);
+    r[i] = x - y;
   }
-  return NULL;
+  return c;
 }
 
-/* Compare magnitudes. Returns -1 if |a| < |b|, 0 if equal, 1 if |a| > |b| */
-static int cmp_abs(const TBigInt *a, const TBigInt *b) {
-  if (a->len != b->len) return a->len < b->len ? -1 : 1;
-  for (int i = a->len - 1; i >= 0; i--) {
-    if (a->buff[i] != b->buff[i]) return a->buff[i] < b->buff[i] ? -1 : 1;
+
+/* add 'c' to the 'n' limbs of 'r'; returns the carry out */
+static Limb incr (Limb *r, int n, Limb c) {
+  int i;
+  for (i = 0; i < n && c != 0; i++) {
+    r[i] += c;
+    c = (r[i] < c);
   }
-  return 0;
+  return c;
 }
 
-int luaB_compare(TValue *v1, TValue *v2) {
-  /* Assumes v1 and v2 are BigInt or Integer */
-  /* We can't easily use to_bigint here because we don't have L for allocation if needed.
-     But wait, if we are in luaB_compare, one of them MUST be BigInt (dispatch logic).
-     Actually we generally need L to allocate temporary bigints for comparison if mixed.
-     But we can do "virtual" comparison without allocation. */
-
-  int s1, s2;
-  unsigned int l1, l2;
-  l_uint32 buf1[2], buf2[2]; /* For integer conversion */
-  const l_uint32 *d1, *d2;
-
-  if (ttisbigint(v1)) {
-    TBigInt *b = bigvalue(v1);
-    s1 = b->sign; l1 = b->len; d1 = b->buff;
-  } else {
-    lua_Integer i = ivalue(v1);
-    if (i < 0) { s1 = -1; if (i!=LUA_MININTEGER) i = -i; } else s1 = 1;
-    if (i == 0) l1 = 0;
-    else if (i == LUA_MININTEGER) { buf1[0]=0; buf1[1]=0x80000000; l1=2; }
-    else {
-        buf1[0] = (l_uint32)i; buf1[1] = (l_uint32)(i>>32);
-        l1 = (buf1[1] != 0) ? 2 : 1;
-    }
-    d1 = buf1;
-  }
-
-  if (ttisbigint(v2)) {
-    TBigInt *b = bigvalue(v2);
-    s2 = b->sign; l2 = b->len; d2 = b->buff;
-  } else {
-    lua_Integer i = ivalue(v2);
-    if (i < 0) { s2 = -1; if (i!=LUA_MININTEGER) i = -i; } else s2 = 1;
-    if (i == 0) l2 = 0;
-    else if (i == LUA_MININTEGER) { buf2[0]=0; buf2[1]=0x80000000; l2=2; }
-    else {
-        buf2[0] = (l_uint32)i; buf2[1] = (l_uint32)(i>>32);
-        l2 = (buf2[1] != 0) ? 2 : 1;
-    }
-    d2 = buf2;
+
+/* r[0..an) = a + b for an >= bn; returns the carry */
+static Limb add (Limb *r, const Limb *a, int an, const Limb *b, int bn) {
+  Limb c = addn(r, a, b, bn);
+  if (r != a) memcpy(r + bn, a + bn, (an - bn) * sizeof(Limb));
+  return incr(r + bn, an - bn, c);
+}
+
+
+/* r[0..an) = a - b for a >= b; returns the borrow (zero) */
+static Limb sub (Limb *r, const Limb *a, int an, const Limb *b, int bn) {
+  Limb c = subn(r, a, b, bn);
+  int i;
+  for (i = bn; i < an; i++) {
+    Limb x = a[i];
+    r[i] = x - c;
+    c = (x < c);
   }
+  return c;
+}
+
+
+/* r = a * m; returns the high limb */
+static Limb mul1 (Limb *r, const Limb *a, int n, Limb m) {
+  Limb c = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    Limb hi, lo;
+    mulwide(a[i], m, hi, lo);
+    lo += c;
+    hi += (lo < c);
+    r[i] = lo;
+    c = hi;
+  }
+  return c;
+}
+
 
-  if (s1 != s2) return s1 < s2 ? -1 : 1;
+/* r += a * m; returns the carry limb */
+static Limb addmul1 (Limb *r, const Limb *a, int n, Limb m) {
+  Limb c = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    Limb hi, lo;
+    mulwide(a[i], m, hi, lo);
+    lo += c;
+    hi += (lo < c);
+    lo += r[i];
+    hi += (lo < r[i]);
+    r[i] = lo;
+    c = hi;
+  }
+  return c;
+}
 
-  int cmp = 0;
-  if (l1 != l2) cmp = l1 < l2 ? -1 : 1;
+
+/* r -= a * m; returns the borrow limb */
+static Limb submul1 (Limb *r, const Limb *a, int n, Limb m) {
+  Limb c = 0;
+  int i;
+  for (i = 0; i < n; i++) {
+    Limb hi, lo, x;
+    mulwide(a[i], m, hi, lo);
+    lo += c;
+    hi += (lo < c);
+    x = r[i];
+    hi += (x < lo);
+    r[i] = x - lo;
+    c = hi;
+  }
+  return c;
+}
+
+
+/* r = a << s, 0 <= s < LIMBBITS; returns the bits shifted out */
+static Limb shl (Limb *r, const Limb *a, int n, int s) {
+  Limb out = 0;
+  int i;
+  if (s == 0) {
+    memmove(r, a, n * sizeof(Limb));
+    return 0;
+  }
+  for (i = 0; i < n; i++) {
+    Limb x = a[i];
+    r[i] = (x << s) | out;
+    out = x >> (LIMBBITS - s);
+  }
+  return out;
+}
+
+
+/* r = a >> s, 0 <= s < LIMBBITS */
+static void shr (Limb *r, const Limb *a, int n, int s) {
+  int i;
+  if (s == 0) {
+    memmove(r, a, n * sizeof(Limb));
+    return;
+  }
+  for (i = 0; i < n; i++)
+    r[i] = (a[i] >> s) | (i + 1 < n ? a[i + 1] << (LIMBBITS - s) : 0);
+}
+
+
+/* r[0..an+bn) = a * b, bn >= 1; 'r' must not overlap the operands */
+static void mulbase (Limb *r, const Limb *a, int an, const Limb *b, int bn) {
+  int j;
+  r[an] = mul1(r, a, an, b[0]);
+  for (j = 1; j < bn; j++)
+    r[an + j] = addmul1(r + j, a, an, b[j]);
+}
+
+
+/* d[0..xn) = |x - y| for yn <= xn; returns whether x < y */
+static int absdiff (Limb *d, const Limb *x, int xn, const Limb *y, int yn) {
+  if (cmpmag(x, xn, y, yn) >= 0) {
+    sub(d, x, xn, y, yn);
+    return 0;
+  }
+  else {  /* x < y, so the limbs of 'x' above 'yn' are zero */
+    subn(d, y, x, yn);
+    memset(d + yn, 0, (xn - yn) * sizeof(Limb));
+    return 1;
+  }
+}
+
+
+/* scratch limbs used by 'kmul' on 'n' limbs */
+static int kscratch (int n) {
+  int s = 0;
+  while (n >= KARATSUBA_THRESHOLD) {
+    int h = n - n / 2;
+    s += 6 * h + 1;
+    n = h;
+  }
+  return s;
+}
+
+
+/*
+** Karatsuba: r[0..2n) = a * b, both 'n' limbs long. With a = a1*B^h + a0
+** and b = b1*B^h + b0, the middle term a0*b1 + a1*b0 is
+** z0 + z2 - (a0 - a1)*(b0 - b1), which takes three half-size products.
+*/
+static void kmul (Limb *r, const Limb *a, const Limb *b, int n, Limb *w) {
+  if (n < KARATSUBA_THRESHOLD)
+    mulbase(r, a, n, b, n);
   else {
-    for (int i = l1 - 1; i >= 0; i--) {
-      if (d1[i] != d2[i]) { cmp = d1[i] < d2[i] ? -1 : 1; break; }
-    }
+    int h = n - n / 2, l = n / 2;
+    Limb *da = w, *db = w + h, *t = w + 2 * h, *mid = w + 4 * h;
+    Limb *ws = w + 6 * h + 1;
+    int neg = absdiff(da, a, h, a + h, l) ^ absdiff(db, b, h, b + h, l);
+    kmul(r, a, b, h, ws);  /* z0 */
+    kmul(r + 2 * h, a + h, b + h, l, ws);  /* z2 */
+    kmul(t, da, db, h, ws);
+    mid[2 * h] = add(mid, r, 2 * h, r + 2 * h, 2 * l);  /* z0 + z2 */
+    if (neg)
+      mid[2 * h] += addn(mid, mid, t, 2 * h);
+    else
+      mid[2 * h] -= subn(mid, mid, t, 2 * h);
+    incr(r + 3 * h + 1, 2 * n - 3 * h - 1, addn(r + h, r + h, mid, 2 * h + 1));
   }
+}
 
-  return s1 == 1 ? cmp : -cmp;
+
+/* scratch limbs used by 'mul' when the shorter operand has 'n' limbs */
+static int mulscratch (int n) {
+  return (n < KARATSUBA_THRESHOLD) ? 0 : 10 * n + kscratch(n);
 }
 
-/* dst = |a| + |b| */
-static void add_abs(TBigInt *dst, const TBigInt *a, const TBigInt *b) {
-  unsigned int len = a->len > b->len ? a->len : b->len;
-  l_uint64 carry = 0;
-  for (unsigned int i = 0; i < len || carry; i++) {
-    l_uint64 sum = carry;
-    if (i < a->len) sum += a->buff[i];
-    if (i < b->len) sum += b->buff[i];
-    dst->buff[i] = (l_uint32)sum;
-    carry = sum >> 32;
+
+/*
+** r[0..an+bn) = a * b for an, bn >= 1. Unbalanced operands are split
+** into slices as long as the shorter one. 'r' must not overlap the
+** operands.
+*/
+static void mul (Limb *r, const Limb *a, int an, const Limb *b, int bn,
+                 Limb *w) {
+  if (an < bn) {
+    const Limb *t = a; int tn = an;
+    a = b; an = bn; b = t; bn = tn;
   }
-  dst->len = len + (carry ? 1 : 0);
-  if (dst->buff[dst->len-1] == 0 && dst->len > 0) big_normalize(dst); /* Should generally not happen in add unless 0 */
+  if (bn < KARATSUBA_THRESHOLD)
+    mulbase(r, a, an, b, bn);
+  else if (an == bn)
+    kmul(r, a, b, bn, w);
   else {
-      /* Re-check len if carry caused extension */
-      if (dst->buff[len] != 0) dst->len = len + 1;
-      else dst->len = len;
+    Limb *t = w;
+    int i;
+    w += 2 * bn;
+    kmul(r, a, b, bn, w);
+    for (i = bn; i < an; i += bn) {
+      int m = (an - i < bn) ? an - i : bn;
+      if (m == bn)
+        kmul(t, a + i, b, bn, w);
+      else
+        mul(t, a + i, m, b, bn, w);
+      /* r[i..i+bn) holds the upper half of the previous slice */
+      add(r + i, t, m + bn, r + i, bn);
+    }
   }
-  big_normalize(dst);
 }
 
-/* dst = |a| - |b|. Assumes |a| >= |b| */
-static void sub_abs(TBigInt *dst, const TBigInt *a, const TBigInt *b) {
-  long long borrow = 0;
-  for (unsigned int i = 0; i < a->len; i++) {
-    long long diff = (long long)a->buff[i] - borrow;
-    if (i < b->len) diff -= b->buff[i];
 
-    if (diff < 0) {
-      diff += BIGINT_BASE;
-      borrow = 1;
-    } else {
-      borrow = 0;
+/* q = a / d for a single-limb divisor; returns the remainder */
+static Limb divrem1 (Limb *q, const Limb *a, int n, Limb d) {
+  Limb r = 0;
+  while (n-- > 0)
+    q[n] = divwide(r, a[n], d, &r);
+  return r;
+}
+
+
+/*
+** Knuth's algorithm D: q[0..an-bn] = a / b and r[0..bn) = a % b, for
+** an >= bn >= 2 and b[bn-1] != 0. 'w' has an + bn + 1 limbs.
+*/
+static void divknuth (Limb *q, Limb *r, const Limb *a, int an,
+                      const Limb *b, int bn, Limb *w) {
+  Limb *u = w, *v = w + an + 1;
+  Limb vtop, vnext;
+  int s = limbclz(b[bn - 1]);
+  int j;
+  shl(v, b, bn, s);  /* normalize so that the top bit of 'v' is set */
+  u[an] = shl(u, a, an, s);
+  vtop = v[bn - 1];
+  vnext = v[bn - 2];
+  for (j = an - bn; j >= 0; j--) {
+    Limb ujn = u[j + bn], qhat, rhat, borrow;
+    int exact = 1;  /* 'rhat' fits in a limb? */
+    if (ujn >= vtop) {  /* ujn == vtop */
+      qhat = ~(Limb)0;
+      rhat = u[j + bn - 1] + vtop;
+      exact = (rhat >= vtop);
     }
-    dst->buff[i] = (l_uint32)diff;
-  }
-  dst->len = a->len;
-  big_normalize(dst);
-}
-
-void luaB_add(lua_State *L, TValue *v1, TValue *v2, TValue *res) {
-  int pushes = 0;
-  TBigInt *b1 = to_bigint(L, v1, &pushes);
-  TBigInt *b2 = to_bigint(L, v2, &pushes);
-
-  if (b1 && b2) {
-    unsigned int max_len = (b1->len > b2->len ? b1->len : b2->len) + 1;
-    TBigInt *r = luaB_new(L, max_len);
-
-    if (b1->sign == b2->sign) {
-      add_abs(r, b1, b2);
-      r->sign = b1->sign;
-    } else {
-      int cmp = cmp_abs(b1, b2);
-      if (cmp >= 0) {
-        sub_abs(r, b1, b2);
-        r->sign = b1->sign;
-      } else {
-        sub_abs(r, b2, b1);
-        r->sign = b2->sign;
-      }
+    else
+      qhat = divwide(ujn, u[j + bn - 1], vtop, &rhat);
+    while (exact) {  /* qhat*v[n-2] > rhat*B + u[j+n-2]? */
+      Limb hi, lo;
+      mulwide(qhat, vnext, hi, lo);
+      if (hi < rhat || (hi == rhat && lo <= u[j + bn - 2]))
+        break;
+      qhat--;
+      rhat += vtop;
+      exact = (rhat >= vtop);
     }
-    setbigvalue(L, res, r);
-  } else {
-    setnilvalue(res);
-  }
-  L->top.p -= pushes;
-}
-
-void luaB_sub(lua_State *L, TValue *v1, TValue *v2, TValue *res) {
-  int pushes = 0;
-  TBigInt *b1 = to_bigint(L, v1, &pushes);
-  TBigInt *b2 = to_bigint(L, v2, &pushes);
-
-  if (b1 && b2) {
-    unsigned int max_len = (b1->len > b2->len ? b1->len : b2->len) + 1;
-    TBigInt *r = luaB_new(L, max_len);
-
-    if (b1->sign != b2->sign) {
-      add_abs(r, b1, b2);
-      r->sign = b1->sign;
-    } else {
-      int cmp = cmp_abs(b1, b2);
-      if (cmp >= 0) {
-        sub_abs(r, b1, b2);
-        r->sign = b1->sign;
-      } else {
-        sub_abs(r, b2, b1);
-        r->sign = -b1->sign;
-      }
+    borrow = submul1(u + j, v, bn, qhat);
+    u[j + bn] = ujn - borrow;
+    if (ujn < borrow) {  /* 'qhat' was one too large: add 'v' back */
+      qhat--;
+      u[j + bn] += addn(u + j, u + j, v, bn);
     }
-    setbigvalue(L, res, r);
-  } else {
-    setnilvalue(res);
+    q[j] = qhat;
+  }
+  if (r != NULL)
+    shr(r, u, bn, s);
+}
+
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Lua values
+** =======================================================
+*/
+
+/* signed view of an integer or big integer operand */
+typedef struct BigNum {
+  const Limb *d;
+  int n;
+  int neg;
+  Limb one;  /* limb storage for integer operands */
+} BigNum;
+
+
+/* fill 'x' from 'o'; fails for anything but integers and big integers */
+static int tobignum (const TValue *o, BigNum *x) {
+  if (ttisbigint(o)) {
+    TBigInt *b = bigvalue(o);
+    x->d = b->buff;
+    x->n = normlen(b->buff, cast_int(b->len));
+    x->neg = (b->sign < 0 && x->n > 0);
+  }
+  else if (ttisinteger(o)) {
+    lua_Integer i = ivalue(o);
+    x->neg = (i < 0);
+    x->one = x->neg ? 0u - (Limb)l_castS2U(i) : (Limb)l_castS2U(i);
+    x->d = &x->one;
+    x->n = (i != 0);
   }
-  L->top.p -= pushes;
+  else
+    return 0;
+  return 1;
 }
 
-void luaB_mul(lua_State *L, TValue *v1, TValue *v2, TValue *res) {
-  int pushes = 0;
-  TBigInt *b1 = to_bigint(L, v1, &pushes);
-  TBigInt *b2 = to_bigint(L, v2, &pushes);
 
-  if (b1 && b2) {
-    if (b1->len == 0 || b2->len == 0) {
-        TBigInt *r = luaB_new(L, 0);
-        setbigvalue(L, res, r);
-        L->top.p -= pushes;
-        return;
+static TBigInt *newbig (lua_State *L, int n) {
+  GCObject *o = luaC_newobj(L, LUA_VNUMBIG, sizebigint(n));
+  TBigInt *b = gco2big(o);
+  b->len = b->size = cast_uint(n);
+  b->sign = 1;
+  return b;
+}
+
+
+TBigInt *luaB_new (lua_State *L, unsigned int len) {
+  TBigInt *b = newbig(L, cast_int(len));
+  memset(b->buff, 0, len * sizeof(Limb));
+  return b;
+}
+
+
+/* limbs kept alive on the stack until the caller pops them */
+static Limb *pushscratch (lua_State *L, int n) {
+  TBigInt *b = newbig(L, n);
+  setbigvalue(L, s2v(L->top.p), b);
+  L->top.p++;
+  return b->buff;
+}
+
+
+static void checklen (lua_State *L, lua_Unsigned n) {
+  if (n > (lua_Unsigned)MAXBIGLEN)
+    luaG_runerror(L, "BigInt result too large");
+}
+
+
+/*
+** Store the magnitude 'd' with sign 'neg' in 'res': as an integer when
+** it fits, else in 'r' (if 'd' is already its buffer) or a new bigint.
+*/
+static void setresult (lua_State *L, TValue *res, const Limb *d, int n,
+                       int neg, TBigInt *r) {
+  n = normlen(d, n);
+  if (n <= 1) {
+    Limb m = (n == 0) ? 0 : d[0];
+    if (m <= (Limb)LUA_MAXINTEGER) {
+      lua_Integer i = l_castU2S((lua_Unsigned)m);
+      setivalue(res, neg ? -i : i);
+      return;
     }
-    unsigned int len = b1->len + b2->len;
-    TBigInt *r = luaB_new(L, len);
-
-    for (unsigned int i = 0; i < b1->len; i++) {
-      l_uint64 carry = 0;
-      for (unsigned int j = 0; j < b2->len; j++) {
-        l_uint64 tmp = (l_uint64)b1->buff[i] * b2->buff[j] + r->buff[i + j] + carry;
-        r->buff[i + j] = (l_uint32)tmp;
-        carry = tmp >> 32;
-      }
-      r->buff[i + b2->len] = (l_uint32)carry;
+    else if (neg && m == (Limb)LUA_MAXINTEGER + 1) {
+      setivalue(res, LUA_MININTEGER);
+      return;
     }
+  }
+  if (r == NULL) {
+    r = newbig(L, n);
+    memcpy(r->buff, d, n * sizeof(Limb));
+  }
+  r->len = cast_uint(n);
+  r->sign = neg ? -1 : 1;
+  setbigvalue(L, res, r);
+}
+
+
+void luaB_fromint (lua_State *L, lua_Integer i, TValue *res) {
+  TBigInt *b = newbig(L, 1);
+  b->sign = (i < 0) ? -1 : 1;
+  b->buff[0] = (i < 0) ? 0u - (Limb)l_castS2U(i) : (Limb)l_castS2U(i);
+  b->len = (i != 0);
+  setbigvalue(L, res, b);
+}
+
+
+lua_Number luaB_bigtonumber (const TValue *obj) {
+  TBigInt *b;
+  lua_Number r;
+  int n;
+  if (!ttisbigint(obj)) return 0.0;
+  b = bigvalue(obj);
+  n = normlen(b->buff, cast_int(b->len));
+  if (n == 0) return 0.0;
+  /* the two top limbs carry all the precision a float can hold */
+  r = cast_num(b->buff[n - 1]);
+  if (n >= 2)
+    r = r * 18446744073709551616.0 + cast_num(b->buff[n - 2]);
+  r = l_mathop(ldexp)(r, LIMBBITS * (n > 2 ? n - 2 : 0));
+  return (b->sign < 0) ? -r : r;
+}
 
-    r->sign = b1->sign * b2->sign;
-    big_normalize(r);
-    setbigvalue(L, res, r);
-  } else {
-    setnilvalue(res);
+
+/*
+** Compare a big number with a float exactly. Floats at or beyond 2^63
+** are integral and have a short exact magnitude.
+*/
+static int cmpfloat (const BigNum *a, lua_Number f) {
+  Limb m[1024 / LIMBBITS + 2];  /* enough for any finite float */
+  int sa, sf, c;
+  if (luai_numisnan(f))
+    return 2;  /* unordered */
+  sa = (a->n == 0) ? 0 : (a->neg ? -1 : 1);
+  sf = (f == 0) ? 0 : ((f < 0) ? -1 : 1);
+  if (sa != sf || sa == 0)
+    return (sa > sf) - (sa < sf);
+  f = l_mathop(fabs)(f);
+  if (f == (lua_Number)HUGE_VAL)
+    c = -1;
+  else if (f < 9223372036854775808.0) {  /* below 2^63 */
+    lua_Number fl = l_mathop(floor)(f);
+    Limb fi = (Limb)fl;
+    if (a->n > 1 || a->d[0] != fi)
+      c = (a->n > 1 || a->d[0] > fi) ? 1 : -1;
+    else
+      c = (fl < f) ? -1 : 0;
+  }
+  else {
+    int e, n;
+    lua_Number frac = l_mathop(frexp)(f, &e);  /* f = frac * 2^e, e > 63 */
+    n = (e - LIMBBITS) / LIMBBITS;
+    memset(m, 0, (n + 2) * sizeof(Limb));
+    m[n] = (Limb)l_mathop(ldexp)(frac, LIMBBITS);
+    m[n + 1] = shl(m + n, m + n, 1, (e - LIMBBITS) % LIMBBITS);
+    c = cmpmag(a->d, a->n, m, n + 2);
   }
-  L->top.p -= pushes;
+  return a->neg ? -c : c;
 }
 
-void luaB_tostring(lua_State *L, TValue *obj) {
-  if (!ttisbigint(obj)) return;
-  ptrdiff_t offset = savestack(L, obj); /* Save stack offset */
-  TBigInt *b = bigvalue(obj);
 
-  if (b->len == 0) {
-    setsvalue(L, obj, luaS_newliteral(L, "0"));
+int luaB_compare (TValue *v1, TValue *v2) {
+  BigNum a, b;
+  int c;
+  if (!tobignum(v1, &a)) {  /* float on the left? */
+    tobignum(v2, &b);
+    c = cmpfloat(&b, fltvalue(v1));
+    return (c == 2) ? 2 : -c;
+  }
+  else if (!tobignum(v2, &b))
+    return cmpfloat(&a, fltvalue(v2));
+  if (a.neg != b.neg)
+    return a.neg ? -1 : 1;
+  c = cmpmag(a.d, a.n, b.d, b.n);
+  return a.neg ? -c : c;
+}
+
+
+/* res = v1 + v2, or v1 - v2 if 'sub' */
+static void addsub (lua_State *L, TValue *v1, TValue *v2, TValue *res,
+                    int dosub) {
+  BigNum a, b;
+  BigNum *x = &a, *y = &b;
+  Limb buff[SMALLBIG];
+  Limb *d = buff;
+  TBigInt *r = NULL;
+  int n, neg;
+  if (!tobignum(v1, &a) || !tobignum(v2, &b)) {
+    lua_Number n1 = nvalue(v1), n2 = nvalue(v2);
+    setfltvalue(res, dosub ? luai_numsub(L, n1, n2) : luai_numadd(L, n1, n2));
     return;
   }
+  b.neg ^= (dosub && b.n > 0);
+  if (cmpmag(a.d, a.n, b.d, b.n) < 0) {
+    x = &b; y = &a;
+  }
+  n = x->n + 1;
+  if (n > SMALLBIG) {
+    checklen(L, n);
+    r = newbig(L, n);
+    d = r->buff;
+  }
+  if (x->neg == y->neg)
+    d[x->n] = add(d, x->d, x->n, y->d, y->n);
+  else {
+    sub(d, x->d, x->n, y->d, y->n);
+    d[x->n] = 0;
+  }
+  neg = x->neg;
+  setresult(L, res, d, n, neg, r);
+}
 
-  /* Convert to decimal string */
-  /* Estimate size: 10 digits per 32 bits is safe (2^32 approx 4e9) */
-  int estimated = b->len * 10 + 2;
-  char *buff = luaM_newvector(L, estimated, char);
-  int pos = estimated - 1;
-  buff[pos] = '\0';
 
-  /* Work on a copy since we modify it */
-  TBigInt *temp = luaB_new(L, b->len);
-  setbigvalue(L, s2v(L->top.p), temp); /* Anchor temp */
-  L->top.p++;
+void luaB_add (lua_State *L, TValue *v1, TValue *v2, TValue *res) {
+  addsub(L, v1, v2, res, 0);
+}
 
-  /* Reload b because allocation might have invalidated pointer if it triggered GC?
-     luaB_new uses luaC_newobj -> no GC check.
-     But let's be safe and reload 'b' from 'obj' which we can restore.
-  */
-  obj = s2v(restorestack(L, offset));
-  b = bigvalue(obj);
-  big_copy(temp, b);
-
-  while (temp->len > 0) {
-    /* Divide by 10, keep remainder */
-    l_uint64 rem = 0;
-    for (int i = temp->len - 1; i >= 0; i--) {
-      l_uint64 cur = temp->buff[i] + (rem << 32);
-      temp->buff[i] = (l_uint32)(cur / 10);
-      rem = cur % 10;
+
+void luaB_sub (lua_State *L, TValue *v1, TValue *v2, TValue *res) {
+  addsub(L, v1, v2, res, 1);
+}
+
+
+void luaB_mul (lua_State *L, TValue *v1, TValue *v2, TValue *res) {
+  BigNum a, b;
+  BigNum *x = &a, *y = &b;
+  Limb buff[SMALLBIG];
+  Limb *d = buff;
+  TBigInt *r = NULL;
+  int n;
+  if (!tobignum(v1, &a) || !tobignum(v2, &b)) {
+    setfltvalue(res, luai_nummul(L, nvalue(v1), nvalue(v2)));
+    return;
+  }
+  if (a.n == 0 || b.n == 0) {
+    setivalue(res, 0);
+    return;
+  }
+  if (a.n < b.n) {
+    x = &b; y = &a;
+  }
+  n = x->n + y->n;
+  checklen(L, n);
+  if (y->n < KARATSUBA_THRESHOLD) {
+    if (n > SMALLBIG) {
+      r = newbig(L, n);
+      d = r->buff;
     }
-    big_normalize(temp);
-    buff[--pos] = (char)('0' + rem);
+    mulbase(d, x->d, x->n, y->d, y->n);
+  }
+  else {
+    Limb *w = pushscratch(L, mulscratch(y->n));
+    r = newbig(L, n);
+    d = r->buff;
+    mul(d, x->d, x->n, y->d, y->n, w);
+    L->top.p--;  /* scratch */
   }
+  setresult(L, res, d, n, a.neg ^ b.neg, r);
+}
 
-  if (b->sign < 0) buff[--pos] = '-';
 
-  TString *s = luaS_new(L, buff + pos);
-  obj = s2v(restorestack(L, offset));
-  setsvalue(L, obj, s);
+void luaB_unm (lua_State *L, TValue *v, TValue *res) {
+  BigNum a;
+  if (!tobignum(v, &a)) {
+    setfltvalue(res, luai_numunm(L, nvalue(v)));
+  }
+  else
+    setresult(L, res, a.d, a.n, !a.neg, NULL);
+}
+
 
-  luaM_freearray(L, buff, estimated);
-  L->top.p--; /* Pop temp */
+/*
+** Floor division and modulo, as for Lua integers: the quotient rounds
+** toward minus infinity and the remainder takes the sign of the divisor.
+*/
+static void divmod (lua_State *L, TValue *v1, TValue *v2, TValue *res,
+                    int wantmod) {
+  BigNum a, b;
+  Limb *q, *r, *w;
+  int qn, rn, adjust;
+  if (!tobignum(v1, &a) || !tobignum(v2, &b)) {
+    lua_Number n1 = nvalue(v1), n2 = nvalue(v2);
+    if (wantmod) {
+      lua_Number m;
+      luai_nummod(L, n1, n2, m);
+      setfltvalue(res, m);
+    }
+    else
+      setfltvalue(res, luai_numidiv(L, n1, n2));
+    return;
+  }
+  if (b.n == 0)
+    luaG_runerror(L, wantmod ? "attempt to perform 'n%%0'"
+                             : "attempt to perform 'n//0'");
+  qn = (a.n >= b.n) ? a.n - b.n + 2 : 1;  /* room for the rounding carry */
+  rn = b.n;
+  q = pushscratch(L, qn + rn + a.n + b.n + 1);
+  r = q + qn;
+  w = r + rn;
+  memset(q, 0, qn * sizeof(Limb));
+  if (a.n < b.n) {  /* quotient is zero */
+    memcpy(r, a.d, a.n * sizeof(Limb));
+    memset(r + a.n, 0, (rn - a.n) * sizeof(Limb));
+  }
+  else if (b.n == 1)
+    r[0] = divrem1(q, a.d, a.n, b.d[0]);
+  else
+    divknuth(q, r, a.d, a.n, b.d, b.n, w);
+  adjust = (a.neg != b.neg && normlen(r, rn) > 0);
+  if (wantmod) {
+    if (adjust)  /* r = |b| - r */
+      subn(r, b.d, r, rn);
+    setresult(L, res, r, rn, b.neg, NULL);
+  }
+  else {
+    if (adjust)
+      incr(q, qn, 1);
+    setresult(L, res, q, qn, a.neg != b.neg, NULL);
+  }
+  L->top.p--;  /* scratch */
 }
 
-/* Stubs for others */
-void luaB_div(lua_State *L, TValue *v1, TValue *v2, TValue *res) {
-  luaG_runerror(L, "BigInt division not supported");
+
+void luaB_div (lua_State *L, TValue *v1, TValue *v2, TValue *res) {
+  divmod(L, v1, v2, res, 0);
 }
 
-void luaB_mod(lua_State *L, TValue *v1, TValue *v2, TValue *res) {
-  luaG_runerror(L, "BigInt modulus not supported");
+
+void luaB_mod (lua_State *L, TValue *v1, TValue *v2, TValue *res) {
+  divmod(L, v1, v2, res, 1);
 }
 
-void luaB_pow(lua_State *L, TValue *v1, TValue *v2, TValue *res) {
-  luaG_runerror(L, "BigInt power not supported");
+
+/*
+** A big base raised to a non-negative integer is exact (square and
+** multiply, scanning the exponent from its top bit); anything else
+** follows float exponentiation.
+*/
+void luaB_pow (lua_State *L, TValue *v1, TValue *v2, TValue *res) {
+  BigNum a;
+  lua_Integer e;
+  lua_Unsigned bits;
+  Limb *x, *y, *w;
+  int xn, cap, bit;
+  if (!tobignum(v1, &a) || !ttisinteger(v2) || (e = ivalue(v2)) < 0) {
+    setfltvalue(res, luai_numpow(L, nvalue(v1), nvalue(v2)));
+    return;
+  }
+  if (e == 0 || (a.n == 1 && a.d[0] == 1)) {  /* result is 1 or -1 */
+    setivalue(res, (a.neg && (e & 1)) ? -1 : 1);
+    return;
+  }
+  if (a.n == 0) {
+    setivalue(res, 0);
+    return;
+  }
+  bits = (lua_Unsigned)a.n * LIMBBITS - limbclz(a.d[a.n - 1]);
+  if (l_castS2U(e) > (lua_Unsigned)MAXBIGLEN * LIMBBITS / bits)
+    luaG_runerror(L, "BigInt result too large");
+  cap = cast_int(bits * l_castS2U(e) / LIMBBITS) + 2;
+  x = pushscratch(L, 2 * cap + mulscratch(cap));
+  y = x + cap;
+  w = y + cap;
+  memcpy(x, a.d, a.n * sizeof(Limb));
+  xn = a.n;
+  for (bit = LIMBBITS - 2 - limbclz((Limb)e); bit >= 0; bit--) {
+    Limb *t;
+    mul(y, x, xn, x, xn, w);
+    xn = normlen(y, 2 * xn);
+    t = x; x = y; y = t;
+    if ((e >> bit) & 1) {
+      mul(y, x, xn, a.d, a.n, w);
+      xn = normlen(y, xn + a.n);
+      t = x; x = y; y = t;
+    }
+  }
+  setresult(L, res, x, xn, a.neg && (e & 1), NULL);
+  L->top.p--;  /* scratch */
 }
 
-int luaB_tryconvert(lua_State *L, TValue *obj) {
-    return 0;
+/* }====================================================== */
+
+
+/*
+** {======================================================
+** Decimal conversion
+** =======================================================
+*/
+
+/*
+** Level k of the conversion splits numbers below P(k)^2 by
+** P(k) = 10^(19*2^k) into two halves of 19*2^k digits each. Division by
+** P(k) multiplies by the reciprocal R(k) = floor(B^(2m) / P(k)), where
+** 'm' is the length of P(k) and B = 2^64, and then corrects by at most
+** two subtractions.
+*/
+typedef struct DecPow {
+  Limb *p;  /* P(k) */
+  Limb *r;  /* R(k), m + 1 limbs */
+  int m;
+} DecPow;
+
+
+/*
+** R = floor(B^(2m) / P) by Newton's iteration x' = x + x*(B^(2m)-P*x)/B^(2m),
+** which stays below the true reciprocal and roughly squares its error
+** each step. 'r' holds the starting guess (any positive value not above
+** R). 'w' has 8m + 4 + mulscratch(2m) limbs.
+*/
+static void reciprocal (Limb *r, const Limb *p, int m, Limb *w) {
+  Limb *t = w, *e = t + 2 * m + 1, *u = e + 2 * m;
+  Limb *ws = u + 3 * m + 1;
+  for (;;) {
+    int i, en;
+    mul(t, r, m + 1, p, m, ws);
+    /* e = B^(2m) - P*x, which is not negative as x <= R */
+    for (i = 0; i < 2 * m; i++) e[i] = ~t[i];
+    incr(e, 2 * m, 1);
+    for (i = 0; i < 4 && cmpmag(e, 2 * m, p, m) >= 0; i++) {
+      sub(e, e, 2 * m, p, m);
+      incr(r, m + 1, 1);
+    }
+    if (cmpmag(e, 2 * m, p, m) < 0)
+      return;  /* exact */
+    en = normlen(e, 2 * m);
+    mul(u, e, en, r, m + 1, ws);
+    memset(u + m + 1 + en, 0, (2 * m - en) * sizeof(Limb));
+    if (normlen(u + 2 * m, m + 1) == 0)
+      incr(r, m + 1, 1);  /* guarantee progress */
+    else
+      addn(r, r, u + 2 * m, m + 1);
+  }
+}
+
+
+/* write the 'DECDIGITS' digits of 'v' < DECBASE, zero padded */
+static void putchunk (char *s, Limb v) {
+  int i;
+  for (i = DECDIGITS - 1; i >= 0; i--) {
+    s[i] = cast_char('0' + (int)(v % 10));
+    v /= 10;
+  }
 }
 
-lua_Number luaB_bigtonumber(const TValue *obj) {
-    if (!ttisbigint(obj)) return 0.0;
-    TBigInt *b = bigvalue(obj);
-    if (b->len == 0) return 0.0;
 
-    lua_Number res = 0.0;
-    /* Process from most significant limb */
-    for (int i = b->len - 1; i >= 0; i--) {
-        res = res * 4294967296.0 + (lua_Number)b->buff[i];
+/*
+** Write 'x' (n limbs, below P(k)^2, destroyed) as exactly
+** 2 * 19 * 2^k digits. 'w' is free workspace.
+*/
+static void todecimal (char *s, Limb *x, int n, const DecPow *pw, int k,
+                       Limb *w) {
+  int width = DECDIGITS << (k + 1);
+  n = normlen(x, n);
+  if (n == 0)
+    memset(s, '0', width);
+  else if (k < 0)
+    putchunk(s, x[0]);
+  else if (pw[k].m <= TOSTR_THRESHOLD) {
+    int pos;
+    for (pos = width - DECDIGITS; pos >= 0; pos -= DECDIGITS) {
+      putchunk(s + pos, divrem1(x, x, n, DECBASE));
+      n = normlen(x, n);
+    }
+  }
+  else {
+    int m = pw[k].m;
+    Limb *t = w, *q = t + n + m + 1, *qp = q + m + 2;
+    Limb *ws = qp + 2 * m + 2;
+    int qn;
+    /* q = floor(x * R / B^(2m)), at most 2 below x / P */
+    mul(t, x, n, pw[k].r, m + 1, ws);
+    qn = n + m + 1 - 2 * m;
+    if (qn <= 0)
+      qn = 0;
+    else
+      memcpy(q, t + 2 * m, qn * sizeof(Limb));
+    memset(q + qn, 0, (m + 2 - qn) * sizeof(Limb));
+    qn = normlen(q, m + 2);
+    /* x -= q * P */
+    if (qn > 0) {
+      mul(qp, q, qn, pw[k].p, m, ws);
+      sub(x, x, n, qp, normlen(qp, qn + m));
+    }
+    while (cmpmag(x, n, pw[k].p, m) >= 0) {
+      sub(x, x, n, pw[k].p, m);
+      incr(q, m + 2, 1);
     }
+    todecimal(s, q, m + 2, pw, k - 1, ws);
+    todecimal(s + width / 2, x, n, pw, k - 1, ws);
+  }
+}
 
-    if (b->sign < 0) res = -res;
-    return res;
+
+void luaB_tostring (lua_State *L, TValue *obj) {
+  TBigInt *b;
+  DecPow pw[sizeof(int) * CHAR_BIT];
+  Limb *w, *x;
+  char *s;
+  int n, k, i, lb, width, neg;
+  size_t words;
+  if (!ttisbigint(obj)) return;
+  b = bigvalue(obj);
+  n = normlen(b->buff, cast_int(b->len));
+  neg = (b->sign < 0 && n > 0);
+  if (n == 0) {
+    setsvalue(L, obj, luaS_newliteral(L, "0"));
+    return;
+  }
+  /* bounds: P(k) <= x for every level k below the top one, so no power
+     or reciprocal is longer than 2n limbs and there are at most 'lb' + 2
+     levels; the digits take less than 39n bytes */
+  for (lb = 0; (1 << lb) < n; lb++) ;
+  words = 31 * (size_t)n + 8 * (size_t)lb + 32 + mulscratch(n + 1);
+  checklen(L, words);
+  x = pushscratch(L, cast_int(words));
+  b = bigvalue(obj);
+  memcpy(x, b->buff, n * sizeof(Limb));
+  w = x + n;
+  pw[0].p = w;
+  pw[0].p[0] = DECBASE;
+  pw[0].m = 1;
+  w += 1;
+  for (k = 0; cmpmag(x, n, pw[k].p, pw[k].m) >= 0; k++) {
+    int m = pw[k].m;
+    pw[k + 1].p = w;
+    mul(w, pw[k].p, m, pw[k].p, m, w + 2 * m);
+    pw[k + 1].m = normlen(w, 2 * m);
+    w += pw[k + 1].m;
+  }
+  /* now x < P(k); split by P(k-1) at the top */
+  k--;
+  for (i = 0; i <= k; i++) {
+    int m = pw[i].m;
+    pw[i].r = w;
+    w += m + 1;
+    if (m <= TOSTR_THRESHOLD)
+      continue;
+    memset(pw[i].r, 0, (m + 1) * sizeof(Limb));
+    if (pw[i - 1].m <= TOSTR_THRESHOLD) {  /* first level: divide directly */
+      Limb *num = w, *q = num + 2 * m + 1;
+      memset(num, 0, 2 * m * sizeof(Limb));
+      num[2 * m] = 1;
+      divknuth(q, NULL, num, 2 * m + 1, pw[i].p, m, q + m + 2);
+      memcpy(pw[i].r, q, (m + 1) * sizeof(Limb));
+    }
+    else {  /* start from R(i-1)^2, scaled */
+      int pm = pw[i - 1].m;
+      Limb *sq = w;
+      mul(sq, pw[i - 1].r, pm + 1, pw[i - 1].r, pm + 1, sq + 2 * pm + 2);
+      memcpy(pw[i].r, sq + (4 * pm - 2 * m), (m + 1) * sizeof(Limb));
+      reciprocal(pw[i].r, pw[i].p, m, w);
+    }
+  }
+  width = DECDIGITS << (k + 1);
+  s = cast_charp(w);
+  w += (width + 2) / sizeof(Limb) + 1;
+  todecimal(s + 1, x, n, pw, k, w);
+  for (i = 1; i < width && s[i] == '0'; i++) ;
+  if (neg) s[--i] = '-';
+  setsvalue(L, obj, luaS_newlstr(L, s + i, width + 1 - i));
+  L->top.p--;  /* scratch */
 }
+
+/* }====================================================== */
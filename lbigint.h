@@ -11,6 +11,7 @@ LUAI_FUNC void luaB_mul(lua_State *L, TValue *v1, TValue *v2, TValue *res);
 LUAI_FUNC void luaB_div(lua_State *L, TValue *v1, TValue *v2, TValue *res);
 LUAI_FUNC void luaB_mod(lua_State *L, TValue *v1, TValue *v2, TValue *res);
 LUAI_FUNC void luaB_pow(lua_State *L, TValue *v1, TValue *v2, TValue *res);
+LUAI_FUNC void luaB_unm(lua_State *L, TValue *v, TValue *res);
 LUAI_FUNC int luaB_compare(TValue *v1, TValue *v2);
 LUAI_FUNC void luaB_tostring(lua_State *L, TValue *obj);
 
@@ -13,6 +13,7 @@
 #include "lopcodes.h"
 #include "lgc.h"
 #include "ldebug.h"
+#include "lvm.h"
 #include "lopnames.h"
 #include <string.h>
 
@@ -108,7 +109,7 @@ static int bytecode_getcode (lua_State *L) {
   if (idx < 1 || idx > p->sizecode) {
     return luaL_error(L, "index out of range");
   }
-  Instruction i = p->code[idx - 1];
+  Instruction i = luaV_getinst(p, (int)idx - 1);
   lua_pushinteger(L, (lua_Integer)i);
   return 1;
 }
@@ -352,7 +353,7 @@ static int bytecode_dump (lua_State *L) {
   luaL_addstring(&b, buf);
 
   for (i = 0; i < p->sizecode; i++) {
-    Instruction inst = p->code[i];
+    Instruction inst = luaV_getinst(p, i);
     OpCode op = GET_OPCODE(inst);
     enum OpMode mode = getOpMode(op);
     const char *name = (op < NUM_OPCODES && opnames[op]) ? opnames[op] : "UNKNOWN";
@@ -607,7 +608,7 @@ static int bytecode_getinstruction (lua_State *L) {
   if (idx < 1 || idx > p->sizecode) {
     return luaL_error(L, "instruction index out of range");
   }
-  Instruction i = p->code[idx - 1];
+  Instruction i = luaV_getinst(p, idx - 1);
   decode_instruction(L, i);
   return 1;
 }
@@ -164,6 +164,14 @@ static void copytable(lua_State *L, int src_idx, int dst_idx) {
 ** =====================================================================
 */
 
+/*
+** 使所有类的成员解析缓存失效
+*/
+static void bump_class_version(lua_State *L) {
+  G(L)->classver++;
+}
+
+
 /*
 ** 类的__call元方法 - 用于创建实例
 ** 语法: local obj = ClassName(args...)
@@ -245,6 +253,7 @@ static int class_index(lua_State *L) {
 **   0
 */
 static int class_newindex(lua_State *L) {
+  bump_class_version(L);
   /* 栈: [1]=类表, [2]=键, [3]=值 */
   
   /* 如果值是函数，设置到方法表（使用rawget/rawset避免递归） */
@@ -496,6 +505,293 @@ static const char* get_class_name_str(lua_State *L, int class_idx) {
 }
 
 
+/*
+** =====================================================================
+** 成员解析缓存
+** =====================================================================
+** 每个类在 CLASS_KEY_RESCACHE 下保存一张缓存表，把成员名映射到扁平化的
+** 解析结果 {取值种类, 所在表, 赋值种类, 所在表}。缓存表的 [1] 记录创建时
+** 的 G(L)->classver，任何修改类结构的函数都会递增该计数使缓存整体失效。
+** 缓存只记录成员所在的表而不记录成员值，因此直接改写这些表中已有成员的
+** 值（例如类体编译出的 SETFIELD）无需失效缓存。
+** 结果依赖调用者访问级别的成员标记为 RES_SLOW，仍走完整查找流程。
+*/
+
+#define RES_SLOW    0   /* 结果依赖调用者访问级别 */
+#define RES_NONE    1   /* 继承链中没有该成员（赋值：直接写入实例） */
+#define RES_ACCESSOR 2  /* 公开getter/setter */
+#define RES_MEMBER  3   /* 公开成员（仅取值） */
+
+/* 缓存项中的槽位 */
+#define RES_GETKIND  1
+#define RES_GETTABLE 2
+#define RES_SETKIND  3
+#define RES_SETTABLE 4
+
+
+/*
+** 检查 cls[tname][key] 是否是函数
+** 参数：
+**   L - Lua状态机
+**   cls - 类在栈中的绝对索引
+**   tname - 成员表的键名
+**   key - 键在栈中的绝对索引
+** 返回值：
+**   1 - 是函数，此时成员表留在栈顶
+**   0 - 不是函数，栈不变
+*/
+static int has_function(lua_State *L, int cls, const char *tname, int key) {
+  lua_pushstring(L, tname);
+  lua_rawget(L, cls);
+  if (lua_istable(L, -1)) {
+    lua_pushvalue(L, key);
+    lua_rawget(L, -2);
+    int found = lua_isfunction(L, -1);
+    lua_pop(L, 1);
+    if (found) return 1;
+  }
+  lua_pop(L, 1);
+  return 0;
+}
+
+
+/*
+** 解析成员的取值方式，结果写入缓存项
+** 参数：
+**   L - Lua状态机
+**   class_idx - 对象所属类的绝对索引
+**   key - 键的绝对索引
+**   entry - 缓存项的绝对索引
+*/
+static void resolve_get(lua_State *L, int class_idx, int key, int entry) {
+  int kind = RES_NONE;
+  lua_pushvalue(L, class_idx);
+  int iter = lua_gettop(L);
+
+  /* getter：遇到非公开getter即需要访问级别 */
+  while (kind == RES_NONE && lua_istable(L, iter)) {
+    if (has_function(L, iter, CLASS_KEY_PRIVATE_GETTERS, key) ||
+        has_function(L, iter, CLASS_KEY_PROTECTED_GETTERS, key)) {
+      lua_pop(L, 1);
+      kind = RES_SLOW;
+    }
+    else if (has_function(L, iter, CLASS_KEY_GETTERS, key)) {
+      lua_rawseti(L, entry, RES_GETTABLE);
+      kind = RES_ACCESSOR;
+    }
+    else {
+      lua_pushstring(L, CLASS_KEY_PARENT);
+      lua_rawget(L, iter);
+      lua_replace(L, iter);
+    }
+  }
+
+  /* 类成员：第一个包含该成员的类决定结果 */
+  if (kind == RES_NONE) {
+    lua_pushvalue(L, class_idx);
+    lua_replace(L, iter);
+    while (lua_istable(L, iter)) {
+      int access = get_member_access_level(L, iter, key);
+      if (access == ACCESS_PUBLIC) {
+        lua_pushstring(L, CLASS_KEY_METHODS);
+        lua_rawget(L, iter);
+        lua_rawseti(L, entry, RES_GETTABLE);
+        kind = RES_MEMBER;
+        break;
+      }
+      else if (access >= 0) {
+        kind = RES_SLOW;
+        break;
+      }
+      lua_pushstring(L, CLASS_KEY_PARENT);
+      lua_rawget(L, iter);
+      lua_replace(L, iter);
+    }
+  }
+  lua_pop(L, 1);  /* 移除迭代用的类引用 */
+  lua_pushinteger(L, kind);
+  lua_rawseti(L, entry, RES_GETKIND);
+}
+
+
+/*
+** 解析成员的赋值方式，结果写入缓存项
+** 参数同 resolve_get
+*/
+static void resolve_set(lua_State *L, int class_idx, int key, int entry) {
+  const char *k = lua_tostring(L, key);
+  int kind = RES_NONE;
+
+  if (k[0] == '_' && k[1] == '_') {
+    kind = RES_SLOW;  /* 内部键需要检查权限 */
+  }
+  else {
+    lua_pushvalue(L, class_idx);
+    int iter = lua_gettop(L);
+    while (kind == RES_NONE && lua_istable(L, iter)) {
+      if (has_function(L, iter, CLASS_KEY_PRIVATE_SETTERS, key) ||
+          has_function(L, iter, CLASS_KEY_PROTECTED_SETTERS, key)) {
+        lua_pop(L, 1);
+        kind = RES_SLOW;
+      }
+      else if (has_function(L, iter, CLASS_KEY_SETTERS, key)) {
+        lua_rawseti(L, entry, RES_SETTABLE);
+        kind = RES_ACCESSOR;
+      }
+      else {
+        lua_pushstring(L, CLASS_KEY_PARENT);
+        lua_rawget(L, iter);
+        lua_replace(L, iter);
+      }
+    }
+    lua_pop(L, 1);
+    /* 覆盖本类的非公开成员需要访问级别 */
+    if (kind == RES_NONE && get_member_access_level(L, class_idx, key) > ACCESS_PUBLIC)
+      kind = RES_SLOW;
+  }
+  lua_pushinteger(L, kind);
+  lua_rawseti(L, entry, RES_SETKIND);
+}
+
+
+/*
+** 获取（必要时创建）成员的解析缓存项
+** 参数：
+**   L - Lua状态机
+**   class_idx - 对象所属类的绝对索引
+**   key - 键的绝对索引（必须是字符串）
+** 返回值：
+**   缓存项在栈中的索引（缓存项被压入栈顶）
+*/
+static int get_rescache_entry(lua_State *L, int class_idx, int key) {
+  lua_Integer ver = G(L)->classver;
+
+  int valid = 0;
+  lua_pushstring(L, CLASS_KEY_RESCACHE);
+  if (lua_rawget(L, class_idx) == LUA_TTABLE) {
+    lua_rawgeti(L, -1, 1);
+    valid = lua_isinteger(L, -1) && lua_tointeger(L, -1) == ver;
+    lua_pop(L, 1);
+  }
+  if (!valid) {  /* 缓存不存在或已过期，重建 */
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushinteger(L, ver);
+    lua_rawseti(L, -2, 1);
+    lua_pushstring(L, CLASS_KEY_RESCACHE);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, class_idx);
+  }
+  int cache = lua_gettop(L);
+
+  lua_pushvalue(L, key);
+  if (lua_rawget(L, cache) != LUA_TTABLE) {
+    lua_pop(L, 1);
+    lua_createtable(L, 4, 0);
+    int entry = lua_gettop(L);
+    resolve_get(L, class_idx, key, entry);
+    resolve_set(L, class_idx, key, entry);
+    lua_pushvalue(L, key);
+    lua_pushvalue(L, entry);
+    lua_rawset(L, cache);
+  }
+  lua_remove(L, cache);
+  return lua_gettop(L);
+}
+
+
+/*
+** 使用解析缓存读取对象成员
+** 参数：
+**   L - Lua状态机（栈: [1]=对象, [2]=键）
+**   class_idx - 对象所属类的绝对索引
+**   entry - 缓存项的绝对索引
+**   kind - 缓存的取值种类（不为 RES_SLOW）
+** 返回值：
+**   1 - 已压入结果
+**   0 - 缓存所指的成员已不存在，需要走完整查找
+*/
+static int cached_index(lua_State *L, int class_idx, int entry, int kind) {
+  if (kind == RES_ACCESSOR) {
+    lua_rawgeti(L, entry, RES_GETTABLE);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    if (!lua_isfunction(L, -1)) return 0;
+    lua_pushvalue(L, 1);  /* self */
+    lua_call(L, 1, 1);
+    return 1;
+  }
+
+  /* 实例属性（内部键除外） */
+  const char *k = lua_tostring(L, 2);
+  if (!(k[0] == '_' && k[1] == '_')) {
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, 1) != LUA_TNIL) return 1;
+    lua_pop(L, 1);
+  }
+
+  if (kind == RES_MEMBER) {
+    lua_rawgeti(L, entry, RES_GETTABLE);
+    lua_pushvalue(L, 2);
+    return lua_rawget(L, -2) != LUA_TNIL;
+  }
+
+  /* 实例私有数据 */
+  lua_pushstring(L, OBJ_KEY_PRIVATES);
+  if (lua_rawget(L, 1) == LUA_TTABLE) {
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, -2) != LUA_TNIL) {
+      if (get_caller_access_level(L, class_idx) != ACCESS_PRIVATE) {
+        const char *classname = get_class_name_str(L, class_idx);
+        return luaL_error(L, "无法访问对象 '%s' 的私有数据 '%s'", classname, k);
+      }
+      return 1;
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+
+  /* 静态成员 */
+  lua_pushstring(L, CLASS_KEY_STATICS);
+  if (lua_rawget(L, class_idx) == LUA_TTABLE) {
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, -2) != LUA_TNIL) return 1;
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  lua_pushnil(L);
+  return 1;
+}
+
+
+/*
+** 使用解析缓存设置对象成员
+** 参数：
+**   L - Lua状态机（栈: [1]=对象, [2]=键, [3]=值）
+**   entry - 缓存项的绝对索引
+**   kind - 缓存的赋值种类（不为 RES_SLOW）
+** 返回值：
+**   1 - 已完成赋值
+**   0 - 缓存所指的setter已不存在，需要走完整查找
+*/
+static int cached_newindex(lua_State *L, int entry, int kind) {
+  if (kind == RES_ACCESSOR) {
+    lua_rawgeti(L, entry, RES_SETTABLE);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    if (!lua_isfunction(L, -1)) return 0;
+    lua_pushvalue(L, 1);  /* self */
+    lua_pushvalue(L, 3);  /* value */
+    lua_call(L, 2, 0);
+    return 1;
+  }
+  lua_pushvalue(L, 2);
+  lua_pushvalue(L, 3);
+  lua_rawset(L, 1);
+  return 1;
+}
+
+
 /*
 ** 对象的__index元方法 - 用于访问对象属性和方法
 ** 支持访问控制：public成员可自由访问，protected和private成员有限制
@@ -520,6 +816,17 @@ static int object_index(lua_State *L) {
   }
   int class_idx = lua_gettop(L);
   
+  /* 优先使用成员解析缓存，结果与访问级别无关时无需遍历调用栈 */
+  if (lua_type(L, 2) == LUA_TSTRING) {
+    int entry = get_rescache_entry(L, class_idx, 2);
+    lua_rawgeti(L, entry, RES_GETKIND);
+    int kind = (int)lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    if (kind != RES_SLOW && cached_index(L, class_idx, entry, kind))
+      return 1;
+    lua_settop(L, class_idx);
+  }
+  
   /* 确定调用者的访问级别（提前获取，用于getter权限检查） */
   int caller_access = get_caller_access_level(L, class_idx);
   
@@ -736,6 +1043,17 @@ static int object_newindex(lua_State *L) {
   if (lua_istable(L, -1)) {
     int class_idx = lua_gettop(L);
     
+    /* 优先使用成员解析缓存 */
+    if (lua_type(L, 2) == LUA_TSTRING) {
+      int entry = get_rescache_entry(L, class_idx, 2);
+      lua_rawgeti(L, entry, RES_SETKIND);
+      int kind = (int)lua_tointeger(L, -1);
+      lua_pop(L, 1);
+      if (kind != RES_SLOW && cached_newindex(L, entry, kind))
+        return 0;
+      lua_settop(L, class_idx);
+    }
+    
     /* 确定调用者的访问级别（提前获取，用于setter权限检查） */
     int caller_access = get_caller_access_level(L, class_idx);
     
@@ -1025,6 +1343,7 @@ void luaC_newclass(lua_State *L, TString *name) {
 ** 支持final类检查、final方法检查、抽象方法继承、getter/setter继承
 */
 void luaC_inherit(lua_State *L, int child_idx, int parent_idx) {
+  bump_class_version(L);
   child_idx = absindex(L, child_idx);
   parent_idx = absindex(L, parent_idx);
   
@@ -1485,6 +1804,7 @@ void luaC_super(lua_State *L, int obj_idx, TString *method) {
 ** 设置类方法
 */
 void luaC_setmethod(lua_State *L, int class_idx, TString *name, int func_idx) {
+  bump_class_version(L);
   class_idx = absindex(L, class_idx);
   func_idx = absindex(L, func_idx);
   
@@ -1845,6 +2165,7 @@ void luaC_initclass(lua_State *L) {
 **   将成员设置为私有，只有本类内部可以访问
 */
 void luaC_setprivate(lua_State *L, int class_idx, TString *name, int value_idx) {
+  bump_class_version(L);
   class_idx = absindex(L, class_idx);
   value_idx = absindex(L, value_idx);
   
@@ -1879,6 +2200,7 @@ void luaC_setprivate(lua_State *L, int class_idx, TString *name, int value_idx)
 **   将成员设置为受保护，本类和子类可以访问
 */
 void luaC_setprotected(lua_State *L, int class_idx, TString *name, int value_idx) {
+  bump_class_version(L);
   class_idx = absindex(L, class_idx);
   value_idx = absindex(L, value_idx);
   
@@ -2533,6 +2855,7 @@ int luaC_can_override(lua_State *L, int class_idx, TString *name) {
 **   根据访问级别存储到不同的getter表中
 */
 void luaC_setgetter(lua_State *L, int class_idx, TString *prop_name, int func_idx, int access_level) {
+  bump_class_version(L);
   class_idx = absindex(L, class_idx);
   func_idx = absindex(L, func_idx);
   
@@ -2579,6 +2902,7 @@ void luaC_setgetter(lua_State *L, int class_idx, TString *prop_name, int func_id
 **   根据访问级别存储到不同的setter表中
 */
 void luaC_setsetter(lua_State *L, int class_idx, TString *prop_name, int func_idx, int access_level) {
+  bump_class_version(L);
   class_idx = absindex(L, class_idx);
   func_idx = absindex(L, func_idx);
   
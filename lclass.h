@@ -66,6 +66,7 @@
 #define CLASS_KEY_PROTECTED_GETTERS "__protected_getters" /**< Protected getter table. */
 #define CLASS_KEY_PROTECTED_SETTERS "__protected_setters" /**< Protected setter table. */
 #define CLASS_KEY_MEMBER_FLAGS "__member_flags" /**< Member flags table. */
+#define CLASS_KEY_RESCACHE   "__rescache"     /**< Flattened member resolution cache. */
 /**@}*/
 
 /** @name Object Metadata Keys */
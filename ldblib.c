@@ -19,6 +19,7 @@
 #include "lauxlib.h"
 #include "lualib.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
 
 
@@ -29,8 +30,8 @@
 static const char *const HOOKKEY = "_HOOKKEY";
 
 /*
-** The breakpoint table at registry[BREAKPOINTKEY] maps threads to their current
-** hook function.
+** The breakpoint table at registry[BREAKPOINTKEY] maps "file:line" keys to
+** breakpoint records; the code itself is patched by 'lua_setbreakpoint'.
 */
 static const char *const BREAKPOINTKEY = "_BREAKPOINTKEY";
 
@@ -380,108 +381,185 @@ static int db_upvaluejoin (lua_State *L) {
 }
 
 
+static void hookf (lua_State *L, lua_Debug *ar);
+
+
+static void ensure_debug_state (lua_State *L) {
+  if (lua_getfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY) != LUA_TTABLE) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushinteger(L, 0);
+    lua_setfield(L, -2, "mode");
+    lua_pushinteger(L, 0);
+    lua_setfield(L, -2, "target_level");
+    lua_pushinteger(L, 0);
+    lua_setfield(L, -2, "break_level");
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY);
+  }
+}
+
+
 /*
-** Call hook function registered at hook table for the current
-** thread (if there is one)
+** Breakpoints are traps in the code and need no hook, but the step
+** modes need line events. If the thread has no hook, 'hookf' is
+** installed while a mode is active ('on') and removed afterwards,
+** unless a hook was set through 'debug.sethook' in the meantime.
 */
-static void hookf (lua_State *L, lua_Debug *ar) {
-  static const char *const hooknames[] =
-    {"call", "return", "line", "count", "tail call"};
-  
-  int top = lua_gettop(L);
+static void stephook (lua_State *L, int on) {
+  ensure_debug_state(L);
+  if (on) {
+    if (lua_gethook(L) == NULL) {
+      lua_sethook(L, hookf, LUA_MASKLINE, 0);
+      lua_pushthread(L);
+      lua_setfield(L, -2, "hookthread");
+    }
+  }
+  else {
+    lua_getfield(L, -1, "hookthread");
+    lua_pushthread(L);
+    if (lua_rawequal(L, -1, -2)) {
+      int userhook = 0;
+      if (lua_getfield(L, LUA_REGISTRYINDEX, HOOKKEY) == LUA_TTABLE) {
+        lua_pushthread(L);
+        userhook = (lua_rawget(L, -2) != LUA_TNIL);
+        lua_pop(L, 1);
+      }
+      lua_pop(L, 1);
+      if (!userhook && lua_gethook(L) == hookf)
+        lua_sethook(L, NULL, 0, 0);
+      lua_pushnil(L);
+      lua_setfield(L, -4, "hookthread");
+    }
+    lua_pop(L, 2);
+  }
+  lua_pop(L, 1);
+}
+
 
-  if (ar->event == LUA_HOOKLINE && ar->currentline >= 0) {
-    int should_stop = 0;
-    const char *stop_event = "breakpoint";
-
-    /* 1. Check for breakpoints */
-    if (lua_getfield(L, LUA_REGISTRYINDEX, BREAKPOINTKEY) == LUA_TTABLE) {
-      int bptable_idx = lua_gettop(L);
-      lua_getinfo(L, "S", ar);
-      const char *filename = get_filename(ar->source ? ar->source : "");
-      char key[512];
-      snprintf(key, sizeof(key), "%s:%d", filename, ar->currentline);
-      if (lua_getfield(L, bptable_idx, key) == LUA_TTABLE) {
-        int bp_idx = lua_gettop(L);
-        lua_getfield(L, bp_idx, "enabled");
-        if (lua_toboolean(L, -1)) {
-          lua_pop(L, 1); /* pop enabled */
-          if (lua_getfield(L, bp_idx, "condition") == LUA_TSTRING) {
-            const char *cond = lua_tostring(L, -1);
-            char buff[512];
-            if (strncmp(cond, "return ", 7) != 0) {
-              snprintf(buff, sizeof(buff), "return %s", cond);
-              cond = buff;
-            }
-            if (luaL_loadstring(L, cond) == LUA_OK) {
-              if (lua_pcall(L, 0, 1, 0) == LUA_OK) {
-                should_stop = lua_toboolean(L, -1);
-              }
-              lua_pop(L, 1); /* pop result/error */
-            } else {
-              lua_pop(L, 1); /* pop load error */
-            }
-          } else {
-            should_stop = 1; /* unconditional */
-            lua_pop(L, 1); /* pop non-string condition */
-          }
-        } else {
-          lua_pop(L, 1); /* pop disabled */
+/*
+** Decides whether execution stops at the line of 'ar' and reports the
+** stop to the output callback. Breakpoints are only looked up when
+** called from a trap ('atbreak'); step modes are checked either way.
+*/
+static void linestop (lua_State *L, lua_Debug *ar, int atbreak) {
+  int top = lua_gettop(L);
+  int should_stop = 0;
+  const char *stop_event = "breakpoint";
+
+  /* 1. Check for breakpoints */
+  if (atbreak &&
+      lua_getfield(L, LUA_REGISTRYINDEX, BREAKPOINTKEY) == LUA_TTABLE) {
+    int bptable_idx = lua_gettop(L);
+    lua_getinfo(L, "S", ar);
+    const char *filename = get_filename(ar->source ? ar->source : "");
+    char key[512];
+    snprintf(key, sizeof(key), "%s:%d", filename, ar->currentline);
+    if (lua_getfield(L, bptable_idx, key) == LUA_TTABLE) {
+      int bp_idx = lua_gettop(L);
+      lua_getfield(L, bp_idx, "enabled");
+      if (lua_toboolean(L, -1)) {
+        if (lua_getfield(L, bp_idx, "condfunc") == LUA_TFUNCTION) {
+          /* condition was compiled by 'setbreakpoint' */
+          if (lua_pcall(L, 0, 1, 0) == LUA_OK)
+            should_stop = lua_toboolean(L, -1);
         }
+        else
+          should_stop = 1; /* unconditional */
       }
     }
-    lua_settop(L, top);
+  }
+  lua_settop(L, top);
 
-    /* 2. Check debug modes */
-    if (!should_stop) {
-      if (lua_getfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY) == LUA_TTABLE) {
-        int state_idx = lua_gettop(L);
-        lua_getfield(L, state_idx, "mode");
-        int mode = (int)lua_tointeger(L, -1);
-        lua_pop(L, 1);
-        if (mode != 0) {
-          int stop_by_mode = 0;
-          if (mode == 1) stop_by_mode = 1; /* step */
-          else if (mode == 2 || mode == 3) {
-            lua_getfield(L, state_idx, "target_level");
-            int target_level = (int)lua_tointeger(L, -1);
-            lua_pop(L, 1);
-            if (get_stack_level(L) <= target_level)
-              stop_by_mode = 1;
-          }
-          if (stop_by_mode) {
-            should_stop = 1;
-            stop_event = (mode == 1) ? "step" : (mode == 2 ? "next" : "finish");
-            lua_pushinteger(L, 0);
-            lua_setfield(L, state_idx, "mode");
-          }
+  /* 2. Check debug modes */
+  if (!should_stop) {
+    if (lua_getfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY) == LUA_TTABLE) {
+      int state_idx = lua_gettop(L);
+      lua_getfield(L, state_idx, "mode");
+      int mode = (int)lua_tointeger(L, -1);
+      lua_pop(L, 1);
+      if (mode != 0) {
+        int stop_by_mode = 0;
+        if (mode == 1) stop_by_mode = 1; /* step */
+        else if (mode == 2 || mode == 3) {
+          lua_getfield(L, state_idx, "target_level");
+          int target_level = (int)lua_tointeger(L, -1);
+          lua_pop(L, 1);
+          if (get_stack_level(L) <= target_level)
+            stop_by_mode = 1;
+        }
+        if (stop_by_mode) {
+          should_stop = 1;
+          stop_event = (mode == 1) ? "step" : (mode == 2 ? "next" : "finish");
+          lua_pushinteger(L, 0);
+          lua_setfield(L, state_idx, "mode");
         }
       }
     }
-    lua_settop(L, top);
+  }
+  lua_settop(L, top);
 
-    if (should_stop) {
-      if (lua_getfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY) == LUA_TTABLE) {
-        lua_pushinteger(L, get_stack_level(L));
-        lua_setfield(L, -2, "break_level");
-      }
-      lua_pop(L, 1); /* pop DEBUGSTATEKEY table or nil */
-
-      lua_getinfo(L, "S", ar);
-      lua_getfield(L, LUA_REGISTRYINDEX, DEBUGOUTPUTKEY);
-      if (lua_isfunction(L, -1)) {
-        lua_pushstring(L, stop_event);
-        lua_pushstring(L, ar->short_src);
-        lua_pushinteger(L, ar->currentline);
-        lua_pcall(L, 3, 0, 0);
-      } else {
-        fprintf(stderr, "Breakpoint (%s) at %s:%d\n", stop_event, ar->short_src, ar->currentline);
-      }
+  if (should_stop) {
+    if (lua_getfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY) == LUA_TTABLE) {
+      lua_pushinteger(L, get_stack_level(L));
+      lua_setfield(L, -2, "break_level");
+    }
+    lua_pop(L, 1); /* pop DEBUGSTATEKEY table or nil */
+
+    lua_getinfo(L, "S", ar);
+    lua_getfield(L, LUA_REGISTRYINDEX, DEBUGOUTPUTKEY);
+    if (lua_isfunction(L, -1)) {
+      lua_pushstring(L, stop_event);
+      lua_pushstring(L, ar->short_src);
+      lua_pushinteger(L, ar->currentline);
+      lua_pcall(L, 3, 0, 0);
+    } else {
+      fprintf(stderr, "Breakpoint (%s) at %s:%d\n", stop_event, ar->short_src, ar->currentline);
     }
     lua_settop(L, top);
+
+    /* the callback did not resume stepping? */
+    if (lua_getfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY) == LUA_TTABLE &&
+        lua_getfield(L, -1, "mode") == LUA_TNUMBER && lua_tointeger(L, -1) == 0)
+      stephook(L, 0);
   }
+  lua_settop(L, top);
+}
+
+
+/*
+** True if the instruction about to run in the frame of 'ar' is a
+** breakpoint trap; 'breakf' checks that line right after the hook.
+*/
+static int attrap (lua_Debug *ar) {
+  CallInfo *ci = ar->i_ci;
+  return isLua(ci) && GET_OPCODE(*(ci->u.l.savedpc - 1)) == OP_TRAP;
+}
+
+
+/*
+** Break hook, called by the traps that 'debug.setbreakpoint' puts in
+** the code of any thread.
+*/
+static void breakf (lua_State *L, lua_Debug *ar) {
+  linestop(L, ar, 1);
+}
+
+
+/*
+** Call hook function registered at hook table for the current
+** thread (if there is one)
+*/
+static void hookf (lua_State *L, lua_Debug *ar) {
+  static const char *const hooknames[] =
+    {"call", "return", "line", "count", "tail call"};
+  
+  int top = lua_gettop(L);
+
+  if (ar->event == LUA_HOOKLINE && ar->currentline >= 0 && !attrap(ar))
+    linestop(L, ar, 0);
 
-  /* 4. Call user registered hook function */
+  /* Call user registered hook function */
   if (lua_getfield(L, LUA_REGISTRYINDEX, HOOKKEY) == LUA_TTABLE) {
     int hooktable_idx = lua_gettop(L);
     lua_pushthread(L);
@@ -620,28 +698,15 @@ static void ensure_breakpoint_table (lua_State *L) {
   }
 }
 
-static void ensure_debug_state (lua_State *L) {
-  if (lua_getfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY) != LUA_TTABLE) {
-    lua_pop(L, 1);
-    lua_newtable(L);
-    lua_pushinteger(L, 0);
-    lua_setfield(L, -2, "mode");
-    lua_pushinteger(L, 0);
-    lua_setfield(L, -2, "target_level");
-    lua_pushinteger(L, 0);
-    lua_setfield(L, -2, "break_level");
-    lua_pushvalue(L, -1);
-    lua_setfield(L, LUA_REGISTRYINDEX, DEBUGSTATEKEY);
-  }
-}
-
+/*
+** Breakpoints patch the code (see 'lua_setbreakpoint'); their hook is
+** called only when a patched line is reached. A condition is compiled
+** here, once, and run at each hit.
+*/
 static int db_setbreakpoint (lua_State *L) {
   const char *source = luaL_checkstring(L, 1);
   int line = (int)luaL_checkinteger(L, 2);
   const char *condition = luaL_optstring(L, 3, NULL);
-  if (lua_gethook(L) == NULL) {
-    lua_sethook(L, hookf, LUA_MASKLINE, 0);
-  }
   lua_settop(L, 3);
   ensure_breakpoint_table(L); /* index 4 */
   const char *filename = get_filename(source);
@@ -658,9 +723,20 @@ static int db_setbreakpoint (lua_State *L) {
   lua_pushboolean(L, 1);
   lua_setfield(L, 5, "enabled");
   if (condition) {
+    if (strncmp(condition, "return ", 7) == 0)
+      lua_pushstring(L, condition);
+    else
+      lua_pushfstring(L, "return %s", condition);
+    if (luaL_loadstring(L, lua_tostring(L, -1)) != LUA_OK)
+      return luaL_error(L, "invalid breakpoint condition: %s",
+                           lua_tostring(L, -1));
+    lua_setfield(L, 5, "condfunc");
+    lua_pop(L, 1);  /* source of the condition */
     lua_pushstring(L, condition);
     lua_setfield(L, 5, "condition");
   }
+  lua_setbreakhook(L, breakf);
+  lua_setbreakpoint(L, filename, line, 1);
   lua_pushboolean(L, exists);
   lua_setfield(L, 5, "exists");
   lua_pushvalue(L, 5);
@@ -683,6 +759,7 @@ static int db_removebreakpoint (lua_State *L) {
   if (exists) {
     lua_pushnil(L);
     lua_setfield(L, 3, key);
+    lua_setbreakpoint(L, filename, line, 0);
   }
   lua_pushboolean(L, exists);
   lua_remove(L, 3);
@@ -716,6 +793,7 @@ static int db_enablebreakpoint (lua_State *L) {
   if (lua_getfield(L, 4, key) == LUA_TTABLE) {
     lua_pushboolean(L, enable);
     lua_setfield(L, -2, "enabled");
+    lua_setbreakpoint(L, filename, line, enable);
     lua_pushboolean(L, 1);
   } else {
     lua_pushboolean(L, 0);
@@ -730,7 +808,10 @@ static int db_clearbreakpoints (lua_State *L) {
   lua_pushnil(L);
   while (lua_next(L, -2)) {
     count++;
-    lua_pop(L, 1);
+    if (lua_getfield(L, -1, "source") == LUA_TSTRING &&
+        lua_getfield(L, -2, "line") == LUA_TNUMBER)
+      lua_setbreakpoint(L, lua_tostring(L, -2), (int)lua_tointeger(L, -1), 0);
+    lua_pop(L, 3);
   }
   lua_pop(L, 1);
   lua_newtable(L);
@@ -744,6 +825,7 @@ static int db_continue (lua_State *L) {
   lua_pushinteger(L, 0);
   lua_setfield(L, -2, "mode");
   lua_pop(L, 1);
+  stephook(L, 0);
   lua_pushstring(L, "continue");
   return 1;
 }
@@ -753,6 +835,7 @@ static int db_step (lua_State *L) {
   lua_pushinteger(L, 1);
   lua_setfield(L, -2, "mode");
   lua_pop(L, 1);
+  stephook(L, 1);
   lua_pushstring(L, "step");
   return 1;
 }
@@ -768,6 +851,7 @@ static int db_next (lua_State *L) {
   lua_pushinteger(L, break_level);
   lua_setfield(L, -2, "target_level");
   lua_pop(L, 1);
+  stephook(L, 1);
   lua_pushstring(L, "next");
   return 1;
 }
@@ -783,6 +867,7 @@ static int db_finish (lua_State *L) {
   lua_pushinteger(L, break_level - 1);
   lua_setfield(L, -2, "target_level");
   lua_pop(L, 1);
+  stephook(L, 1);
   lua_pushstring(L, "finish");
   return 1;
 }
@@ -1091,3 +1091,283 @@ int luaG_traceexec (lua_State *L, const Instruction *pc) {
   return 1;  /* keep 'trap' on */
 }
 
+
+
+/*
+** {======================================================
+** Breakpoint traps
+** =======================================================
+*/
+
+/*
+** A breakpoint is a line of a source file, named by its last path
+** component. In every live prototype from that file, each instruction
+** where execution enters the line is overwritten with OP_TRAP and the
+** original goes to the sorted side table 'p->traps'. Code without
+** breakpoints runs untouched; prototypes loaded later are patched by
+** 'luaG_loadtraps'.
+*/
+typedef struct BreakLine {
+  char *name;  /* file name, as returned by 'filepart' */
+  int line;
+} BreakLine;
+
+
+static const char *filepart (const char *source) {
+  const char *sep;
+  if (*source == '@')
+    source++;
+  if ((sep = strrchr(source, '/')) != NULL)
+    source = sep + 1;
+  if ((sep = strrchr(source, '\\')) != NULL)
+    source = sep + 1;
+  return source;
+}
+
+
+static int fromfile (const Proto *p, const char *name) {
+  return p->source != NULL && strcmp(filepart(getstr(p->source)), name) == 0;
+}
+
+
+/*
+** Returns the instruction replaced by the trap at 'pc'.
+*/
+Instruction luaG_getorigin (const Proto *p, int pc) {
+  int lo = 0;
+  int hi = p->sizetraps - 1;
+  while (lo <= hi) {
+    int m = (lo + hi) / 2;
+    if (p->traps[m].pc < pc)
+      lo = m + 1;
+    else if (p->traps[m].pc > pc)
+      hi = m - 1;
+    else
+      return p->traps[m].i;
+  }
+  lua_assert(0);  /* every trap has its side entry */
+  return p->code[pc];
+}
+
+
+/*
+** Can the instruction at 'pc' become a trap? The VM reads some
+** instructions in place instead of dispatching them (extra arguments,
+** the jump after a test, OP_TFORCALL/OP_TFORLOOP), and an OP_MMBIN is
+** skipped whenever its arithmetic succeeds.
+*/
+static int trappable (const Proto *p, int pc) {
+  OpCode op = GET_OPCODE(luaV_getinst(p, pc));
+  if (op == OP_EXTRAARG || op == OP_TFORCALL || op == OP_TFORLOOP ||
+      testMMMode(op))
+    return 0;
+  if (pc > 0 && testTMode(GET_OPCODE(luaV_getinst(p, pc - 1))))
+    return 0;
+  return 1;
+}
+
+
+static void settrap (lua_State *L, Proto *p, int pc) {
+  int n = p->sizetraps;
+  int pos = n;
+  p->traps = cast(TrapSite *, luaM_saferealloc_(L, p->traps,
+                 n * sizeof(TrapSite), (n + 1) * sizeof(TrapSite)));
+  p->sizetraps = n + 1;
+  while (pos > 0 && p->traps[pos - 1].pc > pc) {  /* keep it sorted */
+    p->traps[pos] = p->traps[pos - 1];
+    pos--;
+  }
+  p->traps[pos].pc = pc;
+  p->traps[pos].i = p->code[pc];
+  p->code[pc] = CREATE_ABCk(OP_TRAP, 0, 0, 0, 0);
+}
+
+
+/*
+** Puts traps where execution enters 'line' in 'p': the first trappable
+** instruction of each run of instructions from that line, and of each
+** part of a run that starts at the target of a backward jump (so that
+** a loop on a single line stops at every iteration, as a line hook
+** does). Returns the number of traps set.
+*/
+static int patchline (lua_State *L, Proto *p, int line) {
+  int n = p->sizecode;
+  int currentline = p->linedefined;
+  int pending = 0;
+  int count = 0;
+  int pc;
+  lu_byte *loop;
+  if (p->lineinfo == NULL || (p->flag & PF_FIXED) || n == 0)
+    return 0;
+  loop = luaM_newvector(L, n, lu_byte);
+  memset(loop, 0, cast_sizet(n));
+  for (pc = 0; pc < n; pc++) {  /* mark targets of backward jumps */
+    Instruction i = luaV_getinst(p, pc);
+    int target;
+    switch (GET_OPCODE(i)) {
+      case OP_JMP: target = pc + 1 + GETARG_sJ(i); break;
+      case OP_FORLOOP: case OP_TFORLOOP: target = pc + 1 - GETARG_Bx(i); break;
+      default: continue;
+    }
+    if (0 <= target && target <= pc)
+      loop[target] = 1;
+  }
+  for (pc = 0; pc < n; pc++) {
+    int prevline = currentline;
+    currentline = nextline(p, currentline, pc);
+    if (currentline != line)
+      pending = 0;
+    else {
+      if (pc == 0 || prevline != line || loop[pc])
+        pending = 1;
+      if (pending && trappable(p, pc)) {
+        if (GET_OPCODE(p->code[pc]) != OP_TRAP) {
+          settrap(L, p, pc);
+          count++;
+        }
+        pending = 0;
+      }
+    }
+  }
+  luaM_freearray(L, loop, n);
+  return count;
+}
+
+
+/*
+** Removes the traps on 'line' from 'p', restoring their instructions.
+** Returns the number of traps removed.
+*/
+static int unpatchline (lua_State *L, Proto *p, int line) {
+  int n = p->sizetraps;
+  int i, j = 0;
+  for (i = 0; i < n; i++) {
+    TrapSite *t = &p->traps[i];
+    if (luaG_getfuncline(p, t->pc) != line)
+      p->traps[j++] = *t;  /* keep it */
+    else if (GET_OPCODE(p->code[t->pc]) == OP_TRAP)
+      p->code[t->pc] = t->i;
+  }
+  if (j < n) {
+    p->traps = luaM_reallocvector(L, p->traps, n, j, TrapSite);
+    p->sizetraps = j;
+  }
+  return n - j;
+}
+
+
+/*
+** Patches a freshly loaded prototype (and its children) for the
+** breakpoints already set on its file.
+*/
+void luaG_loadtraps (lua_State *L, Proto *p) {
+  global_State *g = G(L);
+  int i;
+  for (i = 0; i < g->nbreaklines; i++) {
+    if (fromfile(p, g->breaklines[i].name))
+      patchline(L, p, g->breaklines[i].line);
+  }
+  for (i = 0; i < p->sizep; i++)
+    luaG_loadtraps(L, p->p[i]);
+}
+
+
+/*
+** Removes every trap from 'p', for passes that rewrite its code.
+*/
+void luaG_droptraps (lua_State *L, Proto *p) {
+  int i;
+  for (i = 0; i < p->sizetraps; i++) {
+    TrapSite *t = &p->traps[i];
+    if (GET_OPCODE(p->code[t->pc]) == OP_TRAP)
+      p->code[t->pc] = t->i;
+  }
+  luaM_freearray(L, p->traps, p->sizetraps);
+  p->traps = NULL;
+  p->sizetraps = 0;
+}
+
+
+void luaG_freebreaklines (lua_State *L) {
+  global_State *g = G(L);
+  int i;
+  for (i = 0; i < g->nbreaklines; i++) {
+    char *name = g->breaklines[i].name;
+    luaM_freearray(L, name, strlen(name) + 1);
+  }
+  luaM_freearray(L, g->breaklines, g->nbreaklines);
+  g->breaklines = NULL;
+  g->nbreaklines = 0;
+}
+
+
+/*
+** Executes OP_TRAP ('pc' points past it): calls the break hook and
+** returns the replaced instruction, which the VM then runs in its
+** place. The hook may remove the breakpoint, so the instruction is
+** fetched first.
+*/
+Instruction luaG_trap (lua_State *L, const Instruction *pc) {
+  CallInfo *ci = L->ci;
+  const Proto *p = ci_func(ci)->p;
+  int npc = pcRel(pc, p);
+  Instruction i = luaG_getorigin(p, npc);
+  ci->u.l.savedpc = pc;
+  if (!isIT(i))  /* top not being used? */
+    L->top.p = ci->top.p;  /* correct top */
+  luaD_breakhook(L, luaG_getfuncline(p, npc));
+  return i;
+}
+
+
+LUA_API void lua_setbreakhook (lua_State *L, lua_Hook func) {
+  G(L)->breakhook = func;
+}
+
+
+LUA_API lua_Hook lua_getbreakhook (lua_State *L) {
+  return G(L)->breakhook;
+}
+
+
+LUA_API int lua_setbreakpoint (lua_State *L, const char *name, int line,
+                                             int on) {
+  global_State *g = G(L);
+  GCObject *o;
+  int i, count = 0;
+  lua_lock(L);
+  name = filepart(name);
+  for (i = 0; i < g->nbreaklines; i++) {
+    BreakLine *b = &g->breaklines[i];
+    if (b->line == line && strcmp(b->name, name) == 0)
+      break;
+  }
+  if (on && i == g->nbreaklines) {  /* new breakpoint? */
+    size_t len = strlen(name);
+    char *copy = luaM_newvector(L, len + 1, char);
+    memcpy(copy, name, len + 1);
+    g->breaklines = cast(BreakLine *, luaM_saferealloc_(L, g->breaklines,
+                        i * sizeof(BreakLine), (i + 1) * sizeof(BreakLine)));
+    g->breaklines[i].name = copy;
+    g->breaklines[i].line = line;
+    g->nbreaklines = i + 1;
+  }
+  else if (!on && i < g->nbreaklines) {  /* remove it */
+    int last = g->nbreaklines - 1;
+    luaM_freearray(L, g->breaklines[i].name, strlen(g->breaklines[i].name) + 1);
+    g->breaklines[i] = g->breaklines[last];
+    g->breaklines = luaM_reallocvector(L, g->breaklines, last + 1, last,
+                                       BreakLine);
+    g->nbreaklines = last;
+  }
+  for (o = g->allgc; o != NULL; o = o->next) {
+    if (o->tt == LUA_VPROTO && fromfile(gco2p(o), name)) {
+      Proto *p = gco2p(o);
+      count += on ? patchline(L, p, line) : unpatchline(L, p, line);
+    }
+  }
+  lua_unlock(L);
+  return count;
+}
+
+/* }====================================================== */
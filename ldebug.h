@@ -60,6 +60,11 @@ LUAI_FUNC const char *luaG_addinfo (lua_State *L, const char *msg,
 LUAI_FUNC l_noret luaG_errormsg (lua_State *L);
 LUAI_FUNC int luaG_traceexec (lua_State *L, const Instruction *pc);
 LUAI_FUNC int luaG_tracecall (lua_State *L);
+LUAI_FUNC Instruction luaG_trap (lua_State *L, const Instruction *pc);
+LUAI_FUNC Instruction luaG_getorigin (const Proto *p, int pc);
+LUAI_FUNC void luaG_loadtraps (lua_State *L, Proto *p);
+LUAI_FUNC void luaG_droptraps (lua_State *L, Proto *p);
+LUAI_FUNC void luaG_freebreaklines (lua_State *L);
 
 
 #endif
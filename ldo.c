@@ -475,6 +475,42 @@ void luaD_inctop (lua_State *L) {
 /* }======================================================= */
 
 
+/**
+ * @brief Calls 'hook' for the given event, protecting the current frame.
+ */
+static void callhook (lua_State *L, lua_Hook hook, int event, int line,
+                                    int ftransfer, int ntransfer) {
+  int mask = CIST_HOOKED;
+  CallInfo *ci = L->ci;
+  ptrdiff_t top = savestack(L, L->top.p);  /* preserve original 'top' */
+  ptrdiff_t ci_top = savestack(L, ci->top.p);  /* idem for 'ci->top' */
+  lua_Debug ar;
+  ar.event = event;
+  ar.currentline = line;
+  ar.i_ci = ci;
+  if (ntransfer != 0) {
+    mask |= CIST_TRAN;  /* 'ci' has transfer information */
+    ci->u2.transferinfo.ftransfer = ftransfer;
+    ci->u2.transferinfo.ntransfer = ntransfer;
+  }
+  if (isLua(ci) && L->top.p < ci->top.p)
+    L->top.p = ci->top.p;  /* protect entire activation register */
+  luaD_checkstack(L, LUA_MINSTACK);  /* ensure minimum stack size */
+  if (ci->top.p < L->top.p + LUA_MINSTACK)
+    ci->top.p = L->top.p + LUA_MINSTACK;
+  L->allowhook = 0;  /* cannot call hooks inside a hook */
+  ci->callstatus |= mask;
+  lua_unlock(L);
+  (*hook)(L, &ar);
+  lua_lock(L);
+  lua_assert(!L->allowhook);
+  L->allowhook = 1;
+  ci->top.p = restorestack(L, ci_top);
+  L->top.p = restorestack(L, top);
+  ci->callstatus &= ~mask;
+}
+
+
 /**
  * @brief Calls a hook for the given event.
  *
@@ -487,36 +523,20 @@ void luaD_inctop (lua_State *L) {
 void luaD_hook (lua_State *L, int event, int line,
                               int ftransfer, int ntransfer) {
   lua_Hook hook = L->hook;
-  if (hook && L->allowhook) {  /* make sure there is a hook */
-    int mask = CIST_HOOKED;
-    CallInfo *ci = L->ci;
-    ptrdiff_t top = savestack(L, L->top.p);  /* preserve original 'top' */
-    ptrdiff_t ci_top = savestack(L, ci->top.p);  /* idem for 'ci->top' */
-    lua_Debug ar;
-    ar.event = event;
-    ar.currentline = line;
-    ar.i_ci = ci;
-    if (ntransfer != 0) {
-      mask |= CIST_TRAN;  /* 'ci' has transfer information */
-      ci->u2.transferinfo.ftransfer = ftransfer;
-      ci->u2.transferinfo.ntransfer = ntransfer;
-    }
-    if (isLua(ci) && L->top.p < ci->top.p)
-      L->top.p = ci->top.p;  /* protect entire activation register */
-    luaD_checkstack(L, LUA_MINSTACK);  /* ensure minimum stack size */
-    if (ci->top.p < L->top.p + LUA_MINSTACK)
-      ci->top.p = L->top.p + LUA_MINSTACK;
-    L->allowhook = 0;  /* cannot call hooks inside a hook */
-    ci->callstatus |= mask;
-    lua_unlock(L);
-    (*hook)(L, &ar);
-    lua_lock(L);
-    lua_assert(!L->allowhook);
-    L->allowhook = 1;
-    ci->top.p = restorestack(L, ci_top);
-    L->top.p = restorestack(L, top);
-    ci->callstatus &= ~mask;
-  }
+  if (hook && L->allowhook)  /* make sure there is a hook */
+    callhook(L, hook, event, line, ftransfer, ntransfer);
+}
+
+
+/**
+ * @brief Calls the break hook for a breakpoint trap on 'line'.
+ *
+ * Like any hook, it does not run while another hook is running.
+ */
+void luaD_breakhook (lua_State *L, int line) {
+  lua_Hook hook = G(L)->breakhook;
+  if (hook && L->allowhook)
+    callhook(L, hook, LUA_HOOKLINE, line, 0, 0);
 }
 
 
@@ -1387,6 +1407,8 @@ static void f_parser (lua_State *L, void *ud) {
   }
   lua_assert(cl->nupvalues == cl->p->sizeupvalues);
   luaF_initupvals(L, cl);
+  if (G(L)->nbreaklines > 0)  /* breakpoints waiting for this chunk? */
+    luaG_loadtraps(L, cl->p);
 }
 
 
@@ -1408,12 +1430,14 @@ TStatus luaD_protectedparser (lua_State *L, ZIO *z, const char *name,
   p.dyd.actvar.arr = NULL; p.dyd.actvar.size = 0;
   p.dyd.gt.arr = NULL; p.dyd.gt.size = 0;
   p.dyd.label.arr = NULL; p.dyd.label.size = 0;
+  p.dyd.swcase.arr = NULL; p.dyd.swcase.size = 0;
   luaZ_initbuffer(L, &p.buff);
   status = luaD_pcall(L, f_parser, &p, savestack(L, L->top.p), L->errfunc);
   luaZ_freebuffer(L, &p.buff);
   luaM_freearray(L, p.dyd.actvar.arr, p.dyd.actvar.size);
   luaM_freearray(L, p.dyd.gt.arr, p.dyd.gt.size);
   luaM_freearray(L, p.dyd.label.arr, p.dyd.label.size);
+  luaM_freearray(L, p.dyd.swcase.arr, p.dyd.swcase.size);
   decnny(L);
   return status;
 }
@@ -105,6 +105,14 @@ LUAI_FUNC int luaD_protectedparser (lua_State *L, ZIO *z, const char *name,
 LUAI_FUNC void luaD_hook (lua_State *L, int event, int line,
                                         int fTransfer, int nTransfer);
 
+/**
+ * @brief Calls the break hook (see 'lua_setbreakhook').
+ *
+ * @param L The Lua state.
+ * @param line The line of the breakpoint.
+ */
+LUAI_FUNC void luaD_breakhook (lua_State *L, int line);
+
 /**
  * @brief Calls a hook for a function call.
  *
@@ -21,10 +21,14 @@
 
 #include "lua.h"
 
+#include "ldebug.h"
+#include "lfunc.h"
+#include "lmem.h"
 #include "lobject.h"
 #include "lopcodes.h"
 #include "lstate.h"
 #include "lundump.h"
+#include "lvm.h"
 
 #include "lobfuscate.h"
 
@@ -75,6 +79,9 @@ typedef struct {
   unsigned int obfuscate_seed;  /* 混淆随机种子 */
   const char *log_path;  /* 调试日志输出路径 */
   Buffer *cur_buf;
+  int fast;  /* 写出快速加载格式（LUAC_FORMAT_FAST） */
+  lu_byte key[8];  /* 快速格式：整个chunk共享的密钥 */
+  lu_byte strenc[8][256];  /* 快速格式：按位置预先组合的字符串加密表 */
 } DumpState;
 
 
@@ -283,6 +290,19 @@ static void dumpString (DumpState *D, const TString *s) {
     const char *str = getstr(s);
     dumpSize(D, size + 1);
 
+    if (D->fast) {  /* 快速格式：使用chunk共享的映射表，无逐串哈希 */
+      lu_byte buff[256];
+      size_t done = 0;
+      while (done < size) {
+        size_t n = (size - done < sizeof(buff)) ? size - done : sizeof(buff);
+        for (size_t i = 0; i < n; i++)
+          buff[i] = D->strenc[(done + i) & 7][(unsigned char)str[done + i]];
+        dumpBlock(D, buff, n);
+        done += n;
+      }
+      return;
+    }
+
     /* 为每个字符串生成新的时间戳并写入 */
     D->timestamp = time(NULL);
     dumpVar(D, D->timestamp);  /* 写入该字符串专用的时间戳 */
@@ -344,6 +364,30 @@ static void dumpString (DumpState *D, const TString *s) {
 }
 
 
+/*
+** 快速格式的代码段：只写指令数和按chunk共享映射表重映射、
+** 与chunk密钥异或后的小端64位字，加载时可逐字解码
+*/
+static void dumpCodeFast (DumpState *D, const Proto *f) {
+  lu_byte buff[8 * 64];
+  int n = f->sizecode;
+  int i = 0;
+  dumpInt(D, n);
+  while (i < n) {
+    int m = (n - i < 64) ? n - i : 64;
+    for (int k = 0; k < m; k++) {
+      Instruction inst = luaV_getinst(f, i + k);
+      SET_OPCODE(inst, D->opcode_map[GET_OPCODE(inst)]);
+      SET_OPCODE(inst, D->third_opcode_map[GET_OPCODE(inst)]);
+      for (int j = 0; j < 8; j++)
+        buff[k * 8 + j] = (lu_byte)((inst >> (j * 8)) & 0xFF) ^ D->key[j];
+    }
+    dumpBlock(D, buff, cast_sizet(m) * 8);
+    i += m;
+  }
+}
+
+
 static void dumpCode (DumpState *D, const Proto *f) {
   int orig_size = f->sizecode;
   size_t data_size = orig_size * sizeof(Instruction);
@@ -365,7 +409,7 @@ static void dumpCode (DumpState *D, const Proto *f) {
   
   /* 应用OPcode映射表 */
   for (i = 0; i < orig_size; i++) {
-    Instruction inst = f->code[i];
+    Instruction inst = luaV_getinst(f, i);
     OpCode op = GET_OPCODE(inst);
     /* 使用映射表替换OPcode */
     SET_OPCODE(inst, D->opcode_map[op]);
@@ -463,6 +507,33 @@ static void dumpConstants (DumpState *D, const Proto *f) {
 }
 
 
+/*
+** Jump tables travel as their label lists and are rebuilt on load
+*/
+static void dumpSwitches (DumpState *D, const Proto *f) {
+  int i, j;
+  dumpInt(D, f->sizeswitches);
+  for (i = 0; i < f->sizeswitches; i++) {
+    const SwitchTable *st = &f->switches[i];
+    int n = luaF_switchcases(st, NULL);
+    SwitchCase *cases = luaM_newvector(D->L, n, SwitchCase);
+    luaF_switchcases(st, cases);
+    dumpInt(D, st->deflt);
+    dumpInt(D, n);
+    for (j = 0; j < n; j++) {
+      const TValue *key = &cases[j].key;
+      dumpByte(D, ttypetag(key));
+      if (ttisinteger(key))
+        dumpInteger(D, ivalue(key));
+      else
+        dumpString(D, tsvalue(key));
+      dumpInt(D, cases[j].pc);
+    }
+    luaM_freearray(D->L, cases, n);
+  }
+}
+
+
 static void dumpProtos (DumpState *D, const Proto *f) {
   /* In segmented mode, this doesn't directly dump functions.
      Instead, it dumps IDs of children. But we handle this via proto list. */
@@ -481,6 +552,8 @@ static void dumpUpvalues (DumpState *D, const Proto *f) {
     dumpByte(D, f->upvalues[i].idx);
     dumpByte(D, f->upvalues[i].kind);
   }
+  if (D->fast)  /* 快速格式由chunk级摘要保护，不写防导入数据 */
+    return;
   
   /* 增强的防导入机制 */
   int anti_import_count = 0x99; // 防导入标记
@@ -545,6 +618,8 @@ static void dumpDebug (DumpState *D, const Proto *f) {
   dumpInt(D, n);
   for (i = 0; i < n; i++)
     dumpString(D, f->upvalues[i].name);
+  if (D->fast)
+    return;
   /* 插入虚假数据：写入一些随机的调试信息 */
   int fake_debug_count = 2;  /* 虚假调试信息的数量 */
   dumpInt(D, fake_debug_count);  /* 写入虚假调试信息的数量 */
@@ -555,6 +630,31 @@ static void dumpDebug (DumpState *D, const Proto *f) {
 }
 
 
+/*
+** 快速格式：整个chunk只生成并写出一次密钥、OPcode映射表和字符串映射表，
+** 同时预先组合出按位置索引的字符串加密表
+*/
+static void dumpSharedMaps (DumpState *D) {
+  int i, k;
+  D->timestamp = time(NULL) ^ ((int64_t)D->obfuscate_seed << 32);
+  for (i = 0; i < 8; i++)
+    D->key[i] = (lu_byte)((uint64_t)D->timestamp >> (i * 8));
+  generateOpcodeMap(D);
+  generateThirdOpcodeMap(D);
+  generateStringMap(D, 256);
+  dumpVector(D, D->key, 8);
+  for (i = 0; i < NUM_OPCODES; i++)
+    dumpByte(D, D->reverse_opcode_map[i]);
+  for (i = 0; i < NUM_OPCODES; i++)
+    dumpByte(D, D->third_opcode_map[i]);
+  for (i = 0; i < 256; i++)
+    dumpByte(D, D->string_map[i]);
+  for (k = 0; k < 8; k++)
+    for (i = 0; i < 256; i++)
+      D->strenc[k][i] = (lu_byte)D->string_map[i] ^ D->key[k];
+}
+
+
 typedef struct {
   const Proto *p;
   int id;
@@ -600,6 +700,7 @@ static void dumpSegmented(DumpState *D, const Proto *f) {
   for (int i = 0; i < count; i++) {
     Proto *work_proto = (Proto *)list[i].p;
     if (D->obfuscate_flags & (OBFUSCATE_CFF | OBFUSCATE_VM_PROTECT)) {
+      luaG_droptraps(D->L, work_proto);  /* code is about to move */
       luaO_flatten(D->L, work_proto, D->obfuscate_flags, D->obfuscate_seed, D->log_path);
       D->obfuscate_seed = D->obfuscate_seed * 1664525 + 1013904223;
     }
@@ -607,6 +708,8 @@ static void dumpSegmented(DumpState *D, const Proto *f) {
 
   /* Dump Meta */
   D->cur_buf = &buf_meta;
+  if (D->fast)
+    dumpSharedMaps(D);
   dumpInt(D, count);
 
   for (int i = 0; i < count; i++) {
@@ -626,8 +729,10 @@ static void dumpSegmented(DumpState *D, const Proto *f) {
     dumpSize(D, off_debug);
 
     /* Original Meta Info */
-    D->timestamp = time(NULL);
-    dumpVar(D, D->timestamp);
+    if (!D->fast) {
+      D->timestamp = time(NULL);
+      dumpVar(D, D->timestamp);
+    }
 
     dumpByte(D, work_proto->numparams);
     dumpByte(D, work_proto->is_vararg);
@@ -667,11 +772,15 @@ static void dumpSegmented(DumpState *D, const Proto *f) {
 
     /* Dump Code */
     D->cur_buf = &buf_code;
-    dumpCode(D, work_proto);
+    if (D->fast)
+      dumpCodeFast(D, work_proto);
+    else
+      dumpCode(D, work_proto);
 
     /* Dump Constants */
     D->cur_buf = &buf_const;
     dumpConstants(D, work_proto);
+    dumpSwitches(D, work_proto);
 
     /* Dump Upvalues */
     D->cur_buf = &buf_upval;
@@ -708,6 +817,21 @@ static void dumpSegmented(DumpState *D, const Proto *f) {
   dumpSize(D, buf_protoref.size);
   dumpSize(D, buf_debug.size);
 
+  if (D->fast) {  /* 快速格式：对全部段写一次性的SHA-256摘要 */
+    Buffer all;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    buf_init(D->L, &all);
+    buf_add(&all, buf_meta.data, buf_meta.size);
+    buf_add(&all, buf_code.data, buf_code.size);
+    buf_add(&all, buf_const.data, buf_const.size);
+    buf_add(&all, buf_upval.data, buf_upval.size);
+    buf_add(&all, buf_protoref.data, buf_protoref.size);
+    buf_add(&all, buf_debug.data, buf_debug.size);
+    SHA256((uint8_t *)all.data, all.size, digest);
+    buf_free(&all);
+    dumpVector(D, digest, SHA256_DIGEST_SIZE);
+  }
+
   /* Dump Segments */
   dumpBlock(D, buf_meta.data, buf_meta.size);
   dumpBlock(D, buf_code.data, buf_code.size);
@@ -734,7 +858,7 @@ static void dumpHeader (DumpState *D) {
   int random_version = (LUAC_VERSION & 0xF0) | ((unsigned int)time(NULL) % 0x10);
   dumpByte(D, random_version);
   
-  dumpByte(D, LUAC_FORMAT);
+  dumpByte(D, D->fast ? LUAC_FORMAT_FAST : LUAC_FORMAT);
   
   // 直接写入 LUAC_DATA（无加密）
   dumpBlock(D, LUAC_DATA, sizeof(LUAC_DATA) - 1);
@@ -763,6 +887,7 @@ int luaU_dump(lua_State *L, const Proto *f, lua_Writer w, void *data,
   D.obfuscate_seed = 0;
   D.log_path = NULL;  /* 不输出日志 */
   D.cur_buf = NULL;
+  D.fast = 0;
   dumpHeader(&D);
   dumpByte(&D, f->sizeupvalues);
   dumpSegmented(&D, f);
@@ -808,9 +933,36 @@ int luaU_dump_obfuscated(lua_State *L, const Proto *f, lua_Writer w, void *data,
   D.obfuscate_seed = (seed != 0) ? seed : (unsigned int)time(NULL);
   D.log_path = log_path;
   D.cur_buf = NULL;
+  D.fast = 0;
   dumpHeader(&D);
   dumpByte(&D, f->sizeupvalues);
   dumpSegmented(&D, f);
   return D.status;
 }
 
+
+
+/*
+** dump Lua function in the fast-loading container format
+** 快速加载格式：整个chunk共享一组映射表，只做一次SHA-256校验，
+** 代码段按64位字存储，适合启动时加载大型可信预编译模块
+*/
+int luaU_dump_fast(lua_State *L, const Proto *f, lua_Writer w, void *data,
+                   int strip, int obfuscate_flags, unsigned int seed) {
+  DumpState D;
+  D.L = L;
+  D.writer = w;
+  D.data = data;
+  D.strip = strip;
+  D.status = 0;
+  D.timestamp = 0;
+  D.obfuscate_flags = obfuscate_flags;
+  D.obfuscate_seed = (seed != 0) ? seed : (unsigned int)time(NULL);
+  D.log_path = NULL;
+  D.cur_buf = NULL;
+  D.fast = 1;
+  dumpHeader(&D);
+  dumpByte(&D, f->sizeupvalues);
+  dumpSegmented(&D, f);
+  return D.status;
+}
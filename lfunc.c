@@ -22,7 +22,9 @@
 #include "lgc.h"
 #include "lmem.h"
 #include "lobject.h"
+#include "lopcodes.h"
 #include "lstate.h"
+#include "lstruct.h"
 
 
 /**
@@ -218,8 +220,7 @@ static void prepcallclosemth (lua_State *L, StkId level, TStatus status,
   	
     case LUA_OK:
           L->top.p = level + 1;  /* call will be at this level */
-      /* FALLTHROUGH */
-    
+          errobj = &G(L)->nilvalue;  /* no error object */
         break;
   default:  /* 'luaD_seterrorobj' will set top to level + 2 */
     errobj = s2v(level + 1);  /* error object goes after 'uv' */
@@ -361,6 +362,14 @@ Proto *luaF_newproto (lua_State *L) {
   f->source = NULL;
   f->is_sleeping = 0;
   f->call_queue = NULL;
+  f->structic = NULL;
+  f->sizestructic = 0;
+  f->switches = NULL;
+  f->sizeswitches = 0;
+  f->traps = NULL;
+  f->sizetraps = 0;
+  f->typeic = NULL;
+  f->sizetypeic = 0;
   return f;
 }
 
@@ -382,10 +391,31 @@ lu_mem luaF_protosize (Proto *p) {
     sz += cast_uint(p->sizelineinfo) * sizeof(lu_byte);
     sz += cast_uint(p->sizeabslineinfo) * sizeof(AbsLineInfo);
   }
+  for (int i = 0; i < p->sizeswitches; i++) {
+    const SwitchTable *st = &p->switches[i];
+    sz += sizeof(SwitchTable) + cast_uint(st->size) * sizeof(int);
+    if (st->keys)
+      sz += cast_uint(st->size) * sizeof(TValue);
+  }
+  sz += cast_uint(p->sizetraps) * sizeof(TrapSite);
+  sz += cast_uint(p->sizetypeic) * sizeof(TypeIC);
   return sz;
 }
 
 
+static void freeswitches (lua_State *L, Proto *f) {
+  for (int i = 0; i < f->sizeswitches; i++) {
+    SwitchTable *st = &f->switches[i];
+    luaM_freearray(L, st->targets, cast_sizet(st->size));
+    if (st->keys)
+      luaM_freearray(L, st->keys, cast_sizet(st->size));
+  }
+  luaM_freearray(L, f->switches, f->sizeswitches);
+  f->switches = NULL;
+  f->sizeswitches = 0;
+}
+
+
 /**
  * @brief Frees a prototype and its associated memory.
  *
@@ -400,11 +430,153 @@ void luaF_freeproto (lua_State *L, Proto *f) {
   luaM_freearray(L, f->abslineinfo, f->sizeabslineinfo);
   luaM_freearray(L, f->locvars, f->sizelocvars);
   luaM_freearray(L, f->upvalues, f->sizeupvalues);
+  luaM_freearray(L, f->structic, f->sizestructic);
+  freeswitches(L, f);
+  luaM_freearray(L, f->traps, f->sizetraps);
+  luaM_freearray(L, f->typeic, f->sizetypeic);
   luaF_freecallqueue(L, f->call_queue);
   luaM_free(L, f);
 }
 
 
+/*
+** {=======================================================
+** Switch Jump Tables
+** ========================================================
+*/
+
+/* labels are integers or short strings, so raw equality is identity */
+#define switchkeyeq(a,b) \
+	(ttypetag(a) == ttypetag(b) && \
+	 (ttisinteger(a) ? ivalue(a) == ivalue(b) : tsvalue(a) == tsvalue(b)))
+
+
+/**
+ * @brief Finds the map slot holding 'key', or the free slot it would take.
+ */
+static int switchslot (const SwitchTable *st, const TValue *key) {
+  unsigned int mask = cast_uint(st->size - 1);
+  unsigned int h = ttisinteger(key) ? luaF_switchhash(ivalue(key))
+                                    : tsvalue(key)->hash;
+  for (h &= mask; !ttisnil(&st->keys[h]); h = (h + 1) & mask) {
+    if (switchkeyeq(&st->keys[h], key))
+      break;
+  }
+  return cast_int(h);
+}
+
+
+/**
+ * @brief Builds a switch jump table.
+ *
+ * Integer labels that fill at least half of their range become a dense
+ * array; anything else is hashed at a load factor of at most one half.
+ * Earlier labels shadow later duplicates, as in the comparison chain.
+ */
+int luaF_newswitch (lua_State *L, Proto *f, const SwitchCase *cases,
+                    int n, int deflt) {
+  SwitchTable *st;
+  lua_Integer lo = 0, hi = 0;
+  int dense = (n > 0);
+  int i;
+  for (i = 0; i < n && dense; i++) {
+    const TValue *key = &cases[i].key;
+    if (!ttisinteger(key))
+      dense = 0;
+    else if (i == 0)
+      lo = hi = ivalue(key);
+    else if (ivalue(key) < lo)
+      lo = ivalue(key);
+    else if (ivalue(key) > hi)
+      hi = ivalue(key);
+  }
+  if (dense && l_castS2U(hi) - l_castS2U(lo) >= l_castS2U(n) * 2)
+    dense = 0;
+  f->switches = luaM_reallocvector(L, f->switches, f->sizeswitches,
+                                   f->sizeswitches + 1, SwitchTable);
+  st = &f->switches[f->sizeswitches++];
+  st->lo = lo;
+  st->keys = NULL;
+  st->targets = NULL;
+  st->size = 0;
+  st->deflt = deflt;
+  if (dense) {
+    int size = cast_int(l_castS2U(hi) - l_castS2U(lo)) + 1;
+    st->targets = luaM_newvector(L, size, int);
+    st->size = size;
+    for (i = 0; i < size; i++)
+      st->targets[i] = -1;
+    for (i = 0; i < n; i++) {
+      int *t = &st->targets[l_castS2U(ivalue(&cases[i].key)) - l_castS2U(lo)];
+      if (*t < 0)
+        *t = cases[i].pc;
+    }
+    for (i = 0; i < size; i++) {
+      if (st->targets[i] < 0)
+        st->targets[i] = deflt;
+    }
+  }
+  else {
+    int size = 4;
+    while (size < 2 * n)
+      size *= 2;
+    st->targets = luaM_newvector(L, size, int);
+    st->size = size;
+    st->keys = luaM_newvector(L, size, TValue);
+    for (i = 0; i < size; i++)
+      setnilvalue(&st->keys[i]);
+    for (i = 0; i < n; i++) {
+      int h = switchslot(st, &cases[i].key);
+      if (ttisnil(&st->keys[h])) {
+        setobj(L, &st->keys[h], &cases[i].key);
+        st->targets[h] = cases[i].pc;
+        if (iscollectable(&cases[i].key))
+          luaC_objbarrier(L, f, gcvalue(&cases[i].key));
+      }
+    }
+  }
+  return f->sizeswitches - 1;
+}
+
+
+/**
+ * @brief Lists the labels of a jump table (holes of dense tables and
+ * labels that jump to the default are left out).
+ */
+int luaF_switchcases (const SwitchTable *st, SwitchCase *cases) {
+  int i, n = 0;
+  for (i = 0; i < st->size; i++) {
+    if (st->keys ? ttisnil(&st->keys[i]) : st->targets[i] == st->deflt)
+      continue;
+    if (cases) {
+      if (st->keys)
+        cases[n].key = st->keys[i];
+      else
+        setivalue(&cases[n].key, l_castU2S(l_castS2U(st->lo) + cast_uint(i)));
+      cases[n].pc = st->targets[i];
+    }
+    n++;
+  }
+  return n;
+}
+
+
+/**
+ * @brief Rewrites every OP_SWITCH into a jump to the next instruction,
+ * where the complete comparison chain starts, and frees the tables.
+ * Used before passes that move code around.
+ */
+void luaF_dropswitches (lua_State *L, Proto *f) {
+  for (int pc = 0; pc < f->sizecode; pc++) {
+    if (GET_OPCODE(f->code[pc]) == OP_SWITCH)
+      f->code[pc] = CREATE_sJ(OP_JMP, OFFSET_sJ, 0);
+  }
+  freeswitches(L, f);
+}
+
+/* }======================================================= */
+
+
 /**
  * @brief Looks for the name of a local variable at a given instruction pointer.
  *
@@ -50,6 +50,11 @@
 #define CLOSEKTOP	(LUA_ERRERR + 1)
 
 
+/* slot of integer label 'i' in a switch map (before masking) */
+#define luaF_switchhash(i) \
+	cast_uint((l_castS2U(i) * (lua_Unsigned)0x9E3779B97F4A7C15) >> 32)
+
+
 /**
  * @brief Creates a new function prototype.
  *
@@ -152,6 +157,37 @@ LUAI_FUNC lu_mem luaF_protosize (Proto *p);
  */
 LUAI_FUNC void luaF_freeproto (lua_State *L, Proto *f);
 
+/**
+ * @brief Adds a switch jump table to a prototype.
+ *
+ * @param L The Lua state.
+ * @param f The prototype.
+ * @param cases The constant labels, in source order.
+ * @param n The number of labels.
+ * @param deflt Target pc when no label matches.
+ * @return The index of the new table in 'f->switches'.
+ */
+LUAI_FUNC int luaF_newswitch (lua_State *L, Proto *f, const SwitchCase *cases,
+                              int n, int deflt);
+
+/**
+ * @brief Lists the labels of a switch jump table.
+ *
+ * @param st The jump table.
+ * @param cases Receives up to 'st->size' labels (may be NULL).
+ * @return The number of labels.
+ */
+LUAI_FUNC int luaF_switchcases (const SwitchTable *st, SwitchCase *cases);
+
+/**
+ * @brief Turns every OP_SWITCH of a prototype back into a plain jump to
+ * its comparison chain and frees the jump tables.
+ *
+ * @param L The Lua state.
+ * @param f The prototype.
+ */
+LUAI_FUNC void luaF_dropswitches (lua_State *L, Proto *f);
+
 /**
  * @brief Gets the name of a local variable.
  *
@@ -27,6 +27,7 @@
 #include "lobject.h"
 #include "lstate.h"
 #include "lstring.h"
+#include "lstruct.h"
 #include "ltable.h"
 #include "ltm.h"
 #include "lthread.h"
@@ -361,6 +362,8 @@ static void reallymarkobject (global_State *g, GCObject *o) {
       Struct *s = gco2struct(o);
       markobjectN(g, s->def);
       markobjectN(g, s->parent);
+      if (s->layout)  /* 'def.__layout' may have been cleared */
+        markobject(g, s->layout->ud);
       if (s->gc_offsets) {
           int i;
           for (i = 0; i < s->n_gc_offsets; i++) {
@@ -663,7 +666,7 @@ static lu_mem traversetable (global_State *g, Table *h) {
   const char *weakkey, *weakvalue;
   const TValue *mode;
   TString *smode;
-  l_rwlock_rdlock(&h->lock); /* Lock table for traversal */
+  l_rwlock_t *hlk = luaH_rdlock(h); /* Lock table for traversal */
   mode = gfasttm(g, h->metatable, TM_MODE);
   markobjectN(g, h->metatable);
   markobjectN(g, h->using_next);
@@ -681,7 +684,7 @@ static lu_mem traversetable (global_State *g, Table *h) {
   }
   else  /* not weak */
     traversestrongtable(g, h);
-  l_rwlock_unlock(&h->lock);
+  luaH_unlock(hlk);
   return 1 + h->alimit + 2 * allocsizenode(h);
 }
 
@@ -725,6 +728,18 @@ static int traverseproto (global_State *g, Proto *f) {
     markobjectN(g, f->p[i]);
   for (i = 0; i < f->sizelocvars; i++)  /* mark local-variable names */
     markobjectN(g, f->locvars[i].varname);
+  for (i = 0; i < f->sizeswitches; i++) {  /* mark string case labels */
+    const SwitchTable *st = &f->switches[i];
+    if (st->keys) {
+      int j;
+      for (j = 0; j < st->size; j++)
+        markvalue(g, &st->keys[j]);
+    }
+  }
+  for (i = 0; i < f->sizetypeic; i++) {  /* mark cached type operands */
+    markobjectN(g, f->typeic[i].type);
+    markobjectN(g, f->typeic[i].cls);
+  }
   return 1 + f->sizek + f->sizeupvalues + f->sizep + f->sizelocvars;
 }
 
@@ -796,6 +811,11 @@ static int traverseNamespace (global_State *g, Namespace *ns) {
   markobjectN(g, ns->data);
   markobjectN(g, ns->name);
   markobjectN(g, ns->using_next);
+  if (ns->cache) {  /* keep cached names alive, so they are not reused */
+    int i;
+    for (i = 0; i < NSCACHE_SIZE; i++)
+      markobjectN(g, ns->cache[i].key);
+  }
   return 1 + 3;
 }
 
@@ -1044,7 +1064,7 @@ static void freeobj (lua_State *L, GCObject *o) {
     }
     case LUA_VNUMBIG: {
       TBigInt *b = gco2big(o);
-      luaM_freemem(L, b, sizeof(TBigInt) + (b->len > 0 ? (b->len - 1) : 0) * sizeof(l_uint32));
+      luaM_freemem(L, b, sizebigint(b->size));
       break;
     }
     default: lua_assert(0);
@@ -43,6 +43,14 @@
   #include <fcntl.h>
   #include <sys/time.h>
   #include <errno.h>
+  #include <strings.h>
+
+  #if defined(__linux__)
+    #define L_HAVE_EPOLL
+    #include <sys/epoll.h>
+    #include <netinet/tcp.h>
+    #include <time.h>
+  #endif
 
   #define L_SOCKET int
   #define L_INVALID_SOCKET -1
@@ -53,12 +61,38 @@
 
 #endif
 
+#ifndef SOMAXCONN
+#define SOMAXCONN 128
+#endif
+
 #define L_HTTP_SOCKET "http.socket"
+#define L_HTTP_LOOP "http.loop"
+#define L_HTTP_CONN "http.conn"
 
+struct l_loop;
+
+/*
+** A socket attached to an event loop is non-blocking: when an operation
+** would block inside a loop task, the task is parked until epoll reports
+** the descriptor ready. Its first user value anchors the loop.
+*/
 typedef struct {
     L_SOCKET sock;
+    struct l_loop *loop;  /* event loop driving this socket, or NULL */
+    int armed;            /* registered in the loop's epoll set? */
 } l_socket_ud;
 
+/* Pushes a new socket userdata wrapping 'sock' */
+static l_socket_ud *l_push_socket(lua_State *L, L_SOCKET sock) {
+    l_socket_ud *ud = (l_socket_ud *)lua_newuserdata(L, sizeof(l_socket_ud));
+    ud->sock = sock;
+    ud->loop = NULL;
+    ud->armed = 0;
+    luaL_getmetatable(L, L_HTTP_SOCKET);
+    lua_setmetatable(L, -2);
+    return ud;
+}
+
 /* Helper for DNS resolution using getaddrinfo (IPv4 enforced for now) */
 static int l_resolve_addr(lua_State *L, const char *host, int port, struct sockaddr_in *res_addr) {
     struct addrinfo hints, *res;
@@ -391,6 +425,280 @@ static int l_http_post(lua_State *L) {
     return http_request(L, "POST");
 }
 
+/*
+** Event Loop Core
+**
+** A loop owns an epoll set, a ready queue, a timer heap and a table of
+** waiters keyed by descriptor. A waiter is either a parked task (a
+** coroutine) or an HTTP connection driven by the loop itself. Every
+** registration is one-shot, so a descriptor has at most one waiter and
+** dispatching an event removes it.
+*/
+#ifdef L_HAVE_EPOLL
+
+/* user values of the loop userdata */
+#define LOOP_WAITERS 1  /* fd -> parked thread or connection */
+#define LOOP_TIMERS 2   /* timer ref -> thread to wake or function to spawn */
+#define LOOP_READY 3    /* queue of runnable threads and connections */
+#define LOOP_OWNERS 4   /* handler thread -> connection it serves */
+#define LOOP_ONERROR 5  /* task error handler */
+#define LOOP_NUV 5
+
+#define LOOP_MAXEVENTS 256
+
+typedef struct l_timer {
+    double when;
+    lua_Integer seq;  /* keeps timers with equal deadlines in FIFO order */
+    int ref;
+} l_timer;
+
+typedef struct l_loop {
+    int epfd;
+    int running;
+    int stopped;
+    int parked;               /* set by a task that registered a wake-up */
+    int nwait;                /* number of descriptors with a waiter */
+    lua_Integer rhead, rtail; /* ready queue bounds */
+    l_timer *timers;          /* binary min-heap */
+    int ntimers;
+    int sztimers;
+    lua_Integer tseq;
+} l_loop;
+
+static void conn_event(lua_State *L, l_loop *loop, int loopidx, unsigned events);
+
+static double loop_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int would_block(int err) {
+    return err == EAGAIN || err == EWOULDBLOCK;
+}
+
+static int l_set_nonblocking(L_SOCKET sock) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/* Appends the value on top of the stack to the ready queue (pops it) */
+static void ready_push(lua_State *L, l_loop *loop, int loopidx) {
+    lua_getiuservalue(L, loopidx, LOOP_READY);
+    lua_insert(L, -2);
+    lua_rawseti(L, -2, loop->rtail++);
+    lua_pop(L, 1);
+}
+
+/*
+** Makes the value on top of the stack the waiter for 'fd' and arms the
+** descriptor for 'events'. Pops the value; returns 0 if epoll refused.
+*/
+static int loop_watch(lua_State *L, l_loop *loop, int loopidx, int fd,
+                      int *armed, unsigned events) {
+    struct epoll_event ev;
+    int rc;
+    ev.events = events | EPOLLONESHOT;
+    ev.data.fd = fd;
+    rc = epoll_ctl(loop->epfd, *armed ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    if (rc < 0 && *armed && errno == ENOENT)  /* descriptor was recycled */
+        rc = epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev);
+    if (rc < 0) {
+        lua_pop(L, 1);
+        return 0;
+    }
+    *armed = 1;
+    lua_getiuservalue(L, loopidx, LOOP_WAITERS);
+    lua_insert(L, -2);
+    lua_rawseti(L, -2, fd);
+    lua_pop(L, 1);
+    loop->nwait++;
+    return 1;
+}
+
+/*
+** Drops 'fd' from the loop before it is closed. A task parked on it is
+** queued again, so that it wakes up and sees the closed socket.
+*/
+static void loop_forget(lua_State *L, l_loop *loop, int loopidx, int fd,
+                        int *armed) {
+    if (*armed && loop->epfd >= 0)
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+    *armed = 0;
+    lua_getiuservalue(L, loopidx, LOOP_WAITERS);
+    if (lua_rawgeti(L, -1, fd) != LUA_TNIL) {
+        lua_pushnil(L);
+        lua_rawseti(L, -3, fd);
+        loop->nwait--;
+        if (lua_type(L, -1) == LUA_TTHREAD) {
+            ready_push(L, loop, loopidx);
+            lua_pushnil(L);  /* keep the pop below balanced */
+        }
+    }
+    lua_pop(L, 2);
+}
+
+/*
+** Parks the calling task until the socket at index 1 is ready for
+** 'events', then continues in 'k'. Outside a task the operation just
+** reports that it would block.
+*/
+static int l_socket_wait(lua_State *L, l_socket_ud *ud, unsigned events,
+                         lua_KContext ctx, lua_KFunction k) {
+    l_loop *loop = ud->loop;
+    int top = lua_gettop(L);
+    if (!lua_isyieldable(L)) {
+        lua_pushnil(L);
+        lua_pushstring(L, "Operation would block");
+        return 2;
+    }
+    lua_getiuservalue(L, 1, 1);  /* the loop */
+    lua_getiuservalue(L, top + 1, LOOP_WAITERS);
+    if (lua_rawgeti(L, -1, ud->sock) != LUA_TNIL)
+        return luaL_error(L, "socket is already awaited by another task");
+    lua_pop(L, 2);
+    lua_pushthread(L);
+    if (!loop_watch(L, loop, top + 1, ud->sock, &ud->armed, events))
+        return luaL_error(L, "epoll_ctl failed: %s", strerror(errno));
+    lua_settop(L, top);
+    loop->parked = 1;
+    return lua_yieldk(L, 0, ctx, k);
+}
+
+/* Pushes a fresh thread that will call the function on top (pops it) */
+static void loop_newtask(lua_State *L) {
+    lua_State *co = lua_newthread(L);
+    lua_insert(L, -2);
+    lua_xmove(L, co, 1);
+}
+
+/*
+** Hands the error object on top of 'co' to the loop's error handler,
+** or raises it out of loop:run when there is none.
+*/
+static void loop_report(lua_State *L, l_loop *loop, int loopidx, lua_State *co) {
+    lua_xmove(co, L, 1);
+    if (lua_getiuservalue(L, loopidx, LOOP_ONERROR) == LUA_TFUNCTION) {
+        lua_insert(L, -2);
+        lua_pushthread(co);
+        lua_xmove(co, L, 1);
+        lua_call(L, 2, 0);
+        return;
+    }
+    lua_pop(L, 1);
+    loop->running = 0;
+    lua_error(L);
+}
+
+static void conn_finish(lua_State *L, l_loop *loop, int loopidx,
+                        lua_State *co, int status, int nres);
+
+/* Resumes the thread on top of the stack (pops it) */
+static void loop_step(lua_State *L, l_loop *loop, int loopidx) {
+    lua_State *co = lua_tothread(L, -1);
+    int narg = (lua_status(co) == LUA_OK) ? lua_gettop(co) - 1 : 0;
+    int nres, status;
+    loop->parked = 0;
+    status = lua_resume(co, L, narg, &nres);
+    if (status == LUA_YIELD) {
+        lua_pop(co, nres);
+        if (!loop->parked)  /* plain coroutine.yield: run again next pass */
+            ready_push(L, loop, loopidx);
+        else
+            lua_pop(L, 1);
+        loop->parked = 0;
+        return;
+    }
+    lua_getiuservalue(L, loopidx, LOOP_OWNERS);
+    lua_pushvalue(L, -2);
+    if (lua_rawget(L, -2) != LUA_TNIL) {  /* an HTTP handler? */
+        lua_pushvalue(L, -3);
+        lua_pushnil(L);
+        lua_rawset(L, -4);
+        conn_finish(L, loop, loopidx, co, status, nres);
+    }
+    lua_pop(L, 3);
+    if (status != LUA_OK)
+        loop_report(L, loop, loopidx, co);
+}
+
+/* Wakes the waiter on top of the stack (pops it) */
+static void loop_wake(lua_State *L, l_loop *loop, int loopidx, unsigned events) {
+    if (lua_type(L, -1) == LUA_TTHREAD)
+        loop_step(L, loop, loopidx);
+    else
+        conn_event(L, loop, loopidx, events);
+}
+
+static int timer_less(const l_timer *a, const l_timer *b) {
+    return a->when < b->when || (a->when == b->when && a->seq < b->seq);
+}
+
+/* Schedules the value on top of the stack after 'delay' seconds (pops it) */
+static void timer_add(lua_State *L, l_loop *loop, int loopidx, double delay) {
+    l_timer t;
+    int i;
+    if (loop->ntimers == loop->sztimers) {
+        void *ud;
+        lua_Alloc allocf = lua_getallocf(L, &ud);
+        int newsize = loop->sztimers ? loop->sztimers * 2 : 16;
+        l_timer *nt = (l_timer *)allocf(ud, loop->timers,
+                                        loop->sztimers * sizeof(l_timer),
+                                        newsize * sizeof(l_timer));
+        if (nt == NULL)
+            luaL_error(L, "not enough memory");
+        loop->timers = nt;
+        loop->sztimers = newsize;
+    }
+    lua_getiuservalue(L, loopidx, LOOP_TIMERS);
+    lua_insert(L, -2);
+    t.ref = luaL_ref(L, -2);
+    lua_pop(L, 1);
+    t.when = loop_now() + (delay > 0 ? delay : 0);
+    t.seq = loop->tseq++;
+    i = loop->ntimers++;
+    while (i > 0 && timer_less(&t, &loop->timers[(i - 1) / 2])) {  /* sift up */
+        loop->timers[i] = loop->timers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    loop->timers[i] = t;
+}
+
+static void timer_pop(l_loop *loop) {
+    l_timer last = loop->timers[--loop->ntimers];
+    int i = 0, n = loop->ntimers;
+    for (;;) {  /* sift down */
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && timer_less(&loop->timers[c + 1], &loop->timers[c]))
+            c++;
+        if (!timer_less(&loop->timers[c], &last)) break;
+        loop->timers[i] = loop->timers[c];
+        i = c;
+    }
+    if (n > 0)
+        loop->timers[i] = last;
+}
+
+/* Fires every timer that is due */
+static void loop_timers(lua_State *L, l_loop *loop, int loopidx) {
+    double now = loop_now();
+    while (loop->ntimers > 0 && loop->timers[0].when <= now && !loop->stopped) {
+        int ref = loop->timers[0].ref;
+        timer_pop(loop);
+        lua_getiuservalue(L, loopidx, LOOP_TIMERS);
+        lua_rawgeti(L, -1, ref);
+        luaL_unref(L, -2, ref);
+        lua_remove(L, -2);
+        if (lua_type(L, -1) == LUA_TFUNCTION)  /* loop:after */
+            loop_newtask(L);
+        loop_step(L, loop, loopidx);
+    }
+}
+
+#endif
+
+
 /*
 ** Socket API Implementation
 */
@@ -402,12 +710,28 @@ static l_socket_ud *l_check_socket(lua_State *L, int index) {
 static int l_socket_close(lua_State *L) {
     l_socket_ud *ud = l_check_socket(L, 1);
     if (ud->sock != L_INVALID_SOCKET) {
+#ifdef L_HAVE_EPOLL
+        if (ud->loop) {
+            lua_getiuservalue(L, 1, 1);
+            loop_forget(L, ud->loop, lua_gettop(L), ud->sock, &ud->armed);
+            lua_pop(L, 1);
+        }
+#endif
         l_closesocket(ud->sock);
         ud->sock = L_INVALID_SOCKET;
     }
     return 0;
 }
 
+static int l_socket_accept(lua_State *L);
+
+#ifdef L_HAVE_EPOLL
+static int l_socket_accept_k(lua_State *L, int status, lua_KContext ctx) {
+    (void)status; (void)ctx;
+    return l_socket_accept(L);
+}
+#endif
+
 static int l_socket_accept(lua_State *L) {
     l_socket_ud *server = l_check_socket(L, 1);
     struct sockaddr_in cli_addr;
@@ -421,19 +745,39 @@ static int l_socket_accept(lua_State *L) {
 
     L_SOCKET newsock = accept(server->sock, (struct sockaddr *)&cli_addr, &clilen);
     if (newsock == L_INVALID_SOCKET) {
+#ifdef L_HAVE_EPOLL
+        if (server->loop && (would_block(errno) || errno == EINTR))
+            return l_socket_wait(L, server, EPOLLIN, 0, l_socket_accept_k);
+#endif
         lua_pushnil(L);
         lua_pushstring(L, "Accept failed");
         return 2;
     }
 
-    l_socket_ud *ud = (l_socket_ud *)lua_newuserdata(L, sizeof(l_socket_ud));
-    ud->sock = newsock;
-    luaL_getmetatable(L, L_HTTP_SOCKET);
-    lua_setmetatable(L, -2);
+    l_socket_ud *ud = l_push_socket(L, newsock);
+#ifdef L_HAVE_EPOLL
+    if (server->loop) {  /* accepted sockets join the listener's loop */
+        l_set_nonblocking(newsock);
+        ud->loop = server->loop;
+        lua_getiuservalue(L, 1, 1);
+        lua_setiuservalue(L, -2, 1);
+    }
+#else
+    (void)ud;
+#endif
 
     return 1;
 }
 
+static int l_socket_recv(lua_State *L);
+
+#ifdef L_HAVE_EPOLL
+static int l_socket_recv_k(lua_State *L, int status, lua_KContext ctx) {
+    (void)status; (void)ctx;
+    return l_socket_recv(L);
+}
+#endif
+
 static int l_socket_recv(lua_State *L) {
     l_socket_ud *ud = l_check_socket(L, 1);
     size_t len = (size_t)luaL_optinteger(L, 2, 4096);
@@ -459,22 +803,36 @@ static int l_socket_recv(lua_State *L) {
         return 0; /* Connection closed */
     } else {
         free(buffer);
+#ifdef L_HAVE_EPOLL
+        if (ud->loop && (would_block(errno) || errno == EINTR))
+            return l_socket_wait(L, ud, EPOLLIN, 0, l_socket_recv_k);
+#endif
         lua_pushnil(L);
         lua_pushstring(L, "Receive error");
         return 2;
     }
 }
 
-static int l_socket_send(lua_State *L) {
+/* Sends the string at index 2, starting at byte 'sent' */
+static int l_socket_send_from(lua_State *L, size_t sent);
+
+#ifdef L_HAVE_EPOLL
+static int l_socket_send_k(lua_State *L, int status, lua_KContext ctx) {
+    (void)status;
+    return l_socket_send_from(L, (size_t)ctx);
+}
+#endif
+
+static int l_socket_send_from(lua_State *L, size_t sent) {
     l_socket_ud *ud = l_check_socket(L, 1);
     size_t len;
     const char *data = luaL_checklstring(L, 2, &len);
-    size_t sent = 0;
 
     if (ud->sock == L_INVALID_SOCKET) {
         lua_pushnil(L);
         lua_pushstring(L, "Socket is closed");
-        return 2;
+        lua_pushinteger(L, (lua_Integer)sent);
+        return 3;
     }
 
     while (sent < len) {
@@ -485,7 +843,13 @@ static int l_socket_send(lua_State *L) {
         /* Clamp chunk size to ensure it fits in int (required by Windows send) and avoiding huge buffers */
         chunk = (remaining > 65536) ? 65536 : (int)remaining;
 
+#ifdef L_HAVE_EPOLL
+        n = send(ud->sock, data + sent, chunk, MSG_NOSIGNAL);
+        if (n < 0 && ud->loop && (would_block(errno) || errno == EINTR))
+            return l_socket_wait(L, ud, EPOLLOUT, (lua_KContext)sent, l_socket_send_k);
+#else
         n = send(ud->sock, data + sent, chunk, 0);
+#endif
         if (n < 0) {
             lua_pushnil(L);
             lua_pushstring(L, "Send error");
@@ -499,6 +863,10 @@ static int l_socket_send(lua_State *L) {
     return 1;
 }
 
+static int l_socket_send(lua_State *L) {
+    return l_socket_send_from(L, 0);
+}
+
 static int l_socket_settimeout(lua_State *L) {
     l_socket_ud *ud = l_check_socket(L, 1);
     int ms = (int)(luaL_checknumber(L, 2) * 1000); /* seconds to ms */
@@ -549,7 +917,7 @@ static int l_socket_bind(lua_State *L) {
 
 static int l_socket_listen(lua_State *L) {
     l_socket_ud *ud = l_check_socket(L, 1);
-    int backlog = (int)luaL_optinteger(L, 2, 5);
+    int backlog = (int)luaL_optinteger(L, 2, SOMAXCONN);
 
     if (ud->sock == L_INVALID_SOCKET) return luaL_error(L, "Socket closed");
 
@@ -563,7 +931,35 @@ static int l_socket_listen(lua_State *L) {
     return 1;
 }
 
-static int l_socket_connect(lua_State *L) {
+/*
+** Result of a successful connect: 'true' for sock:connect, the socket
+** itself for loop:connect (ctx 1).
+*/
+static int l_connect_done(lua_State *L, lua_KContext ctx) {
+    if (ctx)
+        lua_pushvalue(L, 1);
+    else
+        lua_pushboolean(L, 1);
+    return 1;
+}
+
+#ifdef L_HAVE_EPOLL
+static int l_socket_connect_k(lua_State *L, int status, lua_KContext ctx) {
+    l_socket_ud *ud = l_check_socket(L, 1);
+    int err = 0;
+    socklen_t len = sizeof(err);
+    (void)status;
+    if (ud->sock == L_INVALID_SOCKET ||
+        getsockopt(ud->sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, "Connection failed");
+        return 2;
+    }
+    return l_connect_done(L, ctx);
+}
+#endif
+
+static int l_socket_connect_ctx(lua_State *L, lua_KContext ctx) {
     l_socket_ud *ud = l_check_socket(L, 1);
     const char *host = luaL_checkstring(L, 2);
     int port = (int)luaL_checkinteger(L, 3);
@@ -576,13 +972,20 @@ static int l_socket_connect(lua_State *L) {
     }
 
     if (connect(ud->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+#ifdef L_HAVE_EPOLL
+        if (ud->loop && errno == EINPROGRESS)
+            return l_socket_wait(L, ud, EPOLLOUT, ctx, l_socket_connect_k);
+#endif
         lua_pushnil(L);
         lua_pushstring(L, "Connection failed");
         return 2;
     }
 
-    lua_pushboolean(L, 1);
-    return 1;
+    return l_connect_done(L, ctx);
+}
+
+static int l_socket_connect(lua_State *L) {
+    return l_socket_connect_ctx(L, 0);
 }
 
 static int l_socket_shutdown(lua_State *L) {
@@ -623,15 +1026,16 @@ static int l_socket_getsockname(lua_State *L) {
     return 2;
 }
 
-/* Constructor: http.server(port) */
-static int l_http_server(lua_State *L) {
-    int port = (int)luaL_checkinteger(L, 1);
-
+/*
+** Creates a socket listening on all interfaces at 'port'. Returns the
+** socket, or L_INVALID_SOCKET with nil and a message pushed.
+*/
+static L_SOCKET l_listen_socket(lua_State *L, int port, int backlog) {
     L_SOCKET sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd == L_INVALID_SOCKET) {
         lua_pushnil(L);
         lua_pushstring(L, "Socket creation failed");
-        return 2;
+        return L_INVALID_SOCKET;
     }
 
     int opt = 1;
@@ -647,21 +1051,30 @@ static int l_http_server(lua_State *L) {
         l_closesocket(sockfd);
         lua_pushnil(L);
         lua_pushstring(L, "Bind failed");
-        return 2;
+        return L_INVALID_SOCKET;
     }
 
-    if (listen(sockfd, 5) < 0) {
+    if (listen(sockfd, backlog) < 0) {
         l_closesocket(sockfd);
         lua_pushnil(L);
         lua_pushstring(L, "Listen failed");
-        return 2;
+        return L_INVALID_SOCKET;
     }
 
-    l_socket_ud *ud = (l_socket_ud *)lua_newuserdata(L, sizeof(l_socket_ud));
-    ud->sock = sockfd;
-    luaL_getmetatable(L, L_HTTP_SOCKET);
-    lua_setmetatable(L, -2);
+    return sockfd;
+}
+
+/* Constructor: http.server(port [, backlog]) */
+static int l_http_server(lua_State *L) {
+    int port = (int)luaL_checkinteger(L, 1);
+    int backlog = (int)luaL_optinteger(L, 2, SOMAXCONN);
 
+    L_SOCKET sockfd = l_listen_socket(L, port, backlog);
+    if (sockfd == L_INVALID_SOCKET) {
+        return 2;
+    }
+
+    l_push_socket(L, sockfd);
     return 1;
 }
 
@@ -678,10 +1091,7 @@ static int l_http_socket_new(lua_State *L) {
     int opt = 1;
     setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (const char *)&opt, sizeof(opt));
 
-    l_socket_ud *ud = (l_socket_ud *)lua_newuserdata(L, sizeof(l_socket_ud));
-    ud->sock = sockfd;
-    luaL_getmetatable(L, L_HTTP_SOCKET);
-    lua_setmetatable(L, -2);
+    l_push_socket(L, sockfd);
 
     return 1;
 }
@@ -709,20 +1119,785 @@ static int l_http_client(lua_State *L) {
         return 2;
     }
 
-    l_socket_ud *ud = (l_socket_ud *)lua_newuserdata(L, sizeof(l_socket_ud));
-    ud->sock = sockfd;
-    luaL_getmetatable(L, L_HTTP_SOCKET);
-    lua_setmetatable(L, -2);
+    l_push_socket(L, sockfd);
+
+    return 1;
+}
+
+/*
+** Event Loop API
+*/
+#ifdef L_HAVE_EPOLL
+
+#define CONN_LISTEN 0  /* accepting on a listening socket */
+#define CONN_READ 1    /* waiting for a complete request */
+#define CONN_HANDLE 2  /* handler task running */
+#define CONN_WRITE 3   /* flushing the response */
+#define CONN_CLOSED 4
+
+#define CONN_MAXHEADER (64 * 1024)
+#define CONN_MAXBODY (16 * 1024 * 1024)
+#define CONN_READSIZE 16384
+
+/* user values of a connection */
+#define CONN_UV_LOOP 1
+#define CONN_UV_HANDLER 2
+#define CONN_UV_SOCKET 3  /* listening socket (CONN_LISTEN only) */
+#define CONN_NUV 3
+
+typedef struct l_buf {
+    char *p;
+    size_t n;
+    size_t size;
+} l_buf;
+
+/* An HTTP/1.1 connection served by loop:serve, parsed without a task */
+typedef struct l_conn {
+    L_SOCKET sock;
+    int armed;
+    int state;
+    int keepalive;
+    int eof;                /* peer finished sending */
+    l_socket_ud *listener;  /* CONN_LISTEN only */
+    l_buf in;
+    l_buf out;
+    size_t outpos;
+} l_conn;
+
+static l_loop *l_check_loop(lua_State *L, int index) {
+    return (l_loop *)luaL_checkudata(L, index, L_HTTP_LOOP);
+}
+
+/* Ensures room for 'sz' more bytes in 'b' */
+static char *buf_reserve(lua_State *L, l_buf *b, size_t sz) {
+    if (b->size - b->n < sz) {
+        void *ud;
+        lua_Alloc allocf = lua_getallocf(L, &ud);
+        size_t newsize = b->size * 2;
+        char *np;
+        if (newsize < b->n + sz)
+            newsize = b->n + sz;
+        np = (char *)allocf(ud, b->p, b->size, newsize);
+        if (np == NULL)
+            luaL_error(L, "Out of memory");
+        b->p = np;
+        b->size = newsize;
+    }
+    return b->p + b->n;
+}
+
+static void buf_add(lua_State *L, l_buf *b, const char *s, size_t l) {
+    memcpy(buf_reserve(L, b, l), s, l);
+    b->n += l;
+}
+
+static void buf_free(lua_State *L, l_buf *b) {
+    void *ud;
+    lua_Alloc allocf = lua_getallocf(L, &ud);
+    if (b->p != NULL)
+        allocf(ud, b->p, b->size, 0);
+    b->p = NULL;
+    b->n = b->size = 0;
+}
+
+/* Attaches the socket at 'sockidx' to the loop at 'loopidx' */
+static void l_attach(lua_State *L, int loopidx, int sockidx) {
+    l_loop *loop = l_check_loop(L, loopidx);
+    l_socket_ud *ud = l_check_socket(L, sockidx);
+    if (ud->sock == L_INVALID_SOCKET)
+        luaL_error(L, "Socket closed");
+    if (ud->loop != NULL && ud->loop != loop)
+        luaL_error(L, "socket is attached to another loop");
+    l_set_nonblocking(ud->sock);
+    ud->loop = loop;
+    lua_pushvalue(L, loopidx);
+    lua_setiuservalue(L, sockidx, 1);
+}
+
+static void conn_close(lua_State *L, l_loop *loop, l_conn *c) {
+    if (c->state == CONN_CLOSED)
+        return;
+    if (c->armed && loop->epfd >= 0)
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, c->sock, NULL);
+    l_closesocket(c->sock);
+    c->sock = L_INVALID_SOCKET;
+    c->state = CONN_CLOSED;
+    buf_free(L, &c->in);
+    buf_free(L, &c->out);
+}
+
+/* Waits for 'events' on the connection at 'ci' */
+static void conn_arm(lua_State *L, l_loop *loop, int loopidx, int ci, unsigned events) {
+    l_conn *c = (l_conn *)lua_touserdata(L, ci);
+    lua_pushvalue(L, ci);
+    if (!loop_watch(L, loop, loopidx, c->sock, &c->armed, events))
+        conn_close(L, loop, c);
+}
+
+/* Pushes a connection sharing the loop and handler of the one at 'ci' */
+static l_conn *conn_new(lua_State *L, int ci) {
+    l_conn *c = (l_conn *)lua_newuserdatauv(L, sizeof(l_conn), CONN_NUV);
+    memset(c, 0, sizeof(l_conn));
+    c->sock = L_INVALID_SOCKET;
+    c->state = CONN_CLOSED;
+    luaL_setmetatable(L, L_HTTP_CONN);
+    lua_getiuservalue(L, ci, CONN_UV_LOOP);
+    lua_setiuservalue(L, -2, CONN_UV_LOOP);
+    lua_getiuservalue(L, ci, CONN_UV_HANDLER);
+    lua_setiuservalue(L, -2, CONN_UV_HANDLER);
+    return c;
+}
+
+static const char *http_reason(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+static void conn_process(lua_State *L, l_loop *loop, int loopidx, int ci);
+
+/* Writes out the pending response, then waits for the next request */
+static void conn_flush(lua_State *L, l_loop *loop, int loopidx, int ci) {
+    l_conn *c = (l_conn *)lua_touserdata(L, ci);
+    while (c->outpos < c->out.n) {
+        ssize_t n = send(c->sock, c->out.p + c->outpos, c->out.n - c->outpos, MSG_NOSIGNAL);
+        if (n > 0)
+            c->outpos += (size_t)n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else if (n < 0 && would_block(errno)) {
+            c->state = CONN_WRITE;
+            conn_arm(L, loop, loopidx, ci, EPOLLOUT);
+            return;
+        }
+        else {
+            conn_close(L, loop, c);
+            return;
+        }
+    }
+    c->out.n = c->outpos = 0;
+    if (!c->keepalive) {
+        conn_close(L, loop, c);
+        return;
+    }
+    c->state = CONN_READ;
+    if (c->in.n > 0) {  /* pipelined request: parse it on the next pass */
+        lua_pushvalue(L, ci);
+        ready_push(L, loop, loopidx);
+    }
+    else
+        conn_arm(L, loop, loopidx, ci, EPOLLIN);
+}
+
+/*
+** Queues a response. 'bodyidx' and 'hdridx' are stack indices of the body
+** and of a header table, or 0.
+*/
+static void conn_respond(lua_State *L, l_loop *loop, int loopidx, int ci,
+                         int code, int bodyidx, int hdridx) {
+    l_conn *c = (l_conn *)lua_touserdata(L, ci);
+    const char *body = "";
+    size_t blen = 0;
+    char line[128];
+    int n;
+    if (bodyidx != 0 && !lua_isnil(L, bodyidx))
+        body = luaL_tolstring(L, bodyidx, &blen);  /* anchored on the stack */
+    c->out.n = c->outpos = 0;
+    n = snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", code, http_reason(code));
+    buf_add(L, &c->out, line, (size_t)n);
+    if (hdridx != 0) {
+        lua_pushnil(L);
+        while (lua_next(L, hdridx) != 0) {
+            size_t kl, vl;
+            const char *k, *v;
+            if (lua_type(L, -2) == LUA_TSTRING && lua_isstring(L, -1)) {
+                k = lua_tolstring(L, -2, &kl);
+                v = lua_tolstring(L, -1, &vl);
+                if (strcasecmp(k, "content-length") != 0 && strcasecmp(k, "connection") != 0) {
+                    buf_add(L, &c->out, k, kl);
+                    buf_add(L, &c->out, ": ", 2);
+                    buf_add(L, &c->out, v, vl);
+                    buf_add(L, &c->out, "\r\n", 2);
+                }
+            }
+            lua_pop(L, 1);
+        }
+    }
+    n = snprintf(line, sizeof(line), "Content-Length: %lu\r\nConnection: %s\r\n\r\n",
+                 (unsigned long)blen, c->keepalive ? "keep-alive" : "close");
+    buf_add(L, &c->out, line, (size_t)n);
+    buf_add(L, &c->out, body, blen);
+    conn_flush(L, loop, loopidx, ci);
+}
+
+/* Answers with an error status and closes the connection afterwards */
+static void conn_reject(lua_State *L, l_loop *loop, int loopidx, int ci, int code) {
+    l_conn *c = (l_conn *)lua_touserdata(L, ci);
+    c->keepalive = 0;
+    c->in.n = 0;
+    conn_respond(L, loop, loopidx, ci, code, 0, 0);
+}
+
+/* Turns the handler's results (status, body, headers) into a response */
+static void conn_finish(lua_State *L, l_loop *loop, int loopidx,
+                        lua_State *co, int status, int nres) {
+    int ci = lua_gettop(L);
+    l_conn *c = (l_conn *)lua_touserdata(L, ci);
+    int isnum = 1;
+    lua_Integer code = 200;
+    if (c->state != CONN_HANDLE)
+        return;
+    if (status != LUA_OK) {
+        conn_reject(L, loop, loopidx, ci, 500);
+        return;
+    }
+    luaL_checkstack(L, nres + LUA_MINSTACK, "too many results");
+    lua_xmove(co, L, nres);
+    if (nres >= 1 && !lua_isnil(L, ci + 1))
+        code = lua_tointegerx(L, ci + 1, &isnum);
+    if (!isnum || code < 100 || code > 999)
+        conn_reject(L, loop, loopidx, ci, 500);
+    else
+        conn_respond(L, loop, loopidx, ci, (int)code,
+                     nres >= 2 ? ci + 2 : 0,
+                     (nres >= 3 && lua_istable(L, ci + 3)) ? ci + 3 : 0);
+    lua_settop(L, ci);
+}
 
+static const char *find_crlf(const char *p, const char *end) {
+    while (p + 1 < end) {
+        const char *r = (const char *)memchr(p, '\r', (size_t)(end - p - 1));
+        if (r == NULL)
+            return NULL;
+        if (r[1] == '\n')
+            return r;
+        p = r + 1;
+    }
+    return NULL;
+}
+
+static int has_token(const char *v, size_t vl, const char *token) {
+    size_t tl = strlen(token), i;
+    for (i = 0; i + tl <= vl; i++) {
+        if (strncasecmp(v + i, token, tl) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+** Parses the request line and headers in [p, p + hlen) into the request
+** table on top of the stack. Returns 0 or an HTTP error status.
+*/
+static int parse_request(lua_State *L, l_conn *c, const char *p, size_t hlen, size_t *clen) {
+    const char *end = p + hlen - 2;  /* keep the last header line's CRLF */
+    const char *eol = find_crlf(p, end);
+    const char *sp1, *sp2, *q, *line;
+    int haveclen = 0;
+    sp1 = (const char *)memchr(p, ' ', (size_t)(eol - p));
+    if (sp1 == NULL)
+        return 400;
+    sp2 = (const char *)memchr(sp1 + 1, ' ', (size_t)(eol - sp1 - 1));
+    if (sp2 == NULL || eol - sp2 != 9 || memcmp(sp2 + 1, "HTTP/1.", 7) != 0)
+        return 400;
+    lua_pushlstring(L, p, (size_t)(sp1 - p));
+    lua_setfield(L, -2, "method");
+    q = (const char *)memchr(sp1 + 1, '?', (size_t)(sp2 - sp1 - 1));
+    lua_pushlstring(L, sp1 + 1, (size_t)((q ? q : sp2) - sp1 - 1));
+    lua_setfield(L, -2, "path");
+    if (q) {
+        lua_pushlstring(L, q + 1, (size_t)(sp2 - q - 1));
+        lua_setfield(L, -2, "query");
+    }
+    lua_pushlstring(L, sp2 + 6, 3);
+    lua_setfield(L, -2, "version");
+    c->keepalive = (sp2[8] == '1');
+    *clen = 0;
+    lua_newtable(L);
+    for (line = eol + 2; line < end; line = eol + 2) {
+        char name[128];
+        const char *colon, *v, *ve;
+        size_t nl, i;
+        eol = find_crlf(line, end);
+        colon = (const char *)memchr(line, ':', (size_t)(eol - line));
+        if (colon == NULL || colon == line || (nl = (size_t)(colon - line)) >= sizeof(name))
+            return 400;
+        for (i = 0; i < nl; i++) {
+            char ch = line[i];
+            name[i] = (ch >= 'A' && ch <= 'Z') ? (char)(ch + ('a' - 'A')) : ch;
+        }
+        name[nl] = '\0';
+        for (v = colon + 1; v < eol && (*v == ' ' || *v == '\t'); v++) ;
+        for (ve = eol; ve > v && (ve[-1] == ' ' || ve[-1] == '\t'); ve--) ;
+        if (strcmp(name, "content-length") == 0) {
+            const char *d;
+            size_t n = 0;
+            if (v == ve)
+                return 400;
+            for (d = v; d < ve; d++) {
+                if (*d < '0' || *d > '9' || n > CONN_MAXBODY)
+                    return 400;
+                n = n * 10 + (size_t)(*d - '0');
+            }
+            if (haveclen && n != *clen)
+                return 400;  /* conflicting lengths: ambiguous framing */
+            *clen = n;
+            haveclen = 1;
+        }
+        else if (strcmp(name, "transfer-encoding") == 0)
+            return 501;  /* chunked bodies are not supported */
+        else if (strcmp(name, "connection") == 0) {
+            if (has_token(v, (size_t)(ve - v), "close"))
+                c->keepalive = 0;
+            else if (has_token(v, (size_t)(ve - v), "keep-alive"))
+                c->keepalive = 1;
+        }
+        if (lua_getfield(L, -1, name) != LUA_TNIL) {  /* repeated: join */
+            lua_pushliteral(L, ", ");
+            lua_pushlstring(L, v, (size_t)(ve - v));
+            lua_concat(L, 3);
+        }
+        else {
+            lua_pop(L, 1);
+            lua_pushlstring(L, v, (size_t)(ve - v));
+        }
+        lua_setfield(L, -2, name);
+    }
+    lua_setfield(L, -2, "headers");
+    return 0;
+}
+
+/* Reads what the socket has; returns 0 if the connection was closed */
+static int conn_fill(lua_State *L, l_loop *loop, l_conn *c) {
+    for (;;) {
+        size_t avail;
+        ssize_t n;
+        buf_reserve(L, &c->in, CONN_READSIZE);
+        avail = c->in.size - c->in.n;
+        n = recv(c->sock, c->in.p + c->in.n, avail, 0);
+        if (n > 0) {
+            c->in.n += (size_t)n;
+            if ((size_t)n < avail || c->in.n > CONN_MAXHEADER + CONN_MAXBODY)
+                return 1;
+        }
+        else if (n == 0) {
+            c->eof = 1;
+            c->keepalive = 0;
+            return 1;
+        }
+        else if (errno == EINTR)
+            continue;
+        else if (would_block(errno))
+            return 1;
+        else {
+            conn_close(L, loop, c);
+            return 0;
+        }
+    }
+}
+
+/* Runs the handler for the next complete request, or waits for more input */
+static void conn_process(lua_State *L, l_loop *loop, int loopidx, int ci) {
+    l_conn *c = (l_conn *)lua_touserdata(L, ci);
+    const char *p = c->in.p;
+    const char *hend = NULL;
+    size_t hlen, clen, total;
+    int err;
+    lua_State *co;
+    if (c->in.n >= 4) {
+        const char *e = p + c->in.n, *r;
+        for (r = find_crlf(p, e); r != NULL; r = find_crlf(r + 2, e)) {
+            if (e - r >= 4 && r[2] == '\r' && r[3] == '\n') {
+                hend = r;
+                break;
+            }
+        }
+    }
+    if (hend == NULL) {
+        if (c->in.n > CONN_MAXHEADER)
+            conn_reject(L, loop, loopidx, ci, 431);
+        else if (c->eof)
+            conn_close(L, loop, c);
+        else
+            conn_arm(L, loop, loopidx, ci, EPOLLIN);
+        return;
+    }
+    hlen = (size_t)(hend - p) + 4;
+    lua_createtable(L, 0, 6);
+    err = parse_request(L, c, p, hlen, &clen);
+    if (err == 0 && clen > CONN_MAXBODY)
+        err = 413;
+    if (err != 0) {
+        lua_settop(L, ci);
+        conn_reject(L, loop, loopidx, ci, err);
+        return;
+    }
+    if (c->in.n - hlen < clen) {  /* body still arriving */
+        lua_settop(L, ci);
+        if (c->eof)
+            conn_close(L, loop, c);
+        else
+            conn_arm(L, loop, loopidx, ci, EPOLLIN);
+        return;
+    }
+    if (c->eof)
+        c->keepalive = 0;
+    lua_pushlstring(L, p + hlen, clen);
+    lua_setfield(L, -2, "body");
+    total = hlen + clen;
+    memmove(c->in.p, c->in.p + total, c->in.n - total);
+    c->in.n -= total;
+    /* run the handler in a fresh task owned by this connection */
+    c->state = CONN_HANDLE;
+    lua_getiuservalue(L, ci, CONN_UV_HANDLER);
+    lua_insert(L, -2);
+    co = lua_newthread(L);
+    lua_insert(L, -3);
+    lua_xmove(L, co, 2);
+    lua_getiuservalue(L, loopidx, LOOP_OWNERS);
+    lua_pushvalue(L, -2);
+    lua_pushvalue(L, ci);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+    loop_step(L, loop, loopidx);
+}
+
+/* Accepts every pending connection on a listener */
+static void conn_accept(lua_State *L, l_loop *loop, int loopidx, int ci) {
+    l_conn *lc = (l_conn *)lua_touserdata(L, ci);
+    l_socket_ud *ls = lc->listener;
+    if (ls->sock == L_INVALID_SOCKET)  /* listener was closed */
+        return;
+    for (;;) {
+        l_conn *c;
+        int one = 1;
+        L_SOCKET fd = accept(ls->sock, NULL, NULL);
+        if (fd == L_INVALID_SOCKET) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;  /* drained (or out of descriptors): retry on the next event */
+        }
+        l_set_nonblocking(fd);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        c = conn_new(L, ci);
+        c->sock = fd;
+        c->state = CONN_READ;
+        c->keepalive = 1;
+        conn_arm(L, loop, loopidx, lua_gettop(L), EPOLLIN);
+        lua_pop(L, 1);
+    }
+    lua_pushvalue(L, ci);
+    loop_watch(L, loop, loopidx, ls->sock, &ls->armed, EPOLLIN);
+}
+
+/* Handles readiness of the connection on top of the stack (pops it) */
+static void conn_event(lua_State *L, l_loop *loop, int loopidx, unsigned events) {
+    int ci = lua_gettop(L);
+    l_conn *c = (l_conn *)lua_touserdata(L, ci);
+    switch (c->state) {
+        case CONN_LISTEN:
+            conn_accept(L, loop, loopidx, ci);
+            break;
+        case CONN_READ:
+            if (events != 0 && !conn_fill(L, loop, c))
+                break;
+            conn_process(L, loop, loopidx, ci);
+            break;
+        case CONN_WRITE:
+            conn_flush(L, loop, loopidx, ci);
+            break;
+        default:  /* closed, or queued while its handler runs */
+            break;
+    }
+    lua_settop(L, ci - 1);
+}
+
+static int l_conn_gc(lua_State *L) {
+    l_conn *c = (l_conn *)luaL_checkudata(L, 1, L_HTTP_CONN);
+    if (c->state != CONN_LISTEN && c->state != CONN_CLOSED)
+        l_closesocket(c->sock);  /* closing also drops it from epoll */
+    c->state = CONN_CLOSED;
+    buf_free(L, &c->in);
+    buf_free(L, &c->out);
+    return 0;
+}
+
+/* Constructor: http.loop() */
+static int l_http_loop(lua_State *L) {
+    int i;
+    l_loop *loop = (l_loop *)lua_newuserdatauv(L, sizeof(l_loop), LOOP_NUV);
+    memset(loop, 0, sizeof(l_loop));
+    loop->epfd = -1;
+    loop->rhead = loop->rtail = 1;
+    luaL_setmetatable(L, L_HTTP_LOOP);
+    for (i = 1; i < LOOP_ONERROR; i++) {
+        lua_newtable(L);
+        lua_setiuservalue(L, -2, i);
+    }
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        lua_pushnil(L);
+        lua_pushstring(L, "epoll_create failed");
+        return 2;
+    }
+    return 1;
+}
+
+static int l_loop_gc(lua_State *L) {
+    l_loop *loop = l_check_loop(L, 1);
+    if (loop->epfd >= 0) {
+        close(loop->epfd);
+        loop->epfd = -1;
+    }
+    if (loop->timers != NULL) {
+        void *ud;
+        lua_Alloc allocf = lua_getallocf(L, &ud);
+        allocf(ud, loop->timers, loop->sztimers * sizeof(l_timer), 0);
+        loop->timers = NULL;
+        loop->ntimers = loop->sztimers = 0;
+    }
+    return 0;
+}
+
+/* loop:spawn(f, ...): runs f(...) as a task; returns its coroutine */
+static int l_loop_spawn(lua_State *L) {
+    l_loop *loop = l_check_loop(L, 1);
+    int n = lua_gettop(L);
+    lua_State *co;
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    co = lua_newthread(L);
+    lua_insert(L, 2);
+    lua_xmove(L, co, n - 1);
+    lua_pushvalue(L, 2);
+    ready_push(L, loop, 1);
     return 1;
 }
 
+/* loop:sleep(seconds): suspends the calling task */
+static int l_loop_sleep(lua_State *L) {
+    l_loop *loop = l_check_loop(L, 1);
+    lua_Number sec = luaL_checknumber(L, 2);
+    if (!lua_isyieldable(L))
+        return luaL_error(L, "loop:sleep must be called from a loop task");
+    lua_settop(L, 1);
+    lua_pushthread(L);
+    timer_add(L, loop, 1, (double)sec);
+    loop->parked = 1;
+    return lua_yield(L, 0);
+}
+
+/* loop:after(seconds, f): runs f as a new task once the delay expires */
+static int l_loop_after(lua_State *L) {
+    l_loop *loop = l_check_loop(L, 1);
+    lua_Number sec = luaL_checknumber(L, 2);
+    luaL_checktype(L, 3, LUA_TFUNCTION);
+    lua_settop(L, 3);
+    timer_add(L, loop, 1, (double)sec);
+    return 0;
+}
+
+static int l_loop_stop(lua_State *L) {
+    l_check_loop(L, 1)->stopped = 1;
+    return 0;
+}
+
+/* loop:onerror(f): f(err, co) receives task errors instead of loop:run */
+static int l_loop_onerror(lua_State *L) {
+    l_check_loop(L, 1);
+    if (!lua_isnoneornil(L, 2))
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+    lua_settop(L, 2);
+    lua_setiuservalue(L, 1, LOOP_ONERROR);
+    return 0;
+}
+
+/* loop:wrap(sock): makes an existing socket non-blocking on this loop */
+static int l_loop_wrap(lua_State *L) {
+    l_attach(L, 1, 2);
+    lua_settop(L, 2);
+    return 1;
+}
+
+/* loop:listen(port [, backlog]) */
+static int l_loop_listen(lua_State *L) {
+    int port = (int)luaL_checkinteger(L, 2);
+    int backlog = (int)luaL_optinteger(L, 3, SOMAXCONN);
+    l_check_loop(L, 1);
+    L_SOCKET sockfd = l_listen_socket(L, port, backlog);
+    if (sockfd == L_INVALID_SOCKET) {
+        return 2;
+    }
+    l_push_socket(L, sockfd);
+    l_attach(L, 1, lua_gettop(L));
+    return 1;
+}
+
+/* loop:connect(host, port): returns a connected socket on this loop */
+static int l_loop_connect(lua_State *L) {
+    l_check_loop(L, 1);
+    luaL_checkstring(L, 2);
+    luaL_checkinteger(L, 3);
+    lua_settop(L, 3);
+    L_SOCKET sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd == L_INVALID_SOCKET) {
+        lua_pushnil(L);
+        lua_pushstring(L, "Socket creation failed");
+        return 2;
+    }
+    l_push_socket(L, sockfd);
+    l_attach(L, 1, 4);
+    lua_replace(L, 1);  /* (sock, host, port), as for sock:connect */
+    return l_socket_connect_ctx(L, 1);
+}
+
+/*
+** loop:serve(sock, handler): serves HTTP/1.1 on a listening socket of this
+** loop. Each request runs handler(req) in its own task; the handler
+** returns status, body and an optional header table. Connections are
+** kept alive unless the client asks otherwise.
+*/
+static int l_loop_serve(lua_State *L) {
+    l_loop *loop = l_check_loop(L, 1);
+    l_socket_ud *ls = l_check_socket(L, 2);
+    l_conn *lc;
+    luaL_checktype(L, 3, LUA_TFUNCTION);
+    lua_settop(L, 3);
+    if (ls->sock == L_INVALID_SOCKET)
+        return luaL_error(L, "Socket closed");
+    if (ls->loop != loop)
+        return luaL_error(L, "socket is not attached to this loop");
+    lua_getiuservalue(L, 1, LOOP_WAITERS);
+    if (lua_rawgeti(L, -1, ls->sock) != LUA_TNIL)
+        return luaL_error(L, "socket is already awaited by another task");
+    lua_pop(L, 2);
+    lc = (l_conn *)lua_newuserdatauv(L, sizeof(l_conn), CONN_NUV);
+    memset(lc, 0, sizeof(l_conn));
+    lc->sock = ls->sock;
+    lc->state = CONN_LISTEN;
+    lc->listener = ls;
+    luaL_setmetatable(L, L_HTTP_CONN);
+    lua_pushvalue(L, 1);
+    lua_setiuservalue(L, 4, CONN_UV_LOOP);
+    lua_pushvalue(L, 3);
+    lua_setiuservalue(L, 4, CONN_UV_HANDLER);
+    lua_pushvalue(L, 2);
+    lua_setiuservalue(L, 4, CONN_UV_SOCKET);
+    if (!loop_watch(L, loop, 1, ls->sock, &ls->armed, EPOLLIN))
+        return luaL_error(L, "epoll_ctl failed: %s", strerror(errno));
+    return 0;
+}
+
+/* Wakes whatever waits on 'fd' */
+static void loop_dispatch(lua_State *L, l_loop *loop, int loopidx, int fd, unsigned events) {
+    lua_getiuservalue(L, loopidx, LOOP_WAITERS);
+    if (lua_rawgeti(L, -1, fd) == LUA_TNIL) {  /* stale event */
+        lua_pop(L, 2);
+        return;
+    }
+    lua_pushnil(L);
+    lua_rawseti(L, -3, fd);
+    lua_remove(L, -2);
+    loop->nwait--;
+    loop_wake(L, loop, loopidx, events);
+}
+
+/*
+** loop:run(): runs tasks until none is runnable, parked or scheduled, or
+** until loop:stop() is called.
+*/
+static int l_loop_run(lua_State *L) {
+    l_loop *loop = l_check_loop(L, 1);
+    struct epoll_event events[LOOP_MAXEVENTS];
+    lua_settop(L, 1);
+    if (loop->running)
+        return luaL_error(L, "loop is already running");
+    if (loop->epfd < 0)
+        return luaL_error(L, "loop is closed");
+    loop->running = 1;
+    loop->stopped = 0;
+    while (!loop->stopped) {
+        lua_Integer last = loop->rtail;  /* work queued now waits a pass */
+        int timeout = -1, nev, i;
+        while (loop->rhead < last && !loop->stopped) {
+            lua_getiuservalue(L, 1, LOOP_READY);
+            lua_rawgeti(L, -1, loop->rhead);
+            lua_pushnil(L);
+            lua_rawseti(L, -3, loop->rhead++);
+            lua_remove(L, -2);
+            loop_wake(L, loop, 1, 0);
+        }
+        if (loop->stopped)
+            break;
+        if (loop->rhead < loop->rtail)
+            timeout = 0;
+        else if (loop->ntimers > 0) {
+            double d = loop->timers[0].when - loop_now();
+            timeout = d <= 0 ? 0 : d > 86400 ? 86400000 : (int)(d * 1000) + 1;
+        }
+        else if (loop->nwait == 0)
+            break;  /* nothing left to wait for */
+        nev = epoll_wait(loop->epfd, events, LOOP_MAXEVENTS, timeout);
+        if (nev < 0 && errno != EINTR) {
+            loop->running = 0;
+            return luaL_error(L, "epoll_wait failed: %s", strerror(errno));
+        }
+        for (i = 0; i < nev && !loop->stopped; i++)
+            loop_dispatch(L, loop, 1, events[i].data.fd, events[i].events);
+        loop_timers(L, loop, 1);
+    }
+    loop->running = 0;
+    return 0;
+}
+
+static const luaL_Reg loop_methods[] = {
+    {"spawn", l_loop_spawn},
+    {"sleep", l_loop_sleep},
+    {"after", l_loop_after},
+    {"run", l_loop_run},
+    {"stop", l_loop_stop},
+    {"onerror", l_loop_onerror},
+    {"wrap", l_loop_wrap},
+    {"listen", l_loop_listen},
+    {"connect", l_loop_connect},
+    {"serve", l_loop_serve},
+    {"__gc", l_loop_gc},
+    {NULL, NULL}
+};
+
+#else
+
+/* Placeholder for platforms without epoll */
+static int l_http_loop(lua_State *L) {
+    lua_pushnil(L);
+    lua_pushstring(L, "Platform not supported");
+    return 2;
+}
+
+#endif
+
 static const luaL_Reg httplib[] = {
     {"get", l_http_get},
     {"post", l_http_post},
     {"server", l_http_server},
     {"client", l_http_client},
     {"socket", l_http_socket_new},
+    {"loop", l_http_loop},
     {NULL, NULL}
 };
 
@@ -750,6 +1925,19 @@ LUAMOD_API int luaopen_http(lua_State *L) {
     luaL_setfuncs(L, socket_methods, 0);
     lua_pop(L, 1);
 
+#ifdef L_HAVE_EPOLL
+    luaL_newmetatable(L, L_HTTP_LOOP);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    luaL_setfuncs(L, loop_methods, 0);
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, L_HTTP_CONN);
+    lua_pushcfunction(L, l_conn_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+#endif
+
     luaL_newlib(L, httplib);
     return 1;
 }
@@ -108,6 +108,7 @@ static const luaL_Reg stdlibs[] = {
   {"ByteCode", luaopen_ByteCode},
   {"wasm3", luaopen_wasm3},
   {LUA_LEXERLIBNAME, luaopen_lexer},
+  {LUA_JSONLIBNAME, luaopen_json},
 
 #ifndef _WIN32
   {LUA_SMGRNAME, luaopen_smgr},
@@ -179,6 +180,7 @@ static const luaL_Reg loadedlibs[] = {
   {"ByteCode", luaopen_ByteCode},
   {"wasm3", luaopen_wasm3},
   {LUA_LEXERLIBNAME, luaopen_lexer},
+  {LUA_JSONLIBNAME, luaopen_json},
 
 #ifndef _WIN32
   {LUA_SMGRNAME, luaopen_smgr},
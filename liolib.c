@@ -12,10 +12,12 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #ifndef _WIN32
 #include <sys/mman.h>
 #endif
@@ -751,6 +753,288 @@ static int f_flush (lua_State *L) {
 }
 
 
+/*
+** {======================================================
+** Line index shared by 'readline', 'readlines' and 'linecount'
+** =======================================================
+*/
+
+/* key, in the registry, for the table of cached line indices */
+#define IO_LINEIDX	"_IO_lineidx"
+
+#define LINEIDX_META	"io.lineindex"
+
+/* maximum number of files whose line index is kept */
+#if !defined(LUAI_MAXLINEIDX)
+#define LUAI_MAXLINEIDX		8
+#endif
+
+/* nanosecond part of a modification time, where the platform has one */
+#if !defined(l_mtimens)
+#if defined(__APPLE__)
+#define l_mtimens(st)	((st)->st_mtimespec.tv_nsec)
+#elif defined(__linux__)
+#define l_mtimens(st)	((st)->st_mtim.tv_nsec)
+#else
+#define l_mtimens(st)	0
+#endif
+#endif
+
+
+/*
+** Contents of a file (mapped when possible) plus the offset where each
+** of its lines starts. Line 'i' (0-based) spans from 'lines[i]' up to
+** the next newline, or up to the end of the file for the last line, so
+** 'nlines' is the number of newlines plus one. The index is reused while
+** the file keeps the device, inode, size and modification time recorded
+** in 'st'; 'stable' is false for files whose size says nothing about
+** their contents (pipes, /proc entries), which are rescanned every time.
+*/
+typedef struct LineIndex {
+  char *data;
+  size_t size;
+  size_t *lines;
+  size_t nlines;
+  int mapped;  /* true if 'data' comes from 'mmap' */
+  int stable;
+  struct stat st;
+} LineIndex;
+
+
+static void lidx_release (LineIndex *li) {
+#ifndef _WIN32
+  if (li->mapped)
+    munmap(li->data, li->size);
+  else
+#endif
+    free(li->data);
+  free(li->lines);
+  li->data = NULL;
+  li->lines = NULL;
+  li->size = li->nlines = 0;
+  li->mapped = 0;
+}
+
+
+static int lidx_gc (lua_State *L) {
+  lidx_release((LineIndex *)luaL_checkudata(L, 1, LINEIDX_META));
+  return 0;
+}
+
+
+static int lidx_fresh (const LineIndex *li, const struct stat *st) {
+  return (li->stable && li->st.st_dev == st->st_dev &&
+          li->st.st_ino == st->st_ino && li->st.st_size == st->st_size &&
+          li->st.st_mtime == st->st_mtime &&
+          l_mtimens(&li->st) == l_mtimens(st));
+}
+
+
+/*
+** Read the whole of 'f' into a malloc'ed buffer, for files that cannot
+** be mapped.
+*/
+static int lidx_readall (LineIndex *li, FILE *f) {
+  size_t cap = LUAL_BUFFERSIZE, n = 0;
+  char *buff = NULL;
+  for (;;) {
+    char *nb = (cap <= (~(size_t)0) / 2) ? (char *)realloc(buff, cap) : NULL;
+    if (nb == NULL) {
+      free(buff);
+      errno = ENOMEM;
+      return 0;
+    }
+    buff = nb;
+    n += fread(buff + n, 1, cap - n, f);
+    if (n < cap) break;
+    cap *= 2;
+  }
+  if (ferror(f)) {
+    free(buff);
+    return 0;
+  }
+  li->data = buff;
+  li->size = n;
+  return 1;
+}
+
+
+/*
+** Build the offset vector with 'memchr', which the C library
+** vectorizes, instead of testing the contents byte by byte.
+*/
+static int lidx_scan (LineIndex *li) {
+  const char *s = li->data;
+  const char *e = s + li->size;
+  size_t cap = li->size / 64 + 16;  /* guess; grows as needed */
+  size_t n = 1;
+  size_t *lines = (size_t *)malloc(cap * sizeof(size_t));
+  if (lines == NULL) {
+    errno = ENOMEM;
+    return 0;
+  }
+  lines[0] = 0;
+  while (s < e && (s = (const char *)memchr(s, '\n', e - s)) != NULL) {
+    if (n == cap) {
+      size_t *nl = (size_t *)realloc(lines, (cap *= 2) * sizeof(size_t));
+      if (nl == NULL) {
+        free(lines);
+        errno = ENOMEM;
+        return 0;
+      }
+      lines = nl;
+    }
+    lines[n++] = (size_t)(++s - li->data);
+  }
+  li->lines = lines;
+  li->nlines = n;
+  return 1;
+}
+
+
+static int lidx_load (LineIndex *li, const char *filename) {
+  int en;
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) return 0;
+  if (fstat(fileno(f), &li->st) != 0)
+    goto fail;
+  li->stable = (S_ISREG(li->st.st_mode) && li->st.st_size > 0);
+#ifndef _WIN32
+  if (li->stable && (unsigned long long)li->st.st_size <= (~(size_t)0)) {
+    void *p = mmap(NULL, (size_t)li->st.st_size, PROT_READ, MAP_PRIVATE,
+                   fileno(f), 0);
+    if (p != MAP_FAILED) {
+      li->data = (char *)p;
+      li->size = (size_t)li->st.st_size;
+      li->mapped = 1;
+    }
+  }
+#endif
+  if (!li->mapped && !lidx_readall(li, f))
+    goto fail;
+  fclose(f);
+  if (!lidx_scan(li)) {
+    en = errno;
+    lidx_release(li);
+    errno = en;
+    return 0;
+  }
+  return 1;
+ fail:
+  en = errno;
+  fclose(f);
+  errno = en;
+  return 0;
+}
+
+
+static int lidx_cache (lua_State *L) {
+  if (lua_getfield(L, LUA_REGISTRYINDEX, IO_LINEIDX) == LUA_TTABLE)
+    return 1;
+  lua_pop(L, 1);
+  return 0;
+}
+
+
+/*
+** Push the line index of 'filename', reusing the cached one while the
+** file is unchanged. Returns NULL, with 'errno' set and nothing pushed,
+** if the file cannot be read.
+*/
+static LineIndex *getlineindex (lua_State *L, const char *filename) {
+  struct stat st;
+  LineIndex *li;
+  if (stat(filename, &st) != 0)
+    return NULL;
+  if (!lidx_cache(L)) {
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, IO_LINEIDX);
+  }
+  if (lua_getfield(L, -1, filename) == LUA_TUSERDATA) {
+    li = (LineIndex *)lua_touserdata(L, -1);
+    if (lidx_fresh(li, &st)) {
+      lua_remove(L, -2);  /* remove cache table */
+      return li;
+    }
+    lidx_release(li);  /* stale; rebuild it in place */
+  }
+  else {
+    int n = 0;
+    lua_pop(L, 1);
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+      lua_pop(L, 1);
+      n++;
+    }
+    if (n >= LUAI_MAXLINEIDX) {  /* cache is full? drop some entry */
+      lua_pushnil(L);
+      lua_next(L, -2);
+      lidx_release((LineIndex *)lua_touserdata(L, -1));
+      lua_pop(L, 1);
+      lua_pushnil(L);
+      lua_settable(L, -3);
+    }
+    li = (LineIndex *)lua_newuserdatauv(L, sizeof(LineIndex), 0);
+    memset(li, 0, sizeof(LineIndex));
+    luaL_setmetatable(L, LINEIDX_META);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -3, filename);
+  }
+  if (!lidx_load(li, filename)) {
+    int en = errno;
+    lua_pop(L, 1);
+    lua_pushnil(L);
+    lua_setfield(L, -2, filename);
+    lua_pop(L, 1);
+    errno = en;
+    return NULL;
+  }
+  lua_remove(L, -2);  /* remove cache table */
+  return li;
+}
+
+
+/* forget the line index of a file that is about to be rewritten */
+static void droplineindex (lua_State *L, const char *filename) {
+  if (!lidx_cache(L)) return;
+  if (lua_getfield(L, -1, filename) == LUA_TUSERDATA) {
+    lidx_release((LineIndex *)lua_touserdata(L, -1));
+    lua_pushnil(L);
+    lua_setfield(L, -3, filename);
+  }
+  lua_pop(L, 2);
+}
+
+
+/* push line 'k' (0-based) as a string or, in binary mode, a byte table */
+static void pushline (lua_State *L, const LineIndex *li, size_t k,
+                      int binary) {
+  size_t start = li->lines[k];
+  size_t l = (k + 1 < li->nlines) ? li->lines[k + 1] - 1 - start
+                                  : li->size - start;
+  const char *s = (l > 0) ? li->data + start : "";
+  if (binary) {
+    size_t i;
+    lua_createtable(L, (l <= INT_MAX) ? (int)l : 0, 0);
+    for (i = 0; i < l; i++) {
+      lua_pushinteger(L, (unsigned char)s[i]);
+      lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+  }
+  else {
+#if defined(_WIN32)
+    /* text mode used to translate "\r\n" */
+    if (l > 0 && s[l - 1] == '\r' && k + 1 < li->nlines) l--;
+#endif
+    lua_pushlstring(L, s, l);
+  }
+}
+
+/* }====================================================== */
+
+
+
 /**
  * 按行号读取文件的特定行
  * 功能描述：读取文件中指定行号的内容，支持文本和二进制模式
@@ -762,10 +1046,7 @@ static int io_readline_n (lua_State *L) {
   lua_Integer line_num = luaL_checkinteger(L, 2);
   const char *mode = luaL_optstring(L, 3, "t");
   int binary_mode = (mode[0] == 'b' || mode[0] == 'B');
-  FILE *f;
-  int current_line = 1;
-  luaL_Buffer b;
-  int c;
+  LineIndex *li;
   
   if (line_num < 1) {
     luaL_pushfail(L);
@@ -774,41 +1055,18 @@ static int io_readline_n (lua_State *L) {
   }
   
   errno = 0;
-  f = fopen(filename, binary_mode ? "rb" : "r");
-  if (f == NULL) {
+  li = getlineindex(L, filename);
+  if (li == NULL) {
     return luaL_fileresult(L, 0, filename);
   }
   
-  /* 跳过前面的行 */
-  while (current_line < line_num) {
-    c = fgetc(f);
-    if (c == EOF) {
-      fclose(f);
-      luaL_pushfail(L);
-      lua_pushfstring(L, "文件只有 %d 行", current_line - 1);
-      return 2;
-    }
-    if (c == '\n') current_line++;
-  }
-  
-  if (binary_mode) {
-    /* 二进制模式：返回字节table */
-    lua_newtable(L);
-    int idx = 1;
-    while ((c = fgetc(f)) != EOF && c != '\n') {
-      lua_pushinteger(L, (unsigned char)c);
-      lua_rawseti(L, -2, idx++);
-    }
-  } else {
-    /* 文本模式：返回字符串 */
-    luaL_buffinit(L, &b);
-    while ((c = fgetc(f)) != EOF && c != '\n') {
-      luaL_addchar(&b, c);
-    }
-    luaL_pushresult(&b);
+  if ((lua_Unsigned)line_num > li->nlines) {
+    luaL_pushfail(L);
+    lua_pushfstring(L, "文件只有 %I 行", (lua_Integer)(li->nlines - 1));
+    return 2;
   }
   
-  fclose(f);
+  pushline(L, li, (size_t)line_num - 1, binary_mode);
   return 1;
 }
 
@@ -851,6 +1109,7 @@ static int io_writeline_n (lua_State *L) {
   strcpy(temp_filename, filename);
   strcat(temp_filename, ".tmp");
   
+  droplineindex(L, filename);
   errno = 0;
   f_in = fopen(filename, binary_mode ? "rb" : "r");
   if (f_in == NULL) {
@@ -1013,27 +1272,20 @@ static int f_readline_n (lua_State *L) {
  */
 static int io_linecount (lua_State *L) {
   const char *filename = luaL_checkstring(L, 1);
-  FILE *f;
-  int count = 0;
-  int c;
-  int has_content = 0;
+  LineIndex *li;
+  size_t count;
   
   errno = 0;
-  f = fopen(filename, "r");
-  if (f == NULL) {
+  li = getlineindex(L, filename);
+  if (li == NULL) {
     return luaL_fileresult(L, 0, filename);
   }
   
-  while ((c = fgetc(f)) != EOF) {
-    has_content = 1;
-    if (c == '\n') count++;
-  }
-  
+  count = li->nlines - 1;
   /* 如果文件有内容但最后一行没有换行符，也算一行 */
-  if (has_content && c != '\n') count++;
+  if (li->size > 0 && li->data[li->size - 1] != '\n') count++;
   
-  fclose(f);
-  lua_pushinteger(L, count);
+  lua_pushinteger(L, (lua_Integer)count);
   return 1;
 }
 
@@ -1050,11 +1302,8 @@ static int io_readlines_range (lua_State *L) {
   lua_Integer end_line = luaL_checkinteger(L, 3);
   const char *mode = luaL_optstring(L, 4, "t");
   int binary_mode = (mode[0] == 'b' || mode[0] == 'B');
-  FILE *f;
-  int current_line = 1;
-  int c;
-  int result_idx = 1;
-  luaL_Buffer b;
+  LineIndex *li;
+  size_t first, last, k;
   
   if (start_line < 1) {
     luaL_pushfail(L);
@@ -1068,50 +1317,23 @@ static int io_readlines_range (lua_State *L) {
   }
   
   errno = 0;
-  f = fopen(filename, binary_mode ? "rb" : "r");
-  if (f == NULL) {
+  li = getlineindex(L, filename);
+  if (li == NULL) {
     return luaL_fileresult(L, 0, filename);
   }
   
-  /* 创建结果table */
-  lua_newtable(L);
-  
-  /* 跳过前面的行 */
-  while (current_line < start_line) {
-    c = fgetc(f);
-    if (c == EOF) {
-      fclose(f);
-      return 1;  /* 返回空table */
-    }
-    if (c == '\n') current_line++;
+  if ((lua_Unsigned)start_line > li->nlines) {
+    lua_newtable(L);
+    return 1;  /* 返回空table */
   }
+  first = (size_t)start_line - 1;
+  last = ((lua_Unsigned)end_line < li->nlines) ? (size_t)end_line : li->nlines;
   
-  /* 读取范围内的所有行 */
-  while (current_line <= end_line) {
-    if (binary_mode) {
-      /* 二进制模式：每行为字节table */
-      lua_newtable(L);
-      int byte_idx = 1;
-      while ((c = fgetc(f)) != EOF && c != '\n') {
-        lua_pushinteger(L, (unsigned char)c);
-        lua_rawseti(L, -2, byte_idx++);
-      }
-      lua_rawseti(L, -2, result_idx++);
-    } else {
-      /* 文本模式：每行为字符串 */
-      luaL_buffinit(L, &b);
-      while ((c = fgetc(f)) != EOF && c != '\n') {
-        luaL_addchar(&b, c);
-      }
-      luaL_pushresult(&b);
-      lua_rawseti(L, -2, result_idx++);
-    }
-    
-    if (c == EOF) break;
-    current_line++;
+  lua_createtable(L, (last - first <= INT_MAX) ? (int)(last - first) : 0, 0);
+  for (k = first; k < last; k++) {
+    pushline(L, li, k, binary_mode);
+    lua_rawseti(L, -2, (lua_Integer)(k - first) + 1);
   }
-  
-  fclose(f);
   return 1;
 }
 
@@ -1155,6 +1377,7 @@ static int io_writelines_range (lua_State *L) {
   strcpy(temp_filename, filename);
   strcat(temp_filename, ".tmp");
   
+  droplineindex(L, filename);
   errno = 0;
   f_in = fopen(filename, binary_mode ? "rb" : "r");
   f_out = fopen(temp_filename, binary_mode ? "wb" : "w");
@@ -1437,6 +1660,10 @@ static void createmeta (lua_State *L) {
   luaL_setfuncs(L, meth, 0);  /* add file methods to method table */
   lua_setfield(L, -2, "__index");  /* metatable.__index = method table */
   lua_pop(L, 1);  /* pop metatable */
+  luaL_newmetatable(L, LINEIDX_META);  /* metatable for line indices */
+  lua_pushcfunction(L, lidx_gc);
+  lua_setfield(L, -2, "__gc");
+  lua_pop(L, 1);  /* pop metatable */
 }
 
 
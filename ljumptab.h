@@ -139,6 +139,8 @@ static const void *const disptab[NUM_OPCODES] = {
 &&L_OP_ASYNCWRAP,
 &&L_OP_GENERICWRAP,
 &&L_OP_CHECKTYPE,
+&&L_OP_SWITCH,
+&&L_OP_TRAP,
 &&L_OP_EXTRAARG
 
 };
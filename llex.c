@@ -45,11 +45,16 @@
 #define currIsNewline(ls)	(ls->current == '\n' || ls->current == '\r')
 
 /* Duplicate helper functions for llex.c */
-static const char* nirithy_b64 = "9876543210zyxwvutsrqponmlkjihgfedcbaZYXWVUTSRQPONMLKJIHGFEDCBA-_";
-
+/*
+** Value of 'c' in the envelope's base64 alphabet,
+** "9876543210zyxwvutsrqponmlkjihgfedcbaZYXWVUTSRQPONMLKJIHGFEDCBA-_".
+*/
 static int nirithy_b64_val(char c) {
-  const char *p = strchr(nirithy_b64, c);
-  if (p) return (int)(p - nirithy_b64);
+  if (c >= '0' && c <= '9') return '9' - c;
+  if (c >= 'a' && c <= 'z') return 10 + ('z' - c);
+  if (c >= 'A' && c <= 'Z') return 36 + ('Z' - c);
+  if (c == '-') return 62;
+  if (c == '_') return 63;
   return -1;
 }
 
@@ -9,6 +9,8 @@
 
 #include "lprefix.h"
 
+#include <string.h>
+
 #include "lua.h"
 
 #include "lgc.h"
@@ -26,7 +28,7 @@ Namespace *luaN_new (lua_State *L, TString *name) {
   ns->name = name;
   ns->data = NULL;
   ns->using_next = NULL;
-  ns->using_next = NULL;
+  ns->cache = NULL;
 
   /* Anchor ns on stack to prevent collection during table allocation */
   setnsvalue(L, s2v(L->top.p), ns);
@@ -42,5 +44,112 @@ Namespace *luaN_new (lua_State *L, TString *name) {
 }
 
 void luaN_free (lua_State *L, Namespace *ns) {
+  luaM_freearray(L, ns->cache, NSCACHE_SIZE);
   luaM_free(L, ns);
 }
+
+
+/*
+** Cache entry for 'key' in 'ns', allocating the cache on first use, or
+** NULL if 'key' is not cached (only short strings, i.e. names, are).
+*/
+static NsCacheEntry *cacheentry (lua_State *L, Namespace *ns,
+                                 const TValue *key) {
+  if (!ttisshrstring(key))
+    return NULL;
+  if (ns->cache == NULL) {
+    NsCacheEntry *c = luaM_newvector(L, NSCACHE_SIZE, NsCacheEntry);
+    memset(c, 0, NSCACHE_SIZE * sizeof(NsCacheEntry));
+    ns->cache = c;
+  }
+  return &ns->cache[lmod(tsvalue(key)->hash, NSCACHE_SIZE)];
+}
+
+
+/* lock table 'h' for reading or, if 'write', for writing */
+#define nslock(h,write)	((write) ? luaH_wrlock(h) : luaH_rdlock(h))
+
+
+/*
+** Find 'key' in the data of 'ns' or of the namespaces it uses, in
+** chain order. Returns the table holding it (with its slot in '*slot')
+** or NULL. The table is returned locked ('write' selects the mode, the
+** lock taken is left in '*lk'), so '*slot' stays valid until the caller
+** unlocks it. Resolutions of names are cached in 'ns'; a slot found
+** there stays valid until some namespace gains a key (the only way
+** their tables can be rehashed, and done under the table's write lock
+** together with 'luaN_invalidate'), so a cached slot is only trusted
+** after its version is checked with the owner locked.
+*/
+static Table *resolve (lua_State *L, Namespace *ns, const TValue *key,
+                       const TValue **slot, int write, l_rwlock_t **lk) {
+  NsCacheEntry *e = cacheentry(L, ns, key);
+  Namespace *n;
+  *lk = NULL;
+  if (e != NULL && e->key == tsvalue(key) && e->version == G(L)->nsver) {
+    if (e->owner == NULL)
+      return NULL;
+    *lk = nslock(e->owner, write);
+    if (e->version == G(L)->nsver && !isempty(e->slot)) {
+      *slot = e->slot;
+      return e->owner;
+    }
+    luaH_unlock(*lk);
+    *lk = NULL;
+  }
+  for (n = ns; n != NULL; n = n->using_next) {
+    Table *h = n->data;
+    if (h) {
+      const TValue *res;
+      l_rwlock_t *hlk = nslock(h, write);
+      res = luaH_get(h, key);
+      if (!isempty(res)) {
+        *slot = res;
+        *lk = hlk;  /* keep it locked for the caller */
+        break;
+      }
+      luaH_unlock(hlk);
+    }
+  }
+  if (e != NULL) {
+    e->key = tsvalue(key);
+    e->owner = (n != NULL) ? n->data : NULL;
+    e->slot = (n != NULL) ? *slot : NULL;
+    e->version = G(L)->nsver;
+    luaC_objbarrier(L, ns, e->key);
+  }
+  return (n != NULL) ? n->data : NULL;
+}
+
+
+/*
+** 'val = ns[key]' through the 'using' chain of 'ns'. Returns 0 (leaving
+** 'val' untouched) when no namespace in the chain has 'key'.
+*/
+int luaN_get (lua_State *L, Namespace *ns, const TValue *key, StkId val) {
+  const TValue *slot;
+  l_rwlock_t *hlk;
+  Table *h = resolve(L, ns, key, &slot, 0, &hlk);
+  if (h == NULL)
+    return 0;
+  setobj2s(L, val, slot);
+  luaH_unlock(hlk);
+  return 1;
+}
+
+
+/*
+** Assign 'val' to an existing 'key' somewhere in the 'using' chain of
+** 'ns'. Returns 0 when no namespace there has 'key'.
+*/
+int luaN_set (lua_State *L, Namespace *ns, const TValue *key, TValue *val) {
+  const TValue *slot;
+  l_rwlock_t *hlk;
+  Table *h = resolve(L, ns, key, &slot, 1, &hlk);
+  if (h == NULL)
+    return 0;
+  setobj2t(L, cast(TValue *, slot), val);
+  luaC_barrierback(L, obj2gco(h), val);
+  luaH_unlock(hlk);
+  return 1;
+}
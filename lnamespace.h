@@ -9,7 +9,32 @@
 
 #include "lobject.h"
 
+
+/* size of the resolution cache of a namespace (a power of 2) */
+#define NSCACHE_SIZE	64
+
+
+/*
+** Entry of the resolution cache: where 'key' was found in the chain of
+** 'using' namespaces ('owner' NULL if nowhere), valid while the global
+** 'nsver' equals 'version'.
+*/
+typedef struct NsCacheEntry {
+  TString *key;
+  struct Table *owner;
+  const TValue *slot;
+  lua_Integer version;
+} NsCacheEntry;
+
+
+/* namespaces gained a key or were relinked: drop all cached resolutions */
+#define luaN_invalidate(L)	(G(L)->nsver++)
+
 LUAI_FUNC Namespace *luaN_new (lua_State *L, TString *name);
 LUAI_FUNC void luaN_free (lua_State *L, Namespace *ns);
+LUAI_FUNC int luaN_get (lua_State *L, Namespace *ns, const TValue *key,
+                        StkId val);
+LUAI_FUNC int luaN_set (lua_State *L, Namespace *ns, const TValue *key,
+                        TValue *val);
 
 #endif
@@ -1551,6 +1551,10 @@ int luaO_flatten (lua_State *L, Proto *f, int flags, unsigned int seed,
     }
   }
   
+  /* 跳转表的目标是绝对PC，重排代码前先退回到比较链 */
+  if (flags & (OBFUSCATE_CFF | OBFUSCATE_VM_PROTECT))
+    luaF_dropswitches(L, f);
+
   /* 检查是否需要扁平化 */
   if (!(flags & OBFUSCATE_CFF)) {
     /* 未启用控制流扁平化，但可能需要VM保护 */
@@ -3746,13 +3750,13 @@ int luaO_executeVM (lua_State *L, Proto *f) {
         TString *key = tsvalue(rc);
         if (ttistable(upval)) {
            Table *h = hvalue(upval);
-           l_rwlock_rdlock(&h->lock);
+           l_rwlock_t *hlk = luaH_rdlock(h);
            const TValue *res = luaH_getshortstr(h, key);
            if (!isempty(res)) {
               setobj2s(L, ra, res);
-              l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               savepc(L); L->top.p = ci->top.p;
               luaV_finishget(L, upval, rc, ra, NULL);
            }
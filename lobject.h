@@ -398,13 +398,17 @@ typedef struct GCObject {
  */
 typedef struct TBigInt {
   CommonHeader;
-  unsigned int len;  /**< Number of limbs. */
-  int sign;          /**< 1 or -1. */
-  l_uint32 buff[1];  /**< Limbs (little endian). */
+  unsigned int len;   /**< Number of limbs in use. */
+  unsigned int size;  /**< Number of limbs allocated. */
+  int sign;           /**< 1 or -1. */
+  l_uint64 buff[1];   /**< Limbs (little endian). */
 } TBigInt;
 
 #define gco2big(o)	check_exp((o)->tt == LUA_VNUMBIG, (TBigInt*)(o))
 
+/* size of a big integer with room for 'n' limbs */
+#define sizebigint(n)	(offsetof(TBigInt, buff) + (n) * sizeof(l_uint64))
+
 LUAI_FUNC lua_Number luaB_bigtonumber (const TValue *obj);
 
 
@@ -521,6 +525,7 @@ typedef struct TExternalString {
 typedef struct Struct {
   CommonHeader;
   struct Table *def;    /**< Struct definition (type info). */
+  const struct StructLayout *layout;  /**< Compiled layout of 'def'. */
   int *gc_offsets;      /**< GC offsets array. */
   int n_gc_offsets;     /**< Number of GC offsets. */
   size_t data_size;     /**< Size of the data block. */
@@ -721,6 +726,49 @@ LUAI_FUNC void luaF_callqueuepush (lua_State *L, CallQueue *q, int nargs);
 LUAI_FUNC int luaF_callqueuepop (lua_State *L, CallQueue *q, int *nargs, TValue *args);
 
 
+/**
+ * @brief Constant case label of a 'switch' and the pc of its body.
+ */
+typedef struct SwitchCase {
+  TValue key;  /**< Integer or short-string label. */
+  int pc;  /**< First instruction of the case body. */
+} SwitchCase;
+
+/**
+ * @brief Jump table of a 'switch' whose labels are all constants (OP_SWITCH).
+ *
+ * Integer labels covering at least half of their range index 'targets'
+ * directly ('keys' is NULL); anything else is an open-addressing map
+ * from 'keys' to the parallel 'targets'. A miss jumps to 'deflt'.
+ */
+typedef struct SwitchTable {
+  lua_Integer lo;  /**< Smallest label of a dense table. */
+  TValue *keys;  /**< Map slots (nil when free), or NULL if dense. */
+  int *targets;  /**< Target pcs. */
+  int size;  /**< Size of 'targets' (a power of 2 for maps). */
+  int deflt;  /**< Target pc when no label matches. */
+} SwitchTable;
+
+
+/**
+ * @brief Instruction overwritten by OP_TRAP while a breakpoint is set.
+ */
+typedef struct TrapSite {
+  int pc;  /**< Position of the trap in 'code'. */
+  Instruction i;  /**< The instruction it replaced. */
+} TrapSite;
+
+
+/**
+ * @brief Inline cache of an OP_CHECKTYPE instruction.
+ */
+typedef struct TypeIC {
+  GCObject *type;  /**< Type operand seen last, NULL if unused. */
+  GCObject *cls;  /**< Class of the last instance that passed, or NULL. */
+  unsigned int mask;  /**< Tag bits (see 'luaV_typebits') 'type' accepts. */
+} TypeIC;
+
+
 /*
 ** Function Prototypes
 */
@@ -760,6 +808,14 @@ typedef struct Proto {
   int is_sleeping; /**< Sleep status. */
   CallQueue *call_queue; /**< Call queue for sleep/wake. */
   struct VMCodeTable *vm_code_table;  /**< VM protection code table pointer. */
+  struct StructIC *structic;  /**< Struct field inline caches (lazy). */
+  int sizestructic;  /**< Size of 'structic' array. */
+  SwitchTable *switches;  /**< Jump tables of OP_SWITCH. */
+  int sizeswitches;  /**< Size of 'switches' array. */
+  TrapSite *traps;  /**< Instructions replaced by OP_TRAP, sorted by pc. */
+  int sizetraps;  /**< Size of 'traps' array. */
+  TypeIC *typeic;  /**< OP_CHECKTYPE inline caches (lazy). */
+  int sizetypeic;  /**< Size of 'typeic' array. */
 } Proto;
 
 /* }======================================================= */
@@ -921,6 +977,7 @@ typedef struct Namespace {
   TString *name; /**< Namespace name. */
   struct GCObject *gclist; /**< GC list. */
   struct Namespace *using_next; /**< Linked list of used namespaces. */
+  struct NsCacheEntry *cache; /**< Resolution cache through the chain (lazy). */
 } Namespace;
 
 
@@ -946,10 +1003,13 @@ typedef struct Namespace {
  */
 typedef struct SuperStruct {
   CommonHeader;
+  lu_byte sorted; /**< Whether 'data' is in key order (see 'luaS_next'). */
   TString *name; /**< SuperStruct name. */
   unsigned int nsize; /**< Size. */
   unsigned int ncapacity; /**< Capacity. */
-  TValue *data; /**< Data. */
+  TValue *data; /**< Data: key/value pairs. */
+  unsigned int *index; /**< Hash of 'data' positions plus one (0 is empty). */
+  unsigned int sizeindex; /**< Size of 'index' (a power of 2). */
 } SuperStruct;
 
 #define gco2superstruct(o)	check_exp((o)->tt == LUA_VSUPERSTRUCT, &((cast_u(o) - offsetof(SuperStruct, next))->superstruct))
@@ -1035,7 +1095,7 @@ typedef struct Table {
   GCObject *gclist; /**< Garbage collector list. */
   lu_byte type;    /**< Custom type flag. */
   lu_byte is_shared; /**< Lock enablement flag. */
-  l_rwlock_t lock; /**< Lock for thread safety. */
+  l_rwlock_t *_Atomic lock; /**< Lock for thread safety (created by luaH_share). */
   struct Namespace *using_next; /**< Used namespaces. */
 } Table;
 
@@ -29,6 +29,10 @@
 
 static int logtable_onlog(lua_State *L) {
   int enable = lua_toboolean(L, 1);
+  const char *path = luaL_optstring(L, 2, NULL);
+  if (path != NULL) {
+    luaH_set_log_path(path);
+  }
   int result = luaH_enable_access_log(L, enable);
   lua_pushboolean(L, result);
   return 1;
@@ -194,6 +198,29 @@ static int logtable_getuserdata(lua_State *L) {
   return 1;
 }
 
+static int logtable_setasync(lua_State *L) {
+  static const char *const formats[] = {"text", "binary", NULL};
+  int enabled = lua_toboolean(L, 1);
+  lua_Integer capacity = luaL_optinteger(L, 2, 0);
+  int binary = luaL_checkoption(L, 3, "text", formats);
+  luaL_argcheck(L, capacity >= 0, 2, "capacity must be non-negative");
+  lua_pushboolean(L, luaH_set_access_log_async(enabled, (size_t)capacity, binary));
+  return 1;
+}
+
+static int logtable_stats(lua_State *L) {
+  size_t recorded, dropped, written;
+  luaH_get_access_log_stats(&recorded, &dropped, &written);
+  lua_createtable(L, 0, 3);
+  lua_pushinteger(L, (lua_Integer)recorded);
+  lua_setfield(L, -2, "recorded");
+  lua_pushinteger(L, (lua_Integer)dropped);
+  lua_setfield(L, -2, "dropped");
+  lua_pushinteger(L, (lua_Integer)written);
+  lua_setfield(L, -2, "written");
+  return 1;
+}
+
 static const luaL_Reg logtable_funcs[] = {
   {"onlog", logtable_onlog},
   {"getlogpath", logtable_getlogpath},
@@ -220,6 +247,8 @@ static const luaL_Reg logtable_funcs[] = {
   {"getjnienv", logtable_getjnienv},
   {"setuserdata", logtable_setuserdata},
   {"getuserdata", logtable_getuserdata},
+  {"setasync", logtable_setasync},
+  {"stats", logtable_stats},
   {NULL, NULL}
 };
 
@@ -135,6 +135,8 @@ LUAI_DDEF const lu_byte luaP_opmodes[NUM_OPCODES] = {
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_ASYNCWRAP */
  ,opmode(0, 0, 0, 0, 1, iABC)		/* OP_GENERICWRAP */
  ,opmode(0, 0, 0, 0, 0, iABC)		/* OP_CHECKTYPE */
+ ,opmode(0, 0, 0, 0, 0, iABx)		/* OP_SWITCH */
+ ,opmode(0, 0, 1, 0, 0, iABC)		/* OP_TRAP */
  ,opmode(0, 0, 0, 0, 0, iAx)		/* OP_EXTRAARG */
 };
 
@@ -412,6 +412,8 @@ OP_GETOPS,/*	A	R[A] := LXC_OPERATORS				*/
 OP_ASYNCWRAP,/*	A B	R[A] := async_wrap(R[B])			*/
 OP_GENERICWRAP,/* A B	R[A] := generic_wrap(R[B], R[B+1], R[B+2])	*/
 OP_CHECKTYPE,/*	A B C	if (check_type(R[A], R[B]) != true) error(K[C])	*/
+OP_SWITCH,/*	A Bx	pc := SWITCHES[Bx][R[A]] (or its default)	*/
+OP_TRAP,/*		call the break hook; run the replaced instruction	*/
 
 OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
 } OpCode;
@@ -459,6 +461,15 @@ OP_EXTRAARG/*	Ax	extra (larger) argument for previous opcode	*/
   (*) In OP_ERRNNIL, (Bx == 0) means index of global name doesn't
   fit in Bx. (So, that name is not available for the error message.)
 
+  (*) OP_SWITCH replaces the jump that opens the comparison chain of a
+  'switch' whose case labels are all integer or short-string constants.
+  The chain still follows it, complete, so treating OP_SWITCH as a jump
+  to the next instruction is always correct.
+
+  (*) OP_TRAP is never generated by the compiler. It overwrites an
+  instruction while a breakpoint is set on its line; the original is
+  kept in the 'traps' side table of the Proto (see 'luaG_getorigin').
+
   (*) For comparisons, k specifies what condition the test should accept
   (true or false).
 
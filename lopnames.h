@@ -127,6 +127,8 @@ static const char *const opnames[] = {
   "ASYNCWRAP",
   "GENERICWRAP",
   "CHECKTYPE",
+  "SWITCH",
+  "TRAP",
   "EXTRAARG",
   NULL
 };
@@ -30,6 +30,7 @@
 #include "lstring.h"
 #include "ltable.h"
 #include "ltm.h"
+#include "lvm.h"
 #include "lopnames.h"
 
 
@@ -2190,6 +2191,39 @@ static void parlist (LexState *ls, TString **varargname) {
 }
 
 
+/*
+** Emit the run-time check of parameter 'vidx' against the named type
+** 'tname'. A builtin type name that no local or upvalue shadows is
+** resolved here into a type code kept in B (with k set), so checking
+** it needs neither a register nor a global lookup.
+*/
+static void codetypecheck (FuncState *fs, int vidx, TString *tname) {
+  LexState *ls = fs->ls;
+  expdesc e_val, e_type;
+  int val_reg, type_reg, name_k, code;
+  init_var(fs, &e_val, vidx);
+  luaK_exp2anyreg(fs, &e_val);
+  val_reg = e_val.u.info;
+  singlevaraux(fs, tname, &e_type, 1);
+  if (e_type.k == VVOID && (code = luaV_typecode(getstr(tname))) >= 0) {
+    name_k = luaK_stringK(fs, getlocalvardesc(fs, vidx)->vd.name);
+    luaK_codeABCk(fs, OP_CHECKTYPE, val_reg, code, name_k, 1);
+    return;
+  }
+  if (e_type.k == VVOID) {
+    expdesc key;
+    singlevaraux(fs, ls->envn, &e_type, 1);
+    codestring(&key, tname);
+    luaK_indexed(fs, &e_type, &key);
+  }
+  luaK_exp2nextreg(fs, &e_type);
+  type_reg = e_type.u.info;
+  name_k = luaK_stringK(fs, getlocalvardesc(fs, vidx)->vd.name);
+  luaK_codeABC(fs, OP_CHECKTYPE, val_reg, type_reg, name_k);
+  fs->freereg = type_reg;  /* free type register */
+}
+
+
 /**
  * 解析函数体
  * 支持两种语法：
@@ -2265,28 +2299,7 @@ static void body (LexState *ls, expdesc *e, int ismethod, int line) {
            int j;
            for (j = 0; j < MAX_TYPE_DESCS; j++) {
               if (vd->vd.hint->descs[j].type == LVT_NAME && vd->vd.hint->descs[j].typename) {
-                 /* Using OP_CHECKTYPE A B C */
-                 expdesc e_val;
-                 init_var(&new_fs, &e_val, i);
-                 luaK_exp2anyreg(&new_fs, &e_val);
-                 int val_reg = e_val.u.info;
-
-                 expdesc e_type;
-                 singlevaraux(&new_fs, vd->vd.hint->descs[j].typename, &e_type, 1);
-                 if (e_type.k == VVOID) {
-                    expdesc key;
-                    singlevaraux(&new_fs, ls->envn, &e_type, 1);
-                    codestring(&key, vd->vd.hint->descs[j].typename);
-                    luaK_indexed(&new_fs, &e_type, &key);
-                 }
-                 luaK_exp2nextreg(&new_fs, &e_type);
-                 int type_reg = e_type.u.info;
-
-                 int name_k = luaK_stringK(&new_fs, vd->vd.name);
-
-                 luaK_codeABC(&new_fs, OP_CHECKTYPE, val_reg, type_reg, name_k);
-
-                 new_fs.freereg = type_reg; /* Free type_reg */
+                 codetypecheck(&new_fs, i, vd->vd.hint->descs[j].typename);
               }
            }
         }
@@ -2346,28 +2359,7 @@ static void body (LexState *ls, expdesc *e, int ismethod, int line) {
                int j;
                for (j = 0; j < MAX_TYPE_DESCS; j++) {
                   if (vd->vd.hint->descs[j].type == LVT_NAME && vd->vd.hint->descs[j].typename) {
-                 /* Using OP_CHECKTYPE A B C */
-                     expdesc e_val;
-                     init_var(&impl_fs, &e_val, i);
-                 luaK_exp2anyreg(&impl_fs, &e_val);
-                 int val_reg = e_val.u.info;
-
-                     expdesc e_type;
-                     singlevaraux(&impl_fs, vd->vd.hint->descs[j].typename, &e_type, 1);
-                     if (e_type.k == VVOID) {
-                        expdesc key;
-                        singlevaraux(&impl_fs, ls->envn, &e_type, 1);
-                        codestring(&key, vd->vd.hint->descs[j].typename);
-                        luaK_indexed(&impl_fs, &e_type, &key);
-                     }
-                     luaK_exp2nextreg(&impl_fs, &e_type);
-                 int type_reg = e_type.u.info;
-
-                 int name_k = luaK_stringK(&impl_fs, vd->vd.name);
-
-                 luaK_codeABC(&impl_fs, OP_CHECKTYPE, val_reg, type_reg, name_k);
-
-                 impl_fs.freereg = type_reg;
+                 codetypecheck(&impl_fs, i, vd->vd.hint->descs[j].typename);
                   }
                }
             }
@@ -2773,28 +2765,7 @@ static void parse_generic_arrow_body(LexState *ls, FuncState *factory_fs, expdes
              int j;
              for (j = 0; j < MAX_TYPE_DESCS; j++) {
                 if (vd->vd.hint->descs[j].type == LVT_NAME && vd->vd.hint->descs[j].typename) {
-                 /* Using OP_CHECKTYPE A B C */
-                   expdesc e_val;
-                   init_var(&impl_fs, &e_val, i);
-                 luaK_exp2anyreg(&impl_fs, &e_val);
-                 int val_reg = e_val.u.info;
-
-                   expdesc e_type;
-                   singlevaraux(&impl_fs, vd->vd.hint->descs[j].typename, &e_type, 1);
-                   if (e_type.k == VVOID) {
-                      expdesc key;
-                      singlevaraux(&impl_fs, ls->envn, &e_type, 1);
-                      codestring(&key, vd->vd.hint->descs[j].typename);
-                      luaK_indexed(&impl_fs, &e_type, &key);
-                   }
-                   luaK_exp2nextreg(&impl_fs, &e_type);
-                 int type_reg = e_type.u.info;
-
-                 int name_k = luaK_stringK(&impl_fs, vd->vd.name);
-
-                 luaK_codeABC(&impl_fs, OP_CHECKTYPE, val_reg, type_reg, name_k);
-
-                 impl_fs.freereg = type_reg;
+                 codetypecheck(&impl_fs, i, vd->vd.hint->descs[j].typename);
                 }
              }
           }
@@ -6118,11 +6089,46 @@ static void matchstat (LexState *ls, int line) {
   leaveblock(fs);
 }
 
+/* fewest constant labels worth a jump table instead of the chain */
+#define MINSWITCHCASES	3
+
+
+/*
+** Records case label 'e' of the innermost 'switch' for its jump table.
+** Returns false if the label is not an integer or short-string constant.
+*/
+static int switchcase (LexState *ls, const expdesc *e) {
+  Dyndata *dyd = ls->dyd;
+  SwitchCase *sc;
+  TValue v;
+  if (!luaK_exp2const(ls->fs, e, &v) || !(ttisinteger(&v) || ttisshrstring(&v)))
+    return 0;
+  luaM_growvector(ls->L, dyd->swcase.arr, dyd->swcase.n + 1,
+                  dyd->swcase.size, SwitchCase, MAX_INT, "switch cases");
+  sc = &dyd->swcase.arr[dyd->swcase.n++];
+  setobj(ls->L, &sc->key, &v);
+  sc->pc = -1;  /* body not reached yet */
+  return 1;
+}
+
+
+/*
+** Every case is compiled into a chain of equality tests. When all labels
+** are integer or short-string constants, the jump that opens the chain
+** becomes an OP_SWITCH that looks the control value up in a jump table
+** and goes straight to the matching body (or to the default). The chain
+** stays behind it, so anything that does not know OP_SWITCH may run it
+** as a jump to the next instruction.
+*/
 static void switchstat (LexState *ls, int line) {
   FuncState *fs = ls->fs;
+  Dyndata *dyd = ls->dyd;
   BlockCnt bl;
   expdesc ctrl;
   int jump_to_check;
+  int dispatch;  /* pc of the jump that opens the chain */
+  int firstcase = dyd->swcase.n;  /* first label of this switch in 'dyd' */
+  int constcases;  /* all labels so far fit a jump table? */
   int fallthrough_jump = -1;
   int default_label = -1;
   int previous_body_active = 0; /* To track if we need to generate fallthrough jump */
@@ -6147,12 +6153,15 @@ static void switchstat (LexState *ls, int line) {
   }
 
   /* Initial jump to first check */
-  jump_to_check = luaK_jump(fs);
+  jump_to_check = dispatch = luaK_jump(fs);
+  /* the table needs the chain to start right after 'dispatch' */
+  constcases = (ls->t.token == TK_CASE);
 
   while (ls->t.token != TK_END && ls->t.token != TK_EOS && ls->t.token != '}') {
     if (ls->t.token == TK_CASE) {
       int to_body_jump = NO_JUMP;
       int next_check_jump;
+      int caselabels = dyd->swcase.n;  /* first label of this case */
 
       /* Handle fallthrough from previous body */
       if (previous_body_active) {
@@ -6176,6 +6185,8 @@ static void switchstat (LexState *ls, int line) {
         ls->expr_flags |= E_NO_COLON;
         expr(ls, &e);
         ls->expr_flags = old_flags;
+        if (constcases)
+          constcases = switchcase(ls, &e);
 
         luaK_infix(fs, OPR_EQ, &c);
         luaK_posfix(fs, OPR_EQ, &c, &e, ls->linenumber);
@@ -6203,6 +6214,8 @@ static void switchstat (LexState *ls, int line) {
         luaK_patchtohere(fs, fallthrough_jump);
         fallthrough_jump = -1;
       }
+      for (; constcases && caselabels < dyd->swcase.n; caselabels++)
+        dyd->swcase.arr[caselabels].pc = fs->pc;
 
       /* Parse Body */
       if (testnext(ls, TK_ARROW)) {
@@ -6277,6 +6290,15 @@ static void switchstat (LexState *ls, int line) {
     luaK_patchtohere(fs, fallthrough_jump);
   }
 
+  if (constcases && dyd->swcase.n - firstcase >= MINSWITCHCASES) {
+    int deflt = (default_label != -1) ? default_label : fs->pc;
+    int idx = luaF_newswitch(ls->L, fs->f, &dyd->swcase.arr[firstcase],
+                             dyd->swcase.n - firstcase, deflt);
+    lua_assert(GET_OPCODE(fs->f->code[dispatch]) == OP_JMP);
+    fs->f->code[dispatch] = CREATE_ABx(OP_SWITCH, ctrl.u.info, idx);
+  }
+  dyd->swcase.n = firstcase;
+
   if (ls->t.token == TK_END) {
     luaX_next(ls);
   } else {
@@ -10938,10 +10960,9 @@ static void superstructstat (LexState *ls, int line) {
     }
 
     checknext(ls, ':');
+    luaK_exp2nextreg(fs, &key);  /* before 'val' can reuse its register */
     expr(ls, &val);
-
     luaK_exp2nextreg(fs, &val);
-    luaK_exp2nextreg(fs, &key);
 
     luaK_codeABC(fs, OP_SETSUPER, ss_reg, key.u.info, val.u.info);
 
@@ -13045,7 +13066,7 @@ LClosure *luaY_parser (lua_State *L, ZIO *z, Mbuffer *buff,
   lexstate.dyd = dyd;
   lexstate.curpos=0;
   lexstate.tokpos=0;
-  dyd->actvar.n = dyd->gt.n = dyd->label.n = 0;
+  dyd->actvar.n = dyd->gt.n = dyd->label.n = dyd->swcase.n = 0;
   luaX_setinput(L, &lexstate, z, funcstate.f->source, firstchar);
   mainfunc(&lexstate, &funcstate);
   lua_assert(!funcstate.prev && funcstate.nups == 1 && !lexstate.fs);
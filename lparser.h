@@ -217,6 +217,11 @@ typedef struct Dyndata {
   } actvar;
   Labellist gt;  /**< list of pending gotos */
   Labellist label;   /**< list of active labels */
+  struct {  /**< constant case labels of the open 'switch' statements */
+    SwitchCase *arr;
+    int n;
+    int size;
+  } swcase;
 } Dyndata;
 
 
@@ -255,7 +255,7 @@ static void freestack (lua_State *L) {
 static void init_registry (lua_State *L, global_State *g) {
   /* create registry */
   Table *registry = luaH_new(L);
-  registry->is_shared = 1;
+  luaH_share(L, registry);
   sethvalue(L, &g->l_registry, registry);
   luaH_resize(L, registry, LUA_RIDX_LAST, 0);
   /* registry[LUA_RIDX_MAINTHREAD] = L */
@@ -328,6 +328,7 @@ static void close_state (lua_State *L) {
     luaC_freeallobjects(L);  /* collect all objects */
     luai_userstateclose(L);
   }
+  luaG_freebreaklines(L);
   luaM_freearray(L, G(L)->strt.hash, G(L)->strt.size);
   luaM_poolshutdown(L);  /* shutdown memory pool */
   l_mutex_destroy(&g->lock);
@@ -497,6 +498,11 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud, unsigned seed) {
   g->genminormul = LUAI_GENMINORMUL;
   for (i=0; i < LUA_NUMTAGS; i++) g->mt[i] = NULL;
   g->vm_code_list = NULL;  /* initialize VM code list */
+  g->classver = 0;
+  g->nsver = 0;
+  g->breakhook = NULL;
+  g->breaklines = NULL;
+  g->nbreaklines = 0;
   luaM_poolinit(L);  /* initialize memory pool */
   l_mutex_init(&g->lock);
   if (luaD_rawrunprotected(L, f_luaopen, NULL) != LUA_OK) {
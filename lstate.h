@@ -358,6 +358,11 @@ typedef struct global_State {
   MemPoolArena mempool;  /**< Memory pool manager. */
   /* VM protection code table list */
   struct VMCodeTable *vm_code_list;  /**< VM protection code table list head. */
+  lua_Integer classver;  /**< Bumped whenever a class is modified (lclass.c). */
+  lua_Integer nsver;  /**< Bumped whenever namespace resolution may change (lnamespace.c). */
+  lua_Hook breakhook;  /**< Called when a breakpoint trap is hit. */
+  struct BreakLine *breaklines;  /**< Lines with breakpoints (ldebug.c). */
+  int nbreaklines;  /**< Number of entries in 'breaklines'. */
 } global_State;
 
 
@@ -13,6 +13,12 @@
 #include <stddef.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "lua.h"
 
 #include "ldebug.h"
@@ -56,11 +62,35 @@ int luaS_eqlngstr (TString *a, TString *b) {
 }
 
 
+/*
+** Multipliers for the string hash (odd 64-bit constants with well-mixed
+** bits, from the golden ratio and MurmurHash3's finalizer).
+*/
+#define STRHASH_K1	0x9E3779B97F4A7C15ULL
+#define STRHASH_K2	0xFF51AFD7ED558CCDULL
+
+#define strhash_mix(h,w)	((h) = ((h) ^ (w)) * STRHASH_K2, (h) ^= (h) >> 29)
+
+
+/*
+** Seeded string hash consuming 8 bytes per step. Words are read with
+** 'memcpy', so the string needs no particular alignment; the tail is
+** zero-padded into one last word.
+*/
 static unsigned luaS_hash (const char *str, size_t l, unsigned seed) {
-  unsigned int h = seed ^ cast_uint(l);
-  for (; l > 0; l--)
-    h ^= ((h<<5) + (h>>2) + cast_byte(str[l - 1]));
-  return h;
+  uint64_t h = ((cast(uint64_t, seed) << 32) | seed) ^ (cast(uint64_t, l) * STRHASH_K1);
+  uint64_t w;
+  for (; l >= 8; l -= 8, str += 8) {
+    memcpy(&w, str, 8);
+    strhash_mix(h, w);
+  }
+  if (l > 0) {
+    w = 0;
+    memcpy(&w, str, l);
+    strhash_mix(h, w);
+  }
+  h *= STRHASH_K1;
+  return cast_uint(h ^ (h >> 32));
 }
 
 
@@ -267,7 +297,7 @@ static TString *internshrstr (lua_State *L, const char *str, size_t l) {
   TString **list = &tb->hash[lmod(h, tb->size)];
   lua_assert(str != NULL);  /* otherwise 'memcmp'/'memcpy' are undefined */
   for (ts = *list; ts != NULL; ts = ts->u.hnext) {
-    if (l == cast_uint(ts->shrlen) &&
+    if (ts->hash == h && l == cast_uint(ts->shrlen) &&
         (memcmp(str, getshrstr(ts), l * sizeof(char)) == 0)) {
       /* found! */
       if (isdead(g, ts))  /* dead (but not collected yet)? */
@@ -436,3 +466,158 @@ TString *luaS_normstr (lua_State *L, TString *ts) {
     return internshrstr(L, str, len);
   }
 }
+
+
+/*
+** {======================================================
+** Substring search
+** =======================================================
+*/
+
+/* needles at least this long fall back to Two-Way when verification
+   work outgrows the haystack scanned so far */
+#define TWOWAY_MIN	32
+
+#define l_maxz(a,b)	((a) > (b) ? (a) : (b))
+
+
+/*
+** Crochemore-Perrin Two-Way search: linear time and constant space for
+** any needle. Used when first/last-byte filtering keeps finding
+** candidates that fail late (periodic needles and haystacks).
+*/
+static const char *twoway (const char *hs, size_t hl,
+                           const char *ns, size_t l) {
+  const unsigned char *h = (const unsigned char *)hs;
+  const unsigned char *n = (const unsigned char *)ns;
+  const unsigned char *z = h + hl;
+  size_t ip, jp, k, p, ms, p0, mem, mem0;
+  /* maximal suffix for '<' */
+  ip = (size_t)-1; jp = 0; k = p = 1;
+  while (jp + k < l) {
+    if (n[ip + k] == n[jp + k]) {
+      if (k == p) { jp += p; k = 1; }
+      else k++;
+    }
+    else if (n[ip + k] > n[jp + k]) { jp += k; k = 1; p = jp - ip; }
+    else { ip = jp++; k = p = 1; }
+  }
+  ms = ip;
+  p0 = p;
+  /* maximal suffix for '>' */
+  ip = (size_t)-1; jp = 0; k = p = 1;
+  while (jp + k < l) {
+    if (n[ip + k] == n[jp + k]) {
+      if (k == p) { jp += p; k = 1; }
+      else k++;
+    }
+    else if (n[ip + k] < n[jp + k]) { jp += k; k = 1; p = jp - ip; }
+    else { ip = jp++; k = p = 1; }
+  }
+  if (ip + 1 > ms + 1) ms = ip;  /* critical factorization */
+  else p = p0;
+  if (memcmp(n, n + p, ms + 1) != 0) {  /* needle is not periodic? */
+    mem0 = 0;
+    p = l_maxz(ms, l - ms - 1) + 1;
+  }
+  else
+    mem0 = l - p;
+  mem = 0;
+  while (cast_sizet(z - h) >= l) {
+    /* compare the right half */
+    for (k = l_maxz(ms + 1, mem); k < l && n[k] == h[k]; k++) ;
+    if (k < l) {
+      h += k - ms;
+      mem = 0;
+      continue;
+    }
+    /* compare the left half */
+    for (k = ms + 1; k > mem && n[k - 1] == h[k - 1]; k--) ;
+    if (k <= mem)
+      return (const char *)h;
+    h += p;
+    mem = mem0;
+  }
+  return NULL;
+}
+
+
+/*
+** Candidates are positions whose first and last bytes match the
+** needle's; only those reach 'memcmp'. SSE2 (or AVX2) tests 16 (32)
+** positions per step. 'work' counts verified bytes; once it gets out
+** of proportion with long needles, the rest of the haystack goes to
+** Two-Way so the search stays linear.
+*/
+#define toomuchwork(work,i,l)	((l) >= TWOWAY_MIN && (work) > 4 * (i) + 4096)
+
+const char *luaS_memfind (const char *s, size_t ls,
+                          const char *p, size_t lp) {
+  size_t i = 0, work = 0;
+  if (lp == 0)
+    return s;  /* empty strings are everywhere */
+  if (lp > ls)
+    return NULL;
+  if (lp == 1)
+    return (const char *)memchr(s, *p, ls);
+#if defined(__AVX2__)
+  {
+    const __m256i first = _mm256_set1_epi8(p[0]);
+    const __m256i last = _mm256_set1_epi8(p[lp - 1]);
+    for (; i + lp - 1 + 32 <= ls; i += 32) {
+      __m256i f = _mm256_loadu_si256((const __m256i *)(s + i));
+      __m256i e = _mm256_loadu_si256((const __m256i *)(s + i + lp - 1));
+      unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+          _mm256_and_si256(_mm256_cmpeq_epi8(f, first),
+                           _mm256_cmpeq_epi8(e, last)));
+      while (mask != 0) {
+        size_t pos = i + (size_t)__builtin_ctz(mask);
+        if (memcmp(s + pos + 1, p + 1, lp - 2) == 0)
+          return s + pos;
+        work += lp;
+        mask &= mask - 1;
+      }
+      if (toomuchwork(work, i, lp))
+        return twoway(s + i + 32, ls - i - 32, p, lp);
+    }
+  }
+#elif defined(__SSE2__)
+  {
+    const __m128i first = _mm_set1_epi8(p[0]);
+    const __m128i last = _mm_set1_epi8(p[lp - 1]);
+    for (; i + lp - 1 + 16 <= ls; i += 16) {
+      __m128i f = _mm_loadu_si128((const __m128i *)(s + i));
+      __m128i e = _mm_loadu_si128((const __m128i *)(s + i + lp - 1));
+      unsigned int mask = (unsigned int)_mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(f, first), _mm_cmpeq_epi8(e, last)));
+      while (mask != 0) {
+        size_t pos = i + (size_t)__builtin_ctz(mask);
+        if (memcmp(s + pos + 1, p + 1, lp - 2) == 0)
+          return s + pos;
+        work += lp;
+        mask &= mask - 1;
+      }
+      if (toomuchwork(work, i, lp))
+        return twoway(s + i + 16, ls - i - 16, p, lp);
+    }
+  }
+#endif
+  /* scalar: 'memchr' for the first byte, then the last byte */
+  while (i + lp <= ls) {
+    const char *c = (const char *)memchr(s + i, p[0], ls - lp + 1 - i);
+    if (c == NULL)
+      return NULL;
+    i = cast_sizet(c - s);
+    if (c[lp - 1] == p[lp - 1]) {
+      if (memcmp(c + 1, p + 1, lp - 2) == 0)
+        return c;
+      work += lp;
+    }
+    i++;
+    if (toomuchwork(work, i, lp))
+      return twoway(s + i, ls - i, p, lp);
+  }
+  return NULL;
+}
+
+/* }====================================================== */
@@ -28,12 +28,17 @@
 #include "lauxlib.h"
 #include "lualib.h"
 #include "llimits.h"
+#include "lstring.h"
 
 #include "aes.h"
 #include "crc.h"
 #include "sha256.h"
 
 
+/* plain substring search; the kernel is shared with the 'in' operator */
+#define lmemfind	luaS_memfind
+
+
 /*
 ** maximum number of captures that a pattern can do during
 ** pattern-matching. This limit is arbitrary, but must fit in
@@ -386,6 +391,7 @@ static int str_dump (lua_State *L) {
   int obfuscate_flags = 0;
   unsigned int seed = 0;
   int envelop = 1;  /* 默认带壳 */
+  int fast = 0;  /* 快速加载格式 */
   const char *log_path = NULL;  /* 日志输出路径 */
   
   luaL_checktype(L, 1, LUA_TFUNCTION);
@@ -415,6 +421,11 @@ static int str_dump (lua_State *L) {
     }
     lua_pop(L, 1);
 
+    /* 读取 fast 字段（快速加载格式） */
+    lua_getfield(L, 2, "fast");
+    fast = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
     /* 读取 envelop 字段 */
     lua_getfield(L, 2, "envelop");
     if (!lua_isnil(L, -1)) {
@@ -449,7 +460,10 @@ static int str_dump (lua_State *L) {
   state.init = 0;
   
   int result;
-  if (obfuscate_flags != 0) {
+  if (fast) {
+    /* 使用快速加载格式 */
+    result = lua_dump_fast(L, writer, &state, strip, obfuscate_flags, seed);
+  } else if (obfuscate_flags != 0) {
     /* 使用带混淆的导出函数 */
     result = lua_dump_obfuscated(L, writer, &state, strip, obfuscate_flags, seed, log_path);
   } else {
@@ -563,22 +577,15 @@ static int string_sub (lua_State *L) {
   
   /* 查找并剔除所有匹配的子串 */
   while (current < end) {
-    const char *match_pos = (const char *)memchr(current, *p, end - current);
+    const char *match_pos = lmemfind(current, end - current, p, lp);
     if (!match_pos) {
       /* 没有找到匹配，添加剩余部分并结束 */
       luaL_addlstring(&b, current, end - current);
       break;
     }
-    
-    /* 检查是否完全匹配 */
-    if (match_pos + lp <= end && memcmp(match_pos, p, lp) == 0) {
-      /* 找到完整匹配，添加匹配之前的内容，然后跳过匹配的部分 */
-      luaL_addlstring(&b, current, match_pos - current);
-      current = match_pos + lp;
-    } else {
-      /* 不是完整匹配，移动到下一个位置 */
-      current = match_pos + 1;
-    }
+    /* 找到完整匹配，添加匹配之前的内容，然后跳过匹配的部分 */
+    luaL_addlstring(&b, current, match_pos - current);
+    current = match_pos + lp;
   }
   
   luaL_pushresult(&b);
@@ -1112,28 +1119,6 @@ static const char *match (MatchState *ms, const char *s, const char *p) {
 
 
 
-static const char *lmemfind (const char *s1, size_t l1,
-                               const char *s2, size_t l2) {
-  if (l2 == 0) return s1;  /* empty strings are everywhere */
-  else if (l2 > l1) return NULL;  /* avoids a negative 'l1' */
-  else {
-    const char *init;  /* to search for a '*s2' inside 's1' */
-    l2--;  /* 1st char will be checked by 'memchr' */
-    l1 = l1-l2;  /* 's2' cannot be found after that */
-    while (l1 > 0 && (init = (const char *)memchr(s1, *s2, l1)) != NULL) {
-      init++;   /* 1st char is already checked */
-      if (memcmp(init, s2+1, l2) == 0)
-        return init-1;
-      else {  /* correct 'l1' and 's1' to try again */
-        l1 -= ct_diff2sz(init - s1);
-        s1 = init;
-      }
-    }
-    return NULL;  /* not found */
-  }
-}
-
-
 /*
 ** get information about the i-th capture. If there are no captures
 ** and 'i==0', return information about the whole match, which
@@ -1518,70 +1503,27 @@ static int str_split (lua_State *L) {
       if (p == NULL) {
         lua_pushlstring(L, s, e - s);
         lua_rawseti(L, -2, i++);
-        break;
+        s = e; /* done */
+      } else {
+        lua_pushlstring(L, s, p - s);
+        lua_rawseti(L, -2, i++);
+        s = p + sep_l;
       }
-      lua_pushlstring(L, s, p - s);
-      lua_rawseti(L, -2, i++);
-      s = p + sep_l;
     }
-    if (s == e && l > 0) { /* trailing empty string if separator was at the end */
-        /* Logic check: if string is "a,b," and sep is ",", we want {"a", "b", ""} */
-        /* lmemfind returns pointer to start of sep. */
-        /* loop breaks when s >= e. */
-        /* If the last char was sep, then s will equal e after s = p + sep_l. */
-        /* But we need to check if the loop condition covers this. */
-        /* Actually, if s == e, it means we finished exactly at end. */
-        /* If original string ended with sep, we pushed the part before sep. */
-        /* Example: "a," split by ",". */
-        /* 1. lmemfind finds "," at offset 1. p points to ",". */
-        /* 2. push "a". i=2. s becomes "," + 1 = end. */
-        /* 3. loop terminates. */
-        /* We need to push empty string? Python's split("a,") -> ['a', '']. */
-        /* Lua's common implementations usually do this. */
-        
-        /* Let's refine the loop logic. */
+    /* "split" returns {""} for "" input with any separator */
+    if (l == 0) {
+      lua_pushliteral(L, "");
+      lua_rawseti(L, -2, 1);
     }
-  }
-  
-  /* Re-implementation for correct behavior matching common split */
-  if (sep_l > 0) {
-      /* Reset stack and table */
-      lua_pop(L, 1); 
-      lua_newtable(L);
-      i = 1;
-      s = lua_tostring(L, 1); /* reset s */
-      
-      while (s < e) {
-        const char *p = lmemfind(s, e - s, sep, sep_l);
-        if (p == NULL) {
-          lua_pushlstring(L, s, e - s);
-          lua_rawseti(L, -2, i++);
-          s = e; /* done */
-        } else {
-          lua_pushlstring(L, s, p - s);
-          lua_rawseti(L, -2, i++);
-          s = p + sep_l;
-        }
-      }
-      /* If the string ended with separator, push empty string */
-      /* Check original string length to avoid pushing "" for empty string input if desired, 
-         but "split" usually returns {""} for "" input with any separator. */
-      if (l == 0) {
-          lua_pushliteral(L, "");
-          lua_rawseti(L, -2, 1);
-      }
-      else if (s == e) { 
-          /* If s reached e exactly after a separator, it means last part is empty. */
-          /* We need to know if the last operation was a separator skip. */
-          /* Compare s with previous pointer? */
-          /* Easier way: check if original string ends with separator */
-          if (l >= sep_l && memcmp(e - sep_l, sep, sep_l) == 0) {
-              lua_pushliteral(L, "");
-              lua_rawseti(L, -2, i);
-          }
+    else if (s == e) {
+      /* if the string ended with the separator, the last part is empty */
+      if (l >= sep_l && memcmp(e - sep_l, sep, sep_l) == 0) {
+        lua_pushliteral(L, "");
+        lua_rawseti(L, -2, i);
       }
+    }
   }
-  
+
   return 1;
 }
 
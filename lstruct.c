@@ -8,6 +8,7 @@
 
 #include "lprefix.h"
 
+#include <limits.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -22,21 +23,15 @@
 #include "lstring.h"
 #include "lapi.h"
 #include "ldebug.h"
+#include "lmem.h"
 #include <stdio.h>
 
-/* Field types */
-#define ST_INT 0
-#define ST_FLOAT 1
-#define ST_BOOL 2
-#define ST_STRUCT 3
-#define ST_STRING 4
-#define ST_ARRAY 5
-
 /* Keys for StructDef table */
 #define KEY_SIZE "__size"
 #define KEY_FIELDS "__fields"
 #define KEY_NAME "__name"
 #define KEY_GC_OFFSETS "__gc_offsets"
+#define KEY_LAYOUT "__layout"
 
 /* Keys for Field Info table */
 #define F_OFFSET "offset"
@@ -103,71 +98,248 @@ static void get_gc_offsets(lua_State *L, Table *def, int **offsets, int *count)
     }
 }
 
+/**
+ * @brief Reads one integer entry of a field info table.
+ *
+ * @param L The Lua state.
+ * @param info The field info table.
+ * @param k The entry name.
+ * @param def Value returned when the entry is missing.
+ * @return The entry value.
+ */
+static int get_info_int(lua_State *L, Table *info, const char *k, int def) {
+    const TValue *v = luaH_getshortstr(info, luaS_new(L, k));
+    return ttisinteger(v) ? (int)ivalue(v) : def;
+}
+
 /**
  * @brief Retrieves information about a struct field.
  *
  * @param L The Lua state.
  * @param fields The fields table.
  * @param key The field name.
- * @param[out] offset Field offset.
- * @param[out] type Field type.
- * @param[out] size Field size.
- * @param[out] nested_def Nested struct definition (if applicable).
- * @param[out] arr_len Array length (if applicable).
- * @param[out] arr_elem_type Array element type (if applicable).
- * @param[out] arr_elem_size Array element size (if applicable).
+ * @param[out] f Field descriptor to fill ('sub' is left NULL).
+ * @return 1 if the field exists, 0 otherwise.
  */
-static void get_field_info(lua_State *L, Table *fields, TString *key, int *offset, int *type, int *size, Table **nested_def, int *arr_len, int *arr_elem_type, int *arr_elem_size) {
+static int get_field_info(lua_State *L, Table *fields, TString *key, StructField *f) {
     const TValue *v = luaH_getstr(fields, key);
-    if (ttistable(v)) {
-        Table *info = hvalue(v);
+    memset(f, 0, sizeof(*f));
+    f->name = key;
+    f->type = -1;
+    if (!ttistable(v))
+        return 0;
+    Table *info = hvalue(v);
+    f->offset = get_info_int(L, info, F_OFFSET, 0);
+    f->type = get_info_int(L, info, F_TYPE, -1);
+    f->size = get_info_int(L, info, F_SIZE, 0);
+    if (f->type == ST_ARRAY) {
+        f->arr_len = get_info_int(L, info, F_LEN, 0);
+        f->arr_elem_type = get_info_int(L, info, F_ELEM_TYPE, 0);
+        f->arr_elem_size = get_info_int(L, info, F_ELEM_SIZE, 0);
+    }
+    if (f->type == ST_STRUCT || f->type == ST_ARRAY) {
+        const TValue *vd = luaH_getshortstr(info, luaS_new(L, F_DEF));
+        if (ttistable(vd)) f->def = hvalue(vd);
+    }
+    return f->type != -1;
+}
 
-        lua_pushstring(L, F_OFFSET);
-        TValue *vo = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-        if (!ttisnil(vo)) *offset = (int)ivalue(vo);
-        lua_pop(L, 1);
 
-        lua_pushstring(L, F_TYPE);
-        TValue *vt = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-        if (!ttisnil(vt)) *type = (int)ivalue(vt);
-        lua_pop(L, 1);
+/*
+** {======================================================
+** Compiled layouts
+** =======================================================
+*/
 
-        lua_pushstring(L, F_SIZE);
-        TValue *vs = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-        if (!ttisnil(vs)) *size = (int)ivalue(vs);
-        lua_pop(L, 1);
+/**
+ * @brief Returns the compiled layout of a struct definition.
+ *
+ * @param L The Lua state.
+ * @param def The struct definition table (may be NULL).
+ * @return The layout, or NULL if 'def' was not built by struct.define.
+ */
+static const StructLayout *get_layout(lua_State *L, Table *def) {
+    if (def == NULL) return NULL;
+    const TValue *v = luaH_getshortstr(def, luaS_new(L, KEY_LAYOUT));
+    if (ttisfulluserdata(v) && uvalue(v)->len >= sizeof(StructLayout)) {
+        const StructLayout *l = (const StructLayout *)getudatamem(uvalue(v));
+        if (l->owner == def) return l;
+    }
+    return NULL;
+}
 
-        if (*type == ST_STRUCT) {
-            lua_pushstring(L, F_DEF);
-            TValue *vd = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-            if (!ttisnil(vd) && ttistable(vd)) *nested_def = hvalue(vd);
-            lua_pop(L, 1);
-        } else if (*type == ST_ARRAY) {
-            lua_pushstring(L, F_LEN);
-            TValue *vl = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-            if (!ttisnil(vl)) *arr_len = (int)ivalue(vl);
-            lua_pop(L, 1);
+/**
+ * @brief Finds a field in a compiled layout.
+ *
+ * @param l The layout.
+ * @param key The field name.
+ * @return The field index, or -1 if absent.
+ */
+static int layout_find(const StructLayout *l, TString *key) {
+    if (key->tt == LUA_VSHRSTR) {
+        unsigned int h = (key->hash >> l->shift) & l->mask;
+        int i;
+        while ((i = l->slots[h]) >= 0) {
+            if (l->fields[i].name == key) return i;
+            h = (h + 1) & l->mask;
+        }
+    } else if (l->nlong > 0) {
+        for (int i = 0; i < l->nfields; i++) {
+            TString *name = l->fields[i].name;
+            if (name->tt == LUA_VLNGSTR && luaS_eqlngstr(name, key)) return i;
+        }
+    }
+    return -1;
+}
 
-            lua_pushstring(L, F_ELEM_TYPE);
-            TValue *vet = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-            if (!ttisnil(vet)) *arr_elem_type = (int)ivalue(vet);
-            lua_pop(L, 1);
+/**
+ * @brief Checks whether short-name hashes map to distinct slots.
+ *
+ * @param hs Hashes of the short field names.
+ * @param n Number of hashes.
+ * @param mask Slot mask.
+ * @param shift Hash shift.
+ * @param used Scratch array of mask+1 bytes.
+ * @return 1 if there is no collision, 0 otherwise.
+ */
+static int layout_perfect(const unsigned int *hs, int n, unsigned int mask, int shift, lu_byte *used) {
+    memset(used, 0, mask + 1);
+    for (int i = 0; i < n; i++) {
+        unsigned int h = (hs[i] >> shift) & mask;
+        if (used[h]) return 0;
+        used[h] = 1;
+    }
+    return 1;
+}
 
-            lua_pushstring(L, F_ELEM_SIZE);
-            TValue *ves = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-            if (!ttisnil(ves)) *arr_elem_size = (int)ivalue(ves);
-            lua_pop(L, 1);
+/**
+ * @brief Compiles the fields table of a definition into a StructLayout.
+ *
+ * Stores the layout under '__layout' in the definition. The layout's user
+ * value anchors the field names, nested definitions and layouts, and the
+ * GC offsets it points to.
+ *
+ * @param L The Lua state.
+ * @param def_idx Stack index of the definition table.
+ * @param fields_idx Stack index of the fields table.
+ */
+static void build_layout(lua_State *L, int def_idx, int fields_idx) {
+    Table *def = (Table *)lua_topointer(L, def_idx);
+    Table *fields = (Table *)lua_topointer(L, fields_idx);
+    int n = 0, nshort = 0, nlong = 0;
 
-            lua_pushstring(L, F_DEF);
-            TValue *vd = (TValue*)luaH_getstr(info, tsvalue(s2v(L->top.p - 1)));
-            if (!ttisnil(vd) && ttistable(vd)) *nested_def = hvalue(vd);
-            lua_pop(L, 1);
+    /* Collect field names into the anchor table */
+    lua_newtable(L);
+    int anchor_idx = lua_gettop(L);
+    lua_pushnil(L);
+    while (lua_next(L, fields_idx) != 0) {
+        lua_pop(L, 1);
+        if (lua_type(L, -1) == LUA_TSTRING) {
+            lua_pushvalue(L, -1);
+            lua_rawseti(L, anchor_idx, ++n);
+        }
+    }
+    if (n > SHRT_MAX)
+        luaL_error(L, "too many fields in struct");
+
+    /* Pick a slot count and shift that separate all short names */
+    unsigned int nslots = 4;
+    while (nslots < (unsigned int)n * 2) nslots <<= 1;
+    unsigned int *hs = (unsigned int *)malloc((n + 1) * sizeof(unsigned int) + nslots * 4);
+    if (hs == NULL)
+        luaL_error(L, "not enough memory");
+    lu_byte *used = (lu_byte *)(hs + n + 1);
+    for (int i = 1; i <= n; i++) {
+        lua_rawgeti(L, anchor_idx, i);
+        TString *name = tsvalue(s2v(L->top.p - 1));
+        if (name->tt == LUA_VSHRSTR) hs[nshort++] = name->hash;
+        else nlong++;
+        lua_pop(L, 1);
+    }
+    int shift = 0, found = 0;
+    for (unsigned int m = nslots; m <= nslots * 4 && !found; m <<= 1) {
+        for (shift = 0; shift < 32; shift++) {
+            if (layout_perfect(hs, nshort, m - 1, shift, used)) {
+                nslots = m;
+                found = 1;
+                break;
+            }
+        }
+    }
+    free(hs);
+    if (!found) shift = 0;  /* fall back to linear probing */
+
+    size_t fsize = (size_t)(n > 0 ? n : 1) * sizeof(StructField);
+    StructLayout *l = (StructLayout *)lua_newuserdatauv(L,
+            offsetof(StructLayout, fields) + fsize + nslots * sizeof(short), 1);
+    l->owner = def;
+    l->ud = uvalue(s2v(L->top.p - 1));
+    l->nfields = n;
+    l->nlong = nlong;
+    l->size = get_int_field(L, def_idx, KEY_SIZE);
+    l->mask = nslots - 1;
+    l->shift = shift;
+    l->slots = (short *)((char *)l->fields + fsize);
+    for (unsigned int j = 0; j < nslots; j++) l->slots[j] = -1;
+    get_gc_offsets(L, def, &l->gc_offsets, &l->n_gc_offsets);
+    lua_pushstring(L, KEY_GC_OFFSETS);
+    lua_rawget(L, def_idx);
+    lua_rawseti(L, anchor_idx, 2 * n + 1);  /* 'gc_offsets' points into it */
+
+    for (int i = 0; i < n; i++) {
+        StructField *f = &l->fields[i];
+        lua_rawgeti(L, anchor_idx, i + 1);
+        get_field_info(L, fields, tsvalue(s2v(L->top.p - 1)), f);
+        lua_pop(L, 1);
+        if (f->def) {
+            f->sub = get_layout(L, f->def);
+            sethvalue(L, s2v(L->top.p), f->def);
+            api_incr_top(L);
+            lua_rawseti(L, anchor_idx, n + i + 1);
+            if (f->sub) {  /* views of this field point at it */
+                setuvalue(L, s2v(L->top.p), f->sub->ud);
+                api_incr_top(L);
+                lua_rawseti(L, anchor_idx, 2 * n + 2 + i);
+            }
+        }
+        if (f->name->tt == LUA_VSHRSTR) {
+            unsigned int h = (f->name->hash >> shift) & l->mask;
+            while (l->slots[h] >= 0) h = (h + 1) & l->mask;
+            l->slots[h] = (short)i;
         }
-    } else {
-        *type = -1;
     }
+
+    lua_pushvalue(L, anchor_idx);
+    lua_setiuservalue(L, -2, 1);
+    lua_pushstring(L, KEY_LAYOUT);
+    lua_insert(L, -2);
+    lua_rawset(L, def_idx);
+    lua_pop(L, 1);  /* anchor */
 }
 
+/**
+ * @brief Returns the inline cache of a struct field instruction.
+ *
+ * The cache array is allocated on first use, one entry per instruction.
+ *
+ * @param L The Lua state.
+ * @param p The prototype running the instruction.
+ * @param pc Index of the instruction.
+ * @return The cache entry, or NULL if 'pc' is out of range.
+ */
+StructIC *luaS_structic (lua_State *L, Proto *p, int pc) {
+    if (p->structic == NULL && p->sizecode > 0) {
+        StructIC *ic = luaM_newvector(L, p->sizecode, StructIC);
+        memset(ic, 0, p->sizecode * sizeof(StructIC));
+        p->structic = ic;
+        p->sizestructic = p->sizecode;
+    }
+    if (pc < 0 || pc >= p->sizestructic) return NULL;
+    return &p->structic[pc];
+}
+
+/* }====================================================== */
+
 /**
  * @brief Copies a struct object.
  *
@@ -184,6 +356,7 @@ void luaS_copystruct (lua_State *L, TValue *dest, const TValue *src) {
         /* Source is a View -> Create a View */
         s_dest = (Struct *)luaC_newobjdt(L, LUA_TSTRUCT, offsetof(Struct, inline_data), 0);
         s_dest->def = s_src->def;
+        s_dest->layout = s_src->layout;
         s_dest->parent = s_src->parent;
         s_dest->data = s_src->data;
         s_dest->data_size = size;
@@ -193,6 +366,7 @@ void luaS_copystruct (lua_State *L, TValue *dest, const TValue *src) {
         /* Source is an Owner -> Create an Owner (Deep Copy) */
         s_dest = (Struct *)luaC_newobjdt(L, LUA_TSTRUCT, offsetof(Struct, inline_data) + size, 0);
         s_dest->def = s_src->def;
+        s_dest->layout = s_src->layout;
         s_dest->parent = NULL;
         s_dest->data = s_dest->inline_data.d;
         s_dest->data_size = size;
@@ -208,50 +382,43 @@ void luaS_copystruct (lua_State *L, TValue *dest, const TValue *src) {
 }
 
 /**
- * @brief Handles struct field access (indexing).
+ * @brief Resolves a field of a struct.
+ *
+ * Uses the compiled layout when there is one; otherwise fills 'tmp' from
+ * the definition's fields table.
  *
  * @param L The Lua state.
- * @param t The struct value.
- * @param key The field key.
- * @param val The stack slot to store the result.
+ * @param s The struct.
+ * @param key The field name.
+ * @param tmp Scratch descriptor for definitions without a layout.
+ * @param[out] idx Field index inside the layout, or -1.
+ * @return The field descriptor, or NULL if the field does not exist.
  */
-void luaS_structindex (lua_State *L, const TValue *t, TValue *key, StkId val) {
-    if (!ttisstring(key)) {
-        setnilvalue(s2v(val));
-        return;
-    }
-    Struct *s = structvalue(t);
-    Table *def = s->def;
-
-    /* Get fields table */
-    lua_pushstring(L, KEY_FIELDS);
-    const TValue *vf = luaH_getstr(def, tsvalue(s2v(L->top.p - 1)));
-    lua_pop(L, 1);
-    if (!ttistable(vf)) {
-        setnilvalue(s2v(val));
-        return;
-    }
-    Table *fields = hvalue(vf);
-
-    int offset, type, size;
-    Table *nested_def = NULL;
-    int arr_len = 0, arr_elem_type = 0, arr_elem_size = 0;
-    get_field_info(L, fields, tsvalue(key), &offset, &type, &size, &nested_def, &arr_len, &arr_elem_type, &arr_elem_size);
-
-    if (type == -1) {
-        /* Check if key exists in definition table (e.g. __size, __name) */
-        const TValue *vdef = luaH_getstr(def, tsvalue(key));
-        if (!isempty(vdef)) {
-            setobj2s(L, val, vdef);
-            return;
-        }
-        setnilvalue(s2v(val));
-        return;
+static const StructField *find_field(lua_State *L, Struct *s, TString *key, StructField *tmp, int *idx) {
+    const StructLayout *l = s->layout;
+    *idx = -1;
+    if (l != NULL) {
+        *idx = layout_find(l, key);
+        return (*idx >= 0) ? &l->fields[*idx] : NULL;
     }
+    const TValue *vf = luaH_getshortstr(s->def, luaS_new(L, KEY_FIELDS));
+    if (!ttistable(vf) || !get_field_info(L, hvalue(vf), key, tmp))
+        return NULL;
+    return tmp;
+}
 
-    lu_byte *p = s->data + offset;
+/**
+ * @brief Reads a struct field into a stack slot.
+ *
+ * @param L The Lua state.
+ * @param s The struct.
+ * @param f The field descriptor.
+ * @param val The stack slot to store the result.
+ */
+static void read_field(lua_State *L, Struct *s, const StructField *f, StkId val) {
+    lu_byte *p = s->data + f->offset;
 
-    switch (type) {
+    switch (f->type) {
         case ST_INT: {
             lua_Integer i;
             memcpy(&i, p, sizeof(i));
@@ -276,14 +443,20 @@ void luaS_structindex (lua_State *L, const TValue *t, TValue *key, StkId val) {
             v->value_.struct_ = new_s;
             v->tt_ = ctb(LUA_VSTRUCT);
 
-            new_s->def = nested_def;
-            new_s->data_size = size;
+            new_s->def = f->def;
+            new_s->layout = f->sub;
+            new_s->data_size = f->size;
             new_s->parent = obj2gco(s);
             new_s->data = p;
             new_s->gc_offsets = NULL; /* Init before call */
             new_s->n_gc_offsets = 0;
 
-            get_gc_offsets(L, nested_def, &new_s->gc_offsets, &new_s->n_gc_offsets);
+            if (f->sub) {
+                new_s->gc_offsets = f->sub->gc_offsets;
+                new_s->n_gc_offsets = f->sub->n_gc_offsets;
+            } else {
+                get_gc_offsets(L, f->def, &new_s->gc_offsets, &new_s->n_gc_offsets);
+            }
 
             checkliveness(L, v);
             break;
@@ -309,10 +482,10 @@ void luaS_structindex (lua_State *L, const TValue *t, TValue *key, StkId val) {
             /* Restore val */
             val = restorestack(L, val_off);
 
-            arr->len = arr_len;
-            arr->size = arr_elem_size;
-            arr->type = arr_elem_type;
-            arr->def = nested_def;
+            arr->len = f->arr_len;
+            arr->size = f->arr_elem_size;
+            arr->type = f->arr_elem_type;
+            arr->def = f->def;
             arr->data = p; /* Point to struct data */
 
             /* Set metatable */
@@ -341,48 +514,23 @@ void luaS_structindex (lua_State *L, const TValue *t, TValue *key, StkId val) {
 }
 
 /**
- * @brief Handles struct field assignment (newindex).
+ * @brief Writes a value into a struct field.
  *
  * @param L The Lua state.
- * @param t The struct value.
- * @param key The field key.
+ * @param s The struct.
+ * @param f The field descriptor.
  * @param val The value to assign.
  */
-void luaS_structnewindex (lua_State *L, const TValue *t, TValue *key, TValue *val) {
-    if (!ttisstring(key)) {
-        luaG_runerror(L, "struct key must be string");
-        return;
-    }
-    Struct *s = structvalue(t);
-    Table *def = s->def;
-
-    lua_pushstring(L, KEY_FIELDS);
-    const TValue *vf = luaH_getstr(def, tsvalue(s2v(L->top.p - 1)));
-    lua_pop(L, 1);
-    if (!ttistable(vf)) {
-        luaG_runerror(L, "invalid struct definition");
-        return;
-    }
-    Table *fields = hvalue(vf);
-
-    int offset, type, size;
-    Table *nested_def = NULL;
-    int arr_len = 0, arr_elem_type = 0, arr_elem_size = 0;
-    get_field_info(L, fields, tsvalue(key), &offset, &type, &size, &nested_def, &arr_len, &arr_elem_type, &arr_elem_size);
+static void write_field(lua_State *L, Struct *s, const StructField *f, TValue *val) {
+    lu_byte *p = s->data + f->offset;
+    const char *fname = getstr(f->name);
 
-    if (type == -1) {
-        luaG_runerror(L, "field '%s' does not exist in struct", getstr(tsvalue(key)));
-        return;
-    }
-
-    lu_byte *p = s->data + offset;
-
-    switch (type) {
+    switch (f->type) {
         case ST_INT: {
             lua_Integer i;
             if (!ttisinteger(val)) {
                 if (!luaV_tointeger(val, &i, 0)) {
-                     luaG_runerror(L, "expected integer for field '%s'", getstr(tsvalue(key)));
+                     luaG_runerror(L, "expected integer for field '%s'", fname);
                 }
             } else {
                 i = ivalue(val);
@@ -393,7 +541,7 @@ void luaS_structnewindex (lua_State *L, const TValue *t, TValue *key, TValue *va
         case ST_FLOAT: {
             lua_Number n;
             if (!tonumber(val, &n)) {
-                luaG_runerror(L, "expected number for field '%s'", getstr(tsvalue(key)));
+                luaG_runerror(L, "expected number for field '%s'", fname);
             }
             memcpy(p, &n, sizeof(n));
             break;
@@ -403,18 +551,18 @@ void luaS_structnewindex (lua_State *L, const TValue *t, TValue *key, TValue *va
             break;
         case ST_STRUCT: {
             if (!ttisstruct(val)) {
-                luaG_runerror(L, "expected struct for field '%s'", getstr(tsvalue(key)));
+                luaG_runerror(L, "expected struct for field '%s'", fname);
             }
             Struct *s_val = structvalue(val);
-            if (s_val->def != nested_def) {
-                 luaG_runerror(L, "struct type mismatch for field '%s'", getstr(tsvalue(key)));
+            if (s_val->def != f->def) {
+                 luaG_runerror(L, "struct type mismatch for field '%s'", fname);
             }
-            memcpy(p, s_val->data, size);
+            memcpy(p, s_val->data, f->size);
             break;
         }
         case ST_STRING: {
             if (!ttisstring(val)) {
-                luaG_runerror(L, "expected string for field '%s'", getstr(tsvalue(key)));
+                luaG_runerror(L, "expected string for field '%s'", fname);
             }
             TString *ts = tsvalue(val);
             memcpy(p, &ts, sizeof(TString *));
@@ -422,22 +570,112 @@ void luaS_structnewindex (lua_State *L, const TValue *t, TValue *key, TValue *va
         }
         case ST_ARRAY: {
             if (!ttisfulluserdata(val)) {
-                luaG_runerror(L, "expected array for field '%s'", getstr(tsvalue(key)));
+                luaG_runerror(L, "expected array for field '%s'", fname);
             }
             Array *arr = (Array *)getudatamem(uvalue(val));
             /* Check compatibility */
-            if (arr->len != arr_len || arr->size != arr_elem_size || arr->type != arr_elem_type) {
-                luaG_runerror(L, "array type/size mismatch for field '%s'", getstr(tsvalue(key)));
+            if (arr->len != (size_t)f->arr_len || arr->size != (size_t)f->arr_elem_size || arr->type != f->arr_elem_type) {
+                luaG_runerror(L, "array type/size mismatch for field '%s'", fname);
             }
-            if (arr->type == ST_STRUCT && arr->def != nested_def) {
-                luaG_runerror(L, "array struct type mismatch for field '%s'", getstr(tsvalue(key)));
+            if (arr->type == ST_STRUCT && arr->def != f->def) {
+                luaG_runerror(L, "array struct type mismatch for field '%s'", fname);
             }
-            memcpy(p, arr->data, size); /* Copy entire array data */
+            memcpy(p, arr->data, f->size); /* Copy entire array data */
             break;
         }
     }
 }
 
+/**
+ * @brief Reads a struct field, filling an inline cache on success.
+ *
+ * @param L The Lua state.
+ * @param t The struct value.
+ * @param key The field key.
+ * @param val The stack slot to store the result.
+ * @param ic Inline cache of the calling instruction (may be NULL).
+ */
+void luaS_structget (lua_State *L, const TValue *t, TValue *key, StkId val, StructIC *ic) {
+    if (!ttisstring(key)) {
+        setnilvalue(s2v(val));
+        return;
+    }
+    Struct *s = structvalue(t);
+    StructField tmp;
+    int idx;
+    const StructField *f = find_field(L, s, tsvalue(key), &tmp, &idx);
+
+    if (f == NULL) {
+        /* Check if key exists in definition table (e.g. __size, __name) */
+        const TValue *vdef = luaH_getstr(s->def, tsvalue(key));
+        if (!isempty(vdef)) {
+            setobj2s(L, val, vdef);
+            return;
+        }
+        setnilvalue(s2v(val));
+        return;
+    }
+    if (ic != NULL && idx >= 0) {
+        ic->layout = s->layout;
+        ic->field = idx;
+    }
+    read_field(L, s, f, val);
+}
+
+/**
+ * @brief Writes a struct field, filling an inline cache on success.
+ *
+ * @param L The Lua state.
+ * @param t The struct value.
+ * @param key The field key.
+ * @param val The value to assign.
+ * @param ic Inline cache of the calling instruction (may be NULL).
+ */
+void luaS_structset (lua_State *L, const TValue *t, TValue *key, TValue *val, StructIC *ic) {
+    if (!ttisstring(key)) {
+        luaG_runerror(L, "struct key must be string");
+        return;
+    }
+    Struct *s = structvalue(t);
+    StructField tmp;
+    int idx;
+    const StructField *f = find_field(L, s, tsvalue(key), &tmp, &idx);
+
+    if (f == NULL) {
+        luaG_runerror(L, "field '%s' does not exist in struct", getstr(tsvalue(key)));
+        return;
+    }
+    if (ic != NULL && idx >= 0) {
+        ic->layout = s->layout;
+        ic->field = idx;
+    }
+    write_field(L, s, f, val);
+}
+
+/**
+ * @brief Handles struct field access (indexing).
+ *
+ * @param L The Lua state.
+ * @param t The struct value.
+ * @param key The field key.
+ * @param val The stack slot to store the result.
+ */
+void luaS_structindex (lua_State *L, const TValue *t, TValue *key, StkId val) {
+    luaS_structget(L, t, key, val, NULL);
+}
+
+/**
+ * @brief Handles struct field assignment (newindex).
+ *
+ * @param L The Lua state.
+ * @param t The struct value.
+ * @param key The field key.
+ * @param val The value to assign.
+ */
+void luaS_structnewindex (lua_State *L, const TValue *t, TValue *key, TValue *val) {
+    luaS_structset(L, t, key, val, NULL);
+}
+
 /**
  * @brief Checks if two struct objects are equal.
  *
@@ -481,6 +719,7 @@ static int struct_call (lua_State *L) {
     api_incr_top(L);
 
     s->def = def;
+    s->layout = NULL;
     s->data_size = size;
     s->parent = NULL;
     s->gc_offsets = NULL; /* Init to NULL before calling function that might GC */
@@ -488,8 +727,14 @@ static int struct_call (lua_State *L) {
     s->data = s->inline_data.d;
     memset(s->data, 0, size);
 
-    /* Get GC offsets (might trigger GC) */
-    get_gc_offsets(L, def, &s->gc_offsets, &s->n_gc_offsets);
+    /* Get layout and GC offsets (might trigger GC) */
+    s->layout = get_layout(L, def);
+    if (s->layout) {
+        s->gc_offsets = s->layout->gc_offsets;
+        s->n_gc_offsets = s->layout->n_gc_offsets;
+    } else {
+        get_gc_offsets(L, def, &s->gc_offsets, &s->n_gc_offsets);
+    }
 
     /* Initialize with defaults */
     lua_pushstring(L, KEY_FIELDS);
@@ -812,6 +1057,8 @@ static int struct_define (lua_State *L) {
     }
     if (gc_offsets_arr) free(gc_offsets_arr);
 
+    build_layout(L, def_idx, fields_idx);
+
     lua_pop(L, 1); /* Pop fields table */
 
     /* Set metatable for Def */
@@ -880,6 +1127,7 @@ static int array_index(lua_State *L) {
             /* Retrieve GC offsets first to avoid GC while struct is uninitialized */
             int *gc_offsets = NULL;
             int n_gc_offsets = 0;
+            const StructLayout *layout = get_layout(L, arr->def);
             get_gc_offsets(L, arr->def, &gc_offsets, &n_gc_offsets);
 
             /* Retrieve parent from array uservalue (anchored there by luaS_structindex) */
@@ -902,6 +1150,7 @@ static int array_index(lua_State *L) {
             /* L->top does not change, we replaced the value */
 
             s->def = arr->def;
+            s->layout = layout;
             s->data_size = arr->size;
             s->gc_offsets = gc_offsets;
             s->n_gc_offsets = n_gc_offsets;
@@ -1061,7 +1310,7 @@ static int safe_array_index(lua_State *L) {
     lua_pop(L, 1);
     int idx = (int)luaL_checkinteger(L, 2);
 
-    l_rwlock_rdlock(&h->lock);
+    l_rwlock_t *hlk = luaH_rdlock(h);
     const TValue *res = luaH_getint(h, idx);
 
     if (!ttisnil(res) && ttisstruct(res)) {
@@ -1072,16 +1321,18 @@ static int safe_array_index(lua_State *L) {
         L->top.p++;
 
         Table *def = s->def;
+        const StructLayout *layout = s->layout;
         size_t size = s->data_size;
         int *gc_offsets = s->gc_offsets;
         int n_gc_offsets = s->n_gc_offsets;
         GCObject *parent = obj2gco(s);
         lu_byte *data = s->data;
-        l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
 
         /* Create View */
         Struct *new_s = (Struct *)luaC_newobjdt(L, LUA_TSTRUCT, offsetof(Struct, inline_data), 0);
         new_s->def = def;
+        new_s->layout = layout;
         new_s->data_size = size;
         new_s->gc_offsets = gc_offsets;
         new_s->n_gc_offsets = n_gc_offsets;
@@ -1097,7 +1348,7 @@ static int safe_array_index(lua_State *L) {
         api_incr_top(L);
         return 1;
     }
-    l_rwlock_unlock(&h->lock);
+    luaH_unlock(hlk);
     lua_pushnil(L);
     return 1;
 }
@@ -1147,6 +1398,7 @@ static int create_safe_struct_array(lua_State *L, int def_idx, int count) {
     int *gc_offsets;
     int n_gc_offsets;
     get_gc_offsets(L, (Table*)lua_topointer(L, def_idx), &gc_offsets, &n_gc_offsets);
+    const StructLayout *layout = get_layout(L, (Table*)lua_topointer(L, def_idx));
 
     lua_pop(L, 1); /* pop def */
 
@@ -1157,6 +1409,7 @@ static int create_safe_struct_array(lua_State *L, int def_idx, int count) {
     for (int i = 1; i <= count; i++) {
         Struct *s = (Struct *)luaC_newobjdt(L, LUA_TSTRUCT, offsetof(Struct, inline_data) + size, 0);
         s->def = (Table*)lua_topointer(L, def_idx);
+        s->layout = layout;
         s->data_size = size;
         s->gc_offsets = gc_offsets;
         s->n_gc_offsets = n_gc_offsets;
@@ -9,10 +9,81 @@
 #include "lua.h"
 #include "lobject.h"
 
+/* Field types */
+#define ST_INT 0
+#define ST_FLOAT 1
+#define ST_BOOL 2
+#define ST_STRUCT 3
+#define ST_STRING 4
+#define ST_ARRAY 5
+
+
+/**
+ * @brief One field of a compiled struct layout.
+ */
+typedef struct StructField {
+  TString *name;        /**< Field name. */
+  int offset;           /**< Byte offset inside the data block. */
+  int type;             /**< Field type (ST_INT, ST_FLOAT, ...). */
+  int size;             /**< Field size in bytes. */
+  int arr_len;          /**< Array length (ST_ARRAY only). */
+  int arr_elem_type;    /**< Array element type (ST_ARRAY only). */
+  int arr_elem_size;    /**< Array element size (ST_ARRAY only). */
+  struct Table *def;    /**< Nested struct or array element definition. */
+  const struct StructLayout *sub;  /**< Layout of 'def', if any. */
+} StructField;
+
+
+/**
+ * @brief Compiled layout of a struct definition.
+ *
+ * Built once by struct.define and stored as a userdata under '__layout'
+ * in the definition table. Every struct using the layout marks 'ud', so
+ * clearing '__layout' does not free it under live instances. Field names are found through a hash table of
+ * field indices keyed on the string hash; 'shift' is chosen so that short
+ * names land in distinct slots whenever possible.
+ */
+typedef struct StructLayout {
+  struct Table *owner;  /**< Definition this layout was compiled from. */
+  struct Udata *ud;     /**< Userdata holding this layout. */
+  int nfields;          /**< Number of fields. */
+  int nlong;            /**< Number of fields with long-string names. */
+  int size;             /**< Size of the data block. */
+  unsigned int mask;    /**< Size of 'slots' minus one. */
+  int shift;            /**< Hash shift applied before masking. */
+  int *gc_offsets;      /**< GC offsets (owned by the definition). */
+  int n_gc_offsets;     /**< Number of GC offsets. */
+  short *slots;         /**< Field index per slot, -1 if empty. */
+  StructField fields[1];  /**< Field descriptors. */
+} StructLayout;
+
+
+/**
+ * @brief Per-instruction inline cache for struct field access.
+ */
+typedef struct StructIC {
+  const StructLayout *layout;  /**< Layout seen last, NULL if unused. */
+  int field;                   /**< Field index inside 'layout'. */
+} StructIC;
+
+
+/*
+** Field cached in 'ic' for struct 's' and constant key 'k', or NULL
+** when the cache misses.
+*/
+#define luaS_icfield(ic,s,k) \
+  ((ic)->layout == (s)->layout && (ic)->layout != NULL && \
+   (ic)->field < (ic)->layout->nfields && \
+   (ic)->layout->fields[(ic)->field].name == (k) \
+     ? &(ic)->layout->fields[(ic)->field] : NULL)
+
 LUAI_FUNC void luaS_copystruct (lua_State *L, TValue *dest, const TValue *src);
 LUAI_FUNC int luaopen_struct (lua_State *L);
 LUAI_FUNC void luaS_structindex (lua_State *L, const TValue *t, TValue *key, StkId val);
 LUAI_FUNC void luaS_structnewindex (lua_State *L, const TValue *t, TValue *key, TValue *val);
+LUAI_FUNC StructIC *luaS_structic (lua_State *L, Proto *p, int pc);
+LUAI_FUNC void luaS_structget (lua_State *L, const TValue *t, TValue *key, StkId val, StructIC *ic);
+LUAI_FUNC void luaS_structset (lua_State *L, const TValue *t, TValue *key, TValue *val, StructIC *ic);
 LUAI_FUNC int luaS_structeq (const TValue *t1, const TValue *t2);
 
 #endif
@@ -15,6 +15,14 @@
 #include "lvm.h"
 #include "ldebug.h"
 
+/*
+** Members live in 'data' as key/value pairs and are found through
+** 'index', an open-addressing (linear probing) hash of their positions
+** kept at most half full. 'data' is only put in key order when a
+** traversal needs it, so building a superstruct costs one hash insert
+** per member plus a single sort.
+*/
+
 static int super_compare(const TValue *k1, const TValue *k2) {
   int t1 = ttype(k1);
   int t2 = ttype(k2);
@@ -36,8 +44,13 @@ static int super_compare(const TValue *k1, const TValue *k2) {
         return (n1 < n2) ? -1 : (n1 > n2 ? 1 : 0);
     }
     case LUA_TSTRING: {
+        if (tsvalue(k1) == tsvalue(k2)) return 0;
         return strcmp(getstr(tsvalue(k1)), getstr(tsvalue(k2)));
     }
+    case LUA_TLIGHTUSERDATA: {
+        void *p1 = pvalue(k1), *p2 = pvalue(k2);
+        return (p1 < p2) ? -1 : (p1 > p2 ? 1 : 0);
+    }
     default: {
         if (iscollectable(k1)) {
              return (gcvalue(k1) < gcvalue(k2)) ? -1 : ((gcvalue(k1) > gcvalue(k2)) ? 1 : 0);
@@ -48,88 +61,175 @@ static int super_compare(const TValue *k1, const TValue *k2) {
   return 0;
 }
 
+
+/* keys are equal as raw table keys; short strings compare by address */
+static int super_equal (const TValue *k1, const TValue *k2) {
+  if (ttisshrstring(k1))
+    return ttisshrstring(k2) && tsvalue(k1) == tsvalue(k2);
+  return luaV_rawequalobj(k1, k2);
+}
+
+
+static unsigned int super_hash (const TValue *key) {
+  switch (ttypetag(key)) {
+    case LUA_VSHRSTR: return tsvalue(key)->hash;
+    case LUA_VLNGSTR: return luaS_hashlongstr(tsvalue(key));
+    case LUA_VNUMINT: {
+      lua_Unsigned u = l_castS2U(ivalue(key));
+      return cast_uint(u ^ (u >> 32)) * 2654435761u;
+    }
+    case LUA_VNUMFLT: {
+      lua_Integer i;
+      lua_Number n = fltvalue(key);
+      lua_Unsigned u;
+      if (luaV_flttointeger(n, &i, F2Ieq)) {  /* same hash as the integer */
+        u = l_castS2U(i);
+        return cast_uint(u ^ (u >> 32)) * 2654435761u;
+      }
+      memcpy(&u, &n, sizeof(u) < sizeof(n) ? sizeof(u) : sizeof(n));
+      return cast_uint(u ^ (u >> 32));
+    }
+    case LUA_VFALSE: return 1;
+    case LUA_VTRUE: return 2;
+    case LUA_VLIGHTUSERDATA: return point2uint(pvalue(key)) * 2654435761u;
+    case LUA_VLCF: return point2uint(cast_voidp(fvalue(key))) * 2654435761u;
+    default:
+      return iscollectable(key) ? point2uint(gcvalue(key)) * 2654435761u : 0;
+  }
+}
+
+
+#define pairkey(ss,p)	(&(ss)->data[(p) * 2])
+
+#define indexmask(ss)	((ss)->sizeindex - 1)
+
+
+/* slot of 'index' holding 'key', or the empty slot where it would go */
+static unsigned int *findslot (const SuperStruct *ss, const TValue *key) {
+  unsigned int i = super_hash(key) & indexmask(ss);
+  for (;;) {
+    unsigned int p = ss->index[i];
+    if (p == 0 || super_equal(pairkey(ss, p - 1), key))
+      return &ss->index[i];
+    i = (i + 1) & indexmask(ss);
+  }
+}
+
+
+static void rebuildindex (SuperStruct *ss) {
+  unsigned int p;
+  memset(ss->index, 0, ss->sizeindex * sizeof(unsigned int));
+  for (p = 0; p < ss->nsize; p++)
+    *findslot(ss, pairkey(ss, p)) = p + 1;
+}
+
+
+/* remove slot 'i' of 'index', moving back later entries of its cluster */
+static void delslot (SuperStruct *ss, unsigned int i) {
+  unsigned int j = i;
+  for (;;) {
+    unsigned int p, home;
+    j = (j + 1) & indexmask(ss);
+    p = ss->index[j];
+    if (p == 0)
+      break;
+    home = super_hash(pairkey(ss, p - 1)) & indexmask(ss);
+    if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+      continue;  /* entry is still reachable from its home slot */
+    ss->index[i] = p;
+    i = j;
+  }
+  ss->index[i] = 0;
+}
+
+
+static void growsuperstruct (lua_State *L, SuperStruct *ss) {
+  unsigned int oldcapacity = ss->ncapacity;
+  unsigned int newcapacity = oldcapacity > 0 ? oldcapacity * 2 : 4;
+  unsigned int *newindex;
+  ss->data = luaM_reallocvector(L, ss->data, oldcapacity * 2, newcapacity * 2, TValue);
+  ss->ncapacity = newcapacity;
+  newindex = luaM_newvector(L, newcapacity * 2, unsigned int);
+  luaM_freearray(L, ss->index, ss->sizeindex);
+  ss->index = newindex;
+  ss->sizeindex = newcapacity * 2;
+  rebuildindex(ss);
+}
+
+
 SuperStruct *luaS_newsuperstruct (lua_State *L, TString *name, unsigned int size) {
   SuperStruct *ss = (SuperStruct *)luaC_newobj(L, LUA_TSUPERSTRUCT, sizeof(SuperStruct));
+  unsigned int capacity = 4;
+  while (capacity < size) capacity *= 2;
   ss->name = name;
+  ss->sorted = 1;
   ss->nsize = 0;
-  ss->ncapacity = size > 0 ? size : 4;
-  ss->data = luaM_newvector(L, ss->ncapacity * 2, TValue);
+  ss->ncapacity = 0;
+  ss->data = NULL;
+  ss->index = NULL;
+  ss->sizeindex = 0;
+  ss->data = luaM_newvector(L, capacity * 2, TValue);
+  ss->ncapacity = capacity;
+  ss->index = luaM_newvector(L, capacity * 2, unsigned int);
+  ss->sizeindex = capacity * 2;
+  rebuildindex(ss);
   return ss;
 }
 
 void luaS_freesuperstruct (lua_State *L, SuperStruct *ss) {
   if (ss->data)
     luaM_freearray(L, ss->data, ss->ncapacity * 2);
+  if (ss->index)
+    luaM_freearray(L, ss->index, ss->sizeindex);
   luaM_free(L, ss);
 }
 
 void luaS_setsuperstruct (lua_State *L, SuperStruct *ss, TValue *key, TValue *val) {
-  int left = 0;
-  int right = ss->nsize - 1;
-  int mid;
-  int cmp;
-
-  if (ss->data) {
-    while (left <= right) {
-      mid = left + (right - left) / 2;
-      TValue *k = &ss->data[mid * 2];
-      cmp = super_compare(key, k);
-      if (cmp == 0) {
-        /* Found */
-        if (ttisnil(val)) {
-           /* Delete by shifting */
-           int nmove = ss->nsize - 1 - mid;
-           if (nmove > 0) {
-              memmove(&ss->data[mid * 2], &ss->data[(mid + 1) * 2], nmove * 2 * sizeof(TValue));
-           }
-           ss->nsize--;
-           /* Optional: shrink capacity if too small? */
-        } else {
-           setobj2t(L, &ss->data[mid * 2 + 1], val);
-        }
-        return;
-      }
-      if (cmp < 0) {
-        right = mid - 1;
-      } else {
-        left = mid + 1;
+  unsigned int *slot = findslot(ss, key);
+  unsigned int p = *slot;
+
+  if (p != 0) {  /* found */
+    if (ttisnil(val)) {
+      /* Delete: the last pair fills the hole */
+      unsigned int last = ss->nsize - 1;
+      delslot(ss, cast_uint(slot - ss->index));
+      if (p - 1 != last) {
+        setobj2t(L, &ss->data[(p - 1) * 2], &ss->data[last * 2]);
+        setobj2t(L, &ss->data[(p - 1) * 2 + 1], &ss->data[last * 2 + 1]);
+        *findslot(ss, pairkey(ss, p - 1)) = p;
+        ss->sorted = 0;
       }
+      ss->nsize--;
+    } else {
+      setobj2t(L, &ss->data[(p - 1) * 2 + 1], val);
+      luaC_barrier(L, ss, val);
     }
+    return;
   }
 
-  /* Not found, insert at 'left' */
+  /* Not found, append */
   if (ttisnil(val)) return;
+  if (ttisfloat(key) && luai_numisnan(fltvalue(key)))
+    luaG_runerror(L, "index is NaN");
 
   if (ss->nsize >= ss->ncapacity) {
-    unsigned int oldcapacity = ss->ncapacity;
-    unsigned int newcapacity = oldcapacity > 0 ? oldcapacity * 2 : 4;
-    ss->data = luaM_reallocvector(L, ss->data, oldcapacity * 2, newcapacity * 2, TValue);
-    ss->ncapacity = newcapacity;
-  }
-
-  /* Shift to right */
-  int nmove = ss->nsize - left;
-  if (nmove > 0) {
-    memmove(&ss->data[(left + 1) * 2], &ss->data[left * 2], nmove * 2 * sizeof(TValue));
+    growsuperstruct(L, ss);
+    slot = findslot(ss, key);
   }
 
-  setobj2t(L, &ss->data[left * 2], key);
-  setobj2t(L, &ss->data[left * 2 + 1], val);
-  ss->nsize++;
+  p = ss->nsize++;
+  setobj2t(L, &ss->data[p * 2], key);
+  setobj2t(L, &ss->data[p * 2 + 1], val);
+  *slot = p + 1;
+  if (p > 0 && super_compare(pairkey(ss, p - 1), key) > 0)
+    ss->sorted = 0;
+  luaC_barrier(L, ss, key);
+  luaC_barrier(L, ss, val);
 }
 
 const TValue *luaS_getsuperstruct (SuperStruct *ss, TValue *key) {
-  int left = 0;
-  int right = ss->nsize - 1;
-  while (left <= right) {
-    int mid = left + (right - left) / 2;
-    TValue *k = &ss->data[mid * 2];
-    int cmp = super_compare(key, k);
-    if (cmp == 0) return &ss->data[mid * 2 + 1];
-    if (cmp < 0) right = mid - 1;
-    else left = mid + 1;
-  }
-  return NULL;
+  unsigned int p = *findslot(ss, key);
+  return (p != 0) ? &ss->data[(p - 1) * 2 + 1] : NULL;
 }
 
 const TValue *luaS_getsuperstruct_str (SuperStruct *ss, TString *key) {
@@ -138,31 +238,60 @@ const TValue *luaS_getsuperstruct_str (SuperStruct *ss, TString *key) {
   return luaS_getsuperstruct(ss, &k);
 }
 
+
+/* merge the sorted runs src[lo..mid) and src[mid..hi) of pairs into dst */
+static void mergepairs (const TValue *src, TValue *dst, unsigned int lo,
+                        unsigned int mid, unsigned int hi) {
+  unsigned int i = lo, j = mid, k = lo;
+  while (i < mid && j < hi) {
+    unsigned int from = (super_compare(&src[j * 2], &src[i * 2]) < 0) ? j++ : i++;
+    memcpy(&dst[k++ * 2], &src[from * 2], 2 * sizeof(TValue));
+  }
+  if (i < mid)
+    memcpy(&dst[k * 2], &src[i * 2], (mid - i) * 2 * sizeof(TValue));
+  else if (j < hi)
+    memcpy(&dst[k * 2], &src[j * 2], (hi - j) * 2 * sizeof(TValue));
+}
+
+
+/* put 'data' in key order (bottom-up merge sort) and reindex it */
+static void sortsuperstruct (lua_State *L, SuperStruct *ss) {
+  unsigned int n = ss->nsize, w;
+  TValue *tmp, *src, *dst;
+  if (n < 2) {
+    ss->sorted = 1;
+    return;
+  }
+  tmp = luaM_newvector(L, n * 2, TValue);
+  src = ss->data;
+  dst = tmp;
+  for (w = 1; w < n; w *= 2) {
+    unsigned int lo;
+    for (lo = 0; lo < n; lo += 2 * w) {
+      unsigned int mid = (lo + w < n) ? lo + w : n;
+      unsigned int hi = (lo + 2 * w < n) ? lo + 2 * w : n;
+      mergepairs(src, dst, lo, mid, hi);
+    }
+    { TValue *t = src; src = dst; dst = t; }
+  }
+  if (src != ss->data)
+    memcpy(ss->data, src, n * 2 * sizeof(TValue));
+  luaM_freearray(L, tmp, n * 2);
+  rebuildindex(ss);
+  ss->sorted = 1;
+}
+
+
 int luaS_next (lua_State *L, SuperStruct *ss, StkId key) {
   unsigned int i = 0;
+  if (!ss->sorted)
+    sortsuperstruct(L, ss);
   if (!ttisnil(s2v(key))) {
-    /* Binary search for key */
-    int left = 0;
-    int right = ss->nsize - 1;
-    int mid;
-    int cmp;
-    int found = 0;
-
-    while (left <= right) {
-      mid = left + (right - left) / 2;
-      TValue *k = &ss->data[mid * 2];
-      cmp = super_compare(s2v(key), k);
-      if (cmp == 0) {
-        i = mid + 1;
-        found = 1;
-        break;
-      }
-      if (cmp < 0) right = mid - 1;
-      else left = mid + 1;
-    }
-    if (!found) {
+    unsigned int p = *findslot(ss, s2v(key));
+    if (p == 0) {
       luaG_runerror(L, "invalid key to 'next'");
     }
+    i = p;  /* position after the key */
   }
 
   if (i < ss->nsize) {
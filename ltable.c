@@ -29,6 +29,7 @@
 #include <limits.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 
 #include "lua.h"
@@ -48,6 +49,8 @@
 ** Table access interception functionality
 */
 static int table_access_enabled = 0;
+static int table_access_async = 0;  /* use the ring-buffer backend? */
+static int table_access_binary = 0;  /* async backend writes binary records? */
 static FILE *table_access_log = NULL;
 static char table_access_log_path[512] = {0};
 
@@ -392,7 +395,8 @@ static void open_table_access_log(void) {
              "/sdcard/XCLUA/hackv/table_access_%s.log", timestamp);
   }
   
-  table_access_log = fopen(table_access_log_path, "a");
+  table_access_log = fopen(table_access_log_path,
+                           (table_access_async && table_access_binary) ? "ab" : "a");
 }
 
 static void close_table_access_log(void) {
@@ -452,6 +456,281 @@ static const char* get_value_type_name(int value_tag) {
   }
 }
 
+
+/*
+** {======================================================
+** Asynchronous access log
+**
+** Producers (table get/set) only fill a fixed-size binary record and
+** push it into a bounded lock-free ring (Vyukov MPMC queue, used here
+** with a single consumer). A background writer thread drains the ring
+** to the log file; records that do not fit are counted as dropped.
+** =======================================================
+*/
+
+#define ALOG_OP_GET	0
+#define ALOG_OP_SET	1
+
+#define ALOG_KEYPREFIX	20
+#define ALOG_DEFCAPACITY	65536
+#define ALOG_MAGIC	"LXTLOG1"
+
+/* what a binary log file stores per access */
+typedef struct AccessRecord {
+  unsigned long long tick;  /* timestamp counter (see 'alog_tick') */
+  unsigned long long table;  /* table address */
+  unsigned long long key;  /* integer key, float bits or string hash */
+  lu_byte op;  /* ALOG_OP_GET or ALOG_OP_SET */
+  lu_byte keytag;  /* variant tag of the key */
+  lu_byte valtag;  /* variant tag of the value (LUA_VABSTKEY if absent) */
+  lu_byte keylen;  /* bytes used in 'keystr' */
+  char keystr[ALOG_KEYPREFIX];  /* prefix of a string key */
+} AccessRecord;
+
+typedef struct AccessSlot {
+  atomic_size_t seq;
+  AccessRecord rec;
+} AccessSlot;
+
+static size_t alog_capacity = ALOG_DEFCAPACITY;
+static AccessSlot *alog_ring = NULL;
+static size_t alog_mask = 0;
+static atomic_size_t alog_head;
+static size_t alog_tail = 0;  /* owned by the writer thread */
+static atomic_size_t alog_recorded;
+static atomic_size_t alog_dropped;
+static atomic_size_t alog_written;
+static atomic_int alog_stop;
+static l_thread_t alog_writer;
+static int alog_running = 0;
+
+
+/* raw timestamp counter: TSC cycles on x86, nanoseconds elsewhere */
+static unsigned long long alog_tick (void) {
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  return __builtin_ia32_rdtsc();
+#elif defined(LUA_USE_WINDOWS)
+  LARGE_INTEGER c, f;
+  QueryPerformanceCounter(&c);
+  QueryPerformanceFrequency(&f);
+  return (unsigned long long)(c.QuadPart * (1000000000.0 / f.QuadPart));
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+
+static void alog_push (const AccessRecord *r) {
+  size_t pos = atomic_load_explicit(&alog_head, memory_order_relaxed);
+  AccessSlot *slot;
+  for (;;) {
+    size_t seq;
+    slot = &alog_ring[pos & alog_mask];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq == pos) {
+      if (atomic_compare_exchange_weak_explicit(&alog_head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    }
+    else if ((ptrdiff_t)(seq - pos) < 0) {  /* full */
+      atomic_fetch_add_explicit(&alog_dropped, 1, memory_order_relaxed);
+      return;
+    }
+    else
+      pos = atomic_load_explicit(&alog_head, memory_order_relaxed);
+  }
+  slot->rec = *r;
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+  atomic_fetch_add_explicit(&alog_recorded, 1, memory_order_relaxed);
+}
+
+
+static int alog_pop (AccessRecord *r) {
+  AccessSlot *slot = &alog_ring[alog_tail & alog_mask];
+  size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (seq != alog_tail + 1)
+    return 0;  /* empty */
+  *r = slot->rec;
+  atomic_store_explicit(&slot->seq, alog_tail + alog_mask + 1,
+                        memory_order_release);
+  alog_tail++;
+  return 1;
+}
+
+
+static void alog_record (const TValue *key, const TValue *value, int op,
+                         const Table *t) {
+  AccessRecord r;
+  memset(&r, 0, sizeof(r));  /* binary logs dump padding and keystr tail */
+  r.tick = alog_tick();
+  r.table = (unsigned long long)(size_t)t;
+  r.op = cast_byte(op);
+  r.keytag = cast_byte(ttypetag(key));
+  r.valtag = (value == NULL || isabstkey(value)) ? LUA_VABSTKEY
+                                                 : cast_byte(ttypetag(value));
+  switch (r.keytag) {
+    case LUA_VSHRSTR: case LUA_VLNGSTR: {
+      TString *ts = tsvalue(key);
+      size_t len = tsslen(ts);
+      r.key = (r.keytag == LUA_VSHRSTR) ? ts->hash : (unsigned long long)len;
+      r.keylen = cast_byte(len < ALOG_KEYPREFIX ? len : ALOG_KEYPREFIX);
+      memcpy(r.keystr, getstr(ts), r.keylen);
+      break;
+    }
+    case LUA_VNUMINT:
+      r.key = (unsigned long long)ivalue(key);
+      break;
+    case LUA_VNUMFLT: {
+      lua_Number n = fltvalue(key);
+      memcpy(&r.key, &n, sizeof(n) < sizeof(r.key) ? sizeof(n) : sizeof(r.key));
+      break;
+    }
+    default:
+      if (iscollectable(key))
+        r.key = (unsigned long long)(size_t)gcvalue(key);
+      break;
+  }
+  alog_push(&r);
+}
+
+
+static void alog_writetext (FILE *f, const AccessRecord *r) {
+  char keybuf[64];
+  switch (r->keytag) {
+    case LUA_VSHRSTR: case LUA_VLNGSTR:
+      snprintf(keybuf, sizeof(keybuf), "STRING:%.*s#%llx",
+               (int)r->keylen, r->keystr, r->key);
+      break;
+    case LUA_VNUMINT:
+      snprintf(keybuf, sizeof(keybuf), "INTEGER:%lld", (long long)r->key);
+      break;
+    case LUA_VNUMFLT: {
+      lua_Number n;
+      memcpy(&n, &r->key, sizeof(n) < sizeof(r->key) ? sizeof(n) : sizeof(r->key));
+      snprintf(keybuf, sizeof(keybuf), "FLOAT:%.17g", (double)n);
+      break;
+    }
+    case LUA_VFALSE: snprintf(keybuf, sizeof(keybuf), "BOOLEAN:false"); break;
+    case LUA_VTRUE: snprintf(keybuf, sizeof(keybuf), "BOOLEAN:true"); break;
+    default:
+      snprintf(keybuf, sizeof(keybuf), "TYPE:%d", novariant(r->keytag));
+      break;
+  }
+  fprintf(f, "[%llu] [%s] [%llx] KEY:%s -> %s\n", r->tick,
+          r->op == ALOG_OP_GET ? "GET" : "SET", r->table, keybuf,
+          r->valtag == LUA_VABSTKEY ? "NOT_FOUND"
+                                    : get_value_type_name(r->valtag));
+}
+
+
+static void *alog_writer_main (void *arg) {
+  FILE *f = (FILE *)arg;
+  AccessRecord r;
+  for (;;) {
+    int stop = atomic_load(&alog_stop);
+    size_t n = 0;
+    while (alog_pop(&r)) {
+      if (table_access_binary)
+        fwrite(&r, sizeof(r), 1, f);
+      else
+        alog_writetext(f, &r);
+      n++;
+    }
+    if (n > 0) {
+      atomic_fetch_add_explicit(&alog_written, n, memory_order_relaxed);
+      fflush(f);
+    }
+    else if (stop)
+      break;  /* stop requested and ring drained */
+    else {
+#if defined(LUA_USE_WINDOWS)
+      Sleep(1);
+#else
+      struct timespec ts = {0, 1000000};  /* 1 ms */
+      nanosleep(&ts, NULL);
+#endif
+    }
+  }
+  return NULL;
+}
+
+
+static int alog_start (FILE *f) {
+  if (alog_ring == NULL) {
+    size_t cap = 2, i;
+    while (cap < alog_capacity) cap <<= 1;
+    alog_ring = (AccessSlot *)malloc(cap * sizeof(AccessSlot));
+    if (alog_ring == NULL)
+      return 0;
+    alog_mask = cap - 1;
+    for (i = 0; i < cap; i++)
+      atomic_init(&alog_ring[i].seq, i);
+    atomic_init(&alog_head, 0);
+    alog_tail = 0;
+  }
+  atomic_store(&alog_recorded, 0);
+  atomic_store(&alog_dropped, 0);
+  atomic_store(&alog_written, 0);
+  atomic_store(&alog_stop, 0);
+  if (table_access_binary) {
+    unsigned int recsize = (unsigned int)sizeof(AccessRecord);
+    fwrite(ALOG_MAGIC, 1, sizeof(ALOG_MAGIC), f);
+    fwrite(&recsize, sizeof(recsize), 1, f);
+  }
+  if (l_thread_create(&alog_writer, alog_writer_main, f) != 0)
+    return 0;
+  alog_running = 1;
+  return 1;
+}
+
+
+static void alog_stopwriter (void) {
+  if (alog_running) {
+    atomic_store(&alog_stop, 1);
+    l_thread_join(alog_writer, NULL);
+    alog_running = 0;
+  }
+}
+
+
+/**
+ * @brief Selects the asynchronous ring-buffer backend.
+ *
+ * @param enabled 1 for async, 0 for the synchronous text log.
+ * @param capacity Ring capacity in records (0 keeps the current one).
+ * @param binary 1 to write binary records, 0 for text lines.
+ * @return 1 on success, 0 if logging is currently enabled.
+ */
+int luaH_set_access_log_async (int enabled, size_t capacity, int binary) {
+  if (table_access_enabled)
+    return 0;
+  if (capacity > 0 && capacity != alog_capacity) {
+    free(alog_ring);  /* no producer can be running while disabled */
+    alog_ring = NULL;
+    alog_capacity = capacity;
+  }
+  table_access_async = enabled;
+  table_access_binary = binary;
+  return 1;
+}
+
+
+/**
+ * @brief Gets the counters of the asynchronous access log.
+ */
+void luaH_get_access_log_stats (size_t *recorded, size_t *dropped,
+                                size_t *written) {
+  *recorded = atomic_load(&alog_recorded);
+  *dropped = atomic_load(&alog_dropped);
+  *written = atomic_load(&alog_written);
+}
+
+/* }====================================================== */
+
 static void log_key_value(const TValue *key, const TValue *value, const char *operation) {
   char key_buf[256] = {0};
   char value_buf[256] = {0};
@@ -530,6 +809,15 @@ static void log_key_value(const TValue *key, const TValue *value, const char *op
 }
 
 
+static void log_access (const Table *t, const TValue *key,
+                        const TValue *value, int op) {
+  if (table_access_async)
+    alog_record(key, value, op, t);
+  else
+    log_key_value(key, value, op == ALOG_OP_GET ? "GET" : "SET");
+}
+
+
 /*
 ** Only hash parts with at least 2^LIMFORLAST have a 'lastfree' field
 ** that optimizes finding a free slot. That field is stored just before
@@ -1249,7 +1537,7 @@ Table *luaH_new (lua_State *L) {
   t->alimit = 0;
   t->using_next = NULL;
   t->is_shared = 0;
-  l_rwlock_init(&t->lock);
+  t->lock = NULL;
   setnodevector(L, t, 0);
   return t;
 }
@@ -1264,11 +1552,41 @@ Table *luaH_new (lua_State *L) {
 void luaH_free (lua_State *L, Table *t) {
   freehash(L, t);
   luaM_freearray(L, t->array, luaH_realasize(t));
-  l_rwlock_destroy(&t->lock);
+  l_rwlock_t *lock = luaH_lockof(t);
+  if (lock != NULL) {
+    l_rwlock_destroy(lock);
+    luaM_free(L, lock);
+  }
   luaM_free(L, t);
 }
 
 
+/**
+ * @brief Marks a table as shared.
+ *
+ * Most tables are never shared, so the rwlock lives in a side
+ * allocation created here instead of being embedded in every Table.
+ *
+ * @param L The Lua state.
+ * @param t The table.
+ */
+void luaH_share (lua_State *L, Table *t) {
+  if (luaH_lockof(t) == NULL) {
+    l_rwlock_t *expected = NULL;
+    l_rwlock_t *lock = luaM_new(L, l_rwlock_t);
+    l_rwlock_init(lock);
+    /* publish with release order; if another thread won, use its lock */
+    if (!atomic_compare_exchange_strong_explicit(&t->lock, &expected, lock,
+                                                 memory_order_release,
+                                                 memory_order_acquire)) {
+      l_rwlock_destroy(lock);
+      luaM_free(L, lock);
+    }
+  }
+  t->is_shared = 1;
+}
+
+
 static Node *getfreepos (Table *t) {
   if (!isdummy(t)) {
     while (t->lastfree > t->node) {
@@ -1462,11 +1780,8 @@ const TValue *luaH_get (Table *t, const TValue *key) {
       result = getgeneric(t, key, 0);
       break;
   }
-  if (table_access_enabled && result != &absentkey) {
-    log_key_value(key, result, "GET");
-  } else if (table_access_enabled) {
-    log_key_value(key, result, "GET");
-  }
+  if (table_access_enabled)
+    log_access(t, key, result, ALOG_OP_GET);
   return result;
 }
 
@@ -1501,9 +1816,8 @@ void luaH_finishset (lua_State *L, Table *t, const TValue *key,
  */
 void luaH_set (lua_State *L, Table *t, const TValue *key, TValue *value) {
   const TValue *slot = luaH_get(t, key);
-  if (table_access_enabled) {
-    log_key_value(key, value, "SET");
-  }
+  if (table_access_enabled)
+    log_access(t, key, value, ALOG_OP_SET);
   luaH_finishset(L, t, key, slot, value);
 }
 
@@ -1521,7 +1835,7 @@ void luaH_setint (lua_State *L, Table *t, lua_Integer key, TValue *value) {
   if (table_access_enabled) {
     TValue k;
     setivalue(&k, key);
-    log_key_value(&k, value, "SET");
+    log_access(t, &k, value, ALOG_OP_SET);
   }
   if (isabstkey(p)) {
     TValue k;
@@ -1679,17 +1993,40 @@ int luaH_enable_access_log (lua_State *L, int enable) {
     if (table_access_log == NULL) {
       return 0;
     }
-    fprintf(table_access_log, "\n========== TABLE ACCESS LOG ENABLED ==========\n");
-    fflush(table_access_log);
+    if (table_access_async) {
+      if (!alog_start(table_access_log)) {
+        close_table_access_log();
+        return 0;
+      }
+    }
+    else {
+      fprintf(table_access_log, "\n========== TABLE ACCESS LOG ENABLED ==========\n");
+      fflush(table_access_log);
+    }
   } else if (!enable && table_access_enabled) {
-    fprintf(table_access_log, "========== TABLE ACCESS LOG DISABLED ==========\n\n");
-    fflush(table_access_log);
+    table_access_enabled = 0;  /* stop producers before draining */
+    if (alog_running)
+      alog_stopwriter();
+    else {
+      fprintf(table_access_log, "========== TABLE ACCESS LOG DISABLED ==========\n\n");
+      fflush(table_access_log);
+    }
     close_table_access_log();
   }
   table_access_enabled = enable;
   return 1;
 }
 
+
+/**
+ * @brief Sets the path of the access log file (used on next enable).
+ *
+ * @param path File path.
+ */
+void luaH_set_log_path (const char *path) {
+  snprintf(table_access_log_path, sizeof(table_access_log_path), "%s", path);
+}
+
 /**
  * @brief Returns the path to the current table access log file.
  *
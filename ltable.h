@@ -43,6 +43,31 @@
 #define nodefromval(v)	cast(Node *, (v))
 
 
+/*
+** Table locking. The lock is only allocated once a table is marked
+** shared (see 'luaH_share'); on ordinary tables these are no-ops.
+** 'luaH_rdlock'/'luaH_wrlock' read 't->lock' once and return the lock
+** they took (NULL if none); that same pointer must be given to
+** 'luaH_unlock', so a concurrent 'luaH_share' cannot make the unlock
+** release a lock that was never acquired.
+*/
+#define luaH_lockof(t)	atomic_load_explicit(&(t)->lock, memory_order_acquire)
+
+l_sinline l_rwlock_t *luaH_rdlock (Table *t) {
+  l_rwlock_t *lk = luaH_lockof(t);
+  if (lk) l_rwlock_rdlock(lk);
+  return lk;
+}
+
+l_sinline l_rwlock_t *luaH_wrlock (Table *t) {
+  l_rwlock_t *lk = luaH_lockof(t);
+  if (lk) l_rwlock_wrlock(lk);
+  return lk;
+}
+
+#define luaH_unlock(lk)	((lk) ? l_rwlock_unlock(lk) : (void)0)
+
+
 /**
  * @brief Gets an integer key from a table.
  *
@@ -259,6 +284,14 @@ LUAI_FUNC void luaH_resizearray (lua_State *L, Table *t, unsigned int nasize);
  */
 LUAI_FUNC void luaH_free (lua_State *L, Table *t);
 
+/**
+ * @brief Marks a table as shared, allocating its lock on first use.
+ *
+ * @param L The Lua state.
+ * @param t The table.
+ */
+LUAI_FUNC void luaH_share (lua_State *L, Table *t);
+
 /**
  * @brief Iterates over a table.
  *
@@ -456,5 +489,33 @@ LUAI_FUNC void luaH_set_filter_userdata (int enabled);
  */
 LUAI_FUNC int luaH_is_filter_userdata_enabled (void);
 
+/**
+ * @brief Sets the path of the access log file (used on next enable).
+ * @param path File path.
+ */
+LUAI_FUNC void luaH_set_log_path (const char *path);
+
+/**
+ * @brief Selects the asynchronous ring-buffer backend for access logging.
+ *
+ * Must be called while logging is disabled. In async mode records are
+ * written by a background thread and string filters are not applied.
+ * @param enabled 1 for async, 0 for the synchronous text log.
+ * @param capacity Ring capacity in records (rounded up to a power of 2).
+ * @param binary 1 to write binary records, 0 for text lines.
+ * @return 1 on success, 0 if logging is currently enabled.
+ */
+LUAI_FUNC int luaH_set_access_log_async (int enabled, size_t capacity,
+                                         int binary);
+
+/**
+ * @brief Gets the counters of the asynchronous access log.
+ * @param recorded Receives the number of records enqueued.
+ * @param dropped Receives the number of records dropped (ring full).
+ * @param written Receives the number of records written to the file.
+ */
+LUAI_FUNC void luaH_get_access_log_stats (size_t *recorded, size_t *dropped,
+                                          size_t *written);
+
 
 #endif
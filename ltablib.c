@@ -22,6 +22,8 @@
 
 #include "lstate.h"
 #include "lobject.h"
+#include "lgc.h"
+#include "ltable.h"
 
 
 /*
@@ -141,42 +143,6 @@ static int gfind (lua_State *L) {
   return 1;
 }
 
-static int clone_aux (lua_State *L,int idx) {
-    luaL_checktype(L, idx, LUA_TTABLE);
-    const char *id = lua_pushfstring(L, "%p",
-                                      lua_topointer(L, idx));
-    lua_gettable(L,1);
-    if(lua_type(L,-1)!=LUA_TNIL){
-        lua_remove(L,idx);
-        return 1;
-    }
-    lua_remove(L,idx+1);
-    lua_newtable(L);
-    lua_pushvalue(L,-1);
-    lua_setfield(L,1,id);
-    lua_pushnil(L);  /* first key */
-    while (lua_next(L, idx)) {
-        if(lua_type(L,idx+3)==LUA_TTABLE)
-           clone_aux(L,idx+3);
-        lua_pushvalue(L,idx+2);
-        lua_insert(L,idx+2);
-        lua_settable(L,idx+1);
-    }
-    if(lua_getmetatable(L,idx))
-      lua_setmetatable(L,idx+1);
-    lua_remove(L,idx);
-    return 1;
-}
-
-static int t_clone (lua_State *L) {
-    luaL_checktype(L, 1, LUA_TTABLE);
-    lua_newtable(L);
-    lua_insert(L,1);
-    clone_aux(L,2);
-    lua_remove(L,1);
-  return 1;
-}
-
 static int tconst (lua_State *L) {
   luaL_checktype(L, 1, LUA_TTABLE);
   lua_concat(L,1);
@@ -185,6 +151,191 @@ static int tconst (lua_State *L) {
 #endif
 //---
 
+/*
+** Deep copy for 'table.clone'. Every table reached through values gets
+** its own copy (keys are shared, as are metatables), and a table reached
+** twice is copied once, so cycles and shared subtables keep their shape.
+** Each copy is sized like its source and filled by copying the source's
+** array and node vectors wholesale; the node vector can be copied as is
+** because a table of the same size places every key in the same slot.
+** A second pass over the copy then replaces table values by their copies.
+** 'CloneMap' maps each source table to its copy and doubles as the work
+** list: entries are filled in the order they were added, so there is no
+** recursion whatever the nesting depth.
+*/
+typedef struct CloneEntry {
+  Table *src;
+  Table *dst;
+} CloneEntry;
+
+typedef struct CloneMap {
+  CloneEntry *e;  /* entries, in discovery order */
+  unsigned int *slot;  /* hash of 'src' -> index in 'e' plus 1 (0 = free) */
+  unsigned int n;  /* number of entries */
+  unsigned int size;  /* capacity of 'e'; 'slot' has 2 * size slots */
+  int idx;  /* stack index of the userdata holding both vectors */
+} CloneMap;
+
+
+static unsigned int clone_hash (const Table *t, unsigned int mask) {
+  size_t p = (size_t)t;
+  return (unsigned int)((p >> 4) ^ (p >> 12) ^ (p >> 20)) & mask;
+}
+
+
+static Table *clone_find (const CloneMap *m, const Table *t) {
+  unsigned int mask = 2 * m->size - 1;
+  unsigned int h = clone_hash(t, mask);
+  unsigned int s;
+  while ((s = m->slot[h]) != 0) {
+    if (m->e[s - 1].src == t)
+      return m->e[s - 1].dst;
+    h = (h + 1) & mask;
+  }
+  return NULL;
+}
+
+
+static void clone_link (CloneMap *m, unsigned int i) {
+  unsigned int mask = 2 * m->size - 1;
+  unsigned int h = clone_hash(m->e[i].src, mask);
+  while (m->slot[h] != 0)
+    h = (h + 1) & mask;
+  m->slot[h] = i + 1;
+}
+
+
+static void clone_grow (lua_State *L, CloneMap *m) {
+  unsigned int size, i;
+  CloneEntry *e;
+  /* 'slot' holds 2 * size entries; keep that and the block size in range */
+  if (m->size >= cast_uint(MAX_INT) / 4 ||
+      cast_sizet(m->size) * 2 >
+        MAX_SIZE / (sizeof(CloneEntry) + 2 * sizeof(unsigned int)))
+    luaL_error(L, "too many tables to clone");
+  size = (m->size == 0) ? 16 : 2 * m->size;
+  e = (CloneEntry *)lua_newuserdatauv(L, size * (sizeof(CloneEntry) +
+                                      2 * sizeof(unsigned int)), 0);
+  if (m->n > 0)
+    memcpy(e, m->e, m->n * sizeof(CloneEntry));
+  m->e = e;
+  m->slot = (unsigned int *)(e + size);
+  m->size = size;
+  memset(m->slot, 0, 2 * size * sizeof(unsigned int));
+  for (i = 0; i < m->n; i++)
+    clone_link(m, i);
+  lua_replace(L, m->idx);
+}
+
+
+/*
+** Create the (still empty) copy of 't' and leave it on the stack, where
+** it stays anchored until the caller stores it in its parent.
+*/
+static Table *clone_new (lua_State *L, CloneMap *m, Table *t) {
+  Table *c;
+  if (m->n == m->size)
+    clone_grow(L, m);
+  lua_newtable(L);
+  c = hvalue(s2v(L->top.p - 1));
+  m->e[m->n].src = t;
+  m->e[m->n].dst = c;
+  clone_link(m, m->n++);
+  return c;
+}
+
+
+/* replace a table value in slot 'v' of copy 'h' by its copy */
+static void clone_value (lua_State *L, CloneMap *m, Table *h, TValue *v,
+                         Table *keep) {
+  Table *t = hvalue(v);
+  Table *c = clone_find(m, t);
+  if (c == NULL) {
+    if (keep != NULL && !l_isfalse(luaH_get(keep, v)))
+      return;  /* shared as it is */
+    c = clone_new(L, m, t);
+    sethvalue(L, v, c);
+    luaC_barrierback(L, obj2gco(h), v);
+    lua_pop(L, 1);
+  }
+  else {
+    sethvalue(L, v, c);
+    luaC_barrierback(L, obj2gco(h), v);
+  }
+}
+
+
+static void clone_fill (lua_State *L, CloneMap *m, unsigned int i,
+                        Table *keep) {
+  Table *t = m->e[i].src;
+  Table *h = m->e[i].dst;
+  GCObject *mt;
+  unsigned int asize, hsize, k;
+  l_rwlock_t *tlk = luaH_rdlock(t);
+  for (;;) {  /* size the copy like the source (which may be shared) */
+    asize = luaH_realasize(t);
+    hsize = cast_uint(allocsizenode(t));
+    if (asize == luaH_realasize(h) && hsize == cast_uint(allocsizenode(h)))
+      break;
+    luaH_unlock(tlk);
+    luaH_resize(L, h, asize, hsize);
+    tlk = luaH_rdlock(t);
+  }
+  if (asize > 0)
+    memcpy(h->array, t->array, asize * sizeof(TValue));
+  if (hsize > 0) {
+    memcpy(h->node, t->node, hsize * sizeof(Node));
+    h->lastfree = h->node + (t->lastfree - t->node);
+    invalidateTMcache(h);  /* the copied keys may include metamethods */
+  }
+  mt = t->metatable;
+  luaH_unlock(tlk);
+  if (isblack(h))  /* collector already went over the empty copy? */
+    luaC_barrierback_(L, obj2gco(h));
+  for (k = 0; k < asize; k++) {
+    if (ttistable(&h->array[k]))
+      clone_value(L, m, h, &h->array[k], keep);
+  }
+  for (k = 0; k < hsize; k++) {
+    TValue *v = gval(gnode(h, k));
+    if (ttistable(v))
+      clone_value(L, m, h, v, keep);
+  }
+  if (mt != NULL) {
+    h->metatable = mt;
+    luaC_objbarrier(L, h, mt);
+    luaC_checkfinalizer(L, obj2gco(h), mt);
+  }
+}
+
+
+/*
+** table.clone(t [, keep]): deep copy of 't'. Subtables that are keys in
+** 'keep' (with a true value) are shared instead of copied, which suits
+** large read-only parts of a snapshot.
+*/
+static int t_clone (lua_State *L) {
+  CloneMap m;
+  Table *keep = NULL;
+  unsigned int i;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  if (!lua_isnoneornil(L, 2)) {
+    luaL_checktype(L, 2, LUA_TTABLE);
+    keep = hvalue(s2v(L->ci->func.p + 2));
+  }
+  lua_settop(L, 2);
+  m.e = NULL;
+  m.slot = NULL;
+  m.n = m.size = 0;
+  lua_pushnil(L);  /* slot for the map */
+  m.idx = lua_gettop(L);
+  clone_new(L, &m, hvalue(s2v(L->ci->func.p + 1)));  /* the result */
+  for (i = 0; i < m.n; i++)
+    clone_fill(L, &m, i, keep);
+  return 1;
+}
+
+
 static int tinsert (lua_State *L) {
   lua_Integer pos;  /* where to insert new element */
   lua_Integer e;
@@ -764,13 +915,14 @@ static int t_share (lua_State *L) {
   luaL_checktype(L, 1, LUA_TTABLE);
   TValue *o = s2v(L->ci->func.p + 1);
   Table *t = hvalue(o);
-  t->is_shared = 1;
+  luaH_share(L, t);
   lua_pushvalue(L, 1);
   return 1;
 }
 
 static const luaL_Reg tab_funcs[] = {
 	{"share", t_share},
+	{"clone", t_clone},
 	{"concat", tconcat},
 #if defined(LUA_COMPAT_FOREACH)
 	{"foreach", foreach},
@@ -782,7 +934,6 @@ static const luaL_Reg tab_funcs[] = {
 	{"clear", clear},
 	{"find", find},
 	{"gfind", gfind},
-	{"clone", t_clone},
 	{"const", tconst},
 #endif
 	{"add", tadd},
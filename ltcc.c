@@ -15,6 +15,7 @@
 #include "lopcodes.h"
 #include "lstate.h"
 #include "lundump.h"
+#include "lvm.h"
 #include "ltcc.h"
 #include "lopnames.h"
 #include "lobfuscate.h"
@@ -179,12 +180,20 @@ static void emit_junk_code(luaL_Buffer *B, unsigned int *seed) {
     }
 }
 
-static void get_label_name(char *out, size_t len, int label_idx, unsigned int seed, int obfuscate) {
+/* Label prefixes of the generic body and of the typed tier's body */
+#define LABEL_GENERIC   "Label"
+#define LABEL_TYPED     "Typed"
+
+/* Room for either prefix, '_' and any int; obfuscated names stay 15 chars */
+#define LABEL_NAMESIZE  (sizeof(LABEL_GENERIC "_") + 11)
+#define LABEL_OBFSIZE   16
+
+static void get_label_name(char *out, size_t len, const char *prefix, int label_idx, unsigned int seed, int obfuscate) {
     if (obfuscate) {
         unsigned int label_seed = seed + label_idx + 1000000;
-        get_random_name(out, len, &label_seed);
+        get_random_name(out, len < LABEL_OBFSIZE ? len : LABEL_OBFSIZE, &label_seed);
     } else {
-        snprintf(out, len, "Label_%d", label_idx);
+        snprintf(out, len, "%s_%d", prefix, label_idx);
     }
 }
 
@@ -328,14 +337,10 @@ static void emit_loadk(luaL_Buffer *B, Proto *p, int k_index, int str_encrypt, i
     }
 }
 
-static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, ProtoInfo *protos, int proto_count, int use_pure_c, int str_encrypt, int seed, int obfuscate) {
+static void emit_op(luaL_Buffer *B, Proto *p, int pc, Instruction i, ProtoInfo *protos, int proto_count, int use_pure_c, int str_encrypt, int seed, int obfuscate, const char *lprefix) {
     OpCode op = GET_OPCODE(i);
     int a = GETARG_A(i);
 
-    char label_name[16];
-    get_label_name(label_name, sizeof(label_name), pc + 1, seed, obfuscate);
-    add_fmt(B, "    %s: /* %s */\n", label_name, opnames[op]);
-
     unsigned int obf_seed = (unsigned int)seed + pc;
 
     switch (op) {
@@ -390,8 +395,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
             add_fmt(B, "    lua_replace(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             break;
         case OP_LFALSESKIP: {
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    if (!lua_toboolean(L, %s)) {\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "        goto %s;\n", target_label);
             add_fmt(B, "    } else {\n");
@@ -412,8 +417,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
             break;
         }
         case OP_LOADKX: {
-            if (pc + 1 < p->sizecode && GET_OPCODE(p->code[pc+1]) == OP_EXTRAARG) {
-                int ax = GETARG_Ax(p->code[pc+1]);
+            if (pc + 1 < p->sizecode && GET_OPCODE(luaV_getinst(p, pc+1)) == OP_EXTRAARG) {
+                int ax = GETARG_Ax(luaV_getinst(p, pc+1));
                 TValue *k = &p->k[ax];
                 if (ttisstring(k)) {
                      if (str_encrypt) {
@@ -860,17 +865,41 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
 
         case OP_JMP: {
             int sj = GETARG_sJ(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + sj + 1, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + sj + 1, seed, obfuscate);
             add_fmt(B, "    goto %s;\n", target_label);
             break;
         }
 
+        case OP_SWITCH: {
+            /* dense tables become a C switch; other values and maps fall
+               into the comparison chain that follows */
+            const SwitchTable *st = &p->switches[GETARG_Bx(i)];
+            char target_label[LABEL_NAMESIZE];
+            if (st->keys != NULL) {
+                add_fmt(B, "    /* SWITCH: comparison chain */\n");
+                break;
+            }
+            add_fmt(B, "    if (lua_isinteger(L, %s)) {\n", obf_int(a + 1, &obf_seed, obfuscate));
+            add_fmt(B, "        switch ((lua_Unsigned)lua_tointeger(L, %s) - (lua_Unsigned)%lluULL) {\n",
+                    obf_int(a + 1, &obf_seed, obfuscate), (unsigned long long)l_castS2U(st->lo));
+            for (int j = 0; j < st->size; j++) {
+                if (st->targets[j] == st->deflt) continue;
+                get_label_name(target_label, sizeof(target_label), lprefix, st->targets[j] + 1, seed, obfuscate);
+                add_fmt(B, "            case %d: goto %s;\n", j, target_label);
+            }
+            get_label_name(target_label, sizeof(target_label), lprefix, st->deflt + 1, seed, obfuscate);
+            add_fmt(B, "            default: goto %s;\n", target_label);
+            add_fmt(B, "        }\n");
+            add_fmt(B, "    }\n");
+            break;
+        }
+
         case OP_EQ: { // if ((R[A] == R[B]) ~= k) then pc++
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(b + 1, &obf_seed, obfuscate));
@@ -884,8 +913,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_LT: {
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(b + 1, &obf_seed, obfuscate));
@@ -899,8 +928,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_LE: {
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(b + 1, &obf_seed, obfuscate));
@@ -914,8 +943,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_EQK: {
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             emit_loadk(B, p, b, str_encrypt, seed, obfuscate);
@@ -929,8 +958,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_EQI: {
             int sb = GETARG_sB(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushinteger(L, %s);\n", obf_int(sb, &obf_seed, obfuscate));
@@ -944,8 +973,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_LTI: {
             int sb = GETARG_sB(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushinteger(L, %s);\n", obf_int(sb, &obf_seed, obfuscate));
@@ -959,8 +988,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_LEI: {
             int sb = GETARG_sB(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushinteger(L, %s);\n", obf_int(sb, &obf_seed, obfuscate));
@@ -974,8 +1003,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_GTI: {
             int sb = GETARG_sB(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushinteger(L, %s);\n", obf_int(sb, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
@@ -989,8 +1018,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_GEI: {
             int sb = GETARG_sB(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        lua_pushinteger(L, %s);\n", obf_int(sb, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
@@ -1053,8 +1082,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
             unsigned int b = GETARG_vB(i);
             unsigned int c = GETARG_vC(i);
             if (TESTARG_k(i)) {
-                if (pc + 1 < p->sizecode && GET_OPCODE(p->code[pc+1]) == OP_EXTRAARG) {
-                    int ax = GETARG_Ax(p->code[pc+1]);
+                if (pc + 1 < p->sizecode && GET_OPCODE(luaV_getinst(p, pc+1)) == OP_EXTRAARG) {
+                    int ax = GETARG_Ax(luaV_getinst(p, pc+1));
                     c += ax * (MAXARG_C + 1);
                 }
             }
@@ -1158,8 +1187,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
             int n = GETARG_vB(i);
             unsigned int c = GETARG_vC(i);
             if (TESTARG_k(i)) {
-                if (pc + 1 < p->sizecode && GET_OPCODE(p->code[pc+1]) == OP_EXTRAARG) {
-                    int ax = GETARG_Ax(p->code[pc+1]);
+                if (pc + 1 < p->sizecode && GET_OPCODE(luaV_getinst(p, pc+1)) == OP_EXTRAARG) {
+                    int ax = GETARG_Ax(luaV_getinst(p, pc+1));
                     c += ax * (MAXARG_C + 1);
                 }
             }
@@ -1199,8 +1228,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
 
         case OP_FORPREP: {
             int bx = GETARG_Bx(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + bx + 1, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + bx + 1, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        if (lua_isinteger(L, %s) && lua_isinteger(L, %s)) {\n", obf_int(a + 1, &obf_seed, obfuscate), obf_int(a + 3, &obf_seed, obfuscate));
             add_fmt(B, "            lua_Integer step = lua_tointeger(L, %s);\n", obf_int(a + 3, &obf_seed, obfuscate));
@@ -1220,8 +1249,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
 
         case OP_FORLOOP: {
             int bx = GETARG_Bx(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 2 - bx, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 2 - bx, seed, obfuscate);
             add_fmt(B, "    {\n");
             add_fmt(B, "        if (lua_isinteger(L, %s)) {\n", obf_int(a + 3, &obf_seed, obfuscate));
             add_fmt(B, "            lua_Integer step = lua_tointeger(L, %s);\n", obf_int(a + 3, &obf_seed, obfuscate));
@@ -1252,8 +1281,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
 
         case OP_TFORPREP: {
             int bx = GETARG_Bx(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + bx + 1, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + bx + 1, seed, obfuscate);
             add_fmt(B, "    lua_toclose(L, %s);\n", obf_int(a + 3 + 1, &obf_seed, obfuscate));
             add_fmt(B, "    goto %s;\n", target_label);
             break;
@@ -1273,8 +1302,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
 
         case OP_TFORLOOP: {
             int bx = GETARG_Bx(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 2 - bx, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 2 - bx, seed, obfuscate);
             add_fmt(B, "    if (!lua_isnil(L, %s)) {\n", obf_int(a + 5, &obf_seed, obfuscate));
             add_fmt(B, "        lua_pushvalue(L, %s);\n", obf_int(a + 5, &obf_seed, obfuscate));
             add_fmt(B, "        lua_replace(L, %s);\n", obf_int(a + 3, &obf_seed, obfuscate));
@@ -1285,8 +1314,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
 
         case OP_TEST: {
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    if (lua_toboolean(L, %s) != %d) goto %s;\n", obf_int(a + 1, &obf_seed, obfuscate), k, target_label);
             break;
         }
@@ -1294,8 +1323,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_TESTSET: {
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    if (lua_toboolean(L, %s) != %d) goto %s;\n", obf_int(b + 1, &obf_seed, obfuscate), k, target_label);
             add_fmt(B, "    lua_pushvalue(L, %s);\n", obf_int(b + 1, &obf_seed, obfuscate));
             add_fmt(B, "    lua_replace(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
@@ -1305,8 +1334,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_TESTNIL: {
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    if (lua_isnil(L, %s) == %d) goto %s;\n", obf_int(b + 1, &obf_seed, obfuscate), k, target_label);
             int a = GETARG_A(i);
             if (a != MAXARG_A) {
@@ -1400,8 +1429,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_INSTANCEOF: {
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    lua_pushvalue(L, %s);\n", obf_int(a + 1, &obf_seed, obfuscate));
             add_fmt(B, "    lua_pushvalue(L, %s);\n", obf_int(b + 1, &obf_seed, obfuscate));
             add_fmt(B, "    if (lua_instanceof(L, %s, %s) != %d) goto %s;\n", obf_int(-2, &obf_seed, obfuscate), obf_int(-1, &obf_seed, obfuscate), k, target_label);
@@ -1447,6 +1476,10 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_CHECKTYPE: {
             int b = GETARG_B(i);
             int c = GETARG_C(i);
+            if (GETARG_k(i)) {  /* builtin type: B is its type code */
+                add_fmt(B, "    lua_checktype(L, %s, \"%s\");\n", obf_int(a + 1, &obf_seed, obfuscate), luaV_typename(b));
+                break;
+            }
             add_fmt(B, "    lua_pushvalue(L, %s);\n", obf_int(b + 1, &obf_seed, obfuscate));
             emit_loadk(B, p, c, str_encrypt, seed, obfuscate); /* name */
             add_fmt(B, "    lua_checktype(L, %s, lua_tostring(L, %s));\n", obf_int(a + 1, &obf_seed, obfuscate), obf_int(-1, &obf_seed, obfuscate));
@@ -1465,8 +1498,8 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
         case OP_IS: {
             int b = GETARG_B(i);
             int k = GETARG_k(i);
-            char target_label[16];
-            get_label_name(target_label, sizeof(target_label), pc + 1 + 2, seed, obfuscate);
+            char target_label[LABEL_NAMESIZE];
+            get_label_name(target_label, sizeof(target_label), lprefix, pc + 1 + 2, seed, obfuscate);
             add_fmt(B, "    {\n");
             emit_loadk(B, p, b, str_encrypt, seed, obfuscate); // Push type name K[B]
             add_fmt(B, "        int res = lua_is(L, %s, lua_tostring(L, %s));\n", obf_int(a + 1, &obf_seed, obfuscate), obf_int(-1, &obf_seed, obfuscate));
@@ -1619,7 +1652,609 @@ static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, Pr
     }
 }
 
-static void process_proto(luaL_Buffer *B, Proto *p, int id, ProtoInfo *protos, int proto_count, int use_pure_c, int str_encrypt, int seed, int obfuscate, int inline_opt) {
+static void emit_instruction(luaL_Buffer *B, Proto *p, int pc, Instruction i, ProtoInfo *protos, int proto_count, int use_pure_c, int str_encrypt, int seed, int obfuscate) {
+    char label_name[LABEL_NAMESIZE];
+    get_label_name(label_name, sizeof(label_name), LABEL_GENERIC, pc + 1, seed, obfuscate);
+    add_fmt(B, "    %s: /* %s */\n", label_name, opnames[GET_OPCODE(i)]);
+    emit_op(B, p, pc, i, protos, proto_count, use_pure_c, str_encrypt, seed, obfuscate, LABEL_GENERIC);
+}
+
+/*
+** Typed register tier ({typed = true})
+**
+** Each proto is analysed for registers that only ever hold integers or only
+** floats: FORLOOP counters and arithmetic over LOADI/LOADF/numeric constants
+** and other such registers. Those registers live in unboxed C locals. The
+** proto is emitted twice, a typed body followed by the generic API body.
+** Instructions that cannot be typed run their API form inside the typed body
+** once the typed registers they read have been written back to the stack. A
+** failed guard (a loop limit or step that is not an integer) writes back every
+** typed register and continues in the generic body at the same pc.
+*/
+
+#define TK_TOP  0   /* no write seen yet */
+#define TK_INT  1   /* lua_Integer local */
+#define TK_FLT  2   /* lua_Number local */
+#define TK_ANY  3   /* boxed, lives on the Lua stack */
+
+typedef struct TypedInfo {
+    int nregs;
+    lu_byte kind[MAXARG_A + 1];
+    lu_byte forloop[MAXARG_A + 1];  /* register A of a typed FORPREP */
+} TypedInfo;
+
+static const char tcc_typed_helpers[] =
+    "static inline lua_Integer tcc_imod(lua_State *L, lua_Integer m, lua_Integer n) {\n"
+    "    lua_Integer r;\n"
+    "    if ((lua_Unsigned)n + 1u <= 1u) {\n"
+    "        if (n == 0) luaL_error(L, \"attempt to perform 'n%%0'\");\n"
+    "        return 0;\n"
+    "    }\n"
+    "    r = m % n;\n"
+    "    if (r != 0 && (r ^ n) < 0) r += n;\n"
+    "    return r;\n"
+    "}\n"
+    "static inline lua_Integer tcc_idiv(lua_State *L, lua_Integer m, lua_Integer n) {\n"
+    "    lua_Integer q;\n"
+    "    if ((lua_Unsigned)n + 1u <= 1u) {\n"
+    "        if (n == 0) luaL_error(L, \"attempt to perform 'n//0'\");\n"
+    "        return (lua_Integer)(0u - (lua_Unsigned)m);\n"
+    "    }\n"
+    "    q = m / n;\n"
+    "    if ((m ^ n) < 0 && m % n != 0) q -= 1;\n"
+    "    return q;\n"
+    "}\n"
+    "static inline lua_Integer tcc_shiftl(lua_Integer x, lua_Integer y) {\n"
+    "    if (y < 0) return (y <= -64) ? 0 : (lua_Integer)((lua_Unsigned)x >> (lua_Unsigned)(-y));\n"
+    "    return (y >= 64) ? 0 : (lua_Integer)((lua_Unsigned)x << (lua_Unsigned)y);\n"
+    "}\n\n";
+
+static int tk_join(int x, int y) {
+    if (x == TK_TOP) return y;
+    if (y == TK_TOP || x == y) return x;
+    return TK_ANY;
+}
+
+/* Kind of a numeric constant, TK_ANY for anything that cannot be unboxed */
+static int tk_const(Proto *p, int idx) {
+    TValue *k = &p->k[idx];
+    if (ttisinteger(k)) return TK_INT;
+    if (ttisfloat(k)) {
+        lua_Number n = fltvalue(k);
+        return (n == n && n - n == 0) ? TK_FLT : TK_ANY;  /* finite only */
+    }
+    return TK_ANY;
+}
+
+static int tk_arith(OpCode op, int x, int y) {
+    if (x == TK_ANY || y == TK_ANY) return TK_ANY;
+    if (x == TK_TOP || y == TK_TOP) return TK_TOP;
+    switch (op) {
+        case OP_ADD: case OP_SUB: case OP_MUL:
+            return (x == TK_INT && y == TK_INT) ? TK_INT : TK_FLT;
+        case OP_DIV: case OP_POW:
+            return TK_FLT;
+        default:  /* integer-only operators; float operands stay boxed */
+            return (x == TK_INT && y == TK_INT) ? TK_INT : TK_ANY;
+    }
+}
+
+/* Base arithmetic opcode of a K/I variant */
+static OpCode tk_baseop(OpCode op) {
+    switch (op) {
+        case OP_ADDK: case OP_ADDI: return OP_ADD;
+        case OP_SUBK: return OP_SUB;
+        case OP_MULK: return OP_MUL;
+        case OP_MODK: return OP_MOD;
+        case OP_POWK: return OP_POW;
+        case OP_DIVK: return OP_DIV;
+        case OP_IDIVK: return OP_IDIV;
+        case OP_BANDK: return OP_BAND;
+        case OP_BORK: return OP_BOR;
+        case OP_BXORK: return OP_BXOR;
+        case OP_SHRI: return OP_SHR;
+        case OP_SHLI: return OP_SHL;
+        default: return op;
+    }
+}
+
+/*
+** Kind an instruction writes to R[A] when emitted typed, or -1 if the
+** instruction has no typed form.
+*/
+static int tk_result(Proto *p, int pc, const lu_byte *kind) {
+    Instruction i = luaV_getinst(p, pc);
+    OpCode op = GET_OPCODE(i);
+    int a = GETARG_A(i);
+    switch (op) {
+        case OP_LOADI: return TK_INT;
+        case OP_LOADF: return TK_FLT;
+        case OP_LOADK: return tk_const(p, GETARG_Bx(i));
+        case OP_MOVE: return kind[GETARG_B(i)];
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_IDIV:
+        case OP_MOD: case OP_POW: case OP_BAND: case OP_BOR: case OP_BXOR:
+        case OP_SHL: case OP_SHR:
+            return tk_arith(op, kind[GETARG_B(i)], kind[GETARG_C(i)]);
+        case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_MODK: case OP_POWK:
+        case OP_DIVK: case OP_IDIVK: case OP_BANDK: case OP_BORK: case OP_BXORK:
+            return tk_arith(tk_baseop(op), kind[GETARG_B(i)], tk_const(p, GETARG_C(i)));
+        case OP_ADDI: case OP_SHRI:
+            return tk_arith(tk_baseop(op), kind[GETARG_B(i)], TK_INT);
+        case OP_SHLI:
+            return tk_arith(OP_SHL, TK_INT, kind[GETARG_B(i)]);
+        case OP_UNM: {
+            int x = kind[GETARG_B(i)];
+            return x;
+        }
+        case OP_BNOT: {
+            int x = kind[GETARG_B(i)];
+            return (x == TK_FLT) ? TK_ANY : x;
+        }
+        case OP_FORPREP:
+            /* integer loop: init typed, limit and step integral or guarded */
+            if (kind[a] == TK_FLT || kind[a] == TK_ANY ||
+                kind[a + 1] == TK_FLT || kind[a + 2] == TK_FLT)
+                return TK_ANY;
+            return TK_INT;
+        case OP_FORLOOP:
+            return (kind[a] == TK_FLT || kind[a] == TK_ANY) ? TK_ANY : kind[a];
+        default:
+            return -1;
+    }
+}
+
+/*
+** Registers [*lo, *hi] an instruction without a typed form may write.
+** Returns 0 when it writes no register.
+*/
+static int tk_writes(Proto *p, int pc, int *lo, int *hi) {
+    Instruction i = luaV_getinst(p, pc);
+    int a = GETARG_A(i);
+    *lo = a;
+    *hi = a;
+    switch (GET_OPCODE(i)) {
+        case OP_JMP: case OP_EQ: case OP_LT: case OP_LE: case OP_EQK:
+        case OP_EQI: case OP_LTI: case OP_LEI: case OP_GTI: case OP_GEI:
+        case OP_TEST: case OP_SETTABUP: case OP_SETUPVAL: case OP_SETTABLE:
+        case OP_SETI: case OP_SETFIELD: case OP_SETLIST: case OP_RETURN:
+        case OP_RETURN0: case OP_RETURN1: case OP_CLOSE: case OP_TBC:
+        case OP_MMBIN: case OP_MMBINI: case OP_MMBINK: case OP_EXTRAARG:
+        case OP_NOP: case OP_VARARGPREP: case OP_SWITCH:
+            return 0;
+        case OP_TESTNIL:
+            return a != MAXARG_A;
+        case OP_LOADNIL:
+            *hi = a + GETARG_B(i);
+            return 1;
+        case OP_SELF:
+            *hi = a + 1;
+            return 1;
+        case OP_FORLOOP:
+            *hi = a + 3;
+            return 1;
+        case OP_CALL:
+            if (GETARG_B(i) == 0 || GETARG_C(i) == 0) break;
+            *hi = a + GETARG_C(i) - 2;
+            return GETARG_C(i) > 1;
+        case OP_MOVE: case OP_LOADK: case OP_LOADKX: case OP_LOADI: case OP_LOADF:
+        case OP_LOADFALSE: case OP_LFALSESKIP: case OP_LOADTRUE: case OP_GETUPVAL:
+        case OP_GETTABUP: case OP_GETTABLE: case OP_GETFIELD: case OP_GETI:
+        case OP_NEWTABLE: case OP_CLOSURE: case OP_NOT: case OP_LEN:
+        case OP_CONCAT: case OP_TESTSET: case OP_FORPREP:
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_IDIV:
+        case OP_MOD: case OP_POW: case OP_BAND: case OP_BOR: case OP_BXOR:
+        case OP_SHL: case OP_SHR: case OP_ADDK: case OP_SUBK: case OP_MULK:
+        case OP_MODK: case OP_POWK: case OP_DIVK: case OP_IDIVK: case OP_BANDK:
+        case OP_BORK: case OP_BXORK: case OP_ADDI: case OP_SHRI: case OP_SHLI:
+        case OP_UNM: case OP_BNOT:
+            return 1;
+        default:
+            break;
+    }
+    *hi = p->maxstacksize - 1;  /* calls, varargs and the rest: A and up */
+    return 1;
+}
+
+static int tk_multret(Proto *p, int pc) {
+    Instruction i;
+    if (pc < 0) return -1;
+    i = luaV_getinst(p, pc);
+    if ((GET_OPCODE(i) == OP_CALL || GET_OPCODE(i) == OP_VARARG) && GETARG_C(i) == 0)
+        return GETARG_A(i);
+    return -1;
+}
+
+/*
+** Registers [*lo, *hi] an instruction run through its API form may read.
+** Multiple-result consumers read up to the producer's base, since the slots
+** above it hold call results rather than registers. Returns -1 when the
+** producer cannot be found, which disables the tier for the proto.
+*/
+static int tk_reads(Proto *p, int pc, int *lo, int *hi) {
+    Instruction i = luaV_getinst(p, pc);
+    int a = GETARG_A(i), b = GETARG_B(i), c = GETARG_C(i);
+    *lo = 0;
+    *hi = p->maxstacksize - 1;
+    switch (GET_OPCODE(i)) {
+        case OP_JMP: case OP_LOADK: case OP_LOADKX: case OP_LOADI: case OP_LOADF:
+        case OP_LOADNIL: case OP_LOADFALSE: case OP_LOADTRUE: case OP_GETUPVAL:
+        case OP_GETTABUP: case OP_NEWTABLE: case OP_RETURN0: case OP_MMBIN:
+        case OP_MMBINI: case OP_MMBINK: case OP_EXTRAARG: case OP_NOP:
+        case OP_VARARGPREP:
+            return 0;
+        case OP_MOVE: case OP_GETFIELD: case OP_GETI: case OP_TESTSET:
+        case OP_TESTNIL: case OP_NOT: case OP_LEN: case OP_UNM: case OP_BNOT:
+        case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_MODK: case OP_POWK:
+        case OP_DIVK: case OP_IDIVK: case OP_BANDK: case OP_BORK: case OP_BXORK:
+        case OP_ADDI: case OP_SHRI: case OP_SHLI:
+            *lo = *hi = b;
+            return 1;
+        case OP_SETUPVAL: case OP_EQK: case OP_EQI: case OP_LTI: case OP_LEI:
+        case OP_GTI: case OP_GEI: case OP_TEST: case OP_LFALSESKIP: case OP_RETURN1:
+        case OP_SWITCH:
+            *lo = *hi = a;
+            return 1;
+        case OP_GETTABLE: case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_IDIV: case OP_MOD: case OP_POW: case OP_BAND: case OP_BOR:
+        case OP_BXOR: case OP_SHL: case OP_SHR: case OP_SELF:
+            *lo = (b < c) ? b : c;
+            *hi = (b < c) ? c : b;
+            return 1;
+        case OP_EQ: case OP_LT: case OP_LE:
+            *lo = (a < b) ? a : b;
+            *hi = (a < b) ? b : a;
+            return 1;
+        case OP_SETTABLE: case OP_SETFIELD: case OP_SETI: case OP_SETTABUP:
+            *lo = 0;
+            *hi = (a > c) ? a : c;
+            if (b > *hi) *hi = b;
+            return 1;
+        case OP_CONCAT:
+            *lo = a;
+            *hi = a + b - 1;
+            return 1;
+        case OP_FORPREP: case OP_FORLOOP:
+            *lo = a;
+            *hi = a + 3;
+            return 1;
+        case OP_CALL: case OP_TAILCALL: case OP_RETURN: case OP_SETLIST: {
+            int vb = (GET_OPCODE(i) == OP_SETLIST) ? GETARG_vB(i) : b;
+            *lo = a;
+            if (vb != 0) {
+                *hi = a + vb - 1;
+                return 1;
+            }
+            *hi = tk_multret(p, pc - 1) - 1;
+            return (*hi >= a - 1) ? 1 : -1;
+        }
+        default:
+            return 1;
+    }
+}
+
+/*
+** Fixed point over register kinds. Every writer of a typed register is an
+** instruction whose typed form produces exactly that kind; parameters and
+** registers written by anything else are pinned boxed, and pinning repeats
+** until no writer of a typed register would fall back to its API form.
+** Returns the number of typed registers (0 disables the tier).
+*/
+static int typed_analyse(Proto *p, TypedInfo *ti) {
+    lu_byte next[MAXARG_A + 1];
+    lu_byte pinned[MAXARG_A + 1];
+    int n = p->maxstacksize;
+    int ntyped = 0, repin = 1;
+    if (n > MAXARG_A) return 0;
+    ti->nregs = n;
+    memset(pinned, 0, sizeof(pinned));
+    memset(ti->forloop, 0, sizeof(ti->forloop));
+    for (int pc = 0; pc < p->sizecode; pc++) {
+        int lo, hi;
+        if (tk_reads(p, pc, &lo, &hi) < 0) return 0;
+    }
+    for (int r = 0; r < p->numparams && r < n; r++) pinned[r] = 1;
+    while (repin) {
+        int changed = 1;
+        memset(ti->kind, TK_TOP, sizeof(ti->kind));
+        while (changed) {
+            for (int r = 0; r < n; r++) next[r] = pinned[r] ? TK_ANY : TK_TOP;
+            for (int pc = 0; pc < p->sizecode; pc++) {
+                Instruction i = luaV_getinst(p, pc);
+                int a = GETARG_A(i);
+                int res = tk_result(p, pc, ti->kind);
+                if (res >= 0) {
+                    next[a] = tk_join(next[a], res);
+                    if (GET_OPCODE(i) == OP_FORLOOP && a + 3 < n)
+                        next[a + 3] = tk_join(next[a + 3], res);
+                }
+                else {
+                    int lo, hi;
+                    if (tk_writes(p, pc, &lo, &hi))
+                        for (int r = lo; r <= hi && r < n; r++) next[r] = TK_ANY;
+                }
+            }
+            changed = memcmp(next, ti->kind, n) != 0;
+            memcpy(ti->kind, next, n);
+        }
+        repin = 0;
+        for (int r = 0; r < n; r++) {
+            if (ti->kind[r] == TK_TOP) {  /* never written: keep it boxed */
+                pinned[r] = 1;
+                repin = 1;
+            }
+        }
+        for (int pc = 0; pc < p->sizecode && !repin; pc++) {
+            Instruction i = luaV_getinst(p, pc);
+            OpCode op = GET_OPCODE(i);
+            int a = GETARG_A(i);
+            int res = tk_result(p, pc, ti->kind);
+            if (op == OP_FORPREP || op == OP_FORLOOP) {
+                /* the loop runs typed only if the counter and control are */
+                int typed = (a + 3 < n && ti->kind[a] == TK_INT && ti->kind[a + 3] == TK_INT);
+                if (!typed && a + 3 < n && (ti->kind[a] != TK_ANY || ti->kind[a + 3] != TK_ANY)) {
+                    pinned[a] = pinned[a + 3] = 1;
+                    repin = 1;
+                }
+            }
+            else if (res >= 0 && ti->kind[a] != TK_ANY && res != ti->kind[a]) {
+                pinned[a] = 1;
+                repin = 1;
+            }
+        }
+    }
+    for (int r = 0; r < n; r++)
+        if (ti->kind[r] != TK_ANY) ntyped++;
+    for (int pc = 0; pc < p->sizecode; pc++) {
+        Instruction i = luaV_getinst(p, pc);
+        int a = GETARG_A(i);
+        if (GET_OPCODE(i) == OP_FORPREP && a + 3 < n && ti->kind[a] == TK_INT)
+            ti->forloop[a] = 1;
+    }
+    return ntyped;
+}
+
+static int tk_is_typed(const TypedInfo *ti, int r) {
+    return r >= 0 && r < ti->nregs && ti->kind[r] != TK_ANY;
+}
+
+static void emit_flush_reg(luaL_Buffer *B, const TypedInfo *ti, int r) {
+    if (ti->kind[r] == TK_INT)
+        add_fmt(B, "    lua_pushinteger(L, tr%d); lua_replace(L, %d);\n", r, r + 1);
+    else
+        add_fmt(B, "    lua_pushnumber(L, tr%d); lua_replace(L, %d);\n", r, r + 1);
+}
+
+static void emit_flush_range(luaL_Buffer *B, const TypedInfo *ti, int lo, int hi) {
+    for (int r = lo; r <= hi && r < ti->nregs; r++)
+        if (tk_is_typed(ti, r)) emit_flush_reg(B, ti, r);
+}
+
+/* Write back every typed register and continue in the generic body */
+static void emit_deopt(luaL_Buffer *B, const TypedInfo *ti, int pc) {
+    emit_flush_range(B, ti, 0, ti->nregs - 1);
+    add_fmt(B, "    goto " LABEL_GENERIC "_%d;\n", pc + 1);
+}
+
+static void tk_int_literal(char *out, size_t len, lua_Integer v) {
+    if (v == LUA_MININTEGER)
+        snprintf(out, len, "((lua_Integer)(-%lldLL - 1))", (long long)LUA_MAXINTEGER);
+    else
+        snprintf(out, len, "((lua_Integer)%lldLL)", (long long)v);
+}
+
+/* C expression for a typed operand: register, constant or immediate */
+static void tk_reg_operand(char *out, size_t len, int r) {
+    snprintf(out, len, "tr%d", r);
+}
+
+static void tk_const_operand(char *out, size_t len, Proto *p, int idx) {
+    TValue *k = &p->k[idx];
+    if (ttisinteger(k)) tk_int_literal(out, len, ivalue(k));
+    else snprintf(out, len, "((lua_Number)%.17g)", fltvalue(k));
+}
+
+static void emit_typed_arith(luaL_Buffer *B, OpCode op, int kind, int a, const char *x, const char *y) {
+    if (kind == TK_INT) {
+        switch (op) {
+            case OP_ADD: add_fmt(B, "    tr%d = (lua_Integer)((lua_Unsigned)%s + (lua_Unsigned)%s);\n", a, x, y); break;
+            case OP_SUB: add_fmt(B, "    tr%d = (lua_Integer)((lua_Unsigned)%s - (lua_Unsigned)%s);\n", a, x, y); break;
+            case OP_MUL: add_fmt(B, "    tr%d = (lua_Integer)((lua_Unsigned)%s * (lua_Unsigned)%s);\n", a, x, y); break;
+            case OP_MOD: add_fmt(B, "    tr%d = tcc_imod(L, %s, %s);\n", a, x, y); break;
+            case OP_IDIV: add_fmt(B, "    tr%d = tcc_idiv(L, %s, %s);\n", a, x, y); break;
+            case OP_BAND: add_fmt(B, "    tr%d = (lua_Integer)((lua_Unsigned)%s & (lua_Unsigned)%s);\n", a, x, y); break;
+            case OP_BOR: add_fmt(B, "    tr%d = (lua_Integer)((lua_Unsigned)%s | (lua_Unsigned)%s);\n", a, x, y); break;
+            case OP_BXOR: add_fmt(B, "    tr%d = (lua_Integer)((lua_Unsigned)%s ^ (lua_Unsigned)%s);\n", a, x, y); break;
+            case OP_SHL: add_fmt(B, "    tr%d = tcc_shiftl(%s, %s);\n", a, x, y); break;
+            case OP_SHR: add_fmt(B, "    tr%d = tcc_shiftl(%s, (lua_Integer)(0u - (lua_Unsigned)%s));\n", a, x, y); break;
+            default: lua_assert(0); break;
+        }
+    }
+    else {
+        switch (op) {
+            case OP_ADD: add_fmt(B, "    tr%d = (lua_Number)%s + (lua_Number)%s;\n", a, x, y); break;
+            case OP_SUB: add_fmt(B, "    tr%d = (lua_Number)%s - (lua_Number)%s;\n", a, x, y); break;
+            case OP_MUL: add_fmt(B, "    tr%d = (lua_Number)%s * (lua_Number)%s;\n", a, x, y); break;
+            case OP_DIV: add_fmt(B, "    tr%d = (lua_Number)%s / (lua_Number)%s;\n", a, x, y); break;
+            case OP_POW: add_fmt(B, "    tr%d = pow((lua_Number)%s, (lua_Number)%s);\n", a, x, y); break;
+            default: lua_assert(0); break;
+        }
+    }
+}
+
+/* Typed compare-and-skip: the next instruction is skipped when (x op y) ~= k */
+static void emit_typed_compare(luaL_Buffer *B, int pc, const char *x, const char *cmp, const char *y, int k) {
+    char target_label[LABEL_NAMESIZE];
+    get_label_name(target_label, sizeof(target_label), LABEL_TYPED, pc + 1 + 2, 0, 0);
+    add_fmt(B, "    if ((%s %s %s) != %d) goto %s;\n", x, cmp, y, k, target_label);
+}
+
+/*
+** Emit the typed form of instruction 'pc' if it has one under the final
+** kinds. Returns 0 if the caller must emit the API form instead.
+*/
+static int emit_typed_op(luaL_Buffer *B, Proto *p, int pc, const TypedInfo *ti) {
+    Instruction i = luaV_getinst(p, pc);
+    OpCode op = GET_OPCODE(i);
+    int a = GETARG_A(i);
+    int b = GETARG_B(i);
+    char x[64], y[64];
+    switch (op) {
+        case OP_LOADI: case OP_LOADF: case OP_LOADK: case OP_MOVE:
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_IDIV:
+        case OP_MOD: case OP_POW: case OP_BAND: case OP_BOR: case OP_BXOR:
+        case OP_SHL: case OP_SHR: case OP_ADDK: case OP_SUBK: case OP_MULK:
+        case OP_MODK: case OP_POWK: case OP_DIVK: case OP_IDIVK: case OP_BANDK:
+        case OP_BORK: case OP_BXORK: case OP_ADDI: case OP_SHRI: case OP_SHLI:
+        case OP_UNM: case OP_BNOT: {
+            int res = tk_result(p, pc, ti->kind);
+            if (!tk_is_typed(ti, a) || res != ti->kind[a]) return 0;
+            switch (op) {
+                case OP_LOADI:
+                    add_fmt(B, "    tr%d = %d;\n", a, GETARG_sBx(i));
+                    break;
+                case OP_LOADF:
+                    add_fmt(B, "    tr%d = (lua_Number)%d;\n", a, GETARG_sBx(i));
+                    break;
+                case OP_LOADK:
+                    tk_const_operand(x, sizeof(x), p, GETARG_Bx(i));
+                    add_fmt(B, "    tr%d = %s;\n", a, x);
+                    break;
+                case OP_MOVE:
+                    add_fmt(B, "    tr%d = tr%d;\n", a, b);
+                    break;
+                case OP_UNM:
+                    if (res == TK_INT) add_fmt(B, "    tr%d = (lua_Integer)(0u - (lua_Unsigned)tr%d);\n", a, b);
+                    else add_fmt(B, "    tr%d = -tr%d;\n", a, b);
+                    break;
+                case OP_BNOT:
+                    add_fmt(B, "    tr%d = (lua_Integer)(~(lua_Unsigned)tr%d);\n", a, b);
+                    break;
+                case OP_ADDI: case OP_SHRI:
+                    tk_reg_operand(x, sizeof(x), b);
+                    snprintf(y, sizeof(y), "%d", GETARG_sC(i));
+                    emit_typed_arith(B, tk_baseop(op), res, a, x, y);
+                    break;
+                case OP_SHLI:
+                    snprintf(x, sizeof(x), "%d", GETARG_sC(i));
+                    tk_reg_operand(y, sizeof(y), b);
+                    emit_typed_arith(B, OP_SHL, res, a, x, y);
+                    break;
+                case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_MODK: case OP_POWK:
+                case OP_DIVK: case OP_IDIVK: case OP_BANDK: case OP_BORK: case OP_BXORK:
+                    tk_reg_operand(x, sizeof(x), b);
+                    tk_const_operand(y, sizeof(y), p, GETARG_C(i));
+                    emit_typed_arith(B, tk_baseop(op), res, a, x, y);
+                    break;
+                default:
+                    tk_reg_operand(x, sizeof(x), b);
+                    tk_reg_operand(y, sizeof(y), GETARG_C(i));
+                    emit_typed_arith(B, op, res, a, x, y);
+                    break;
+            }
+            return 1;
+        }
+        case OP_EQ: case OP_LT: case OP_LE: {
+            if (!tk_is_typed(ti, a) || ti->kind[a] != ti->kind[b]) return 0;
+            tk_reg_operand(x, sizeof(x), a);
+            tk_reg_operand(y, sizeof(y), b);
+            emit_typed_compare(B, pc, x, op == OP_EQ ? "==" : op == OP_LT ? "<" : "<=", y, GETARG_k(i));
+            return 1;
+        }
+        case OP_EQK: {
+            if (!tk_is_typed(ti, a) || tk_const(p, b) != ti->kind[a]) return 0;
+            tk_reg_operand(x, sizeof(x), a);
+            tk_const_operand(y, sizeof(y), p, b);
+            emit_typed_compare(B, pc, x, "==", y, GETARG_k(i));
+            return 1;
+        }
+        case OP_EQI: case OP_LTI: case OP_LEI: case OP_GTI: case OP_GEI: {
+            static const char *const cmps[] = {"==", "<", "<=", ">", ">="};
+            if (!tk_is_typed(ti, a)) return 0;
+            tk_reg_operand(x, sizeof(x), a);
+            snprintf(y, sizeof(y), "%d", GETARG_sB(i));
+            emit_typed_compare(B, pc, x, cmps[op - OP_EQI], y, GETARG_k(i));
+            return 1;
+        }
+        case OP_FORPREP: {
+            char skip_label[LABEL_NAMESIZE];
+            if (!ti->forloop[a]) return 0;
+            get_label_name(skip_label, sizeof(skip_label), LABEL_TYPED, pc + 1 + GETARG_Bx(i) + 2, 0, 0);
+            add_fmt(B, "    {\n");
+            if (tk_is_typed(ti, a + 1)) add_fmt(B, "    tlim%d = tr%d;\n", a, a + 1);
+            else {
+                add_fmt(B, "    if (!lua_isinteger(L, %d)) {\n", a + 2);
+                emit_deopt(B, ti, pc);
+                add_fmt(B, "    }\n");
+                add_fmt(B, "    tlim%d = lua_tointeger(L, %d);\n", a, a + 2);
+            }
+            if (tk_is_typed(ti, a + 2)) add_fmt(B, "    tstep%d = tr%d;\n", a, a + 2);
+            else {
+                add_fmt(B, "    if (!lua_isinteger(L, %d)) {\n", a + 3);
+                emit_deopt(B, ti, pc);
+                add_fmt(B, "    }\n");
+                add_fmt(B, "    tstep%d = lua_tointeger(L, %d);\n", a, a + 3);
+            }
+            /* as 'forprep' in lvm.c: count iterations so the index never wraps */
+            add_fmt(B, "    if (tstep%d == 0) luaL_error(L, \"'for' step is zero\");\n", a);
+            add_fmt(B, "    if ((tstep%d > 0) ? (tr%d > tlim%d) : (tr%d < tlim%d)) goto %s;\n", a, a, a, a, a, skip_label);
+            add_fmt(B, "    if (tstep%d > 0) {\n", a);
+            add_fmt(B, "        tcnt%d = (lua_Unsigned)tlim%d - (lua_Unsigned)tr%d;\n", a, a, a);
+            add_fmt(B, "        if (tstep%d != 1) tcnt%d /= (lua_Unsigned)tstep%d;\n", a, a, a);
+            add_fmt(B, "    } else {\n");
+            add_fmt(B, "        tcnt%d = (lua_Unsigned)tr%d - (lua_Unsigned)tlim%d;\n", a, a, a);
+            add_fmt(B, "        tcnt%d /= (lua_Unsigned)(-(tstep%d + 1)) + 1u;\n", a, a);
+            add_fmt(B, "    }\n");
+            add_fmt(B, "    tr%d = tr%d;\n", a + 3, a);
+            add_fmt(B, "    }\n");
+            return 1;
+        }
+        case OP_FORLOOP: {
+            char target_label[LABEL_NAMESIZE];
+            if (!ti->forloop[a]) return 0;
+            get_label_name(target_label, sizeof(target_label), LABEL_TYPED, pc + 2 - GETARG_Bx(i), 0, 0);
+            add_fmt(B, "    if (tcnt%d > 0) {\n", a);
+            add_fmt(B, "        tcnt%d--;\n", a);
+            add_fmt(B, "        tr%d = (lua_Integer)((lua_Unsigned)tr%d + (lua_Unsigned)tstep%d);\n", a, a, a);
+            add_fmt(B, "        tr%d = tr%d;\n", a + 3, a);
+            add_fmt(B, "        goto %s;\n", target_label);
+            add_fmt(B, "    }\n");
+            return 1;
+        }
+        case OP_MMBIN: case OP_MMBINI: case OP_MMBINK:
+            add_fmt(B, "    /* MMBIN */\n");
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Typed body of a proto; falls back to the generic body through Label_* */
+static void emit_typed_body(luaL_Buffer *B, Proto *p, const TypedInfo *ti, ProtoInfo *protos, int proto_count, int use_pure_c, int str_encrypt, int seed) {
+    add_fmt(B, "    /* typed tier: unboxed registers */\n");
+    for (int r = 0; r < ti->nregs; r++) {
+        if (ti->kind[r] == TK_INT) add_fmt(B, "    lua_Integer tr%d = 0;\n", r);
+        else if (ti->kind[r] == TK_FLT) add_fmt(B, "    lua_Number tr%d = 0;\n", r);
+        if (ti->forloop[r]) add_fmt(B, "    lua_Integer tlim%d = 0, tstep%d = 1; lua_Unsigned tcnt%d = 0;\n", r, r, r);
+    }
+    for (int pc = 0; pc < p->sizecode; pc++) {
+        Instruction i = luaV_getinst(p, pc);
+        char label_name[LABEL_NAMESIZE];
+        int lo, hi;
+        get_label_name(label_name, sizeof(label_name), LABEL_TYPED, pc + 1, 0, 0);
+        add_fmt(B, "    %s: /* %s */\n", label_name, opnames[GET_OPCODE(i)]);
+        if (emit_typed_op(B, p, pc, ti))
+            continue;
+        if (tk_reads(p, pc, &lo, &hi) > 0)
+            emit_flush_range(B, ti, lo, hi);
+        emit_op(B, p, pc, i, protos, proto_count, use_pure_c, str_encrypt, seed, 0, LABEL_TYPED);
+    }
+    if (p->sizecode == 0 || (GET_OPCODE(luaV_getinst(p, p->sizecode-1)) != OP_RETURN && GET_OPCODE(luaV_getinst(p, p->sizecode-1)) != OP_RETURN0 && GET_OPCODE(luaV_getinst(p, p->sizecode-1)) != OP_RETURN1)) {
+        add_fmt(B, "    return 0;\n");
+    }
+    add_fmt(B, "    /* generic tier */\n");
+}
+
+static void process_proto(luaL_Buffer *B, Proto *p, int id, ProtoInfo *protos, int proto_count, int use_pure_c, int str_encrypt, int seed, int obfuscate, int inline_opt, int typed_opt) {
     char L_name[16] = "L";
     char vtab_name[16] = "vtab_idx";
     unsigned int obf_seed = (unsigned int)seed + id;
@@ -1648,10 +2283,16 @@ static void process_proto(luaL_Buffer *B, Proto *p, int id, ProtoInfo *protos, i
         add_fmt(B, "    lua_settop(%s, %s); /* Max Stack Size */\n", L_name, obf_int(p->maxstacksize, &obf_seed, obfuscate));
     }
 
+    if (typed_opt && !obfuscate) {
+        TypedInfo ti;
+        if (typed_analyse(p, &ti) > 0)
+            emit_typed_body(B, p, &ti, protos, proto_count, use_pure_c, str_encrypt, seed);
+    }
+
     // Iterate instructions
     for (int i = 0; i < p->sizecode; i++) {
         if (obfuscate && (my_rand(&obf_seed) % 4 == 0)) emit_junk_code(B, &obf_seed);
-        emit_instruction(B, p, i, p->code[i], protos, proto_count, use_pure_c, str_encrypt, seed, obfuscate);
+        emit_instruction(B, p, i, luaV_getinst(p, i), protos, proto_count, use_pure_c, str_encrypt, seed, obfuscate);
     }
 
     if (obfuscate) {
@@ -1660,7 +2301,7 @@ static void process_proto(luaL_Buffer *B, Proto *p, int id, ProtoInfo *protos, i
     }
 
     // Fallback return if no return op
-    if (p->sizecode == 0 || (GET_OPCODE(p->code[p->sizecode-1]) != OP_RETURN && GET_OPCODE(p->code[p->sizecode-1]) != OP_RETURN0 && GET_OPCODE(p->code[p->sizecode-1]) != OP_RETURN1)) {
+    if (p->sizecode == 0 || (GET_OPCODE(luaV_getinst(p, p->sizecode-1)) != OP_RETURN && GET_OPCODE(luaV_getinst(p, p->sizecode-1)) != OP_RETURN0 && GET_OPCODE(luaV_getinst(p, p->sizecode-1)) != OP_RETURN1)) {
         add_fmt(B, "    return %s;\n", obf_int(0, &obf_seed, obfuscate));
     }
     add_fmt(B, "}\n");
@@ -1712,6 +2353,7 @@ static int tcc_compile(lua_State *L) {
     int seed = 0;
     int provided_flags = 0;
     int inline_opt = 0;
+    int typed_opt = 0;
 
     if (lua_gettop(L) >= 2) {
         if (lua_type(L, 2) == LUA_TTABLE) {
@@ -1740,6 +2382,10 @@ static int tcc_compile(lua_State *L) {
              if (!lua_isnil(L, -1)) inline_opt = lua_toboolean(L, -1);
              lua_pop(L, 1);
 
+             lua_getfield(L, 2, "typed");
+             if (!lua_isnil(L, -1)) typed_opt = lua_toboolean(L, -1);
+             lua_pop(L, 1);
+
              /* Parse boolean flags from table and merge into provided_flags */
              struct { const char *name; int flag; } bool_opts[] = {
                  {"block_shuffle", OBFUSCATE_BLOCK_SHUFFLE},
@@ -1799,6 +2445,10 @@ static int tcc_compile(lua_State *L) {
                      if (!lua_isnil(L, -1)) inline_opt = lua_toboolean(L, -1);
                      lua_pop(L, 1);
 
+                     lua_getfield(L, 3, "typed");
+                     if (!lua_isnil(L, -1)) typed_opt = lua_toboolean(L, -1);
+                     lua_pop(L, 1);
+
                      /* Parse boolean flags from table (arg 3) and merge into provided_flags */
                      struct { const char *name; int flag; } bool_opts[] = {
                          {"block_shuffle", OBFUSCATE_BLOCK_SHUFFLE},
@@ -1877,10 +2527,13 @@ static int tcc_compile(lua_State *L) {
     add_fmt(&B, "#include \"lua.h\"\n");
     add_fmt(&B, "#include \"lauxlib.h\"\n");
     add_fmt(&B, "#include <string.h>\n");
-    if (use_pure_c) {
+    if (use_pure_c || (typed_opt && !obfuscate)) {
         add_fmt(&B, "#include <math.h>\n");
     }
     add_fmt(&B, "\n");
+    if (typed_opt && !obfuscate) {
+        luaL_addstring(&B, tcc_typed_helpers);
+    }
 
     if (obfuscate) {
         add_fmt(&B, "/* Obfuscated Interface */\n");
@@ -1933,7 +2586,7 @@ static int tcc_compile(lua_State *L) {
 
     // Implementations
     for (int i = 0; i < count; i++) {
-        process_proto(&B, protos[i].p, protos[i].id, protos, count, use_pure_c, str_encrypt, seed, obfuscate, inline_opt);
+        process_proto(&B, protos[i].p, protos[i].id, protos, count, use_pure_c, str_encrypt, seed, obfuscate, inline_opt, typed_opt);
     }
 
     // Main entry point
@@ -9,6 +9,7 @@
 
 #include "lthread.h"
 #include "lstruct.h"
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -22,13 +23,52 @@ typedef struct {
     char name[64];          /**< Thread name */
 } ThreadHandle;
 
+/* Ring slots of an unbounded channel; values beyond them spill over */
+#define CHANNEL_RING_SIZE 1024
+
+/* Readiness checks before a blocked sender/receiver sleeps */
+#define CHANNEL_SPIN 128
+
+/* How a value is held in a channel slot */
+#define CELL_NIL 0
+#define CELL_BOOL 1
+#define CELL_INT 2
+#define CELL_FLT 3
+#define CELL_LIGHT 4
+#define CELL_REF 5  /* parked in the channel's user value table */
+
+/**
+ * @brief Value carried inline by a channel slot.
+ */
+typedef union CellValue {
+    lua_Integer i;
+    lua_Number n;
+    void *p;
+    int b;
+} CellValue;
+
+/**
+ * @brief Slot in a channel's ring buffer.
+ *
+ * Scalars are carried inline. Other values are parked in the channel's
+ * user value table at the slot's index, so no registry reference is made.
+ */
+typedef struct ChannelCell {
+    atomic_size_t seq;          /**< Sequence number of the MPMC protocol */
+    int tt;                     /**< CELL_* tag of the value */
+    CellValue v;                /**< Inline value */
+} ChannelCell;
+
 /**
- * @brief Element in a channel's linked list.
+ * @brief Value in the spill queue of an unbounded channel.
+ *
+ * A parked value (CELL_REF) sits in the user value table under the
+ * negative key -(v.i + 1), which no ring slot uses.
  */
-typedef struct ChannelElem {
-    int ref;                    /**< Registry reference to the stored value */
-    struct ChannelElem *next;   /**< Next element in the list */
-} ChannelElem;
+typedef struct SpillCell {
+    int tt;                     /**< CELL_* tag of the value */
+    CellValue v;                /**< Inline value, or park id */
+} SpillCell;
 
 /**
  * @brief Selector structure for 'pick' operations.
@@ -49,15 +89,37 @@ typedef struct Listener {
 
 /**
  * @brief Channel structure for thread communication.
+ *
+ * A ring buffer with lock-free enqueue and dequeue (Vyukov's MPMC queue).
+ * A bounded channel blocks senders while the ring is full. An unbounded
+ * one (the default) spills into a queue under the mutex instead, and
+ * keeps sending there until it drains so values stay in order. Otherwise
+ * the mutex is only taken to sleep, to wake sleepers and to manage
+ * listeners.
  */
 typedef struct {
-    l_mutex_t lock;         /**< Mutex for thread safety */
-    l_cond_t cond;          /**< Condition variable for waiting threads */
-    ChannelElem *head;      /**< Head of the message queue */
-    ChannelElem *tail;      /**< Tail of the message queue */
-    int closed;             /**< Flag indicating if the channel is closed */
-    Listener *listeners;    /**< List of listeners waiting on this channel */
-    int type_ref;           /**< Registry reference to the type constraint */
+    l_mutex_t lock;             /**< Protects listeners and sleeping */
+    l_cond_t cond;              /**< Signaled when values arrive */
+    l_cond_t space;             /**< Signaled when slots are freed */
+    atomic_int closed;          /**< Flag indicating if the channel is closed */
+    atomic_int nlisteners;      /**< Number of registered listeners */
+    atomic_int recv_waiting;    /**< Receivers asleep on 'cond' */
+    atomic_int send_waiting;    /**< Senders asleep on 'space' */
+    Listener *listeners;        /**< List of listeners waiting on this channel */
+    int type_ref;               /**< Registry reference to the type constraint */
+    size_t mask;                /**< Number of slots minus one */
+    int bounded;                /**< Senders wait for room in the ring */
+    atomic_size_t nspill;       /**< Values in the spill queue */
+    atomic_size_t spill_id;     /**< Next park id of a spilled value */
+    SpillCell *spill;           /**< Spill queue (circular, under 'lock') */
+    size_t spill_head;          /**< Index of its oldest value */
+    size_t spill_cap;           /**< Its size (0 or a power of two) */
+    char pad0[64];
+    atomic_size_t enqueue_pos;  /**< Next position to write */
+    char pad1[64];
+    atomic_size_t dequeue_pos;  /**< Next position to read */
+    char pad2[64];
+    ChannelCell cells[1];       /**< Ring buffer ('mask' + 1 slots) */
 } Channel;
 
 /**
@@ -293,49 +355,917 @@ static int thread_id(lua_State *L) {
     return 1;
 }
 
+/*
+** {======================================================
+** Isolated worker states (thread.spawn)
+**
+** Unlike 'thread.create', which runs on a coroutine of the caller's
+** global state and therefore serializes on its global lock, 'spawn'
+** runs each worker in a brand new lua_State with its own GC and string
+** table. Arguments and results cross the boundary as a flat byte
+** stream produced by a deep-copy serializer.
+** =======================================================
+*/
+
+/* Tags of the spawn transfer format */
+#define SPAWN_NIL       0
+#define SPAWN_FALSE     1
+#define SPAWN_TRUE      2
+#define SPAWN_INT       3
+#define SPAWN_NUM       4
+#define SPAWN_STR       5
+#define SPAWN_TABLE     6
+#define SPAWN_FUNC      7
+#define SPAWN_BACKREF   8
+#define SPAWN_ENV       9  /* an '_ENV' upvalue: the receiver's globals */
+
+#define SPAWN_MAXDEPTH  200
+
+/**
+ * @brief Growable byte buffer used to marshal values between states.
+ *
+ * Allocated with malloc because it outlives both the caller's stack
+ * frame and, on the way back, the worker state.
+ */
+typedef struct SpawnBuf {
+    char *data;     /**< Buffer contents */
+    size_t len;     /**< Bytes written */
+    size_t cap;     /**< Allocated capacity */
+    size_t pos;     /**< Read position */
+} SpawnBuf;
+
+/**
+ * @brief Handle of a spawned worker.
+ */
+typedef struct {
+    l_thread_t thread;  /**< Native thread handle */
+    SpawnBuf in;        /**< Serialized function and arguments */
+    SpawnBuf out;       /**< Serialized results or error message */
+    int nargs;          /**< Number of arguments in 'in' */
+    int nres;           /**< Number of results in 'out' */
+    int ok;             /**< 1 if the worker finished without error */
+    int started;        /**< 1 if the native thread was created */
+    int joined;         /**< 1 once the native thread has been joined */
+    int consumed;       /**< 1 once the results were delivered */
+} SpawnHandle;
+
+/**
+ * @brief Serialization context (the 'seen' table maps objects to ids).
+ */
+typedef struct SpawnWriter {
+    lua_State *L;
+    SpawnBuf *b;
+    int seen;       /**< Stack index of the object -> id table */
+    int nextid;     /**< Next id to assign */
+} SpawnWriter;
+
+static void spawnbuf_free(SpawnBuf *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = b->pos = 0;
+}
+
+static int spawnbuf_add(SpawnBuf *b, const void *p, size_t sz) {
+    if (b->len + sz > b->cap) {
+        size_t ncap = b->cap ? b->cap * 2 : 256;
+        char *nd;
+        while (ncap < b->len + sz) ncap *= 2;
+        nd = (char *)realloc(b->data, ncap);
+        if (!nd) return 0;
+        b->data = nd;
+        b->cap = ncap;
+    }
+    memcpy(b->data + b->len, p, sz);
+    b->len += sz;
+    return 1;
+}
+
+static void spawn_put(SpawnWriter *w, const void *p, size_t sz) {
+    if (!spawnbuf_add(w->b, p, sz))
+        luaL_error(w->L, "not enough memory to marshal value");
+}
+
+static void spawn_puttag(SpawnWriter *w, unsigned char tag) {
+    spawn_put(w, &tag, 1);
+}
+
+static void spawn_putsize(SpawnWriter *w, size_t sz) {
+    spawn_put(w, &sz, sizeof(sz));
+}
+
+static int spawn_dumpwriter(lua_State *L, const void *p, size_t sz, void *ud) {
+    (void)L;
+    return spawnbuf_add((SpawnBuf *)ud, p, sz) ? 0 : 1;
+}
+
+static void spawn_write(SpawnWriter *w, int idx, int depth);
+
+/**
+ * @brief Writes a back-reference if the object was already serialized,
+ * otherwise assigns it a fresh id.
+ *
+ * @return 1 if a back-reference was written.
+ */
+static int spawn_checkseen(SpawnWriter *w, int idx) {
+    lua_State *L = w->L;
+    lua_pushvalue(L, idx);
+    if (lua_rawget(L, w->seen) == LUA_TNUMBER) {
+        lua_Integer id = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        spawn_puttag(w, SPAWN_BACKREF);
+        spawn_put(w, &id, sizeof(id));
+        return 1;
+    }
+    lua_pop(L, 1);
+    lua_pushvalue(L, idx);
+    lua_pushinteger(L, w->nextid++);
+    lua_rawset(L, w->seen);
+    return 0;
+}
+
+static void spawn_writetable(SpawnWriter *w, int idx, int depth) {
+    lua_State *L = w->L;
+    lua_Integer narr = (lua_Integer)lua_rawlen(L, idx);
+    size_t nentries = 0;
+    size_t countpos;
+    spawn_puttag(w, SPAWN_TABLE);
+    spawn_put(w, &narr, sizeof(narr));
+    countpos = w->b->len;
+    spawn_putsize(w, 0);  /* patched below */
+    lua_pushnil(L);
+    while (lua_next(L, idx) != 0) {
+        int top = lua_gettop(L);
+        spawn_write(w, top - 1, depth + 1);  /* key */
+        spawn_write(w, top, depth + 1);      /* value */
+        lua_pop(L, 1);
+        nentries++;
+    }
+    memcpy(w->b->data + countpos, &nentries, sizeof(nentries));
+}
+
+static void spawn_writefunc(SpawnWriter *w, int idx, int depth) {
+    lua_State *L = w->L;
+    size_t lenpos, start, len;
+    int nup, i;
+    if (lua_iscfunction(L, idx))
+        luaL_error(L, "cannot transfer a C function to a spawned state");
+    spawn_puttag(w, SPAWN_FUNC);
+    lenpos = w->b->len;
+    spawn_putsize(w, 0);  /* patched below */
+    start = w->b->len;
+    lua_pushvalue(L, idx);
+    if (lua_dump(L, spawn_dumpwriter, w->b, 0) != 0)
+        luaL_error(L, "unable to dump function for spawned state");
+    lua_pop(L, 1);
+    len = w->b->len - start;
+    memcpy(w->b->data + lenpos, &len, sizeof(len));
+    /* upvalues: '_ENV' is rebound to the worker's globals */
+    for (nup = 0; lua_getupvalue(L, idx, nup + 1) != NULL; nup++)
+        lua_pop(L, 1);
+    spawn_put(w, &nup, sizeof(nup));
+    for (i = 1; i <= nup; i++) {
+        const char *name = lua_getupvalue(L, idx, i);
+        if (name && strcmp(name, "_ENV") == 0)
+            spawn_puttag(w, SPAWN_ENV);
+        else
+            spawn_write(w, lua_gettop(L), depth + 1);
+        lua_pop(L, 1);
+    }
+}
+
+/**
+ * @brief Serializes the value at 'idx' (deep copy).
+ *
+ * Shared and cyclic tables/functions are preserved through back-refs.
+ */
+static void spawn_write(SpawnWriter *w, int idx, int depth) {
+    lua_State *L = w->L;
+    idx = lua_absindex(L, idx);
+    if (depth > SPAWN_MAXDEPTH)
+        luaL_error(L, "value too deeply nested to transfer");
+    luaL_checkstack(L, 6, "too many nested values");
+    switch (lua_type(L, idx)) {
+        case LUA_TNIL:
+            spawn_puttag(w, SPAWN_NIL);
+            break;
+        case LUA_TBOOLEAN:
+            spawn_puttag(w, lua_toboolean(L, idx) ? SPAWN_TRUE : SPAWN_FALSE);
+            break;
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, idx)) {
+                lua_Integer i = lua_tointeger(L, idx);
+                spawn_puttag(w, SPAWN_INT);
+                spawn_put(w, &i, sizeof(i));
+            } else {
+                lua_Number n = lua_tonumber(L, idx);
+                spawn_puttag(w, SPAWN_NUM);
+                spawn_put(w, &n, sizeof(n));
+            }
+            break;
+        case LUA_TSTRING: {
+            size_t len;
+            const char *s = lua_tolstring(L, idx, &len);
+            spawn_puttag(w, SPAWN_STR);
+            spawn_putsize(w, len);
+            spawn_put(w, s, len);
+            break;
+        }
+        case LUA_TTABLE:
+            if (!spawn_checkseen(w, idx))
+                spawn_writetable(w, idx, depth);
+            break;
+        case LUA_TFUNCTION:
+            if (!spawn_checkseen(w, idx))
+                spawn_writefunc(w, idx, depth);
+            break;
+        default:
+            luaL_error(L, "cannot transfer a %s value to a spawned state",
+                       luaL_typename(L, idx));
+    }
+}
+
+/**
+ * @brief Serializes 'n' values starting at stack index 'first'.
+ */
+static void spawn_serialize(lua_State *L, SpawnBuf *b, int first, int n) {
+    SpawnWriter w;
+    int i;
+    first = lua_absindex(L, first);
+    lua_newtable(L);
+    w.L = L;
+    w.b = b;
+    w.seen = lua_gettop(L);
+    w.nextid = 1;
+    for (i = 0; i < n; i++)
+        spawn_write(&w, first + i, 0);
+    lua_pop(L, 1);
+}
+
+/**
+ * @brief Deserialization context ('refs' holds objects by id).
+ */
+typedef struct SpawnReader {
+    lua_State *L;
+    SpawnBuf *b;
+    int refs;       /**< Stack index of the id -> object table */
+    int nextid;     /**< Id of the next object read */
+} SpawnReader;
+
+static const char *spawn_get(SpawnReader *r, size_t sz) {
+    const char *p;
+    if (r->b->pos + sz > r->b->len)
+        luaL_error(r->L, "corrupted spawn transfer buffer");
+    p = r->b->data + r->b->pos;
+    r->b->pos += sz;
+    return p;
+}
+
+#define spawn_getv(r,T,v)	memcpy(&(v), spawn_get(r, sizeof(T)), sizeof(T))
+
+static void spawn_read(SpawnReader *r);
+
+static void spawn_register(SpawnReader *r) {
+    lua_pushvalue(r->L, -1);
+    lua_rawseti(r->L, r->refs, r->nextid++);
+}
+
+static void spawn_readtable(SpawnReader *r) {
+    lua_State *L = r->L;
+    lua_Integer narr;
+    size_t nentries, i;
+    spawn_getv(r, lua_Integer, narr);
+    spawn_getv(r, size_t, nentries);
+    lua_createtable(L, (int)narr,
+                    nentries > (size_t)narr ? (int)(nentries - (size_t)narr) : 0);
+    spawn_register(r);
+    for (i = 0; i < nentries; i++) {
+        spawn_read(r);  /* key */
+        spawn_read(r);  /* value */
+        lua_rawset(L, -3);
+    }
+}
+
+static void spawn_readfunc(SpawnReader *r) {
+    lua_State *L = r->L;
+    size_t len;
+    const char *code;
+    int nup, i;
+    spawn_getv(r, size_t, len);
+    code = spawn_get(r, len);
+    if (luaL_loadbufferx(L, code, len, "=spawn", "b") != LUA_OK)
+        lua_error(L);
+    spawn_register(r);
+    spawn_getv(r, int, nup);
+    for (i = 1; i <= nup; i++) {
+        spawn_read(r);
+        if (lua_setupvalue(L, -2, i) == NULL)
+            lua_pop(L, 1);
+    }
+}
+
+static void spawn_read(SpawnReader *r) {
+    lua_State *L = r->L;
+    unsigned char tag = (unsigned char)*spawn_get(r, 1);
+    luaL_checkstack(L, 4, "too many nested values");
+    switch (tag) {
+        case SPAWN_NIL: lua_pushnil(L); break;
+        case SPAWN_ENV: lua_pushglobaltable(L); break;
+        case SPAWN_FALSE: lua_pushboolean(L, 0); break;
+        case SPAWN_TRUE: lua_pushboolean(L, 1); break;
+        case SPAWN_INT: {
+            lua_Integer i;
+            spawn_getv(r, lua_Integer, i);
+            lua_pushinteger(L, i);
+            break;
+        }
+        case SPAWN_NUM: {
+            lua_Number n;
+            spawn_getv(r, lua_Number, n);
+            lua_pushnumber(L, n);
+            break;
+        }
+        case SPAWN_STR: {
+            size_t len;
+            spawn_getv(r, size_t, len);
+            lua_pushlstring(L, spawn_get(r, len), len);
+            break;
+        }
+        case SPAWN_TABLE: spawn_readtable(r); break;
+        case SPAWN_FUNC: spawn_readfunc(r); break;
+        case SPAWN_BACKREF: {
+            lua_Integer id;
+            spawn_getv(r, lua_Integer, id);
+            lua_rawgeti(L, r->refs, id);
+            break;
+        }
+        default:
+            luaL_error(L, "corrupted spawn transfer buffer");
+    }
+}
+
+/**
+ * @brief Deserializes 'n' values from 'b', pushing them onto the stack.
+ */
+static void spawn_deserialize(lua_State *L, SpawnBuf *b, int n) {
+    SpawnReader r;
+    int i;
+    luaL_checkstack(L, n + 4, "too many values to transfer");
+    lua_newtable(L);
+    r.L = L;
+    r.b = b;
+    r.refs = lua_gettop(L);
+    r.nextid = 1;
+    b->pos = 0;
+    for (i = 0; i < n; i++)
+        spawn_read(&r);
+    lua_remove(L, r.refs);
+}
+
+/**
+ * @brief Protected body of a spawned worker: decode, call, encode.
+ *
+ * Stack on entry: lightuserdata(SpawnHandle).
+ */
+static int spawn_run(lua_State *L) {
+    SpawnHandle *sh = (SpawnHandle *)lua_touserdata(L, 1);
+    lua_settop(L, 0);
+    spawn_deserialize(L, &sh->in, sh->nargs + 1);
+    lua_call(L, sh->nargs, LUA_MULTRET);
+    sh->nres = lua_gettop(L);
+    spawn_serialize(L, &sh->out, 1, sh->nres);
+    return 0;
+}
+
+/**
+ * @brief Entry point of a spawned worker thread.
+ *
+ * @param arg The SpawnHandle.
+ * @return NULL.
+ */
+static void *spawn_entry(void *arg) {
+    SpawnHandle *sh = (SpawnHandle *)arg;
+    lua_State *L = luaL_newstate();
+    if (L == NULL) {
+        const char *msg = "cannot create state: not enough memory";
+        spawnbuf_add(&sh->out, msg, strlen(msg));
+        return NULL;
+    }
+    luaL_openlibs(L);
+    lua_pushcfunction(L, spawn_run);
+    lua_pushlightuserdata(L, sh);
+    if (lua_pcall(L, 1, 0, 0) == LUA_OK) {
+        sh->ok = 1;
+    } else {
+        size_t len;
+        const char *msg = lua_tolstring(L, -1, &len);
+        if (msg == NULL) {
+            msg = "(error object is not a string)";
+            len = strlen(msg);
+        }
+        spawnbuf_free(&sh->out);
+        sh->nres = 0;
+        spawnbuf_add(&sh->out, msg, len);
+    }
+    lua_close(L);
+    return NULL;
+}
+
+/**
+ * @brief Spawns a function in a new, independent Lua state.
+ *
+ * The function and arguments are deep-copied into the worker; upvalues
+ * other than _ENV are copied as well. C functions, userdata and
+ * coroutines cannot be transferred.
+ *
+ * Usage: thread.spawn(func, ...)
+ *
+ * @param L The Lua state.
+ * @return 1 (the spawn handle).
+ */
+static int thread_spawn(lua_State *L) {
+    int n = lua_gettop(L);
+    SpawnHandle *sh;
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+
+    sh = (SpawnHandle *)lua_newuserdata(L, sizeof(SpawnHandle));
+    memset(sh, 0, sizeof(SpawnHandle));
+    luaL_getmetatable(L, "lthread.spawn");
+    lua_setmetatable(L, -2);
+
+    spawn_serialize(L, &sh->in, 1, n);
+    sh->nargs = n - 1;
+
+    if (l_thread_create(&sh->thread, spawn_entry, sh) != 0) {
+        spawnbuf_free(&sh->in);
+        return luaL_error(L, "failed to create thread");
+    }
+    sh->started = 1;
+    return 1;
+}
+
+static void spawn_wait(SpawnHandle *sh) {
+    if (sh->started && !sh->joined) {
+        l_thread_join(sh->thread, NULL);
+        sh->joined = 1;
+        spawnbuf_free(&sh->in);
+    }
+}
+
+/**
+ * @brief Waits for a spawned worker and returns its results.
+ *
+ * Errors raised inside the worker are re-raised in the caller.
+ *
+ * Usage: sp:join()
+ *
+ * @param L The Lua state.
+ * @return Number of results returned by the worker function.
+ */
+static int spawn_join(lua_State *L) {
+    SpawnHandle *sh = (SpawnHandle *)luaL_checkudata(L, 1, "lthread.spawn");
+    if (sh->consumed) {
+        return luaL_error(L, "thread already joined");
+    }
+    spawn_wait(sh);
+    sh->consumed = 1;
+    if (!sh->ok) {
+        lua_pushlstring(L, sh->out.data ? sh->out.data : "", sh->out.len);
+        spawnbuf_free(&sh->out);
+        return lua_error(L);
+    }
+    spawn_deserialize(L, &sh->out, sh->nres);
+    spawnbuf_free(&sh->out);
+    return sh->nres;
+}
+
+/**
+ * @brief Garbage collector for spawn handles (joins pending workers).
+ */
+static int spawn_gc(lua_State *L) {
+    SpawnHandle *sh = (SpawnHandle *)luaL_checkudata(L, 1, "lthread.spawn");
+    spawn_wait(sh);
+    spawnbuf_free(&sh->in);
+    spawnbuf_free(&sh->out);
+    return 0;
+}
+
+/* }====================================================== */
+
+/*
+** {======================================================
+** Channels
+** =======================================================
+*/
+
+/**
+ * @brief Claims the next slot to write; returns NULL if the ring is full.
+ */
+static ChannelCell *ring_claim_send(Channel *ch, size_t *ppos) {
+    size_t pos = atomic_load_explicit(&ch->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        ChannelCell *c = &ch->cells[pos & ch->mask];
+        size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        ptrdiff_t dif = (ptrdiff_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ch->enqueue_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                *ppos = pos;
+                return c;
+            }
+        } else if (dif < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&ch->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Claims the next slot to read; returns NULL if the ring is empty.
+ */
+static ChannelCell *ring_claim_recv(Channel *ch, size_t *ppos) {
+    size_t pos = atomic_load_explicit(&ch->dequeue_pos, memory_order_relaxed);
+    for (;;) {
+        ChannelCell *c = &ch->cells[pos & ch->mask];
+        size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        ptrdiff_t dif = (ptrdiff_t)(seq - (pos + 1));
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ch->dequeue_pos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                *ppos = pos;
+                return c;
+            }
+        } else if (dif < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&ch->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+/** @brief Checks whether a value is ready at the read position. */
+static int ring_can_recv(Channel *ch) {
+    size_t pos = atomic_load_explicit(&ch->dequeue_pos, memory_order_relaxed);
+    ChannelCell *c = &ch->cells[pos & ch->mask];
+    return atomic_load_explicit(&c->seq, memory_order_acquire) == pos + 1;
+}
+
+/** @brief Checks whether a slot is free at the write position. */
+static int ring_can_send(Channel *ch) {
+    size_t pos = atomic_load_explicit(&ch->enqueue_pos, memory_order_relaxed);
+    ChannelCell *c = &ch->cells[pos & ch->mask];
+    return atomic_load_explicit(&c->seq, memory_order_acquire) == pos;
+}
+
+/** @brief Checks whether a value is ready in the ring or the spill queue. */
+static int channel_can_recv(Channel *ch) {
+    return ring_can_recv(ch) || atomic_load(&ch->nspill) > 0;
+}
+
+/**
+ * @brief Encodes the value at 'idx' into 'v' if it is a scalar.
+ * @return Its CELL_* tag, CELL_REF if it has to be parked.
+ */
+static int cell_encode(lua_State *L, int idx, CellValue *v) {
+    switch (lua_type(L, idx)) {
+        case LUA_TNIL:
+            return CELL_NIL;
+        case LUA_TBOOLEAN:
+            v->b = lua_toboolean(L, idx);
+            return CELL_BOOL;
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, idx)) {
+                v->i = lua_tointeger(L, idx);
+                return CELL_INT;
+            }
+            v->n = lua_tonumber(L, idx);
+            return CELL_FLT;
+        case LUA_TLIGHTUSERDATA:
+            v->p = lua_touserdata(L, idx);
+            return CELL_LIGHT;
+        default:
+            return CELL_REF;
+    }
+}
+
+/** @brief Pushes a scalar encoded by 'cell_encode'. */
+static void cell_decode(lua_State *L, int tt, const CellValue *v) {
+    switch (tt) {
+        case CELL_BOOL: lua_pushboolean(L, v->b); break;
+        case CELL_INT: lua_pushinteger(L, v->i); break;
+        case CELL_FLT: lua_pushnumber(L, v->n); break;
+        case CELL_LIGHT: lua_pushlightuserdata(L, v->p); break;
+        default: lua_pushnil(L); break;
+    }
+}
+
+/**
+ * @brief Stores the value at 'idx' into the claimed cell 'c'.
+ *
+ * Cannot raise: the user value table was created with one array slot per
+ * cell, so parking a value never allocates.
+ */
+static void cell_store(lua_State *L, Channel *ch, int chidx, ChannelCell *c,
+                       size_t pos, int idx) {
+    c->tt = cell_encode(L, idx, &c->v);
+    if (c->tt == CELL_REF) {
+        lua_getiuservalue(L, chidx, 1);
+        lua_pushvalue(L, idx);
+        lua_rawseti(L, -2, (lua_Integer)(pos & ch->mask) + 1);
+        lua_pop(L, 1);
+    }
+}
+
+/**
+ * @brief Pushes the value parked under 'key'; if 'take', also drops the
+ * channel's reference to it.
+ */
+static void cell_unpark(lua_State *L, int chidx, lua_Integer key, int take) {
+    lua_getiuservalue(L, chidx, 1);
+    lua_rawgeti(L, -1, key);
+    if (take) {
+        lua_pushnil(L);
+        lua_rawseti(L, -3, key);
+    }
+    lua_remove(L, -2);
+}
+
+/** @brief Pushes the value held in the claimed cell 'c'. */
+static void cell_load(lua_State *L, Channel *ch, int chidx, ChannelCell *c, size_t pos) {
+    if (c->tt == CELL_REF)
+        cell_unpark(L, chidx, (lua_Integer)(pos & ch->mask) + 1, 1);
+    else
+        cell_decode(L, c->tt, &c->v);
+}
+
+/* user value key of the spilled value parked with id 'id' */
+#define spill_key(id)	(-(lua_Integer)(id) - 1)
+
+/**
+ * @brief Appends the value at 'idx' to the spill queue.
+ *
+ * A non-scalar value is parked first, outside the mutex, under a key
+ * only this call uses; the mutex then only covers the C-side queue.
+ */
+static void spill_push(lua_State *L, Channel *ch, int chidx, int idx) {
+    SpillCell cell;
+    size_t n;
+    cell.tt = cell_encode(L, idx, &cell.v);
+    if (cell.tt == CELL_REF) {
+        size_t id = atomic_fetch_add(&ch->spill_id, 1);
+        cell.v.i = (lua_Integer)id;
+        lua_getiuservalue(L, chidx, 1);
+        lua_pushvalue(L, idx);
+        lua_rawseti(L, -2, spill_key(id));
+        lua_pop(L, 1);
+    }
+    l_mutex_lock(&ch->lock);
+    n = atomic_load(&ch->nspill);
+    if (n == ch->spill_cap) {  /* full: grow and unwrap */
+        size_t ncap = ch->spill_cap ? ch->spill_cap * 2 : 64, i;
+        SpillCell *ns = (SpillCell *)malloc(ncap * sizeof(SpillCell));
+        if (ns == NULL) {
+            l_mutex_unlock(&ch->lock);
+            if (cell.tt == CELL_REF) {
+                cell_unpark(L, chidx, spill_key(cell.v.i), 1);
+                lua_pop(L, 1);
+            }
+            luaL_error(L, "not enough memory");
+            return;
+        }
+        for (i = 0; i < n; i++)
+            ns[i] = ch->spill[(ch->spill_head + i) & (ch->spill_cap - 1)];
+        free(ch->spill);
+        ch->spill = ns;
+        ch->spill_head = 0;
+        ch->spill_cap = ncap;
+    }
+    ch->spill[(ch->spill_head + n) & (ch->spill_cap - 1)] = cell;
+    atomic_store(&ch->nspill, n + 1);
+    l_mutex_unlock(&ch->lock);
+}
+
+/**
+ * @brief Copies the oldest spilled value into '*cell', removing it if
+ * 'take'. Returns 0 if the spill queue is empty.
+ */
+static int spill_front(Channel *ch, SpillCell *cell, int take) {
+    size_t n;
+    l_mutex_lock(&ch->lock);
+    n = atomic_load(&ch->nspill);
+    if (n > 0) {
+        *cell = ch->spill[ch->spill_head];
+        if (take) {
+            ch->spill_head = (ch->spill_head + 1) & (ch->spill_cap - 1);
+            atomic_store(&ch->nspill, n - 1);
+        }
+    }
+    l_mutex_unlock(&ch->lock);
+    return n > 0;
+}
+
+/** @brief Pushes a value copied by 'spill_front'. */
+static void spill_load(lua_State *L, int chidx, const SpillCell *cell, int take) {
+    if (cell->tt == CELL_REF)
+        cell_unpark(L, chidx, spill_key(cell->v.i), take);
+    else
+        cell_decode(L, cell->tt, &cell->v);
+}
+
+/**
+ * @brief Wakes threads waiting on 'cond' (and selectors, if 'listeners'),
+ * taking the lock only when someone may be asleep.
+ */
+static void channel_notify(Channel *ch, l_cond_t *cond, atomic_int *waiting,
+                           int listeners, int all) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed) == 0 &&
+        (!listeners || atomic_load_explicit(&ch->nlisteners, memory_order_relaxed) == 0))
+        return;
+    l_mutex_lock(&ch->lock);
+    if (all)
+        l_cond_broadcast(cond);
+    else
+        l_cond_signal(cond);
+    if (listeners) {
+        Listener *l = ch->listeners;
+        while (l) {
+            l_mutex_lock(&l->sel->lock);
+            l->sel->signaled = 1;
+            l_cond_signal(&l->sel->cond);
+            l_mutex_unlock(&l->sel->lock);
+            l = l->next;
+        }
+    }
+    l_mutex_unlock(&ch->lock);
+}
+
+/**
+ * @brief Blocks until 'ready' holds or the channel is closed. Spins
+ * briefly first, since the other side is often just about to act.
+ */
+static void channel_sleep(Channel *ch, l_cond_t *cond, atomic_int *waiting,
+                          int (*ready)(Channel *)) {
+    int i;
+    for (i = 0; i < CHANNEL_SPIN; i++) {
+        if (ready(ch) || atomic_load(&ch->closed))
+            return;
+    }
+    l_mutex_lock(&ch->lock);
+    atomic_fetch_add(waiting, 1);
+    while (!ready(ch) && !atomic_load(&ch->closed))
+        l_cond_wait(cond, &ch->lock);
+    atomic_fetch_sub(waiting, 1);
+    l_mutex_unlock(&ch->lock);
+}
+
+/**
+ * @brief Enqueues the value at 'idx'. Returns 0 if the channel is
+ * bounded, its ring is full and 'block' is false.
+ */
+static int channel_put(lua_State *L, Channel *ch, int chidx, int idx, int block) {
+    ChannelCell *c;
+    size_t pos;
+    for (;;) {
+        if (atomic_load(&ch->closed))
+            return luaL_error(L, "channel is closed");
+        c = (ch->bounded || atomic_load(&ch->nspill) == 0)
+            ? ring_claim_send(ch, &pos) : NULL;
+        if (c != NULL)
+            break;
+        if (!ch->bounded) {  /* spill rather than wait */
+            spill_push(L, ch, chidx, idx);
+            return 1;
+        }
+        if (!block)
+            return 0;
+        channel_sleep(ch, &ch->space, &ch->send_waiting, ring_can_send);
+    }
+    cell_store(L, ch, chidx, c, pos, idx);
+    atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+    return 1;
+}
+
+/**
+ * @brief Dequeues one value and pushes it. Returns 0 (pushing nothing) if
+ * the channel is empty and either 'block' is false or it is closed.
+ */
+static int channel_get(lua_State *L, Channel *ch, int chidx, int block) {
+    ChannelCell *c;
+    SpillCell sc;
+    size_t pos;
+    for (;;) {
+        c = ring_claim_recv(ch, &pos);
+        if (c != NULL)
+            break;
+        if (spill_front(ch, &sc, 1)) {  /* ring drained: older values first */
+            spill_load(L, chidx, &sc, 1);
+            return 1;
+        }
+        if (atomic_load(&ch->closed)) {
+            c = ring_claim_recv(ch, &pos);  /* a send may have raced the close */
+            if (c != NULL)
+                break;
+            if (spill_front(ch, &sc, 1)) {
+                spill_load(L, chidx, &sc, 1);
+                return 1;
+            }
+            return 0;
+        }
+        if (!block)
+            return 0;
+        channel_sleep(ch, &ch->cond, &ch->recv_waiting, channel_can_recv);
+    }
+    cell_load(L, ch, chidx, c, pos);
+    atomic_store_explicit(&c->seq, pos + ch->mask + 1, memory_order_release);
+    return 1;
+}
+
 /**
  * @brief Internal implementation of channel creation.
  *
  * @param L The Lua state.
  * @param type_idx Index of the type specifier.
+ * @param capacity Requested capacity (rounded up to a power of two), or
+ * 0 for an unbounded channel.
  * @return 1 (the channel object).
  */
-static int channel_create_impl(lua_State *L, int type_idx) {
-    Channel *ch = (Channel *)lua_newuserdata(L, sizeof(Channel));
+static int channel_create_impl(lua_State *L, int type_idx, lua_Integer capacity) {
+    size_t n = 2, i;
+    if (capacity < 0 || capacity > (1 << 24))
+        return luaL_error(L, "channel capacity out of range");
+    while (n < (size_t)(capacity ? capacity : CHANNEL_RING_SIZE))
+        n <<= 1;
+    Channel *ch = (Channel *)lua_newuserdatauv(L,
+        offsetof(Channel, cells) + n * sizeof(ChannelCell), 1);
     l_mutex_init(&ch->lock);
     l_cond_init(&ch->cond);
-    ch->head = NULL;
-    ch->tail = NULL;
-    ch->closed = 0;
+    l_cond_init(&ch->space);
+    atomic_init(&ch->closed, 0);
+    atomic_init(&ch->nlisteners, 0);
+    atomic_init(&ch->recv_waiting, 0);
+    atomic_init(&ch->send_waiting, 0);
     ch->listeners = NULL;
     ch->type_ref = LUA_NOREF;
+    ch->mask = n - 1;
+    ch->bounded = (capacity != 0);
+    atomic_init(&ch->nspill, 0);
+    atomic_init(&ch->spill_id, 0);
+    ch->spill = NULL;
+    ch->spill_head = ch->spill_cap = 0;
+    atomic_init(&ch->enqueue_pos, 0);
+    atomic_init(&ch->dequeue_pos, 0);
+    for (i = 0; i < n; i++)
+        atomic_init(&ch->cells[i].seq, i);
+    luaL_getmetatable(L, "lthread.channel");
+    lua_setmetatable(L, -2);
+    lua_createtable(L, (int)n, 0);  /* slots for non-scalar values */
+    lua_setiuservalue(L, -2, 1);
     if (type_idx != 0) {
         lua_pushvalue(L, type_idx);
         ch->type_ref = luaL_ref(L, LUA_REGISTRYINDEX);
     }
-    luaL_getmetatable(L, "lthread.channel");
-    lua_setmetatable(L, -2);
     return 1;
 }
 
+/**
+ * @brief Checks the capacity argument of a bounded channel.
+ */
+static lua_Integer channel_checkcap(lua_State *L, int arg) {
+    lua_Integer capacity = luaL_checkinteger(L, arg);
+    if (capacity < 1)
+        luaL_error(L, "channel capacity out of range");
+    return capacity;
+}
+
 /**
  * @brief Helper for factory calls.
  */
 static int channel_factory_call(lua_State *L) {
-    return channel_create_impl(L, lua_upvalueindex(1));
+    if (lua_isnoneornil(L, 1))
+        return channel_create_impl(L, lua_upvalueindex(1), 0);
+    return channel_create_impl(L, lua_upvalueindex(1), channel_checkcap(L, 1));
 }
 
 /**
  * @brief Creates a new channel.
  *
- * Usage: thread.channel([type])
+ * Without arguments, creates an unbounded channel: sends never block.
+ * With a number, creates a bounded channel of that capacity, whose
+ * senders block while it is full. With a type specifier, returns a
+ * constructor for channels checked against it, which takes an optional
+ * capacity.
+ *
+ * Usage: thread.channel([capacity]) or thread.channel(type)([capacity])
  *
  * @param L The Lua state.
  * @return The channel object.
  */
 static int thread_channel(lua_State *L) {
     if (lua_gettop(L) == 0) {
-        return channel_create_impl(L, 0);
+        return channel_create_impl(L, 0, 0);
+    } else if (lua_type(L, 1) == LUA_TNUMBER) {
+        return channel_create_impl(L, 0, channel_checkcap(L, 1));
     } else {
         lua_pushvalue(L, 1);
         lua_pushcclosure(L, channel_factory_call, 1);
@@ -352,15 +1282,6 @@ static int thread_channel(lua_State *L) {
 static int channel_gc(lua_State *L) {
     Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
     l_mutex_lock(&ch->lock);
-    ChannelElem *curr = ch->head;
-    while (curr) {
-        ChannelElem *next = curr->next;
-        luaL_unref(L, LUA_REGISTRYINDEX, curr->ref);
-        free(curr);
-        curr = next;
-    }
-    ch->head = NULL;
-    ch->tail = NULL;
     Listener *l = ch->listeners;
     while (l) {
         Listener *next = l->next;
@@ -370,10 +1291,15 @@ static int channel_gc(lua_State *L) {
     ch->listeners = NULL;
     if (ch->type_ref != LUA_NOREF) {
         luaL_unref(L, LUA_REGISTRYINDEX, ch->type_ref);
+        ch->type_ref = LUA_NOREF;
     }
+    free(ch->spill);
+    ch->spill = NULL;
+    ch->spill_cap = 0;
     l_mutex_unlock(&ch->lock);
     l_mutex_destroy(&ch->lock);
     l_cond_destroy(&ch->cond);
+    l_cond_destroy(&ch->space);
     return 0;
 }
 
@@ -407,7 +1333,20 @@ static int check_type_match(lua_State *L, int type_idx, int val_idx) {
 }
 
 /**
- * @brief Sends a value to the channel (blocking).
+ * @brief Checks the value at 'idx' against the channel's type constraint.
+ */
+static int channel_typecheck(lua_State *L, Channel *ch, int idx) {
+    int ok;
+    if (ch->type_ref == LUA_NOREF)
+        return 1;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, ch->type_ref);
+    ok = check_type_match(L, lua_gettop(L), idx);
+    lua_pop(L, 1);
+    return ok;
+}
+
+/**
+ * @brief Sends a value to the channel, blocking while it is full.
  *
  * Usage: ch:send(val) or ch:push(val)
  *
@@ -418,51 +1357,12 @@ static int channel_send(lua_State *L) {
     Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
     luaL_checkany(L, 2);
 
-    if (ch->type_ref != LUA_NOREF) {
-        lua_rawgeti(L, LUA_REGISTRYINDEX, ch->type_ref);
-        if (!check_type_match(L, -1, 2)) {
-             return luaL_error(L, "channel type mismatch");
-        }
-        lua_pop(L, 1);
-    }
-
-    int ref = luaL_ref(L, LUA_REGISTRYINDEX); // pops value
-
-    ChannelElem *elem = (ChannelElem *)malloc(sizeof(ChannelElem));
-    if (!elem) {
-        luaL_unref(L, LUA_REGISTRYINDEX, ref);
-        return luaL_error(L, "out of memory");
+    if (!channel_typecheck(L, ch, 2)) {
+        return luaL_error(L, "channel type mismatch");
     }
-    elem->ref = ref;
-    elem->next = NULL;
 
-    l_mutex_lock(&ch->lock);
-    if (ch->closed) {
-        l_mutex_unlock(&ch->lock);
-        free(elem);
-        luaL_unref(L, LUA_REGISTRYINDEX, ref);
-        return luaL_error(L, "channel is closed");
-    }
-
-    if (ch->tail) {
-        ch->tail->next = elem;
-        ch->tail = elem;
-    } else {
-        ch->head = ch->tail = elem;
-    }
-
-    l_cond_signal(&ch->cond);
-
-    Listener *l = ch->listeners;
-    while (l) {
-        l_mutex_lock(&l->sel->lock);
-        l->sel->signaled = 1;
-        l_cond_signal(&l->sel->cond);
-        l_mutex_unlock(&l->sel->lock);
-        l = l->next;
-    }
-
-    l_mutex_unlock(&ch->lock);
+    channel_put(L, ch, 1, 2, 1);
+    channel_notify(ch, &ch->cond, &ch->recv_waiting, 1, 0);
     return 0;
 }
 
@@ -472,67 +1372,56 @@ static int channel_send(lua_State *L) {
  * Usage: ch:try_send(val)
  *
  * @param L The Lua state.
- * @return true on success, false otherwise.
+ * @return true on success, false if the channel is full, closed or the
+ * value has the wrong type.
  */
 static int channel_try_send(lua_State *L) {
     Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
     luaL_checkany(L, 2);
 
-    if (ch->type_ref != LUA_NOREF) {
-        lua_rawgeti(L, LUA_REGISTRYINDEX, ch->type_ref);
-        if (!check_type_match(L, -1, 2)) {
-             lua_pop(L, 1);
-             lua_pushboolean(L, 0);
-             return 1;
-        }
-        lua_pop(L, 1);
-    }
-
-    int ref = luaL_ref(L, LUA_REGISTRYINDEX); // pops value
-
-    ChannelElem *elem = (ChannelElem *)malloc(sizeof(ChannelElem));
-    if (!elem) {
-        luaL_unref(L, LUA_REGISTRYINDEX, ref);
-        return luaL_error(L, "out of memory");
-    }
-    elem->ref = ref;
-    elem->next = NULL;
-
-    if (l_mutex_trylock(&ch->lock) != 0) {
-        free(elem);
-        luaL_unref(L, LUA_REGISTRYINDEX, ref);
-        lua_pushboolean(L, 0);
-        return 1;
-    }
-
-    if (ch->closed) {
-        l_mutex_unlock(&ch->lock);
-        free(elem);
-        luaL_unref(L, LUA_REGISTRYINDEX, ref);
+    if (!channel_typecheck(L, ch, 2) || atomic_load(&ch->closed) ||
+        !channel_put(L, ch, 1, 2, 0)) {
         lua_pushboolean(L, 0);
         return 1;
     }
 
-    if (ch->tail) {
-        ch->tail->next = elem;
-        ch->tail = elem;
-    } else {
-        ch->head = ch->tail = elem;
-    }
-
-    l_cond_signal(&ch->cond);
+    channel_notify(ch, &ch->cond, &ch->recv_waiting, 1, 0);
+    lua_pushboolean(L, 1);
+    return 1;
+}
 
-    Listener *l = ch->listeners;
-    while (l) {
-        l_mutex_lock(&l->sel->lock);
-        l->sel->signaled = 1;
-        l_cond_signal(&l->sel->cond);
-        l_mutex_unlock(&l->sel->lock);
-        l = l->next;
+/**
+ * @brief Sends t[i..j] in order, blocking while the channel is full.
+ * Receivers are woken once per batch rather than once per value.
+ *
+ * Usage: ch:send_many(t [, i [, j]])
+ *
+ * @param L The Lua state.
+ * @return The number of values sent.
+ */
+static int channel_send_many(lua_State *L) {
+    Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_Integer i = luaL_optinteger(L, 3, 1);
+    lua_Integer j = luaL_opt(L, luaL_checkinteger, 4, (lua_Integer)lua_rawlen(L, 2));
+    lua_Integer k;
+    lua_settop(L, 2);
+
+    for (k = i; k <= j; k++) {
+        lua_rawgeti(L, 2, k);
+        if (!channel_typecheck(L, ch, 3)) {
+            channel_notify(ch, &ch->cond, &ch->recv_waiting, 1, 1);
+            return luaL_error(L, "channel type mismatch (element %d)", (int)k);
+        }
+        if (!channel_put(L, ch, 1, 3, 0)) {  /* full: wake receivers, then wait */
+            channel_notify(ch, &ch->cond, &ch->recv_waiting, 1, 1);
+            channel_put(L, ch, 1, 3, 1);
+        }
+        lua_pop(L, 1);
     }
 
-    l_mutex_unlock(&ch->lock);
-    lua_pushboolean(L, 1);
+    channel_notify(ch, &ch->cond, &ch->recv_waiting, 1, 1);
+    lua_pushinteger(L, j >= i ? j - i + 1 : 0);
     return 1;
 }
 
@@ -547,28 +1436,11 @@ static int channel_try_send(lua_State *L) {
 static int channel_receive(lua_State *L) {
     Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
 
-    l_mutex_lock(&ch->lock);
-    while (ch->head == NULL) {
-        if (ch->closed) {
-            l_mutex_unlock(&ch->lock);
-            lua_pushnil(L);
-            return 1;
-        }
-        l_cond_wait(&ch->cond, &ch->lock);
-    }
-
-    ChannelElem *elem = ch->head;
-    ch->head = elem->next;
-    if (ch->head == NULL) {
-        ch->tail = NULL;
+    if (!channel_get(L, ch, 1, 1)) {
+        lua_pushnil(L);
+        return 1;
     }
-
-    int ref = elem->ref;
-    free(elem);
-    l_mutex_unlock(&ch->lock);
-
-    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
-    luaL_unref(L, LUA_REGISTRYINDEX, ref);
+    channel_notify(ch, &ch->space, &ch->send_waiting, 0, 0);
     return 1;
 }
 
@@ -583,26 +1455,48 @@ static int channel_receive(lua_State *L) {
 static int channel_try_receive(lua_State *L) {
     Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
 
-    l_mutex_lock(&ch->lock);
-    if (ch->head == NULL) {
-        l_mutex_unlock(&ch->lock);
+    if (!channel_get(L, ch, 1, 0)) {
         lua_pushnil(L);
         return 1;
     }
+    channel_notify(ch, &ch->space, &ch->send_waiting, 0, 0);
+    return 1;
+}
 
-    ChannelElem *elem = ch->head;
-    ch->head = elem->next;
-    if (ch->head == NULL) {
-        ch->tail = NULL;
+/**
+ * @brief Receives up to n values. Blocks until at least one is available,
+ * then takes whatever else is ready without blocking.
+ *
+ * Usage: ch:recv_many(n [, t])
+ *
+ * @param L The Lua state.
+ * @return A sequence of the values received (t, if given) and their
+ * count, or nil if the channel is closed and empty.
+ */
+static int channel_recv_many(lua_State *L) {
+    Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
+    lua_Integer n = luaL_checkinteger(L, 2);
+    lua_Integer got = 0;
+    luaL_argcheck(L, n >= 1, 2, "must be positive");
+    if (lua_isnoneornil(L, 3)) {
+        lua_settop(L, 2);
+        lua_createtable(L, n < 64 ? (int)n : 64, 0);
+    } else {
+        luaL_checktype(L, 3, LUA_TTABLE);
+        lua_settop(L, 3);
     }
 
-    int ref = elem->ref;
-    free(elem);
-    l_mutex_unlock(&ch->lock);
+    while (got < n && channel_get(L, ch, 1, got == 0)) {
+        lua_rawseti(L, 3, ++got);
+    }
 
-    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
-    luaL_unref(L, LUA_REGISTRYINDEX, ref);
-    return 1;
+    if (got == 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    channel_notify(ch, &ch->space, &ch->send_waiting, 0, 1);
+    lua_pushinteger(L, got);
+    return 2;
 }
 
 /**
@@ -616,8 +1510,9 @@ static int channel_try_receive(lua_State *L) {
 static int channel_close(lua_State *L) {
     Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
     l_mutex_lock(&ch->lock);
-    ch->closed = 1;
+    atomic_store(&ch->closed, 1);
     l_cond_broadcast(&ch->cond);
+    l_cond_broadcast(&ch->space);
 
     Listener *l = ch->listeners;
     while (l) {
@@ -642,13 +1537,58 @@ static int channel_close(lua_State *L) {
  */
 static int channel_peek(lua_State *L) {
     Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
-    l_mutex_lock(&ch->lock);
-    if (ch->head) {
-        lua_rawgeti(L, LUA_REGISTRYINDEX, ch->head->ref);
-    } else {
-        lua_pushnil(L);
+    for (;;) {
+        size_t pos = atomic_load(&ch->dequeue_pos);
+        ChannelCell *c = &ch->cells[pos & ch->mask];
+        if (atomic_load_explicit(&c->seq, memory_order_acquire) != pos + 1) {
+            SpillCell sc;
+            if (spill_front(ch, &sc, 0))
+                spill_load(L, 1, &sc, 0);
+            else
+                lua_pushnil(L);
+            return 1;
+        }
+        if (c->tt == CELL_REF)
+            cell_unpark(L, 1, (lua_Integer)(pos & ch->mask) + 1, 0);
+        else
+            cell_decode(L, c->tt, &c->v);
+        if (atomic_load(&c->seq) == pos + 1 && atomic_load(&ch->dequeue_pos) == pos)
+            return 1;  /* not consumed meanwhile */
+        lua_pop(L, 1);
     }
-    l_mutex_unlock(&ch->lock);
+}
+
+/**
+ * @brief Returns the number of values currently queued.
+ *
+ * Usage: ch:count()
+ *
+ * @param L The Lua state.
+ * @return The count.
+ */
+static int channel_count(lua_State *L) {
+    Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
+    size_t tail = atomic_load(&ch->enqueue_pos);
+    size_t head = atomic_load(&ch->dequeue_pos);
+    size_t n = tail > head ? tail - head : 0;
+    lua_pushinteger(L, (lua_Integer)(n + atomic_load(&ch->nspill)));
+    return 1;
+}
+
+/**
+ * @brief Returns the capacity of the channel.
+ *
+ * Usage: ch:capacity()
+ *
+ * @param L The Lua state.
+ * @return The capacity (math.huge if the channel is unbounded).
+ */
+static int channel_capacity(lua_State *L) {
+    Channel *ch = (Channel *)luaL_checkudata(L, 1, "lthread.channel");
+    if (ch->bounded)
+        lua_pushinteger(L, (lua_Integer)ch->mask + 1);
+    else
+        lua_pushnumber(L, (lua_Number)HUGE_VAL);
     return 1;
 }
 
@@ -739,6 +1679,7 @@ static void unregister_all(lua_State *L, int tab_idx, Selector *sel) {
                         Listener *rem = *pp;
                         *pp = rem->next;
                         free(rem);
+                        atomic_fetch_sub(&ch->nlisteners, 1);
                         break;
                     }
                     pp = &(*pp)->next;
@@ -750,6 +1691,24 @@ static void unregister_all(lua_State *L, int tab_idx, Selector *sel) {
     }
 }
 
+/**
+ * @brief Takes a value from the channel at 'chidx' for 'pick'.
+ *
+ * @return 1 with the value (nil if the channel is closed) pushed, or 0 if
+ * the channel is empty.
+ */
+static int pick_take(lua_State *L, Channel *ch, int chidx) {
+    if (channel_get(L, ch, chidx, 0)) {
+        channel_notify(ch, &ch->space, &ch->send_waiting, 0, 0);
+        return 1;
+    }
+    if (atomic_load(&ch->closed)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    return 0;
+}
+
 /**
  * @brief Selects one of multiple channel operations to perform.
  *
@@ -792,7 +1751,7 @@ static int thread_pick(lua_State *L) {
         }
         if (strcmp(op, "recv") == 0) {
             lua_getfield(L, -2, "ch");
-            if (lua_isnil(L, -1) || !lua_touserdata(L, -1)) {
+            if (luaL_testudata(L, -1, "lthread.channel") == NULL) {
                  l_mutex_destroy(&sel.lock);
                  l_cond_destroy(&sel.cond);
                  return luaL_error(L, "missing or invalid channel in recv op (index %d)", i);
@@ -828,43 +1787,29 @@ static int thread_pick(lua_State *L) {
         if (strcmp(op, "recv") == 0) {
             lua_getfield(L, -1, "ch");
             Channel *ch = (Channel *)lua_touserdata(L, -1);
-            lua_pop(L, 1);
 
+            /* register before looking, so that a concurrent send is not missed */
+            Listener *l = malloc(sizeof(Listener));
             l_mutex_lock(&ch->lock);
-            if (ch->head || ch->closed) {
-                int ref = LUA_NOREF;
-                int closed = ch->closed;
-                if (ch->head) {
-                    ChannelElem *elem = ch->head;
-                    ch->head = elem->next;
-                    if (ch->head == NULL) ch->tail = NULL;
-                    ref = elem->ref;
-                    free(elem);
-                }
-                l_mutex_unlock(&ch->lock);
+            if (l) {
+                l->sel = &sel;
+                l->next = ch->listeners;
+                ch->listeners = l;
+                atomic_fetch_add(&ch->nlisteners, 1);
+            }
+            l_mutex_unlock(&ch->lock);
 
+            if (pick_take(L, ch, lua_gettop(L))) {
                 unregister_all(L, 1, &sel);
                 l_mutex_destroy(&sel.lock);
                 l_cond_destroy(&sel.cond);
 
-                lua_rawgeti(L, -2, 2);
-                if (closed && ref == LUA_NOREF) {
-                    lua_pushnil(L);
-                } else {
-                    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
-                    luaL_unref(L, LUA_REGISTRYINDEX, ref);
-                }
+                lua_rawgeti(L, -4, 2);
+                lua_insert(L, -2);
                 lua_call(L, 1, 1);
                 return 1;
             }
-
-            Listener *l = malloc(sizeof(Listener));
-            if (l) {
-                l->sel = &sel;
-                l->next = ch->listeners;
-                ch->listeners = l;
-            }
-            l_mutex_unlock(&ch->lock);
+            lua_pop(L, 1);
         }
         lua_pop(L, 2);
     }
@@ -906,32 +1851,14 @@ static int thread_pick(lua_State *L) {
         if (op && strcmp(op, "recv") == 0) {
             lua_getfield(L, -1, "ch");
             Channel *ch = (Channel *)lua_touserdata(L, -1);
-            lua_pop(L, 1);
-
-            l_mutex_lock(&ch->lock);
-            if (ch->head || ch->closed) {
-                int ref = LUA_NOREF;
-                int closed = ch->closed;
-                if (ch->head) {
-                    ChannelElem *elem = ch->head;
-                    ch->head = elem->next;
-                    if (ch->head == NULL) ch->tail = NULL;
-                    ref = elem->ref;
-                    free(elem);
-                }
-                l_mutex_unlock(&ch->lock);
 
-                lua_rawgeti(L, -2, 2);
-                if (closed && ref == LUA_NOREF) {
-                    lua_pushnil(L);
-                } else {
-                    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
-                    luaL_unref(L, LUA_REGISTRYINDEX, ref);
-                }
+            if (pick_take(L, ch, lua_gettop(L))) {
+                lua_rawgeti(L, -4, 2);
+                lua_insert(L, -2);
                 lua_call(L, 1, 1);
                 return 1;
             }
-            l_mutex_unlock(&ch->lock);
+            lua_pop(L, 1);
         }
         lua_pop(L, 2);
     }
@@ -939,6 +1866,8 @@ static int thread_pick(lua_State *L) {
     return 0;
 }
 
+/* }====================================================== */
+
 static const luaL_Reg thread_methods[] = {
     {"join", thread_join},
     {"name", thread_name},
@@ -946,6 +1875,12 @@ static const luaL_Reg thread_methods[] = {
     {NULL, NULL}
 };
 
+static const luaL_Reg spawn_methods[] = {
+    {"join", spawn_join},
+    {"__gc", spawn_gc},
+    {NULL, NULL}
+};
+
 static const luaL_Reg channel_methods[] = {
     {"send", channel_send},
     {"receive", channel_receive},
@@ -954,6 +1889,10 @@ static const luaL_Reg channel_methods[] = {
     {"pop", channel_receive},
     {"push", channel_send},
     {"peek", channel_peek},
+    {"send_many", channel_send_many},
+    {"recv_many", channel_recv_many},
+    {"count", channel_count},
+    {"capacity", channel_capacity},
     {"recv_op", channel_recv_op},
     {"close", channel_close},
     {"__gc", channel_gc},
@@ -963,6 +1902,7 @@ static const luaL_Reg channel_methods[] = {
 static const luaL_Reg thread_funcs[] = {
     {"create", thread_create},
     {"createx", thread_createx},
+    {"spawn", thread_spawn},
     {"channel", thread_channel},
     {"pick", thread_pick},
     {"on", thread_on},
@@ -984,6 +1924,11 @@ int luaopen_thread(lua_State *L) {
     lua_setfield(L, -2, "__index");
     luaL_setfuncs(L, thread_methods, 0);
 
+    luaL_newmetatable(L, "lthread.spawn");
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    luaL_setfuncs(L, spawn_methods, 0);
+
     luaL_newmetatable(L, "lthread.channel");
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
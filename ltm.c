@@ -14,6 +14,7 @@
 
 #include "lua.h"
 
+#include "lbigint.h"
 #include "ldebug.h"
 #include "ldo.h"
 #include "lgc.h"
@@ -164,6 +165,9 @@ static int callbinTM (lua_State *L, const TValue *p1, const TValue *p2,
 
 void luaT_trybinTM (lua_State *L, const TValue *p1, const TValue *p2,
                     StkId res, TMS event) {
+  if ((ttisbigint(p1) || ttisbigint(p2)) &&  /* big integers are native */
+      luaO_rawarith(L, cast_int(event - TM_ADD) + LUA_OPADD, p1, p2, s2v(res)))
+    return;
   if (l_unlikely(callbinTM(L, p1, p2, res, event) < 0)) {
     switch (event) {
       case TM_BAND: case TM_BOR: case TM_BXOR:
@@ -214,7 +218,12 @@ void luaT_trybiniTM (lua_State *L, const TValue *p1, lua_Integer i2,
 */
 int luaT_callorderTM (lua_State *L, const TValue *p1, const TValue *p2,
                       TMS event) {
-  int tag = callbinTM(L, p1, p2, L->top.p, event);  /* try original event */
+  int tag;
+  if ((ttisbigint(p1) || ttisbigint(p2)) && ttisnumber(p1) && ttisnumber(p2)) {
+    int c = luaB_compare((TValue *)p1, (TValue *)p2);
+    return (event == TM_LT) ? (c < 0) : (c <= 0);
+  }
+  tag = callbinTM(L, p1, p2, L->top.p, event);  /* try original event */
   if (tag >= 0)  /* found tag method? */
     return !tagisfalse(tag);
   luaG_ordererror(L, p1, p2);  /* no metamethod found */
@@ -20,6 +20,7 @@
 #include "lstate.h"
 #include "lfunc.h"
 #include "lopcodes.h"
+#include "lvm.h"
 #include "lopnames.h"
 
 /* 辅助函数：获取操作码名称 */
@@ -155,7 +156,7 @@ static int l_gfi(lua_State *L) {
     /* 遍历所有指令 */
     int pc;
     for (pc = 0; pc < f->sizecode; pc++) {
-        Instruction i = f->code[pc];
+        Instruction i = luaV_getinst(f, pc);
         OpCode o = GET_OPCODE(i);
         
         /* 创建一个表来存储当前指令的信息 */
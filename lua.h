@@ -1006,6 +1006,20 @@ LUA_API int (lua_dump_obfuscated) (lua_State *L, lua_Writer writer, void *data,
                                    int strip, int obfuscate_flags, unsigned int seed,
                                    const char *log_path);
 
+/**
+ * @brief Dumps a function in the fast-loading container format.
+ *
+ * @param L The Lua state.
+ * @param writer Writer function.
+ * @param data User data for writer.
+ * @param strip Whether to strip debug information.
+ * @param obfuscate_flags Flags for obfuscation.
+ * @param seed Random seed.
+ * @return Status code.
+ */
+LUA_API int (lua_dump_fast) (lua_State *L, lua_Writer writer, void *data,
+                             int strip, int obfuscate_flags, unsigned int seed);
+
 
 /*
 ** coroutine functions
@@ -1648,6 +1662,40 @@ LUA_API int (lua_gethookmask) (lua_State *L);
  */
 LUA_API int (lua_gethookcount) (lua_State *L);
 
+/**
+ * @brief Sets the hook called when a breakpoint is hit.
+ *
+ * The hook is shared by all threads and receives a LUA_HOOKLINE event.
+ *
+ * @param L The Lua state.
+ * @param func Hook function (NULL to ignore breakpoints).
+ */
+LUA_API void (lua_setbreakhook) (lua_State *L, lua_Hook func);
+
+/**
+ * @brief Returns the breakpoint hook.
+ *
+ * @param L The Lua state.
+ * @return The hook function.
+ */
+LUA_API lua_Hook (lua_getbreakhook) (lua_State *L);
+
+/**
+ * @brief Sets or clears a breakpoint.
+ *
+ * Instructions that start the line are replaced by traps in every chunk
+ * loaded from a file with that name (its last path component), including
+ * chunks loaded later; other code runs at full speed.
+ *
+ * @param L The Lua state.
+ * @param name Source file name.
+ * @param line Line number.
+ * @param on Nonzero to set the breakpoint, zero to clear it.
+ * @return Number of instructions patched or restored.
+ */
+LUA_API int (lua_setbreakpoint) (lua_State *L, const char *name, int line,
+                                               int on);
+
 /**
  * @brief Sets the C stack limit.
  *
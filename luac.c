@@ -37,6 +37,7 @@ static int listing=0;			/* list bytecodes? */
 static int dumping=1;			/* dump bytecodes? */
 static int stripping=0;			/* strip debug information? */
 static int obfuscate_flags=0;		/* obfuscation flags */
+static int fastformat=0;		/* fast-loading container format? */
 static char Output[]={ OUTPUT };	/* default output file name */
 static const char* output=Output;	/* actual output file name */
 static const char* progname=PROGNAME;	/* actual program name */
@@ -70,6 +71,7 @@ static void usage(const char* message)
   "  -f       enable control flow flattening\n"
   "  -b       enable binary search dispatcher (implies -f)\n"
   "  -O mask  enable obfuscation flags by bitmask\n"
+  "  -F       write the fast-loading container format\n"
   "  -v       show version information\n"
   "  --       stop handling options\n"
   "  -        stop handling options and process stdin\n"
@@ -119,6 +121,8 @@ static int doargs(int argc, char* argv[])
    if (mask == NULL || *mask == 0) usage("'-O' needs argument");
    obfuscate_flags |= strtol(mask, NULL, 0);
   }
+  else if (IS("-F"))			/* fast-loading format */
+   fastformat=1;
   else if (IS("-v"))			/* show version */
    ++version;
   else					/* unknown option */
@@ -201,7 +205,9 @@ static int pmain(lua_State* L)
   FILE* D= (output==NULL) ? stdout : fopen(output,"wb");
   if (D==NULL) cannot("open");
   lua_lock(L);
-  if (obfuscate_flags)
+  if (fastformat)
+   luaU_dump_fast(L,f,writer,D,stripping,obfuscate_flags,0);
+  else if (obfuscate_flags)
    luaU_dump_obfuscated(L,f,writer,D,stripping,obfuscate_flags,0,NULL);
   else
    luaU_dump(L,f,writer,D,stripping);
@@ -579,6 +585,13 @@ static void PrintCode(const Proto* f)
 	printf("%d",GETARG_sJ(i));
 	printf(COMMENT "to %d",GETARG_sJ(i)+pc+2);
 	break;
+   case OP_SWITCH:
+	printf("%d %d",a,bx);
+	printf(COMMENT "%s, default to %d",
+	       f->switches[bx].keys ? "map" : "dense",f->switches[bx].deflt+1);
+	break;
+   case OP_TRAP:  /* only in live code with a breakpoint; no operands */
+	break;
    case OP_EQ:
 	printf("%d %d %d",a,b,isk);
 	break;
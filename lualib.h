@@ -246,6 +246,19 @@ LUAMOD_API int (luaopen_translator) (lua_State *L);
  */
 LUAMOD_API int (luaopen_lexer) (lua_State *L);
 
+/**
+ * @brief Name of the JSON library.
+ */
+#define LUA_JSONLIBNAME	"json"
+
+/**
+ * @brief Opens the JSON library.
+ *
+ * @param L The Lua state.
+ * @return 1 (the library table).
+ */
+LUAMOD_API int (luaopen_json) (lua_State *L);
+
 /**
  * @brief Name of the service manager library.
  */
@@ -66,6 +66,12 @@ typedef struct {
   const char *mem_base;
   size_t mem_offset;
   size_t mem_size;
+
+  /* Fast container format (LUAC_FORMAT_FAST) */
+  int fast;
+  lu_byte key[8];  /* chunk-wide key */
+  lu_byte opdec[NUM_OPCODES];  /* stored opcode -> real opcode */
+  lu_byte strdec[8][256];  /* per-position string decode tables */
 } LoadState;
 
 
@@ -171,6 +177,48 @@ static lua_Integer loadInteger (LoadState *S) {
 }
 
 
+/*
+** Return a view of the next 'size' bytes of the in-memory segments.
+*/
+static const lu_byte *loadView (LoadState *S, size_t size) {
+  const lu_byte *p;
+  lua_assert(S->mem_base != NULL);
+  if (size > S->mem_size - S->mem_offset)
+    error(S, "truncated chunk (memory block)");
+  p = cast(const lu_byte *, S->mem_base + S->mem_offset);
+  S->mem_offset += size;
+  return p;
+}
+
+
+static void decodeStringFast (LoadState *S, char *dst, const lu_byte *src,
+                              size_t size) {
+  for (size_t i = 0; i < size; i++)
+    dst[i] = cast_char(S->strdec[i & 7][src[i]]);
+}
+
+
+/*
+** Fast format strings: plain bytes under the chunk's shared map, decoded
+** straight from the segment into their final place.
+*/
+static TString *loadStringFast (LoadState *S, size_t size) {
+  lua_State *L = S->L;
+  const lu_byte *src = loadView(S, size);
+  TString *ts;
+  if (size <= LUAI_MAXSHORTLEN) {
+    char buff[LUAI_MAXSHORTLEN];
+    decodeStringFast(S, buff, src, size);
+    ts = luaS_newlstr(L, buff, size);
+  }
+  else {
+    ts = luaS_createlngstrobj(L, size);
+    decodeStringFast(S, ts->contents, src, size);
+  }
+  return ts;
+}
+
+
 /*
 ** Load a nullable string into prototype 'p'.
 */
@@ -180,6 +228,8 @@ static TString *loadStringN (LoadState *S, Proto *p) {
   size_t size = loadSize(S);
   if (size == 0)  /* no string? */
     return NULL;
+  else if (S->fast)
+    ts = loadStringFast(S, size - 1);
   else if (--size <= LUAI_MAXSHORTLEN) {  /* short string? */
     /* 读取该字符串专用的时间戳 */
     loadVar(S, S->timestamp);
@@ -420,6 +470,74 @@ static void loadCode (LoadState *S, Proto *f) {
 }
 
 
+/*
+** Fast format code: little-endian 64-bit words XORed with the chunk key,
+** decoded a word at a time with a single combined opcode table.
+*/
+static void loadCodeFast (LoadState *S, Proto *f) {
+  int n = loadInt(S);
+  const lu_byte *src;
+  int i;
+  if (cast_sizet(n) > (S->mem_size - S->mem_offset) / 8)
+    error(S, "truncated chunk (code)");
+  src = loadView(S, cast_sizet(n) * 8);
+  f->code = luaM_newvectorchecked(S->L, n, Instruction);
+  f->sizecode = n;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  {
+    Instruction key;
+    memcpy(&key, S->key, 8);
+    memcpy(f->code, src, cast_sizet(n) * 8);
+    for (i = 0; i < n; i++)
+      f->code[i] ^= key;
+  }
+#else
+  for (i = 0; i < n; i++) {
+    Instruction inst = 0;
+    for (int j = 0; j < 8; j++)
+      inst |= cast(Instruction, src[i * 8 + j] ^ S->key[j]) << (j * 8);
+    f->code[i] = inst;
+  }
+#endif
+  for (i = 0; i < n; i++) {
+    Instruction inst = f->code[i];
+    OpCode op = GET_OPCODE(inst);
+    if (l_unlikely(op >= NUM_OPCODES))
+      error(S, "bad opcode");
+    SET_OPCODE(inst, S->opdec[op]);
+    f->code[i] = inst;
+  }
+}
+
+
+/*
+** Read the fast format's shared key and maps (once per chunk) and
+** precombine them into the decode tables.
+*/
+static void loadSharedMaps (LoadState *S) {
+  lu_byte rev[NUM_OPCODES], third[NUM_OPCODES], rthird[NUM_OPCODES];
+  lu_byte smap[256], rsmap[256];
+  int i, k;
+  loadVector(S, S->key, 8);
+  loadVector(S, rev, NUM_OPCODES);
+  loadVector(S, third, NUM_OPCODES);
+  loadVector(S, smap, 256);
+  memset(rthird, 0, sizeof(rthird));
+  for (i = 0; i < NUM_OPCODES; i++) {
+    if (third[i] >= NUM_OPCODES || rev[i] >= NUM_OPCODES)
+      error(S, "bad opcode map");
+    rthird[third[i]] = cast_byte(i);
+  }
+  for (i = 0; i < NUM_OPCODES; i++)
+    S->opdec[i] = rev[rthird[i]];
+  for (i = 0; i < 256; i++)
+    rsmap[smap[i]] = cast_byte(i);
+  for (k = 0; k < 8; k++)
+    for (i = 0; i < 256; i++)
+      S->strdec[k][i] = rsmap[i ^ S->key[k]];
+}
+
+
 static void loadSegmented(LoadState *S, Proto *main_f);
 
 
@@ -459,6 +577,41 @@ static void loadConstants (LoadState *S, Proto *f) {
 }
 
 
+static void loadSwitches (LoadState *S, Proto *f) {
+  int i, j;
+  int ns = loadInt(S);
+  for (i = 0; i < ns; i++) {
+    int deflt = loadInt(S);
+    int n = loadInt(S);
+    SwitchCase *cases = luaM_newvectorchecked(S->L, n, SwitchCase);
+    for (j = 0; j < n; j++) {
+      TValue *key = &cases[j].key;
+      switch (loadByte(S)) {
+        case LUA_VNUMINT:
+          setivalue(key, loadInteger(S));
+          break;
+        case LUA_VSHRSTR: {
+          TString *ts = loadString(S, f);  /* also in 'k', so anchored */
+          if (ts->tt != LUA_VSHRSTR)
+            error(S, "bad format for switch label");
+          setsvalue(S->L, key, ts);
+          break;
+        }
+        default:
+          error(S, "bad format for switch label");
+      }
+      cases[j].pc = loadInt(S);
+      if (cases[j].pc < 0 || cases[j].pc >= f->sizecode)
+        error(S, "bad switch target");
+    }
+    if (deflt < 0 || deflt >= f->sizecode)
+      error(S, "bad switch target");
+    luaF_newswitch(S->L, f, cases, n, deflt);
+    luaM_freearray(S->L, cases, n);
+  }
+}
+
+
 static void loadProtos (LoadState *S, Proto *f) {
   /* In segmented mode, protos are reconstructed via ProtoRef segment */
 }
@@ -482,6 +635,8 @@ static void loadUpvalues (LoadState *S, Proto *f) {
     f->upvalues[i].idx = loadByte(S);
     f->upvalues[i].kind = loadByte(S);
   }
+  if (S->fast)  /* covered by the chunk digest */
+    return;
   
   /* 增强的防导入验证机制 */
   int anti_import_count = loadInt(S);
@@ -593,6 +748,8 @@ static void loadDebug (LoadState *S, Proto *f) {
     n = f->sizeupvalues;  /* must be this many */
   for (i = 0; i < n; i++)
     f->upvalues[i].name = loadStringN(S, f);
+  if (S->fast)
+    return;
   /* 跳过虚假数据：跳过我们在dumpDebug函数中添加的虚假调试信息 */
   int fake_debug_count = loadInt(S);  /* 读取虚假调试信息的数量 */
   for (i = 0; i < fake_debug_count; i++) {
@@ -614,12 +771,25 @@ static void loadSegmented(LoadState *S, Proto *main_f) {
   size_t len_protoref = loadSize(S);
   size_t len_debug = loadSize(S);
 
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  if (S->fast)
+    loadVector(S, digest, SHA256_DIGEST_SIZE);
+
   size_t total_size = len_meta + len_code + len_const + len_upval + len_protoref + len_debug;
   char *mem_base = (char *)luaM_malloc_(S->L, total_size, 0);
 
   /* Load all data into memory at once */
   loadBlock(S, mem_base, total_size);
 
+  if (S->fast) {  /* verify the whole chunk once */
+    uint8_t actual[SHA256_DIGEST_SIZE];
+    SHA256((uint8_t *)mem_base, total_size, actual);
+    if (memcmp(actual, digest, SHA256_DIGEST_SIZE) != 0) {
+      luaM_free_(S->L, mem_base, total_size);
+      error(S, "chunk integrity verification failed");
+    }
+  }
+
   /* Enable segmented memory reading */
   S->mem_base = mem_base;
   S->mem_size = total_size;
@@ -634,6 +804,8 @@ static void loadSegmented(LoadState *S, Proto *main_f) {
 
   /* Parse Meta Section */
   S->mem_offset = base_meta;
+  if (S->fast)
+    loadSharedMaps(S);
   int count = loadInt(S);
   Proto **protos = (Proto **)luaM_malloc_(S->L, count * sizeof(Proto*), 0);
   
@@ -652,7 +824,8 @@ static void loadSegmented(LoadState *S, Proto *main_f) {
     size_t off_protoref = loadSize(S);
     size_t off_debug = loadSize(S);
 
-    loadVar(S, S->timestamp);
+    if (!S->fast)
+      loadVar(S, S->timestamp);
     f->numparams = loadByte(S);
     f->is_vararg = loadByte(S);
     f->maxstacksize = loadByte(S);
@@ -689,11 +862,15 @@ static void loadSegmented(LoadState *S, Proto *main_f) {
 
     /* Load Code */
     S->mem_offset = base_code + off_code;
-    loadCode(S, f);
+    if (S->fast)
+      loadCodeFast(S, f);
+    else
+      loadCode(S, f);
 
     /* Load Constants */
     S->mem_offset = base_const + off_const;
     loadConstants(S, f);
+    loadSwitches(S, f);
 
     /* Load Upvalues */
     S->mem_offset = base_upval + off_upval;
@@ -1149,8 +1326,9 @@ static void checkHeader (LoadState *S) {
   lu_byte version = loadByte(S);
   lu_byte format = loadByte(S);
   
-  if (format != LUAC_FORMAT)
+  if (format > LUAC_FORMAT_FAST)  /* older formats are told apart below */
     error(S, "format mismatch");
+  S->fast = (format == LUAC_FORMAT_FAST);
   
   /* check LUAC_DATA */
   const char *original_data = LUAC_DATA;
@@ -1178,6 +1356,9 @@ static void checkHeader (LoadState *S) {
     /* b2 (lua_Integer size) verified by detection */
     /* Note: zgetc consumed b2, so we skip checksize(S, lua_Integer) reading */
 
+    if (format != LUAC_FORMAT && format != LUAC_FORMAT_FAST)
+      error(S, "format mismatch (chunk from an older version, recompile it)");
+
     if (loadByte(S) != 8) /* Check lua_Number size (fixed to 8) */
       error(S, "float size mismatch");
 
@@ -1189,6 +1370,8 @@ static void checkHeader (LoadState *S) {
 
   } else {
     S->is_standard = 1;
+    if (format != LUAC_FORMAT_STD)
+      error(S, "format mismatch");
     S->offset = 14; /* Update offset: Sig(4)+Ver(1)+Fmt(1)+Data(6)+b1(1)+b2(1) = 14 */
 
     if (version != LUAC_VERSION_STD)
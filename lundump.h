@@ -23,7 +23,17 @@
 */
 #define LUAC_VERSION  (((LUA_VERSION_NUM / 100) * 16) + LUA_VERSION_NUM % 100)
 
-#define LUAC_FORMAT	0	/* this is the official format */
+/*
+** Format byte. Official Lua chunks carry LUAC_FORMAT_STD; ours carry a
+** different value, raised whenever the opcode set or the chunk layout
+** changes, so a chunk from an older build fails with a clear error
+** instead of in the opcode maps.
+** 2/3: OP_SWITCH and the switch-table section.
+** 4/5: OP_TRAP (never dumped, but it widens the opcode maps).
+*/
+#define LUAC_FORMAT_STD	0	/* this is the official format */
+#define LUAC_FORMAT	4	/* segmented format */
+#define LUAC_FORMAT_FAST	5	/* shared maps, one chunk-level digest */
 
 /* load one chunk; from lundump.c */
 LUAI_FUNC LClosure* luaU_undump (lua_State* L, ZIO* Z, const char* name, int force_standard);
@@ -41,4 +51,9 @@ LUAI_FUNC int luaU_dump_obfuscated (lua_State* L, const Proto* f, lua_Writer w,
                                     void* data, int strip, int obfuscate_flags,
                                     unsigned int seed, const char *log_path);
 
+/* dump one chunk in the fast-loading container format; from ldump.c */
+LUAI_FUNC int luaU_dump_fast (lua_State* L, const Proto* f, lua_Writer w,
+                              void* data, int strip, int obfuscate_flags,
+                              unsigned int seed);
+
 #endif
@@ -62,7 +62,83 @@
 
 /* Helper functions for new opcodes */
 
-static int check_subtype_internal(lua_State *L, const TValue *val, const TValue *type_obj) {
+/*
+** Builtin type names of OP_CHECKTYPE, with the tag bits (see
+** 'luaV_typebits') of the values each one accepts. The parser resolves
+** these names to their index ("type code") when nothing shadows them.
+*/
+static const struct {
+  const char *name;
+  unsigned int mask;
+} builtintypes[] = {
+  {"any", ~0u},
+  {"int", LUAV_TINTBIT},
+  {"integer", LUAV_TINTBIT},
+  {"number", 1u << LUA_TNUMBER},
+  {"float", 1u << LUA_TNUMBER},
+  {"string", 1u << LUA_TSTRING},
+  {"boolean", 1u << LUA_TBOOLEAN},
+  {"table", 1u << LUA_TTABLE},
+  {"function", 1u << LUA_TFUNCTION},
+  {"thread", 1u << LUA_TTHREAD},
+  {"userdata", 1u << LUA_TUSERDATA},
+  {"nil", 1u << LUA_TNIL},
+  {"void", 1u << LUA_TNIL}
+};
+
+#define NBUILTINTYPES	cast_int(sizeof(builtintypes) / sizeof(builtintypes[0]))
+
+
+int luaV_typecode (const char *name) {
+  int i;
+  for (i = 0; i < NBUILTINTYPES; i++) {
+    if (strcmp(name, builtintypes[i].name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+
+unsigned int luaV_typemask (int code) {
+  return (code >= 0 && code < NBUILTINTYPES) ? builtintypes[code].mask : 0u;
+}
+
+
+const char *luaV_typename (int code) {
+  return (code >= 0 && code < NBUILTINTYPES) ? builtintypes[code].name : NULL;
+}
+
+
+/* class of a class instance (its '__class' field), or NULL */
+static GCObject *classof (lua_State *L, const TValue *v) {
+  TString *isobj, *clskey;
+  GCObject *cls = NULL;
+  Table *h;
+  if (!ttistable(v))
+    return NULL;
+  isobj = luaS_new(L, OBJ_KEY_ISOBJ);
+  clskey = luaS_new(L, OBJ_KEY_CLASS);
+  h = hvalue(v);
+  l_rwlock_t *hlk = luaH_rdlock(h);
+  if (!l_isfalse(luaH_getshortstr(h, isobj))) {
+    const TValue *c = luaH_getshortstr(h, clskey);
+    if (ttistable(c))
+      cls = gcvalue(c);
+  }
+  luaH_unlock(hlk);
+  return cls;
+}
+
+
+/*
+** Full check of 'val' against the type operand 'type_obj'. When the
+** answer only depends on 'type_obj' (a builtin type name, or the
+** 'string'/'table' library standing for its type), '*mask' gets the
+** tag bits it accepts; when 'val' is a class instance that passes,
+** '*cls' gets its class.
+*/
+static int check_subtype_internal(lua_State *L, const TValue *val, const TValue *type_obj,
+                                  unsigned int *mask, GCObject **cls) {
     lua_lock(L);
     setobj2s(L, L->top.p, val);
     L->top.p++;
@@ -70,38 +146,32 @@ static int check_subtype_internal(lua_State *L, const TValue *val, const TValue
     L->top.p++;
     lua_unlock(L);
 
-    int val_idx = -2;
-    int type_idx = -1;
+    int val_idx = lua_absindex(L, -2);
+    int type_idx = lua_absindex(L, -1);
 
     int res = 0;
     if (lua_type(L, type_idx) == LUA_TSTRING) {
-        const char *tname = lua_tostring(L, type_idx);
-        if (strcmp(tname, "any") == 0) res = 1;
-        else if (strcmp(tname, "int") == 0 || strcmp(tname, "integer") == 0) res = lua_isinteger(L, val_idx);
-        else if (strcmp(tname, "number") == 0) res = (lua_type(L, val_idx) == LUA_TNUMBER);
-        else if (strcmp(tname, "float") == 0) res = (lua_type(L, val_idx) == LUA_TNUMBER);
-        else if (strcmp(tname, "string") == 0) res = (lua_type(L, val_idx) == LUA_TSTRING);
-        else if (strcmp(tname, "boolean") == 0) res = (lua_type(L, val_idx) == LUA_TBOOLEAN);
-        else if (strcmp(tname, "table") == 0) res = (lua_type(L, val_idx) == LUA_TTABLE);
-        else if (strcmp(tname, "function") == 0) res = (lua_type(L, val_idx) == LUA_TFUNCTION);
-        else if (strcmp(tname, "thread") == 0) res = (lua_type(L, val_idx) == LUA_TTHREAD);
-        else if (strcmp(tname, "userdata") == 0) res = (lua_type(L, val_idx) == LUA_TUSERDATA);
-        else if (strcmp(tname, "nil") == 0 || strcmp(tname, "void") == 0) res = (lua_type(L, val_idx) == LUA_TNIL);
+        *mask = luaV_typemask(luaV_typecode(lua_tostring(L, type_idx)));
+        res = (*mask & luaV_typebits(s2v(L->top.p - 2))) != 0;
     }
     else if (lua_type(L, type_idx) == LUA_TTABLE) {
         lua_getglobal(L, "string");
         if (lua_rawequal(L, -1, type_idx)) {
             lua_pop(L, 1);
+            *mask = 1u << LUA_TSTRING;
             res = (lua_type(L, val_idx) == LUA_TSTRING);
         } else {
             lua_pop(L, 1);
             lua_getglobal(L, "table");
             if (lua_rawequal(L, -1, type_idx)) {
                 lua_pop(L, 1);
+                *mask = 1u << LUA_TTABLE;
                 res = (lua_type(L, val_idx) == LUA_TTABLE);
             } else {
                 lua_pop(L, 1);
                 res = luaC_instanceof(L, val_idx, type_idx);
+                if (res)
+                    *cls = classof(L, s2v(L->top.p - 2));
             }
         }
     }
@@ -121,6 +191,74 @@ static int check_subtype_internal(lua_State *L, const TValue *val, const TValue
     return res;
 }
 
+
+/*
+** Inline cache of the current OP_CHECKTYPE instruction, or NULL if the
+** prototype has not allocated its caches yet.
+*/
+#define typeIC(p)  \
+	((p)->typeic != NULL && pcRel(pc, p) < (p)->sizetypeic \
+	   ? &(p)->typeic[pcRel(pc, p)] : NULL)
+
+
+static TypeIC *gettypeic (lua_State *L, Proto *p, int pc) {
+  if (p->typeic == NULL && p->sizecode > 0) {
+    TypeIC *ic = luaM_newvector(L, p->sizecode, TypeIC);
+    memset(ic, 0, p->sizecode * sizeof(TypeIC));
+    p->typeic = ic;
+    p->sizetypeic = p->sizecode;
+  }
+  return (pc >= 0 && pc < p->sizetypeic) ? &p->typeic[pc] : NULL;
+}
+
+
+/*
+** Slow path of OP_CHECKTYPE. A passing check fills the inline cache of
+** the instruction, so that checking the same type operand again is a
+** mask test (or, for classes, a comparison with the class seen last).
+** As the cache only depends on the type operand, an entry stays right
+** whatever instruction reads it.
+*/
+static void checkparamtype (lua_State *L, CallInfo *ci, Instruction i) {
+  Proto *p = ci_func(ci)->p;
+  const char *expected = "unknown";
+  TValue *rb;
+  luaD_checkstack(L, LUA_MINSTACK);
+  if (GETARG_k(i))  /* builtin type, already tested by the fast path */
+    expected = luaV_typename(GETARG_B(i));
+  else {
+    unsigned int mask = 0;
+    GCObject *cls = NULL;
+    StkId base = ci->func.p + 1;
+    if (check_subtype_internal(L, s2v(base + GETARG_A(i)),
+                               s2v(base + GETARG_B(i)), &mask, &cls)) {
+      rb = s2v(ci->func.p + 1 + GETARG_B(i));
+      if (iscollectable(rb) && (mask != 0 || cls != NULL)) {
+        TypeIC *ic = gettypeic(L, p, pcRel(ci->u.l.savedpc, p));
+        if (ic != NULL) {
+          ic->type = gcvalue(rb);
+          ic->mask = mask;
+          ic->cls = cls;
+          luaC_objbarrier(L, p, ic->type);
+          if (cls != NULL)
+            luaC_objbarrier(L, p, cls);
+        }
+      }
+      return;
+    }
+    rb = s2v(ci->func.p + 1 + GETARG_B(i));
+    if (ttisstring(rb)) expected = getstr(tsvalue(rb));
+    else if (ttistable(rb)) {
+      TString *key_name = luaS_newliteral(L, "__name");
+      const TValue *res = luaH_getstr(hvalue(rb), key_name);
+      if (ttisstring(res)) expected = getstr(tsvalue(res));
+    }
+  }
+  luaG_runerror(L, "Type mismatch for argument '%s': expected %s, got %s",
+                getstr(tsvalue(&p->k[GETARG_C(i)])), expected,
+                luaT_objtypename(L, s2v(ci->func.p + 1 + GETARG_A(i))));
+}
+
 static int lvm_async_start(lua_State *L) {
     int n = lua_gettop(L);
     lua_State *co = lua_newthread(L);
@@ -801,29 +939,14 @@ void luaV_finishget (lua_State *L, const TValue *t, TValue *key, StkId val,
       if (ttistable(t)) {
          Table *h = hvalue(t);
 
-         if (h->using_next) {
-            Namespace *ns = h->using_next;
-            do {
-               Table *nth = ns->data;
-               if (nth) {
-                  if (nth->is_shared) l_rwlock_rdlock(&nth->lock);
-                  const TValue *res = luaH_get(nth, key);
-                  if (!isempty(res)) {
-                     setobj2s(L, val, res);
-                     if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-                     return;
-                  }
-                  if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-               }
-               ns = ns->using_next;
-            } while (ns);
-         }
+         if (h->using_next && luaN_get(L, h->using_next, key, val))
+            return;
 
-         if (h->is_shared) l_rwlock_rdlock(&h->lock);
+         l_rwlock_t *hlk = luaH_rdlock(h);
          const TValue *res = luaH_get(h, key);
          if (!isempty(res)) {
             setobj2s(L, val, res);
-            if (h->is_shared) l_rwlock_unlock(&h->lock);
+            luaH_unlock(hlk);
             return;
          }
          tm = fasttm(L, h->metatable, TM_INDEX);
@@ -832,28 +955,14 @@ void luaV_finishget (lua_State *L, const TValue *t, TValue *key, StkId val,
             tm = fasttm(L, G(L)->mt[LUA_TTABLE], TM_INDEX);
          }
          if (tm == NULL) {
-            if (h->is_shared) l_rwlock_unlock(&h->lock);
+            luaH_unlock(hlk);
             setnilvalue(s2v(val));
             return;
          }
-         if (h->is_shared) l_rwlock_unlock(&h->lock);
+         luaH_unlock(hlk);
       } else if (ttisnamespace(t)) {
-        Namespace *ns = nsvalue(t);
-        do {
-           Table *h = ns->data;
-           if (h) {
-              if (h->is_shared) l_rwlock_rdlock(&h->lock);
-              const TValue *res = luaH_get(h, key);
-              if (!isempty(res)) {
-                 setobj2s(L, val, res);
-                 if (h->is_shared) l_rwlock_unlock(&h->lock);
-                 return;
-              }
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
-           }
-           ns = ns->using_next;
-        } while (ns);
-        setnilvalue(s2v(val));
+        if (!luaN_get(L, nsvalue(t), key, val))
+          setnilvalue(s2v(val));
         return;
       } else if (ttissuperstruct(t)) {
         SuperStruct *ss = superstructvalue(t);
@@ -903,25 +1012,10 @@ void luaV_finishget (lua_State *L, const TValue *t, TValue *key, StkId val,
       Table *h = hvalue(t);
       lua_assert(isempty(slot));
 
-      if (h->using_next) {
-         Namespace *ns = h->using_next;
-         do {
-            Table *nth = ns->data;
-            if (nth) {
-               if (nth->is_shared) l_rwlock_rdlock(&nth->lock);
-               const TValue *res = luaH_get(nth, key);
-               if (!isempty(res)) {
-                  setobj2s(L, val, res);
-                  if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-                  return;
-               }
-               if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-            }
-            ns = ns->using_next;
-         } while (ns);
-      }
+      if (h->using_next && luaN_get(L, h->using_next, key, val))
+         return;
 
-      if (h->is_shared) l_rwlock_rdlock(&h->lock);
+      l_rwlock_t *hlk = luaH_rdlock(h);
       tm = fasttm(L, h->metatable, TM_INDEX);  /* table's metamethod */
       if (tm == LUA_NULLPTR) /* no __index? try __mindex */
         tm = fasttm(L, h->metatable, TM_MINDEX);
@@ -929,11 +1023,11 @@ void luaV_finishget (lua_State *L, const TValue *t, TValue *key, StkId val,
         tm = fasttm(L, G(L)->mt[LUA_TTABLE], TM_INDEX);
       }
       if (tm == LUA_NULLPTR) {  /* no metamethod? */
-        if (h->is_shared) l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         setnilvalue(s2v(val));  /* result is nil */
         return;
       }
-      if (h->is_shared) l_rwlock_unlock(&h->lock);
+      luaH_unlock(hlk);
       /* else will try the metamethod */
     }
     if (ttisfunction(tm)) {  /* is metamethod a function? */
@@ -943,14 +1037,14 @@ void luaV_finishget (lua_State *L, const TValue *t, TValue *key, StkId val,
     t = tm;  /* else try to access 'tm[key]' */
     if (ttistable(t)) {
       Table *h = hvalue(t);
-      if (h->is_shared) l_rwlock_rdlock(&h->lock);
+      l_rwlock_t *hlk = luaH_rdlock(h);
       const TValue *res = luaH_get(h, key);
       if (!isempty(res)) {
         setobj2s(L, val, res);
-        if (h->is_shared) l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         return;
       }
-      if (h->is_shared) l_rwlock_unlock(&h->lock);
+      luaH_unlock(hlk);
     }
     /* else repeat (tail call 'luaV_finishget') */
   }
@@ -981,37 +1075,14 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
       Table *h = hvalue(t);  /* save 't' table */
       lua_assert(isempty(slot));  /* slot must be empty */
 
-      if (h->using_next) {
-         Namespace *ns = h->using_next;
-         while (ns) {
-            Table *nth = ns->data;
-            if (nth) {
-               if (nth->is_shared) l_rwlock_rdlock(&nth->lock);
-               const TValue *res = luaH_get(nth, key);
-               if (!isempty(res) && !isabstkey(res)) {
-                  if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-                  if (nth->is_shared) l_rwlock_wrlock(&nth->lock);
-                  res = luaH_get(nth, key);
-                  if (!isempty(res) && !isabstkey(res)) {
-                     setobj2t(L, cast(TValue *, res), val);
-                     luaC_barrierback(L, obj2gco(nth), val);
-                     if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-                     return;
-                  }
-                  if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-               } else {
-                  if (nth->is_shared) l_rwlock_unlock(&nth->lock);
-               }
-            }
-            ns = ns->using_next;
-         }
-      }
+      if (h->using_next && luaN_set(L, h->using_next, key, val))
+         return;
 
-      if (h->is_shared) l_rwlock_rdlock(&h->lock);
+      l_rwlock_t *hlk = luaH_rdlock(h);
       tm = fasttm(L, h->metatable, TM_NEWINDEX);  /* get metamethod */
-      if (h->is_shared) l_rwlock_unlock(&h->lock);
+      luaH_unlock(hlk);
       if (tm == LUA_NULLPTR) {  /* no metamethod? */
-        if (h->is_shared) l_rwlock_wrlock(&h->lock); /* Lock for writing */
+        hlk = luaH_wrlock(h); /* Lock for writing */
         /* Re-check slot? Calling luaH_finishset which might re-search if slot is absent key? */
         /* luaH_finishset calls luaH_newkey if slot is abstract. */
         /* But slot was passed in. It might be invalid now if we unlocked? */
@@ -1028,7 +1099,7 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
         L->top.p--;
         invalidateTMcache(h);
         luaC_barrierback(L, obj2gco(h), val);
-        if (h->is_shared) l_rwlock_unlock(&h->lock);
+        luaH_unlock(hlk);
         return;
       }
       /* else will try the metamethod */
@@ -1036,39 +1107,16 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
     else {  /* not a table? or slot is NULL */
       if (ttisnamespace(t)) {
          Namespace *ns = nsvalue(t);
-         Namespace *first = ns;
-         while (ns) {
-            Table *h = ns->data;
-            if (h) {
-               if (h->is_shared) l_rwlock_rdlock(&h->lock);
-               const TValue *res = luaH_get(h, key);
-               if (!isempty(res) && !isabstkey(res)) {
-                  if (h->is_shared) l_rwlock_unlock(&h->lock);
-                  /* Found existing key, update it */
-                  if (h->is_shared) l_rwlock_wrlock(&h->lock);
-                  res = luaH_get(h, key); /* Re-check under write lock */
-                  if (!isempty(res) && !isabstkey(res)) {
-                     setobj2t(L, cast(TValue *, res), val);
-                     luaC_barrierback(L, obj2gco(h), val);
-                     if (h->is_shared) l_rwlock_unlock(&h->lock);
-                     return;
-                  }
-                  if (h->is_shared) l_rwlock_unlock(&h->lock);
-               } else {
-                  if (h->is_shared) l_rwlock_unlock(&h->lock);
-               }
-            }
-            ns = ns->using_next;
-         }
+         if (luaN_set(L, ns, key, val))  /* existing key in the chain? */
+            return;
          /* Not found, create in first namespace */
-         ns = first;
-         if (ns && ns->data) {
+         if (ns->data) {
             Table *h = ns->data;
-            if (h->is_shared) l_rwlock_wrlock(&h->lock);
+            l_rwlock_t *hlk = luaH_wrlock(h);
             luaH_set(L, h, key, val);
             luaC_barrierback(L, obj2gco(h), val);
-            if (h->is_shared) l_rwlock_unlock(&h->lock);
-            return;
+            luaN_invalidate(L);  /* under the lock: see 'resolve' */
+            luaH_unlock(hlk);
          }
          return;
       }
@@ -1100,21 +1148,21 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
       }
       else if (ttistable(t)) {
          Table *h = hvalue(t);
-         if (h->is_shared) l_rwlock_wrlock(&h->lock);
+         l_rwlock_t *hlk = luaH_wrlock(h);
          const TValue *res = luaH_get(h, key);
          if (!isempty(res) && !isabstkey(res)) {
             setobj2t(L, cast(TValue *, res), val);
             luaC_barrierback(L, obj2gco(h), val);
-            if (h->is_shared) l_rwlock_unlock(&h->lock);
+            luaH_unlock(hlk);
             return;
          }
-         if (h->is_shared) l_rwlock_unlock(&h->lock);
+         luaH_unlock(hlk);
          // Empty, check TM
-         if (h->is_shared) l_rwlock_rdlock(&h->lock);
+         hlk = luaH_rdlock(h);
          tm = fasttm(L, h->metatable, TM_NEWINDEX);
-         if (h->is_shared) l_rwlock_unlock(&h->lock);
+         luaH_unlock(hlk);
          if (tm == NULL) {
-            if (h->is_shared) l_rwlock_wrlock(&h->lock);
+            hlk = luaH_wrlock(h);
             const TValue *newslot = luaH_get(h, key);
             sethvalue2s(L, L->top.p, h);
             L->top.p++;
@@ -1122,7 +1170,7 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
             L->top.p--;
             invalidateTMcache(h);
             luaC_barrierback(L, obj2gco(h), val);
-            if (h->is_shared) l_rwlock_unlock(&h->lock);
+            luaH_unlock(hlk);
             return;
          }
       } else {
@@ -1139,16 +1187,16 @@ void luaV_finishset (lua_State *L, const TValue *t, TValue *key,
     t = tm;  /* else repeat assignment over 'tm' */
     if (ttistable(t)) {
        Table *h = hvalue(t);
-       if (h->is_shared) l_rwlock_wrlock(&h->lock);
+       l_rwlock_t *hlk = luaH_wrlock(h);
        const TValue *res = luaH_get(h, key);
        if (!isempty(res) && !isabstkey(res)) {
           /* luaV_finishfastset just does setobj2t and barrier */
           setobj2t(L, cast(TValue *, res), val);
           luaC_barrierback(L, obj2gco(h), val);
-          if (h->is_shared) l_rwlock_unlock(&h->lock);
+          luaH_unlock(hlk);
           return;
        }
-       if (h->is_shared) l_rwlock_unlock(&h->lock);
+       luaH_unlock(hlk);
        /* else loop */
     }
     /* else 'return luaV_finishset(L, t, key, val, slot)' (loop) */
@@ -1443,6 +1491,8 @@ int luaV_equalobj (lua_State *L, const TValue *t1, const TValue *t2) {
          integer value, they cannot be equal; otherwise, compare their
          integer values. */
       lua_Integer i1, i2;
+      if (ttisbigint(t1) || ttisbigint(t2))
+        return luaB_compare((TValue*)t1, (TValue*)t2) == 0;
       return (luaV_tointegerns(t1, &i1, F2Ieq) &&
               luaV_tointegerns(t2, &i2, F2Ieq) &&
               i1 == i2);
@@ -1453,7 +1503,8 @@ int luaV_equalobj (lua_State *L, const TValue *t1, const TValue *t2) {
     case LUA_VNIL: case LUA_VFALSE: case LUA_VTRUE: return 1;
     case LUA_VNUMINT: return (ivalue(t1) == ivalue(t2));
     case LUA_VNUMFLT: return luai_numeq(fltvalue(t1), fltvalue(t2));
-    case LUA_VNUMBIG: return luaB_compare((TValue*)t1, (TValue*)t2) == 0;
+    case withvariant(LUA_VNUMBIG):  /* the tag carries the collectable bit */
+      return luaB_compare((TValue*)t1, (TValue*)t2) == 0;
     case LUA_VLIGHTUSERDATA: return pvalue(t1) == pvalue(t2);
     case LUA_VPOINTER: return ptrvalue(t1) == ptrvalue(t2);
     case LUA_VLCF: return fvalue(t1) == fvalue(t2);
@@ -1744,11 +1795,14 @@ static void pushconcept (lua_State *L, Proto *p, UpVal **encup, StkId base,
 void luaV_finishOp (lua_State *L) {
   CallInfo *ci = L->ci;
   StkId base = ci->func.p + 1;
-  Instruction inst = *(ci->u.l.savedpc - 1);  /* interrupted instruction */
+  const Proto *p = ci_func(ci)->p;
+  /* interrupted instruction */
+  Instruction inst = luaV_getinst(p, pcRel(ci->u.l.savedpc, p));
   OpCode op = GET_OPCODE(inst);
   switch (op) {  /* finish its execution */
     case OP_MMBIN: case OP_MMBINI: case OP_MMBINK: {
-      setobjs2s(L, base + GETARG_A(*(ci->u.l.savedpc - 2)), --L->top.p);
+      Instruction pi = luaV_getinst(p, pcRel(ci->u.l.savedpc, p) - 1);
+      setobjs2s(L, base + GETARG_A(pi), --L->top.p);
       break;
     }
     case OP_UNM: case OP_BNOT: case OP_LEN:
@@ -1822,17 +1876,8 @@ static void inopr (lua_State *L, StkId ra, TValue *a, TValue *b) {
     const char *s2 = getstr(tsvalue(b));
     size_t l1 = tsslen(tsvalue(a));
     size_t l2 = tsslen(tsvalue(b));
-    int found = 0;
-    if (l1 <= l2) {
-       size_t i;
-       for (i = 0; i <= l2 - l1; i++) {
-          if (memcmp(s2 + i, s1, l1) == 0) {
-             found = 1;
-             break;
-          }
-       }
-    }
-    if (found) setbtvalue(s2v(ra)); else setbfvalue(s2v(ra));
+    if (luaS_memfind(s2, l2, s1, l1) != NULL) setbtvalue(s2v(ra));
+    else setbfvalue(s2v(ra));
   } else {
     if (l_unlikely(!ttistable(b))) {
       luaG_runerror(L, "expected second 'in' operand to be table or string");
@@ -1896,13 +1941,14 @@ static void inopr (lua_State *L, StkId ra, TValue *a, TValue *b) {
     if (tryop(i1, i2, &r)) { \
        pc++; setivalue(s2v(ra), r); \
     } else { \
-       bigop(L, v1, v2, s2v(ra)); \
-       pc++; \
+       Protect(bigop(L, v1, v2, s2v(ra))); pc++; \
+       checkGC(L, ci->top.p); \
     } \
   }  \
-  else if (ttisbigint(v1) || ttisbigint(v2)) { \
-      bigop(L, v1, v2, s2v(ra)); \
-      pc++; \
+  else if ((ttisbigint(v1) || ttisbigint(v2)) && \
+           ttisnumber(v1) && ttisnumber(v2)) { \
+      Protect(bigop(L, v1, v2, s2v(ra))); pc++; \
+      checkGC(L, ci->top.p); \
   } \
   else op_arithf_aux(L, v1, v2, fop); }
 
@@ -1927,14 +1973,14 @@ static void inopr (lua_State *L, StkId ra, TValue *a, TValue *b) {
        pc++; setivalue(s2v(ra), r); \
     } else { \
        TValue vimm; setivalue(&vimm, imm); \
-       bigop(L, v1, &vimm, s2v(ra)); \
-       pc++; \
+       Protect(bigop(L, v1, &vimm, s2v(ra))); pc++; \
+       checkGC(L, ci->top.p); \
     } \
   }  \
   else if (ttisbigint(v1)) { \
       TValue vimm; setivalue(&vimm, imm); \
-      bigop(L, v1, &vimm, s2v(ra)); \
-      pc++; \
+      Protect(bigop(L, v1, &vimm, s2v(ra))); pc++; \
+      checkGC(L, ci->top.p); \
   } \
   else if (ttisfloat(v1)) {  \
     lua_Number nb = fltvalue(v1);  \
@@ -2077,6 +2123,51 @@ static void inopr (lua_State *L, StkId ra, TValue *a, TValue *b) {
 /* }======================================================= */
 
 
+/**
+ * @brief Looks up the target pc of an OP_SWITCH.
+ *
+ * Labels are integers or short strings, so only integers, floats with an
+ * integral value and short strings can match; anything else, like a miss,
+ * goes to the default target.
+ *
+ * @param st The jump table.
+ * @param v The control value.
+ * @return The pc to continue at.
+ */
+static int switchtarget (const SwitchTable *st, const TValue *v) {
+  unsigned int mask = cast_uint(st->size - 1);
+  unsigned int h;
+  lua_Integer n;
+  if (ttisinteger(v))
+    n = ivalue(v);
+  else if (ttisfloat(v)) {
+    if (!luaV_flttointeger(fltvalue(v), &n, F2Ieq))
+      return st->deflt;
+  }
+  else {
+    TString *ts;
+    if (!ttisshrstring(v) || st->keys == NULL)
+      return st->deflt;
+    ts = tsvalue(v);
+    for (h = ts->hash & mask; !ttisnil(&st->keys[h]); h = (h + 1) & mask) {
+      if (ttisshrstring(&st->keys[h]) && tsvalue(&st->keys[h]) == ts)
+        return st->targets[h];
+    }
+    return st->deflt;
+  }
+  if (st->keys == NULL) {  /* dense table? */
+    lua_Unsigned d = l_castS2U(n) - l_castS2U(st->lo);
+    return (d < cast(lua_Unsigned, st->size)) ? st->targets[d] : st->deflt;
+  }
+  for (h = luaF_switchhash(n) & mask; !ttisnil(&st->keys[h]);
+       h = (h + 1) & mask) {
+    if (ttisinteger(&st->keys[h]) && ivalue(&st->keys[h]) == n)
+      return st->targets[h];
+  }
+  return st->deflt;
+}
+
+
 /*
 ** {=======================================================
 ** Function 'luaV_execute': main interpreter loop
@@ -2155,6 +2246,14 @@ static void inopr (lua_State *L, StkId ra, TValue *a, TValue *b) {
 */
 #define halfProtect(exp)  (savestate(L,ci), (exp))
 
+/*
+** Inline cache of the current struct field instruction, or NULL if the
+** prototype has not allocated its caches yet.
+*/
+#define structIC(p)  \
+	((p)->structic != NULL && pcRel(pc, p) < (p)->sizestructic \
+	   ? &(p)->structic[pcRel(pc, p)] : NULL)
+
 /*
 ** macro executed during Lua functions at points where the
 ** function can yield.
@@ -2246,6 +2345,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
     lua_assert(base <= L->top.p && L->top.p <= L->stack_last.p);
     /* invalidate top for instructions not expecting it */
     lua_assert(isIT(i) || (cast_void(L->top.p = base), 1));
+   dispatch:
     vmdispatch (GET_OPCODE(i)) {
       vmcase(OP_MOVE) {
         StkId ra = RA(i);
@@ -2321,13 +2421,13 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TString *key = tsvalue(rc);  /* key must be a short string */
         if (ttistable(upval)) {
            Table *h = hvalue(upval);
-           if (h->is_shared) l_rwlock_rdlock(&h->lock);
+           l_rwlock_t *hlk = luaH_rdlock(h);
            const TValue *res = luaH_getshortstr(h, key);
            if (!isempty(res)) {
               setobj2s(L, ra, res);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               Protect(luaV_finishget(L, upval, rc, ra, NULL));
            }
         }
@@ -2341,13 +2441,13 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TValue *rc = vRC(i);
         if (ttistable(rb)) {
            Table *h = hvalue(rb);
-           if (h->is_shared) l_rwlock_rdlock(&h->lock);
+           l_rwlock_t *hlk = luaH_rdlock(h);
            const TValue *res = luaH_get_optimized(h, rc);
            if (!isempty(res)) {
               setobj2s(L, ra, res);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               Protect(luaV_finishget(L, rb, rc, ra, NULL));
            }
         }
@@ -2361,13 +2461,13 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         int c = GETARG_C(i);
         if (ttistable(rb)) {
            Table *h = hvalue(rb);
-           if (h->is_shared) l_rwlock_rdlock(&h->lock);
+           l_rwlock_t *hlk = luaH_rdlock(h);
            const TValue *res = luaH_getint(h, c);
            if (!isempty(res)) {
               setobj2s(L, ra, res);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               TValue key;
               setivalue(&key, c);
               Protect(luaV_finishget(L, rb, &key, ra, NULL));
@@ -2405,16 +2505,34 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TString *key = tsvalue(rc);  /* key must be a short string */
         if (ttistable(rb)) {
            Table *h = hvalue(rb);
-           if (h->is_shared) l_rwlock_rdlock(&h->lock);
+           l_rwlock_t *hlk = luaH_rdlock(h);
            const TValue *res = luaH_getshortstr(h, key);
            if (!isempty(res)) {
               setobj2s(L, ra, res);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               Protect(luaV_finishget(L, rb, rc, ra, NULL));
            }
         }
+        else if (ttisstruct(rb)) {
+          Struct *st = structvalue(rb);
+          StructIC *ic = structIC(cl->p);
+          const StructField *f = (ic != NULL) ? luaS_icfield(ic, st, key) : NULL;
+          if (f != NULL && f->type == ST_INT) {
+            lua_Integer iv;
+            memcpy(&iv, st->data + f->offset, sizeof(iv));
+            setivalue(s2v(ra), iv);
+          }
+          else if (f != NULL && f->type == ST_FLOAT) {
+            lua_Number nv;
+            memcpy(&nv, st->data + f->offset, sizeof(nv));
+            setfltvalue(s2v(ra), nv);
+          }
+          else
+            Protect(luaS_structget(L, rb, rc, ra,
+                                   luaS_structic(L, cl->p, pcRel(pc, cl->p))));
+        }
         else
           Protect(luaV_finishget(L, rb, rc, ra, NULL));
         vmbreak;
@@ -2426,14 +2544,14 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TString *key = tsvalue(rb);  /* key must be a short string */
         if (ttistable(upval)) {
            Table *h = hvalue(upval);
-           if (h->is_shared) l_rwlock_wrlock(&h->lock);
+           l_rwlock_t *hlk = luaH_wrlock(h);
            const TValue *res = luaH_getshortstr(h, key);
            if (!isempty(res) && !isabstkey(res)) {
               setobj2t(L, cast(TValue *, res), rc);
               luaC_barrierback(L, obj2gco(h), rc);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               Protect(luaV_finishset(L, upval, rb, rc, NULL));
            }
         }
@@ -2447,14 +2565,14 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TValue *rc = RKC(i);  /* value */
         if (ttistable(s2v(ra))) {
            Table *h = hvalue(s2v(ra));
-           if (h->is_shared) l_rwlock_wrlock(&h->lock);
+           l_rwlock_t *hlk = luaH_wrlock(h);
            const TValue *res = luaH_get_optimized(h, rb);
            if (!isempty(res) && !isabstkey(res)) {
               setobj2t(L, cast(TValue *, res), rc);
               luaC_barrierback(L, obj2gco(h), rc);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               Protect(luaV_finishset(L, s2v(ra), rb, rc, NULL));
            }
         }
@@ -2468,14 +2586,14 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TValue *rc = RKC(i);
         if (ttistable(s2v(ra))) {
            Table *h = hvalue(s2v(ra));
-           if (h->is_shared) l_rwlock_wrlock(&h->lock);
+           l_rwlock_t *hlk = luaH_wrlock(h);
            const TValue *res = luaH_getint(h, c);
            if (!isempty(res) && !isabstkey(res)) {
               setobj2t(L, cast(TValue *, res), rc);
               luaC_barrierback(L, obj2gco(h), rc);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               TValue key;
               setivalue(&key, c);
               Protect(luaV_finishset(L, s2v(ra), &key, rc, NULL));
@@ -2494,17 +2612,33 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         TString *key = tsvalue(rb);  /* key must be a short string */
         if (ttistable(s2v(ra))) {
            Table *h = hvalue(s2v(ra));
-           if (h->is_shared) l_rwlock_wrlock(&h->lock);
+           l_rwlock_t *hlk = luaH_wrlock(h);
            const TValue *res = luaH_getshortstr(h, key);
            if (!isempty(res) && !isabstkey(res)) {
               setobj2t(L, cast(TValue *, res), rc);
               luaC_barrierback(L, obj2gco(h), rc);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               Protect(luaV_finishset(L, s2v(ra), rb, rc, NULL));
            }
         }
+        else if (ttisstruct(s2v(ra))) {
+          Struct *st = structvalue(s2v(ra));
+          StructIC *ic = structIC(cl->p);
+          const StructField *f = (ic != NULL) ? luaS_icfield(ic, st, key) : NULL;
+          if (f != NULL && f->type == ST_INT && ttisinteger(rc)) {
+            lua_Integer iv = ivalue(rc);
+            memcpy(st->data + f->offset, &iv, sizeof(iv));
+          }
+          else if (f != NULL && f->type == ST_FLOAT && ttisfloat(rc)) {
+            lua_Number nv = fltvalue(rc);
+            memcpy(st->data + f->offset, &nv, sizeof(nv));
+          }
+          else
+            Protect(luaS_structset(L, s2v(ra), rb, rc,
+                                   luaS_structic(L, cl->p, pcRel(pc, cl->p))));
+        }
         else
           Protect(luaV_finishset(L, s2v(ra), rb, rc, NULL));
         vmbreak;
@@ -2540,6 +2674,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
            Namespace *target = nsvalue(rb);
            ns->using_next = target;
            luaC_objbarrier(L, ns, target);
+           luaN_invalidate(L);
         }
         else if (ttistable(s2v(ra)) && ttisnamespace(rb)) {
            Table *t = hvalue(s2v(ra));
@@ -2565,7 +2700,7 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         setobj2s(L, ra + 1, rb);
         if (ttistable(rb)) {
            Table *h = hvalue(rb);
-           if (h->is_shared) l_rwlock_rdlock(&h->lock);
+           l_rwlock_t *hlk = luaH_rdlock(h);
            const TValue *res;
            if (key->tt == LUA_VSHRSTR) {
              res = luaH_getshortstr(h, key);
@@ -2574,9 +2709,9 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
            }
            if (!isempty(res)) {
               setobj2s(L, ra, res);
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
            } else {
-              if (h->is_shared) l_rwlock_unlock(&h->lock);
+              luaH_unlock(hlk);
               Protect(luaV_finishget(L, rb, rc, ra, NULL));
            }
         }
@@ -2796,7 +2931,8 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
       }
       vmcase(OP_MMBIN) {
         StkId ra = RA(i);
-        Instruction pi = *(pc - 2);  /* original arith. expression */
+        /* original arith. expression (it may be under a trap) */
+        Instruction pi = luaV_getinst(cl->p, pcRel(pc, cl->p) - 1);
         TValue *rb = vRB(i);
         TMS tm = (TMS)GETARG_C(i);
         StkId result = RA(pi);
@@ -2806,7 +2942,8 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
       }
       vmcase(OP_MMBINI) {
         StkId ra = RA(i);
-        Instruction pi = *(pc - 2);  /* original arith. expression */
+        /* original arith. expression (it may be under a trap) */
+        Instruction pi = luaV_getinst(cl->p, pcRel(pc, cl->p) - 1);
         int imm = GETARG_sB(i);
         TMS tm = (TMS)GETARG_C(i);
         int flip = GETARG_k(i);
@@ -2816,7 +2953,8 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
       }
       vmcase(OP_MMBINK) {
         StkId ra = RA(i);
-        Instruction pi = *(pc - 2);  /* original arith. expression */
+        /* original arith. expression (it may be under a trap) */
+        Instruction pi = luaV_getinst(cl->p, pcRel(pc, cl->p) - 1);
         TValue *imm = KB(i);
         TMS tm = (TMS)GETARG_C(i);
         int flip = GETARG_k(i);
@@ -3785,10 +3923,10 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
           ra = RA(i);
           sethvalue2s(L, ra, t);
           TValue val; sethvalue(L, &val, t);
-          if (reg->is_shared) l_rwlock_wrlock(&reg->lock);
+          l_rwlock_t *reglk = luaH_wrlock(reg);
           luaH_set(L, reg, s2v(L->top.p - 1), &val);
           luaC_barrierback(L, obj2gco(reg), &val);
-          if (reg->is_shared) l_rwlock_unlock(&reg->lock);
+          luaH_unlock(reglk);
           L->top.p--;
           checkGC(L, ra + 1);
         }
@@ -3805,23 +3943,23 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         setsvalue2s(L, L->top.p, key); /* anchor key */
         L->top.p++;
         const TValue *res;
-        if (reg->is_shared) l_rwlock_rdlock(&reg->lock);
+        l_rwlock_t *reglk = luaH_rdlock(reg);
         res = luaH_getstr(reg, key);
         if (!isempty(res)) {
           setobj2s(L, ra, res);
-          if (reg->is_shared) l_rwlock_unlock(&reg->lock);
+          luaH_unlock(reglk);
           L->top.p--;
         } else {
-          if (reg->is_shared) l_rwlock_unlock(&reg->lock);
+          luaH_unlock(reglk);
           Table *t = luaH_new(L);
           updatebase(ci);
           ra = RA(i);
           sethvalue2s(L, ra, t);
           TValue val; sethvalue(L, &val, t);
-          if (reg->is_shared) l_rwlock_wrlock(&reg->lock);
+          reglk = luaH_wrlock(reg);
           luaH_set(L, reg, s2v(L->top.p - 1), &val);
           luaC_barrierback(L, obj2gco(reg), &val);
-          if (reg->is_shared) l_rwlock_unlock(&reg->lock);
+          luaH_unlock(reglk);
           L->top.p--;
           checkGC(L, ra + 1);
         }
@@ -3942,32 +4080,33 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
         vmbreak;
       }
       vmcase(OP_CHECKTYPE) {
-        while (L->top.p < base + cl->p->maxstacksize)
-             setnilvalue(s2v(L->top.p++));
-        luaD_checkstack(L, 2);
-        updatebase(ci);
-        StkId ra = RA(i);
-        TValue *rb = vRB(i);
-        TValue *rc = KC(i);
-
-        if (!check_subtype_internal(L, s2v(ra), rb)) {
-           updatebase(ci);
-           ra = RA(i);
-           rb = vRB(i);
-           const char *name = getstr(tsvalue(rc));
-           const char *expected = "unknown";
-           if (ttisstring(rb)) expected = getstr(tsvalue(rb));
-           else if (ttistable(rb)) {
-                Table *h = hvalue(rb);
-                TString *key_name = luaS_newliteral(L, "__name");
-                const TValue *res = luaH_getstr(h, key_name);
-                if (ttisstring(res)) expected = getstr(tsvalue(res));
-           }
-           luaG_runerror(L, "Type mismatch for argument '%s': expected %s, got %s",
-                          name, expected, luaT_objtypename(L, s2v(ra)));
+        unsigned int bits = luaV_typebits(vRA(i));
+        int ok;
+        if (GETARG_k(i))  /* builtin type resolved by the parser */
+          ok = (builtintypes[GETARG_B(i)].mask & bits) != 0;
+        else {
+          const TypeIC *ic = typeIC(cl->p);
+          TValue *rb = vRB(i);
+          ok = (ic != NULL && iscollectable(rb) && gcvalue(rb) == ic->type &&
+                ((ic->mask & bits) ||
+                 (ic->cls != NULL && classof(L, vRA(i)) == ic->cls)));
         }
+        if (l_unlikely(!ok))
+          Protect(checkparamtype(L, ci, i));
         vmbreak;
       }
+      vmcase(OP_SWITCH) {
+        const Proto *p = cl->p;
+        pc = p->code + switchtarget(&p->switches[GETARG_Bx(i)], vRA(i));
+        updatetrap(ci);
+        vmbreak;
+      }
+      vmcase(OP_TRAP) {
+        i = luaG_trap(L, pc);  /* breakpoint; get the replaced instruction */
+        updatetrap(ci);
+        updatebase(ci);
+        goto dispatch;
+      }
       vmcase(OP_EXTRAARG) {
         lua_assert(0);
         vmbreak;
@@ -3979,5 +4118,8 @@ void luaV_execute (lua_State *L, CallInfo *ci) {
 /* }======================================================= */
 
 Instruction luaV_getinst(const Proto *p, int pc) {
-  return p->code[pc];
+  Instruction i = p->code[pc];
+  if (l_unlikely(GET_OPCODE(i) == OP_TRAP))
+    i = luaG_getorigin(p, pc);
+  return i;
 }
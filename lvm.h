@@ -115,6 +115,16 @@ typedef enum {
 #define luaV_shiftr(x,y)	luaV_shiftl(x,intop(-, 0, y))
 
 
+/*
+** Tag bits of a value for the type masks of OP_CHECKTYPE: one bit per
+** basic type, plus one for integers so that "int" and "number" differ.
+*/
+#define LUAV_TINTBIT	(1u << LUA_NUMTYPES)
+
+#define luaV_typebits(o)  \
+	((1u << ttype(o)) | (ttisinteger(o) ? LUAV_TINTBIT : 0u))
+
+
 
 LUAI_FUNC int luaV_equalobj (lua_State *L, const TValue *t1, const TValue *t2);
 LUAI_FUNC int luaV_lessthan (lua_State *L, const TValue *l, const TValue *r);
@@ -143,5 +153,8 @@ LUAI_FUNC lua_Number luaV_modf (lua_State *L, lua_Number x, lua_Number y);
 LUAI_FUNC lua_Integer luaV_shiftl (lua_Integer x, lua_Integer y);
 LUAI_FUNC void luaV_objlen (lua_State *L, StkId ra, const TValue *rb);
 LUAI_FUNC Instruction luaV_getinst(const Proto *p, int pc);
+LUAI_FUNC int luaV_typecode (const char *name);
+LUAI_FUNC unsigned int luaV_typemask (int code);
+LUAI_FUNC const char *luaV_typename (int code);
 
 #endif
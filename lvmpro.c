@@ -18,6 +18,7 @@
 #include "lstate.h"
 #include "lopcodes.h"
 #include "lundump.h"
+#include "lvm.h"
 
 /* Helper to convert Instruction to Lua Integer */
 static lua_Integer inst2int(Instruction i) {
@@ -64,7 +65,7 @@ static int vm_compile(lua_State *L, Proto *p) {
   /* 3. Code Table (Index 4) */
   lua_createtable(L, p->sizecode, 0);
   for (int i = 0; i < p->sizecode; i++) {
-    Instruction inst = p->code[i];
+    Instruction inst = luaV_getinst(p, i);  /* see through breakpoint traps */
     lua_createtable(L, 0, 9);
 
     lua_pushinteger(L, GET_OPCODE(inst));
@@ -179,6 +180,9 @@ static int vm_compile(lua_State *L, Proto *p) {
   luaL_addstring(&b, "      local _sj = _inst.sj\n");
   luaL_addstring(&b, "      _pc = _pc + _sj\n");
 
+  /* jump tables are an accelerator: the comparison chain follows */
+  gen_opcode(L, &b, OP_SWITCH, "OP_SWITCH", "\n");
+
   /* Comparison */
   gen_opcode(L, &b, OP_EQ, "OP_EQ",
     "      local val = (R(_a) == R(_b))\n"
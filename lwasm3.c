@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include "lua.h"
@@ -11,6 +12,7 @@
 #define WASM3_RUNTIME_METATABLE "wasm3.runtime"
 #define WASM3_MODULE_METATABLE "wasm3.module"
 #define WASM3_FUNCTION_METATABLE "wasm3.function"
+#define WASM3_MEMORY_METATABLE "wasm3.memory"
 
 typedef struct {
     IM3Environment env;
@@ -29,12 +31,27 @@ typedef struct {
     int loaded; // whether it has been loaded into a runtime
 } wasm3_Module;
 
+// Calls with at most this many argument/result slots marshal on the C stack
+#define WASM3_FAST_SLOTS 16
+
 typedef struct {
     IM3Function function;
     // Keep a reference to the runtime so it doesn't get GC'd
     int runtime_ref;
+    // Signature cached by findFunction: argc argument types, then retc result types
+    uint32_t argc;
+    uint32_t retc;
+    M3ValueType types[1];
 } wasm3_Function;
 
+typedef struct {
+    // Owning runtime userdata; the base pointer is re-resolved on every access
+    // so the view stays valid across memory.grow
+    wasm3_Runtime *owner;
+    // Keep a reference to the runtime so it doesn't get GC'd
+    int runtime_ref;
+} wasm3_Memory;
+
 
 static int l_new_environment(lua_State *L) {
     IM3Environment env = m3_NewEnvironment();
@@ -154,8 +171,15 @@ static int runtime_find_function(lua_State *L) {
         return luaL_error(L, "Failed to find function '%s': %s", func_name, result);
     }
 
-    wasm3_Function *wf = (wasm3_Function*)lua_newuserdata(L, sizeof(wasm3_Function));
+    uint32_t argc = m3_GetArgCount(function);
+    uint32_t retc = m3_GetRetCount(function);
+    wasm3_Function *wf = (wasm3_Function*)lua_newuserdata(L,
+            offsetof(wasm3_Function, types) + (argc + retc + 1) * sizeof(M3ValueType));
     wf->function = function;
+    wf->argc = argc;
+    wf->retc = retc;
+    for (uint32_t i = 0; i < argc; i++) wf->types[i] = m3_GetArgType(function, i);
+    for (uint32_t i = 0; i < retc; i++) wf->types[argc + i] = m3_GetRetType(function, i);
 
     // Store reference to runtime
     lua_pushvalue(L, 1);
@@ -173,84 +197,176 @@ static int function_gc(lua_State *L) {
     return 0;
 }
 
-static int function_call(lua_State *L) {
-    wasm3_Function *wf = (wasm3_Function*)luaL_checkudata(L, 1, WASM3_FUNCTION_METATABLE);
-    int top = lua_gettop(L);
-    int argc = top - 1; // first arg is the function object itself
+// Integer value of argument idx for an i32/i64 parameter
+static int64_t wasm3_toint(lua_State *L, int idx) {
+    int isnum;
+    lua_Integer i = lua_tointegerx(L, idx, &isnum);
+    if (isnum) {
+        return (int64_t)i;
+    }
+    if (lua_type(L, idx) == LUA_TBOOLEAN) {
+        return lua_toboolean(L, idx);
+    }
+    lua_Number n = luaL_checknumber(L, idx);
+    if (!(n >= -9223372036854775808.0 && n < 9223372036854775808.0)) {
+        luaL_error(L, "number has no integer representation");
+    }
+    return (int64_t)n;  // truncate like the old text conversion did
+}
+
+// Floating-point value of argument idx for an f32/f64 parameter
+static double wasm3_tonum(lua_State *L, int idx) {
+    if (lua_type(L, idx) == LUA_TBOOLEAN) {
+        return lua_toboolean(L, idx);
+    }
+    return (double)luaL_checknumber(L, idx);
+}
 
-    int expected_argc = m3_GetArgCount(wf->function);
-    if (argc != expected_argc) {
-        return luaL_error(L, "Function expects %d arguments, but %d provided", expected_argc, argc);
+// Stores the value at idx into a wasm3 argument slot of the given type
+static void wasm3_setarg(lua_State *L, int idx, M3ValueType type, uint64_t *slot) {
+    switch (type) {
+        case c_m3Type_i32: *(int32_t*)slot = (int32_t)wasm3_toint(L, idx); break;
+        case c_m3Type_i64: *(int64_t*)slot = wasm3_toint(L, idx); break;
+        case c_m3Type_f32: *(float*)slot = (float)wasm3_tonum(L, idx); break;
+        case c_m3Type_f64: *(double*)slot = wasm3_tonum(L, idx); break;
+        default: luaL_error(L, "unsupported argument type"); break;
     }
+}
 
-    const char* argv[128]; // Max 128 arguments for simplicity in this binding
-    if (argc > 128) {
-        return luaL_error(L, "Too many arguments");
+// Pushes a wasm3 result slot of the given type
+static void wasm3_pushret(lua_State *L, M3ValueType type, const uint64_t *slot) {
+    switch (type) {
+        case c_m3Type_i32: lua_pushinteger(L, *(const int32_t*)slot); break;
+        case c_m3Type_i64: lua_pushinteger(L, *(const int64_t*)slot); break;
+        case c_m3Type_f32: lua_pushnumber(L, *(const float*)slot); break;
+        case c_m3Type_f64: lua_pushnumber(L, *(const double*)slot); break;
+        default: lua_pushnil(L); break;
     }
+}
 
-    // We keep strings to pass to m3_CallArgv. We need to format numbers properly as strings.
-    char arg_bufs[128][64]; // Buffers for string conversion if needed
-    for (int i = 0; i < argc; i++) {
-        int idx = i + 2;
-        if (lua_type(L, idx) == LUA_TNUMBER) {
-            if (lua_isinteger(L, idx)) {
-                snprintf(arg_bufs[i], sizeof(arg_bufs[i]), "%lld", (long long)lua_tointeger(L, idx));
-            } else {
-                snprintf(arg_bufs[i], sizeof(arg_bufs[i]), "%f", lua_tonumber(L, idx));
-            }
-            argv[i] = arg_bufs[i];
-        } else if (lua_type(L, idx) == LUA_TSTRING) {
-            argv[i] = lua_tostring(L, idx);
-        } else if (lua_type(L, idx) == LUA_TBOOLEAN) {
-            snprintf(arg_bufs[i], sizeof(arg_bufs[i]), "%d", lua_toboolean(L, idx));
-            argv[i] = arg_bufs[i];
-        } else {
-            return luaL_error(L, "Argument %d must be number, string, or boolean", i+1);
-        }
+// Argument/result buffers for one call: on the C stack for small signatures
+typedef struct {
+    uint64_t *vals;
+    const void **ptrs;
+    uint64_t fast_vals[WASM3_FAST_SLOTS];
+    const void *fast_ptrs[WASM3_FAST_SLOTS];
+} wasm3_Slots;
+
+static void wasm3_initslots(lua_State *L, wasm3_Function *wf, wasm3_Slots *sl) {
+    uint32_t n = wf->argc > wf->retc ? wf->argc : wf->retc;
+    if (n <= WASM3_FAST_SLOTS) {
+        sl->vals = sl->fast_vals;
+        sl->ptrs = sl->fast_ptrs;
+    } else {
+        // Large signature: scratch userdata left on the stack until return
+        sl->vals = (uint64_t*)lua_newuserdatauv(L, n * (sizeof(uint64_t) + sizeof(void*)), 0);
+        sl->ptrs = (const void**)(sl->vals + n);
+    }
+    for (uint32_t i = 0; i < n; i++) sl->ptrs[i] = &sl->vals[i];
+}
+
+// Runs the function on the arguments already stored in sl->vals
+static M3Result wasm3_invoke(wasm3_Function *wf, wasm3_Slots *sl) {
+    M3Result result = m3_Call(wf->function, wf->argc, sl->ptrs);
+    if (result == m3Err_none && wf->retc > 0) {
+        result = m3_GetResults(wf->function, wf->retc, sl->ptrs);
+    }
+    return result;
+}
+
+static int function_call(lua_State *L) {
+    wasm3_Function *wf = (wasm3_Function*)luaL_checkudata(L, 1, WASM3_FUNCTION_METATABLE);
+    int argc = lua_gettop(L) - 1; // first arg is the function object itself
+
+    if (argc != (int)wf->argc) {
+        return luaL_error(L, "Function expects %d arguments, but %d provided", (int)wf->argc, argc);
     }
 
-    M3Result result = m3_CallArgv(wf->function, argc, argv);
+    wasm3_Slots sl;
+    wasm3_initslots(L, wf, &sl);
+    for (uint32_t i = 0; i < wf->argc; i++) {
+        wasm3_setarg(L, (int)i + 2, wf->types[i], &sl.vals[i]);
+    }
+
+    M3Result result = wasm3_invoke(wf, &sl);
     if (result) {
         return luaL_error(L, "Function call failed: %s", result);
     }
 
-    int retc = m3_GetRetCount(wf->function);
-    if (retc == 0) {
-        return 0;
-    } else if (retc > 0) {
-        uint64_t val[128]; // Max 128 returns
-        const void* valptrs[128];
-        for(int i=0; i<retc; i++) valptrs[i] = &val[i];
+    luaL_checkstack(L, (int)wf->retc, "too many results");
+    for (uint32_t i = 0; i < wf->retc; i++) {
+        wasm3_pushret(L, wf->types[wf->argc + i], &sl.vals[i]);
+    }
+    return (int)wf->retc;
+}
 
-        M3Result resResult = m3_GetResults(wf->function, retc, valptrs);
-        if (resResult) {
-            return luaL_error(L, "Failed to get results: %s", resResult);
+/*
+** fn:callMany(args [, out]) calls the function once per argument tuple.
+** 'args' is either a flat sequence holding argc values per call, or a
+** sequence of tuple tables. Results are stored flat into 'out' (a new
+** table if absent), retc values per call, and 'out' is returned.
+*/
+static int function_callMany(lua_State *L) {
+    wasm3_Function *wf = (wasm3_Function*)luaL_checkudata(L, 1, WASM3_FUNCTION_METATABLE);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_Integer len = (lua_Integer)lua_rawlen(L, 2);
+    int nested = len > 0 && lua_rawgeti(L, 2, 1) == LUA_TTABLE;
+    if (len > 0) lua_pop(L, 1);
+
+    lua_Integer ncalls;
+    if (nested) {
+        ncalls = len;
+    } else if (wf->argc == 0) {
+        ncalls = len;  // one call per (ignored) entry
+    } else {
+        if (len % wf->argc != 0) {
+            return luaL_error(L, "argument count %d is not a multiple of %d", (int)len, (int)wf->argc);
         }
+        ncalls = len / wf->argc;
+    }
 
-        for (int i = 0; i < retc; i++) {
-            M3ValueType type = m3_GetRetType(wf->function, i);
-            switch (type) {
-                case c_m3Type_i32:
-                    lua_pushinteger(L, *(int32_t*)&val[i]);
-                    break;
-                case c_m3Type_i64:
-                    lua_pushinteger(L, *(int64_t*)&val[i]);
-                    break;
-                case c_m3Type_f32:
-                    lua_pushnumber(L, *(float*)&val[i]);
-                    break;
-                case c_m3Type_f64:
-                    lua_pushnumber(L, *(double*)&val[i]);
-                    break;
-                default:
-                    lua_pushnil(L);
-                    break;
+    if (lua_istable(L, 3)) {
+        lua_settop(L, 3);
+    } else {
+        lua_settop(L, 2);
+        lua_createtable(L, (int)(ncalls * wf->retc), 0);
+    }
+    int out = 3;
+
+    wasm3_Slots sl;
+    wasm3_initslots(L, wf, &sl);
+    int base = lua_gettop(L);
+    lua_Integer k = 1;
+    for (lua_Integer c = 0; c < ncalls; c++) {
+        if (nested) {
+            if (lua_rawgeti(L, 2, c + 1) != LUA_TTABLE) {
+                return luaL_error(L, "argument tuple %d is not a table", (int)(c + 1));
+            }
+            for (uint32_t i = 0; i < wf->argc; i++) {
+                lua_rawgeti(L, base + 1, (lua_Integer)i + 1);
+                wasm3_setarg(L, -1, wf->types[i], &sl.vals[i]);
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+        } else {
+            for (uint32_t i = 0; i < wf->argc; i++) {
+                lua_rawgeti(L, 2, c * wf->argc + i + 1);
+                wasm3_setarg(L, -1, wf->types[i], &sl.vals[i]);
+                lua_pop(L, 1);
             }
         }
-        return retc;
-    }
 
-    return 0;
+        M3Result result = wasm3_invoke(wf, &sl);
+        if (result) {
+            return luaL_error(L, "Function call %d failed: %s", (int)(c + 1), result);
+        }
+        for (uint32_t i = 0; i < wf->retc; i++) {
+            wasm3_pushret(L, wf->types[wf->argc + i], &sl.vals[i]);
+            lua_rawseti(L, out, k++);
+        }
+    }
+    lua_settop(L, out);
+    return 1;
 }
 
 
@@ -301,10 +417,38 @@ static int runtime_getMemorySize(lua_State *L) {
     return 1;
 }
 
+// Current base of the runtime's linear memory, or NULL if it has none
+static uint8_t *wasm3_membase(wasm3_Runtime *wr, uint32_t *size) {
+    *size = 0;
+    if (wr->runtime == NULL || wr->runtime->memory.mallocated == NULL)
+        return NULL;
+    return m3_GetMemory(wr->runtime, size, 0);
+}
+
+// Resolves [off, off + len) against the current memory, raising on overflow
+static uint8_t *wasm3_memrange(lua_State *L, wasm3_Runtime *wr, lua_Integer off, lua_Integer len) {
+    uint32_t size;
+    uint8_t *base = wasm3_membase(wr, &size);
+    if (base == NULL)
+        luaL_error(L, "runtime has no linear memory");
+    if (off < 0 || len < 0 || (lua_Unsigned)off > size || (lua_Unsigned)len > size - (lua_Unsigned)off)
+        luaL_error(L, "memory access out of bounds (offset %I, length %I, size %d)",
+                   (LUAI_UACINT)off, (LUAI_UACINT)len, (int)size);
+    return base + off;
+}
+
 static int runtime_getMemory(lua_State *L) {
     wasm3_Runtime *wr = (wasm3_Runtime*)luaL_checkudata(L, 1, WASM3_RUNTIME_METATABLE);
+    if (!lua_isnoneornil(L, 2)) {
+        // Copy just the requested slice
+        lua_Integer off = luaL_checkinteger(L, 2);
+        lua_Integer len = luaL_checkinteger(L, 3);
+        uint8_t *p = wasm3_memrange(L, wr, off, len);
+        lua_pushlstring(L, (const char*)p, (size_t)len);
+        return 1;
+    }
     uint32_t memorySize;
-    uint8_t* memory = m3_GetMemory(wr->runtime, &memorySize, 0);
+    uint8_t* memory = wasm3_membase(wr, &memorySize);
     if (memory) {
         // Return memory contents as string
         lua_pushlstring(L, (const char*)memory, memorySize);
@@ -314,6 +458,127 @@ static int runtime_getMemory(lua_State *L) {
     return 1;
 }
 
+static int runtime_memory(lua_State *L) {
+    wasm3_Runtime *wr = (wasm3_Runtime*)luaL_checkudata(L, 1, WASM3_RUNTIME_METATABLE);
+    wasm3_Memory *wmem = (wasm3_Memory*)lua_newuserdata(L, sizeof(wasm3_Memory));
+    wmem->owner = wr;
+    lua_pushvalue(L, 1);
+    wmem->runtime_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    luaL_getmetatable(L, WASM3_MEMORY_METATABLE);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+/*
+ * Memory views: typed, bounds-checked access to linear memory without copying
+ * the whole memory into a Lua string. Values use wasm's little-endian layout.
+ */
+
+static const char *const wasm3_memtypes[] = {
+    "u8", "i8", "u16", "i16", "u32", "i32", "u64", "i64", "f32", "f64", NULL
+};
+static const unsigned char wasm3_memwidths[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+
+static wasm3_Memory *checkmemory(lua_State *L) {
+    return (wasm3_Memory*)luaL_checkudata(L, 1, WASM3_MEMORY_METATABLE);
+}
+
+static int memory_gc(lua_State *L) {
+    wasm3_Memory *wmem = checkmemory(L);
+    luaL_unref(L, LUA_REGISTRYINDEX, wmem->runtime_ref);
+    wmem->runtime_ref = LUA_NOREF;
+    return 0;
+}
+
+static int memory_size(lua_State *L) {
+    wasm3_Memory *wmem = checkmemory(L);
+    uint32_t size;
+    wasm3_membase(wmem->owner, &size);
+    lua_pushinteger(L, size);
+    return 1;
+}
+
+static int memory_read(lua_State *L) {
+    wasm3_Memory *wmem = checkmemory(L);
+    int t = luaL_checkoption(L, 2, NULL, wasm3_memtypes);
+    lua_Integer off = luaL_checkinteger(L, 3);
+    const uint8_t *p = wasm3_memrange(L, wmem->owner, off, wasm3_memwidths[t]);
+    switch (t) {
+        case 0: lua_pushinteger(L, *p); break;
+        case 1: lua_pushinteger(L, (int8_t)*p); break;
+        case 2: { uint16_t v; memcpy(&v, p, 2); lua_pushinteger(L, v); break; }
+        case 3: { int16_t v; memcpy(&v, p, 2); lua_pushinteger(L, v); break; }
+        case 4: { uint32_t v; memcpy(&v, p, 4); lua_pushinteger(L, v); break; }
+        case 5: { int32_t v; memcpy(&v, p, 4); lua_pushinteger(L, v); break; }
+        case 6: case 7: { int64_t v; memcpy(&v, p, 8); lua_pushinteger(L, (lua_Integer)v); break; }
+        case 8: { float v; memcpy(&v, p, 4); lua_pushnumber(L, (lua_Number)v); break; }
+        default: { double v; memcpy(&v, p, 8); lua_pushnumber(L, (lua_Number)v); break; }
+    }
+    return 1;
+}
+
+static int memory_write(lua_State *L) {
+    wasm3_Memory *wmem = checkmemory(L);
+    int t = luaL_checkoption(L, 2, NULL, wasm3_memtypes);
+    lua_Integer off = luaL_checkinteger(L, 3);
+    uint8_t *p = wasm3_memrange(L, wmem->owner, off, wasm3_memwidths[t]);
+    if (t >= 8) {
+        lua_Number n = luaL_checknumber(L, 4);
+        if (t == 8) { float v = (float)n; memcpy(p, &v, 4); }
+        else { double v = (double)n; memcpy(p, &v, 8); }
+    } else {
+        // Integers are truncated to the target width, as wasm stores do
+        uint64_t v = (uint64_t)luaL_checkinteger(L, 4);
+        switch (wasm3_memwidths[t]) {
+            case 1: { uint8_t b = (uint8_t)v; memcpy(p, &b, 1); break; }
+            case 2: { uint16_t h = (uint16_t)v; memcpy(p, &h, 2); break; }
+            case 4: { uint32_t w = (uint32_t)v; memcpy(p, &w, 4); break; }
+            default: memcpy(p, &v, 8); break;
+        }
+    }
+    return 0;
+}
+
+static int memory_readString(lua_State *L) {
+    wasm3_Memory *wmem = checkmemory(L);
+    lua_Integer off = luaL_checkinteger(L, 2);
+    lua_Integer len = luaL_checkinteger(L, 3);
+    const uint8_t *p = wasm3_memrange(L, wmem->owner, off, len);
+    lua_pushlstring(L, (const char*)p, (size_t)len);
+    return 1;
+}
+
+// writeBuffer(off, src [, len]): src is a string or a ptr-library pointer
+static int memory_writeBuffer(lua_State *L) {
+    wasm3_Memory *wmem = checkmemory(L);
+    lua_Integer off = luaL_checkinteger(L, 2);
+    const void *src;
+    lua_Integer len;
+    if (lua_type(L, 3) == LUA_TSTRING) {
+        size_t slen;
+        src = lua_tolstring(L, 3, &slen);
+        len = luaL_optinteger(L, 4, (lua_Integer)slen);
+        luaL_argcheck(L, len >= 0 && (size_t)len <= slen, 4, "length exceeds source string");
+    } else {
+        luaL_argexpected(L, lua_ispointer(L, 3), 3, "string or pointer");
+        src = lua_topointer(L, 3);
+        len = luaL_checkinteger(L, 4);
+    }
+    uint8_t *p = wasm3_memrange(L, wmem->owner, off, len);
+    if (len > 0)
+        memmove(p, src, (size_t)len);
+    return 0;
+}
+
+// pointer([off]): raw pointer into linear memory, invalidated by memory.grow
+static int memory_pointer(lua_State *L) {
+    wasm3_Memory *wmem = checkmemory(L);
+    lua_Integer off = luaL_optinteger(L, 2, 0);
+    uint8_t *p = wasm3_memrange(L, wmem->owner, off, 0);
+    lua_pushpointer(L, p);
+    return 1;
+}
+
 static int runtime_printInfo(lua_State *L) {
 #if defined(DEBUG)
     wasm3_Runtime *wr = (wasm3_Runtime*)luaL_checkudata(L, 1, WASM3_RUNTIME_METATABLE);
@@ -363,6 +628,7 @@ static const struct luaL_Reg runtime_methods[] = {
     {"findFunction", runtime_find_function},
     {"getMemorySize", runtime_getMemorySize},
     {"getMemory", runtime_getMemory},
+    {"memory", runtime_memory},
     {"printInfo", runtime_printInfo},
     {"getBacktrace", runtime_getBacktrace},
     {"__gc", runtime_gc},
@@ -371,10 +637,23 @@ static const struct luaL_Reg runtime_methods[] = {
 
 static const struct luaL_Reg function_methods[] = {
     {"call", function_call},
+    {"callMany", function_callMany},
     {"__gc", function_gc},
     {NULL, NULL}
 };
 
+static const struct luaL_Reg memory_methods[] = {
+    {"size", memory_size},
+    {"read", memory_read},
+    {"write", memory_write},
+    {"readString", memory_readString},
+    {"writeBuffer", memory_writeBuffer},
+    {"pointer", memory_pointer},
+    {"__len", memory_size},
+    {"__gc", memory_gc},
+    {NULL, NULL}
+};
+
 static const struct luaL_Reg wasm3_lib[] = {
     {"newEnvironment", l_new_environment},
     {NULL, NULL}
@@ -394,6 +673,7 @@ int luaopen_wasm3(lua_State *L) {
     create_meta(L, WASM3_RUNTIME_METATABLE, runtime_methods);
     create_meta(L, WASM3_MODULE_METATABLE, module_methods);
     create_meta(L, WASM3_FUNCTION_METATABLE, function_methods);
+    create_meta(L, WASM3_MEMORY_METATABLE, memory_methods);
 
     luaL_newlib(L, wasm3_lib);
     return 1;
@@ -39,6 +39,9 @@ static void nirithy_derive_key(uint64_t timestamp, uint8_t *key) {
 
 /**
  * @brief Initializes decryption state for ZIO.
+ *
+ * Everything after the current position is ciphertext, including what is
+ * left of the reader's current buffer; the next read decrypts from there.
  */
 void luaZ_init_decrypt (ZIO *z, uint64_t timestamp, const uint8_t *iv) {
   uint8_t key[16];
@@ -46,44 +49,45 @@ void luaZ_init_decrypt (ZIO *z, uint64_t timestamp, const uint8_t *iv) {
   AES_init_ctx_iv(&z->ctx, key, iv);
   z->keystream_idx = 16;
   z->encrypted = 1;
+  z->raw = z->p;
+  z->nraw = z->n;
+  z->n = 0;
 }
 
+
 /**
- * @brief Reads and decrypts a byte from the stream.
+ * @brief Decrypts the next window of ciphertext into 'dbuff'.
  *
- * Should only be called via zgetc macro when z->encrypted is true.
- * Assumes z->n > 0.
+ * The CTR keystream is applied a whole run of blocks at a time; only a
+ * block straddling two windows goes through 'keystream'.
  */
-int luaZ_read_decrypt (ZIO *z) {
-  uint8_t b = cast_uchar(*(z->p++));
-
-  if (z->keystream_idx >= 16) {
-    int i;
-    /* Generate new keystream block */
-    memcpy(z->keystream, z->ctx.Iv, 16);
-    AES_ECB_encrypt(&z->ctx, z->keystream);
-
-    /* Increment IV */
-    for (i = 15; i >= 0; --i) {
-      if (z->ctx.Iv[i] == 255) {
-        z->ctx.Iv[i] = 0;
-        continue;
-      }
-      z->ctx.Iv[i]++;
-      break;
-    }
+static void decryptwindow (ZIO *z, size_t size) {
+  uint8_t *dst = cast(uint8_t *, z->dbuff);
+  size_t i = 0;
+  size_t nblocks;
+  memcpy(dst, z->raw, size);
+  z->raw += size;
+  z->nraw -= size;
+  while (z->keystream_idx < 16 && i < size)  /* finish a partial block */
+    dst[i++] ^= z->keystream[z->keystream_idx++];
+  nblocks = (size - i) / AES_BLOCKLEN;
+  AES_CTR_xcrypt_blocks(&z->ctx, dst + i, nblocks);
+  i += nblocks * AES_BLOCKLEN;
+  if (i < size) {  /* start a partial block */
+    memset(z->keystream, 0, sizeof(z->keystream));
+    AES_CTR_xcrypt_blocks(&z->ctx, z->keystream, 1);
     z->keystream_idx = 0;
+    while (i < size)
+      dst[i++] ^= z->keystream[z->keystream_idx++];
   }
-
-  b ^= z->keystream[z->keystream_idx++];
-  return b;
 }
 
 
 /**
  * @brief Fills the buffer of the input stream.
  *
- * Calls the reader function to get more data.
+ * Calls the reader function to get more data. Encrypted streams are served
+ * from 'dbuff' instead, one decrypted window of the reader's data at a time.
  *
  * @param z The input stream.
  * @return The first character of the new buffer, or EOZ if end of stream.
@@ -92,18 +96,24 @@ int luaZ_fill (ZIO *z) {
   size_t size;
   lua_State *L = z->L;
   const char *buff;
-  lua_unlock(L);
-  buff = z->reader(L, z->data, &size);
-  lua_lock(L);
-  if (buff == NULL || size == 0)
-    return EOZ;
+  if (!z->encrypted || z->nraw == 0) {  /* need more input? */
+    lua_unlock(L);
+    buff = z->reader(L, z->data, &size);
+    lua_lock(L);
+    if (buff == NULL || size == 0)
+      return EOZ;
+    if (z->encrypted) {
+      z->raw = buff;
+      z->nraw = size;
+    }
+  }
+  if (z->encrypted) {  /* hand out the next decrypted window instead */
+    size = (z->nraw < LUAZ_DECBUFFSIZE) ? z->nraw : LUAZ_DECBUFFSIZE;
+    decryptwindow(z, size);
+    buff = z->dbuff;
+  }
   z->n = size - 1;  /* discount char being returned */
   z->p = buff;
-
-  if (z->encrypted) {
-    return luaZ_read_decrypt(z);
-  }
-
   return cast_uchar(*(z->p++));
 }
 
@@ -123,6 +133,7 @@ void luaZ_init (lua_State *L, ZIO *z, lua_Reader reader, void *data) {
   z->n = 0;
   z->p = NULL;
   z->encrypted = 0;
+  z->nraw = 0;
 }
 
 
@@ -155,34 +166,12 @@ size_t luaZ_read (ZIO *z, void *b, size_t n) {
     if (!checkbuffer(z))
       return n;  /* no more input; return number of missing bytes */
 
-    /* If encrypted, we must decrypt byte-by-byte (or block-by-block if optimized)
-       Since our decryption logic is byte-based (AES-CTR), we can iterate.
-       Optimization: decrypt directly into 'b' if possible?
-       Our decrypt function reads from z->p and increments it.
-    */
-    if (z->encrypted) {
-      uint8_t *dst = (uint8_t *)b;
-      size_t i;
-      m = (n <= z->n) ? n : z->n;
-
-      for (i = 0; i < m; i++) {
-        dst[i] = (uint8_t)luaZ_read_decrypt(z);
-      }
-      z->n -= m; /* n decremented by caller of read_decrypt? No, read_decrypt only decs p. */
-                 /* wait, zgetc macro decs n. luaZ_read needs to dec n. */
-                 /* luaZ_read_decrypt accesses z->p directly but DOES NOT decrement z->n. */
-                 /* So we handle n here. */
-
-      b = (char *)b + m;
-      n -= m;
-    } else {
-      m = (n <= z->n) ? n : z->n;  /* min. between n and z->n */
-      memcpy(b, z->p, m);
-      z->n -= m;
-      z->p += m;
-      b = (char *)b + m;
-      n -= m;
-    }
+    m = (n <= z->n) ? n : z->n;  /* min. between n and z->n */
+    memcpy(b, z->p, m);
+    z->n -= m;
+    z->p += m;
+    b = (char *)b + m;
+    n -= m;
   }
   return 0;
 }
@@ -197,6 +186,8 @@ size_t luaZ_read (ZIO *z, void *b, size_t n) {
  */
 const void *luaZ_getaddr (ZIO* z, size_t n) {
   const void *res;
+  if (z->encrypted)  /* window is reused: nothing in it outlives a read */
+    return NULL;
   if (!checkbuffer(z))
     return NULL;  /* no more input */
   if (z->n < n)  /* not enough bytes? */
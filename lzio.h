@@ -16,9 +16,12 @@
 
 #define EOZ	(-1)			/* end of stream */
 
+/* size of the window encrypted chunks are decrypted into */
+#define LUAZ_DECBUFFSIZE	4096
+
 typedef struct Zio ZIO;
 
-#define zgetc(z)  (((z)->n--)>0 ?  ((z)->encrypted ? luaZ_read_decrypt(z) : cast_uchar(*(z)->p++)) : luaZ_fill(z))
+#define zgetc(z)  (((z)->n--)>0 ?  cast_uchar(*(z)->p++) : luaZ_fill(z))
 
 #define zungetc(z)  (((z)->n++), ((z)->p--))
 
@@ -64,14 +67,16 @@ struct Zio {
 
   /* Decryption state */
   int encrypted;
+  const char *raw;		/* encrypted bytes left in the reader's buffer */
+  size_t nraw;			/* number of bytes at 'raw' */
   struct AES_ctx ctx;
-  uint8_t keystream[16];
+  uint8_t keystream[16];	/* keystream of a partially used block */
   int keystream_idx;
+  char dbuff[LUAZ_DECBUFFSIZE];	/* decrypted window read through 'p' */
 };
 
 
 LUAI_FUNC int luaZ_fill (ZIO *z);
-LUAI_FUNC int luaZ_read_decrypt (ZIO *z);
 LUAI_FUNC void luaZ_init_decrypt (ZIO *z, uint64_t timestamp, const uint8_t *iv);
 
 #endif
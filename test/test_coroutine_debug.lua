@@ -21,9 +21,14 @@ local co2 = coroutine.create(function()
     worker("B", 2)
 end)
 
+-- Stop events recorded per thread, keyed by line
+local events = {}
+
 debug.setoutputcallback(function(event, src, line)
     local thread = coroutine.running()
     print(string.format("[%s] Thread %s at %s:%d", event, tostring(thread), src, line))
+    events[thread] = events[thread] or {}
+    events[thread][line] = event
     debug.step(thread)
 end)
 
@@ -31,7 +36,9 @@ print("--- Scenario: Stepping in Coroutine A should not affect Coroutine B ---")
 
 print("Resuming Coroutine A...")
 coroutine.resume(co1)
--- Should see [step] for A
+-- Should see [step] for A: debug.step installs the line hook on the
+-- calling coroutine when it has none of its own, so A's worker lines
+-- are reported (the hook A copied from debug.gethook() is nil)
 
 print("Resuming Coroutine B...")
 coroutine.resume(co2)
@@ -39,3 +46,12 @@ coroutine.resume(co2)
 
 print("Resuming Coroutine A again...")
 coroutine.resume(co1)
+
+local loop = debug.getinfo(worker, "S").linedefined + 1
+local body = loop + 1
+assert(events[co1] and events[co1][loop] == "step", "A did not step into worker")
+assert(events[co1][body] == "step", "A did not step through the loop body")
+local b = events[co2] or {}
+assert(b[loop] == nil and b[body] == nil, "stepping in A leaked into B's worker")
+
+print("test_coroutine_debug passed")
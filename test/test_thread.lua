@@ -485,6 +485,89 @@ run_test("通道发送nil", function()
     assert(val == nil, "发送nil失败")
 end)
 
+print("\n---------- 13. thread.spawn 独立状态测试 ----------")
+
+run_test("thread.spawn 基本执行", function()
+    local sp = thread.spawn(function(a, b)
+        return a + b, a * b
+    end, 6, 7)
+    local s, p = sp:join()
+    assert(s == 13 and p == 42, "spawn返回值错误")
+end)
+
+run_test("thread.spawn 深拷贝参数与结果", function()
+    local cfg = { name = "cfg", list = { 1, 2, 3 } }
+    cfg.self = cfg
+    local sp = thread.spawn(function(c)
+        assert(c.self == c, "循环引用丢失")
+        c.list[4] = 4
+        return c
+    end, cfg)
+    local r = sp:join()
+    assert(r ~= cfg and r.self == r, "结果应为独立副本")
+    assert(#r.list == 4 and #cfg.list == 3, "深拷贝失败")
+end)
+
+run_test("thread.spawn 复制上值", function()
+    local base = 100
+    local function add(x) return base + x end
+    local sp = thread.spawn(function(n) return add(n) end, 5)
+    assert(sp:join() == 105, "上值复制失败")
+end)
+
+run_test("thread.spawn _ENV与nil上值", function()
+    local a = 1
+    local sp = thread.spawn(function() return a + math.floor(1.5) end)
+    assert(sp:join() == 2, "_ENV不是第一个上值时未绑定全局表")
+    local x = nil
+    sp = thread.spawn(function() return x end)
+    assert(sp:join() == nil, "nil上值应保持nil")
+    local y = nil
+    sp = thread.spawn(function() return y, type(string.len) end)
+    local r1, r2 = sp:join()
+    assert(r1 == nil and r2 == "function", "nil上值与_ENV混合失败")
+end)
+
+run_test("table.share 与并发读写", function()
+    local tabs = {}
+    for i = 1, 64 do tabs[i] = {} end
+    local workers = {}
+    for w = 1, 4 do
+        workers[w] = thread.create(function()
+            for round = 1, 50 do
+                for i = 1, #tabs do
+                    local t = tabs[i]
+                    table.insert(t, w)
+                    local _ = t[1], #t
+                end
+            end
+            return true
+        end)
+    end
+    for i = 1, #tabs do table.share(tabs[i]) end
+    for w = 1, 4 do assert(workers[w]:join() == true, "工作线程失败") end
+    for i = 1, #tabs do
+        assert(#tabs[i] == 4 * 50, "共享途中的插入丢失")
+    end
+end)
+
+run_test("thread.spawn 错误传播", function()
+    local sp = thread.spawn(function() error("worker failed", 0) end)
+    local ok, err = pcall(sp.join, sp)
+    assert(not ok and err == "worker failed", "错误未传播")
+end)
+
+run_test("thread.spawn 拒绝不可传输值", function()
+    assert(not pcall(thread.spawn, print), "C函数不应可传输")
+    assert(not pcall(thread.spawn, function() end, io.stdout), "userdata不应可传输")
+end)
+
+run_test("thread.spawn 重复join", function()
+    local sp = thread.spawn(function() return 1 end)
+    sp:join()
+    assert(not pcall(sp.join, sp), "重复join应报错")
+end)
+
 print("\n========== 测试结果汇总 ==========")
 print(string.format("通过: %d", passed))
 print(string.format("失败: %d", failed))
@@ -0,0 +1,48 @@
+-- Benchmark: integer arithmetic that overflows into big integers —
+-- factorials, Fibonacci numbers, powers, floor division and decimal
+-- conversion of numbers with tens of thousands of digits.
+
+local N = tonumber(arg and arg[1]) or 1
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local function run(label, fn)
+  fn()  -- warm up
+  local t0 = now()
+  local r
+  for _ = 1, N do r = fn() end
+  print(string.format("%-28s %8.3f s  %s", label, now() - t0, r))
+end
+
+local function fact(n)
+  local r = 1
+  for i = 2, n do r = r * i end
+  return r
+end
+
+local function fib(n)
+  local a, b = 0, 1
+  for _ = 1, n do a, b = b, a + b end
+  return a
+end
+
+run("factorial 5000 (digits)", function() return #tostring(fact(5000)) end)
+run("fibonacci 50000 (digits)", function() return #tostring(fib(50000)) end)
+local f = fact(3000)
+run("square 3000! x20", function()
+  local r
+  for _ = 1, 20 do r = f * f end
+  return #tostring(r)
+end)
+local b = fact(25)
+run("(25!)^5000 (digits)", function() return #tostring(b ^ 5000) end)
+local x, y = fact(4000), fact(1500)
+run("4000! // 1500! x20", function()
+  local q
+  for _ = 1, 20 do q = x // y end
+  return #tostring(q % 1000000007)
+end)
+local g = fact(20000)
+run("tostring 20000!", function() return #tostring(g) end)
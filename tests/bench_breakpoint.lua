@@ -0,0 +1,31 @@
+-- Benchmark: cost of an idle breakpoint. A breakpoint is set on a line
+-- that the hot loop never reaches; before, that installed a line hook
+-- that formatted and looked up "file:line" on every executed line.
+
+local N = tonumber(arg and arg[1]) or 3000000
+local file = debug.getinfo(1, "S").source:match("[^/\\]+$")
+
+local function never_called()
+  return 0
+end
+
+local function work(n)
+  local s = 0
+  for i = 1, n do
+    if i % 3 == 0 then s = s + i else s = s - 1 end
+  end
+  return s
+end
+
+local function run(label)
+  local t0 = os.clock()
+  local r = work(N)
+  print(string.format("%-32s %8.3f s  (%d)", label, os.clock() - t0, r))
+end
+
+run("no breakpoint")
+debug.setoutputcallback(function() end)
+debug.setbreakpoint(file, debug.getinfo(never_called, "S").linedefined + 1)
+run("idle breakpoint elsewhere")
+debug.clearbreakpoints()
+run("after clearbreakpoints")
@@ -0,0 +1,48 @@
+-- Benchmark: startup cost of loading a large precompiled module in the
+-- default container format vs the fast format (string.dump{fast=true}).
+-- The default format hashes maps per string and per function; the fast
+-- format verifies one digest for the whole chunk.
+
+local NFUNCS = tonumber(arg and arg[1]) or 400
+local ROUNDS = tonumber(arg and arg[2]) or 10
+
+-- generate a module with many functions and string constants
+local parts = {"local M = {}"}
+for i = 1, NFUNCS do
+  parts[#parts + 1] = string.format([[
+function M.f%d(t, x)
+  local name, kind = "field_%d", "kind_%d"
+  if t[name] == nil then t[name] = {kind = kind, n = 0, tag = "entry number %d"} end
+  t[name].n = t[name].n + x * %d
+  return t[name].n, kind .. ":" .. name
+end]], i, i, i % 17, i, i)
+end
+parts[#parts + 1] = "return M"
+local src = table.concat(parts, "\n")
+local fn = assert(load(src, "=module"))
+
+local old = string.dump(fn, {envelop = false})
+local new = string.dump(fn, {envelop = false, fast = true})
+
+local function run(chunk)
+  local c0 = os.clock()
+  local m
+  for _ = 1, ROUNDS do
+    m = assert(load(chunk, "=module", "b"))()
+  end
+  return (os.clock() - c0) / ROUNDS, m
+end
+
+local to, mo = run(old)
+local tn, mn = run(new)
+local t1, t2 = {}, {}
+for i = 1, NFUNCS, 37 do
+  local k = "f" .. i
+  assert(mo[k](t1, 3) == mn[k](t2, 3))
+  assert(select(2, mo[k](t1, 1)) == select(2, mn[k](t2, 1)))
+end
+
+print(string.format("module: %d functions, %d bytes source", NFUNCS, #src))
+print(string.format("default format: %7d bytes  %.3f ms/load", #old, to * 1e3))
+print(string.format("fast format:    %7d bytes  %.3f ms/load", #new, tn * 1e3))
+print(string.format("speedup: %.1fx", to / tn))
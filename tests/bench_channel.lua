@@ -0,0 +1,73 @@
+-- Benchmark: thread channels.
+-- ping-pong: two threads bounce one value, measuring round-trip latency.
+-- fan-in: producers push into one channel and a consumer drains it, with
+-- single-value and batched (send_many/recv_many) transfers.
+
+local thread = require("thread")
+
+local ROUNDS = tonumber(arg and arg[1]) or 20000
+local ITEMS = tonumber(arg and arg[2]) or 200000
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local function pingpong()
+  local ping, pong = thread.channel(1), thread.channel(1)
+  local t0 = now()
+  local peer = thread.create(function()
+    for _ = 1, ROUNDS do pong:send(ping:receive() + 1) end
+  end)
+  local v = 0
+  for _ = 1, ROUNDS do
+    ping:send(v)
+    v = pong:receive()
+  end
+  peer:join()
+  assert(v == ROUNDS)
+  local dt = now() - t0
+  print(string.format("%-24s %8.3f s %10.2f us/round-trip", "ping-pong", dt, dt * 1e6 / ROUNDS))
+end
+
+local function fanin(producers, batch)
+  local ch = thread.channel(1024)
+  local per = ITEMS // producers
+  local t0 = now()
+  local handles = {}
+  for p = 1, producers do
+    handles[p] = thread.create(function()
+      if batch > 1 then
+        local buf = {}
+        for i = 1, batch do buf[i] = i end
+        for _ = 1, per // batch do ch:send_many(buf) end
+      else
+        for i = 1, per do ch:send(i) end
+      end
+    end)
+  end
+  local total = per // (batch > 1 and batch or 1) * (batch > 1 and batch or 1) * producers
+  local got = 0
+  if batch > 1 then
+    local buf = {}
+    while got < total do
+      local _, n = ch:recv_many(batch, buf)
+      got = got + n
+    end
+  else
+    while got < total do
+      ch:receive()
+      got = got + 1
+    end
+  end
+  for p = 1, producers do handles[p]:join() end
+  local dt = now() - t0
+  print(string.format("%-24s %8.3f s %10.0f msgs/s",
+                      string.format("fan-in %dx%s", producers, batch > 1 and (" batch " .. batch) or ""),
+                      dt, got / dt))
+end
+
+pingpong()
+for _, p in ipairs({1, 4}) do
+  fanin(p, 1)
+  fanin(p, 64)
+end
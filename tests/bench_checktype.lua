@@ -0,0 +1,31 @@
+-- Benchmark: calls whose parameters carry annotations that are checked at
+-- run time (classes, generic type parameters, library tables, 'thread').
+
+local N = tonumber(arg and arg[1]) or 2000000
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+class Base
+  function __init__(self) self.v = 1 end
+end
+class Derived extends Base end
+
+local function typed(T)
+  return function(x: T) return x end
+end
+
+local function run(label, f, v)
+  f(v)  -- warm up
+  local t0 = now()
+  for _ = 1, N do f(v) end
+  print(string.format("%-26s %8.3f s", label, now() - t0))
+end
+
+local co = coroutine.create(print)
+run("thread", function(x: thread) return x end, co)
+run("generic T = \"number\"", typed("number"), 1.5)
+run("generic T = string", typed(string), "s")
+run("class (exact)", function(x: Base) return x end, Base())
+run("class (subclass)", function(x: Base) return x end, Derived())
@@ -0,0 +1,40 @@
+-- Benchmark: loading large encrypted chunks (string.envelop sources and
+-- the default enveloped string.dump) against their plain counterparts.
+
+local NFUNCS = tonumber(arg and arg[1]) or 2000
+local ROUNDS = tonumber(arg and arg[2]) or 10
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local parts = {"local M = {}"}
+for i = 1, NFUNCS do
+  parts[#parts + 1] = string.format([[
+function M.f%d(t, x)
+  local name = "field_%d"
+  t[name] = (t[name] or 0) + x * %d
+  return t[name]
+end]], i, i, i)
+end
+parts[#parts + 1] = "return M"
+local src = table.concat(parts, "\n")
+local fn = assert(load(src, "=module"))
+
+local cases = {
+  {"source, plain", src, "t"},
+  {"source, enveloped", string.envelop(src), "bt"},
+  {"bytecode, plain", string.dump(fn, {envelop = false}), "b"},
+  {"bytecode, enveloped", string.dump(fn), "b"},
+}
+
+for _, c in ipairs(cases) do
+  local label, chunk, mode = c[1], c[2], c[3]
+  assert(load(chunk, "=module", mode))
+  local t0 = now()
+  for _ = 1, ROUNDS do
+    assert(load(chunk, "=module", mode))
+  end
+  local dt = (now() - t0) / ROUNDS
+  print(string.format("%-22s %8.1f KB %8.3f ms", label, #chunk / 1024, dt * 1e3))
+end
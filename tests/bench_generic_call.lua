@@ -0,0 +1,25 @@
+-- Benchmark: calls to generic functions whose type parameters are
+-- inferred from the arguments, with one and with several parameters.
+
+local N = tonumber(arg and arg[1]) or 500000
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+function Id(T)(x: T) return x end
+function Pair(A, B)(a: A, b: B) return a end
+struct Vec { int x; int y; }
+
+local function run(label, f, ...)
+  f(...)  -- warm up
+  local t0 = now()
+  for _ = 1, N do f(...) end
+  print(string.format("%-24s %8.3f s", label, now() - t0))
+end
+
+local v = Vec()
+run("Id(number)", Id, 1)
+run("Id(string)", Id, "s")
+run("Id(struct)", Id, v)
+run("Pair(number, string)", Pair, 1, "s")
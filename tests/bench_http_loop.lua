@@ -0,0 +1,60 @@
+-- Benchmark: http.loop serving keep-alive clients from one thread.
+-- Clients and server share the loop, so the rate counts both sides.
+-- Each client sends REQS requests on one connection; the number of
+-- concurrent connections grows until MAXC.
+
+local http = require("http")
+
+local REQS = tonumber(arg and arg[1]) or 50
+local MAXC = tonumber(arg and arg[2]) or 400
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local request = "GET /bench HTTP/1.1\r\nHost: bench\r\n\r\n"
+
+local function client(loop, port, counter)
+  local c = assert(loop:connect("127.0.0.1", port))
+  local buf = ""
+  for _ = 1, REQS do
+    c:send(request)
+    while true do
+      local hend = buf:find("\r\n\r\n", 1, true)
+      if hend then
+        local len = tonumber(buf:match("Content%-Length: (%d+)"))
+        if #buf >= hend + 3 + len then
+          buf = buf:sub(hend + 4 + len)
+          break
+        end
+      end
+      buf = buf .. assert(c:recv(4096))
+    end
+    counter.n = counter.n + 1
+  end
+  c:close()
+end
+
+print(string.format("%-8s %10s %12s", "conns", "time (s)", "requests/s"))
+local nc = 1
+while nc <= MAXC do
+  local loop = http.loop()
+  local srv = assert(loop:listen(0))
+  local _, port = srv:getsockname()
+  loop:serve(srv, function(req)
+    return 200, "hello " .. req.path, {["Content-Type"] = "text/plain"}
+  end)
+  local counter = {n = 0}
+  local t0 = now()
+  for _ = 1, nc do
+    loop:spawn(client, loop, port, counter)
+  end
+  loop:spawn(function()
+    while counter.n < nc * REQS do loop:sleep(0.001) end
+    srv:close()
+  end)
+  loop:run()
+  local dt = now() - t0
+  print(string.format("%-8d %10.3f %12.0f", nc, dt, counter.n / dt))
+  nc = nc * 4
+end
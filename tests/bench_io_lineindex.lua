@@ -0,0 +1,46 @@
+-- Benchmark: reading a log file line by line through io.readline, which
+-- used to rescan the file from byte 0 on every call, plus io.linecount
+-- and io.readlines on the same file.
+
+local NLINES = tonumber(arg and arg[1]) or 20000
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local name = os.tmpname()
+local f = assert(io.open(name, "w"))
+for i = 1, NLINES do
+  f:write(string.format("2024-05-01 12:00:%02d INFO request id=%08x path=/api/v1/items/%d\n",
+                        i % 60, i * 2654435761 % 2^32, i))
+end
+f:close()
+
+local function run(label, fn)
+  local t0 = now()
+  fn()
+  print(string.format("%-28s %8.3f s", label, now() - t0))
+end
+
+run("readline 1..N", function()
+  for i = 1, NLINES do
+    assert(io.readline(name, i))
+  end
+end)
+run("readline random", function()
+  local x = 1
+  for _ = 1, NLINES do
+    x = x * 1103515245 % NLINES + 1
+    assert(io.readline(name, x))
+  end
+end)
+run("linecount x100", function()
+  for _ = 1, 100 do assert(io.linecount(name) == NLINES) end
+end)
+run("readlines 100-line windows", function()
+  for i = 1, NLINES, 100 do
+    assert(#io.readlines(name, i, i + 99) >= 1)
+  end
+end)
+
+os.remove(name)
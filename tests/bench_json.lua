@@ -0,0 +1,36 @@
+-- Benchmark: json.decode / json.encode throughput on a ~1 MB document of
+-- records with repeated keys, short strings, escapes and numbers.
+
+local ROUNDS = tonumber(arg and arg[1]) or 20
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local records = {}
+for i = 1, 5000 do
+  records[i] = {
+    id = i,
+    name = "user_" .. i,
+    email = string.format("user%d@example.com", i),
+    score = i * 0.25,
+    active = i % 3 == 0,
+    tags = {"alpha", "beta", "gamma\t" .. (i % 10)},
+    address = {city = "City " .. (i % 50), zip = string.format("%05d", i)},
+  }
+end
+local text = json.encode(records)
+local mb = #text / (1024 * 1024)
+
+local function run(label, fn)
+  fn()  -- warm up
+  local t0 = now()
+  for _ = 1, ROUNDS do fn() end
+  local dt = now() - t0
+  print(string.format("%-8s %8.3f s %10.1f MB/s", label, dt, mb * ROUNDS / dt))
+end
+
+print(string.format("document: %.2f MB, %d rounds", mb, ROUNDS))
+run("decode", function() return json.decode(text) end)
+local doc = json.decode(text)
+run("encode", function() return json.encode(doc) end)
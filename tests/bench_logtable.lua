@@ -0,0 +1,45 @@
+-- Benchmark: table access logging overhead, synchronous vs async ring.
+-- Usage: lxclua tests/bench_logtable.lua [iterations] [logdir]
+
+local N = tonumber(arg and arg[1]) or 200000
+local dir = arg and arg[2] or os.getenv("TMPDIR") or "/tmp"
+
+local function workload()
+  -- raw accesses go through luaH_get/luaH_set, where logging hooks in
+  local t = {}
+  local rawset, rawget = rawset, rawget
+  local c0 = os.clock()
+  for i = 1, N do
+    rawset(t, "x", i)
+    local _ = rawget(t, "x")
+  end
+  return os.clock() - c0
+end
+
+local base = workload()
+print(string.format("no logging:   %.3fs", base))
+
+local function run(label, path)
+  assert(logtable.onlog(true, path), "cannot open " .. path)
+  local dt = workload()
+  logtable.onlog(false)
+  os.remove(path)
+  print(string.format("%-13s %.3fs (%.1fx)", label .. ":", dt, dt / base))
+  return dt
+end
+
+logtable.setasync(false)
+run("sync text", dir .. "/bench_logtable_sync.log")
+
+logtable.setasync(true, 1 << 16, "text")
+run("async text", dir .. "/bench_logtable_async.log")
+local s = logtable.stats()
+print(string.format("  recorded %d, dropped %d, written %d",
+                    s.recorded, s.dropped, s.written))
+
+logtable.setasync(true, 1 << 16, "binary")
+run("async binary", dir .. "/bench_logtable_async.bin")
+s = logtable.stats()
+print(string.format("  recorded %d, dropped %d, written %d",
+                    s.recorded, s.dropped, s.written))
+logtable.setasync(false)
@@ -0,0 +1,38 @@
+-- Benchmark: global names resolved through 'using' of a chain of
+-- namespaces, and names that no namespace defines.
+
+namespace Outer {
+  namespace Middle {
+    namespace Inner {
+      deep = 1
+    }
+    using namespace Inner;
+    mid = 1
+  }
+  using namespace Middle;
+  top = 1
+}
+using namespace Outer;
+
+local N = tonumber(arg and arg[1]) or 2000000
+local now = os.tickcount
+
+local function run(label, f)
+  local t0 = now()
+  f()
+  print(string.format("%-26s %8.3f s", label, (now() - t0) / 1e6))
+end
+
+run("first namespace", function()
+  local s = 0
+  for _ = 1, N do s = s + top end
+  assert(s == N)
+end)
+run("third namespace", function()
+  local s = 0
+  for _ = 1, N do s = s + deep end
+  assert(s == N)
+end)
+run("missing name", function()
+  for _ = 1, N do assert(undefined_name == nil) end
+end)
@@ -0,0 +1,63 @@
+-- Benchmark: plain substring search through `in`, string.contains,
+-- string.find(..., true) and string.split, on log-line-sized haystacks
+-- and on a 1 MB haystack, including a periodic needle that makes naive
+-- first-byte search quadratic.
+
+local ROUNDS = tonumber(arg and arg[1]) or 50
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local lines = {}
+for i = 1, 4096 do
+  lines[i] = string.format(
+    "2024-05-%02d 12:%02d:%02d INFO  [worker-%d] request id=%08x path=/api/v1/items/%d status=200 bytes=%d",
+    i % 28 + 1, i % 60, (i * 7) % 60, i % 16, i * 2654435761 % 2^32, i, i * 13 % 9000)
+end
+local lines_mb = 0
+for i = 1, #lines do lines_mb = lines_mb + #lines[i] end
+lines_mb = lines_mb / (1024 * 1024)
+
+local big = table.concat(lines, "\n")
+big = big .. string.rep(big, math.max(1, (1024 * 1024) // #big))
+local big_mb = #big / (1024 * 1024)
+local periodic = string.rep("a", 1024 * 1024)
+local periodic_needle = string.rep("a", 63) .. "b"
+
+local function run(label, mb, fn)
+  fn()  -- warm up
+  local t0 = now()
+  for _ = 1, ROUNDS do fn() end
+  local dt = now() - t0
+  print(string.format("%-28s %8.3f s %10.1f MB/s", label, dt, mb * ROUNDS / dt))
+end
+
+run("lines: in (short miss)", lines_mb, function()
+  local n = 0
+  for i = 1, #lines do if "ERROR" in lines[i] then n = n + 1 end end
+  assert(n == 0)
+end)
+run("lines: contains (hit)", lines_mb, function()
+  local n = 0
+  for i = 1, #lines do if string.contains(lines[i], "status=200") then n = n + 1 end end
+  assert(n == #lines)
+end)
+run("lines: find plain", lines_mb, function()
+  for i = 1, #lines do assert(string.find(lines[i], "/api/v1/items/", 1, true)) end
+end)
+run("lines: split", lines_mb, function()
+  for i = 1, #lines do assert(#string.split(lines[i], " ") >= 8) end
+end)
+run("1 MB: in (short miss)", big_mb, function()
+  assert(not ("FATAL" in big))
+end)
+run("1 MB: find (long miss)", big_mb, function()
+  assert(not string.find(big, "path=/api/v2/items/ status=500 bytes=0", 1, true))
+end)
+run("1 MB: split lines", big_mb, function()
+  assert(#string.split(big, "\n") > 4096)
+end)
+run("1 MB periodic: contains", 1, function()
+  assert(not string.contains(periodic, periodic_needle))
+end)
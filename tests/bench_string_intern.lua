@@ -0,0 +1,50 @@
+-- Benchmark: short-string hashing and interning on a single thread.
+-- Every token produced by gmatch is a short string that goes through the
+-- intern table, so the run is dominated by hashing and bucket lookups.
+-- Tokens of several lengths are timed separately, since the hash walks
+-- the string a word at a time and its cost grows with length. Interning
+-- still runs under the core lock (lua_lock); this only measures the hash.
+
+local ITERS = tonumber(arg and arg[1]) or 20000
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+-- 200 lines of 8 "key=value" fields whose keys and values pad to 'len'
+local function make_input(len)
+  local lines = {}
+  for i = 1, 200 do
+    local fields = {}
+    for j = 1, 8 do
+      local k = string.format("k%d_%d_", j, i % 97)
+      local v = string.format("v%d_%d_", j, (i * j) % 1013)
+      k = k .. string.rep("x", len - #k)
+      v = v .. string.rep("y", len - #v)
+      fields[j] = k .. "=" .. v
+    end
+    lines[i] = table.concat(fields, ";")
+  end
+  return lines
+end
+
+local function run(lines, iters)
+  local count, total = 0, 0
+  for n = 1, iters do
+    local line = lines[(n % #lines) + 1]
+    for k, v in line:gmatch("([%w_]+)=([%w_]+)") do
+      total = total + #k + #v
+      count = count + 1
+    end
+  end
+  return count, total
+end
+
+print(string.format("%-8s %10s %14s", "length", "time (s)", "tokens/s"))
+for _, len in ipairs({8, 16, 24, 32, 40}) do
+  local lines = make_input(len)
+  local t0 = now()
+  local count = run(lines, ITERS)
+  local dt = now() - t0
+  print(string.format("%-8d %10.3f %14.0f", len, dt, count * 2 / dt))
+end
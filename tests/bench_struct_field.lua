@@ -0,0 +1,30 @@
+-- Benchmark: hot numeric field loops on structs vs plain tables.
+-- GETFIELD/SETFIELD on a struct hit the per-instruction inline cache,
+-- so the struct loop should be close to the table loop.
+
+local N = tonumber(arg and arg[1]) or 5000000
+
+struct Particle {
+  float x;
+  float y;
+  float vx;
+  float vy;
+  int steps;
+}
+
+local function run(p)
+  local c0 = os.clock()
+  for _ = 1, N do
+    p.x = p.x + p.vx
+    p.y = p.y + p.vy
+    p.steps = p.steps + 1
+  end
+  return os.clock() - c0, p
+end
+
+local ts, p = run(Particle{x = 0.0, y = 0.0, vx = 0.5, vy = 0.25, steps = 0})
+local tt, q = run({x = 0.0, y = 0.0, vx = 0.5, vy = 0.25, steps = 0})
+assert(p.steps == N and q.steps == N and p.x == q.x)
+
+print(string.format("struct: %.3fs  (%.1f ns/iter)", ts, ts * 1e9 / N))
+print(string.format("table:  %.3fs  (%.1f ns/iter)", tt, tt * 1e9 / N))
@@ -0,0 +1,32 @@
+-- Benchmark: building a large superstruct member by member, looking its
+-- members up by name and traversing it.
+
+local N = tonumber(arg and arg[1]) or 100000
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local names = {}
+for i = 1, N do names[i] = "member_" .. ((i * 7919) % N) end
+
+superstruct Defs []
+local t0 = now()
+for i = 1, N do Defs[names[i]] = i end
+print(string.format("build %d members      %8.3f s", N, now() - t0))
+
+t0 = now()
+local sum = 0
+for _ = 1, 10 do
+  for i = 1, N do sum = sum + Defs[names[i]] end
+end
+assert(sum == 10 * N * (N + 1) // 2)
+print(string.format("10 x %d lookups       %8.3f s", N, now() - t0))
+
+t0 = now()
+local n = 0
+for _ = 1, 10 do
+  for _ in pairs(Defs) do n = n + 1 end
+end
+assert(n == 10 * N)
+print(string.format("10 traversals          %8.3f s", now() - t0))
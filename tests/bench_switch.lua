@@ -0,0 +1,154 @@
+-- Benchmark: switch dispatch on constant labels. The "table" variants
+-- compile to OP_SWITCH; the "chain" variants end with one non-constant
+-- label, which keeps the equality chain, so both run the same cases on
+-- this build. Inputs are spread over every case plus some misses.
+
+local ITER = tonumber(arg and arg[1]) or 2000000
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local NOMATCH = -1
+
+local function int_table(x)
+  switch x do
+    case 0: return 0
+    case 1: return 3
+    case 2: return 6
+    case 3: return 9
+    case 4: return 12
+    case 5: return 15
+    case 6: return 18
+    case 7: return 21
+    case 8: return 24
+    case 9: return 27
+    case 10: return 30
+    case 11: return 33
+    case 12: return 36
+    case 13: return 39
+    case 14: return 42
+    case 15: return 45
+    case 16: return 48
+    case 17: return 51
+    case 18: return 54
+    case 19: return 57
+    case 20: return 60
+    case 21: return 63
+    case 22: return 66
+    case 23: return 69
+    case 24: return 72
+    case 25: return 75
+    case 26: return 78
+    case 27: return 81
+    case 28: return 84
+    case 29: return 87
+    case 30: return 90
+    case 31: return 93
+    default: return 0
+  end
+end
+
+local function int_chain(x)
+  switch x do
+    case 0: return 0
+    case 1: return 3
+    case 2: return 6
+    case 3: return 9
+    case 4: return 12
+    case 5: return 15
+    case 6: return 18
+    case 7: return 21
+    case 8: return 24
+    case 9: return 27
+    case 10: return 30
+    case 11: return 33
+    case 12: return 36
+    case 13: return 39
+    case 14: return 42
+    case 15: return 45
+    case 16: return 48
+    case 17: return 51
+    case 18: return 54
+    case 19: return 57
+    case 20: return 60
+    case 21: return 63
+    case 22: return 66
+    case 23: return 69
+    case 24: return 72
+    case 25: return 75
+    case 26: return 78
+    case 27: return 81
+    case 28: return 84
+    case 29: return 87
+    case 30: return 90
+    case 31: return 93
+    case NOMATCH: return -1
+    default: return 0
+  end
+end
+
+local function str_table(s)
+  switch s do
+    case "op_0": return 0
+    case "op_1": return 1
+    case "op_2": return 2
+    case "op_3": return 3
+    case "op_4": return 4
+    case "op_5": return 5
+    case "op_6": return 6
+    case "op_7": return 7
+    case "op_8": return 8
+    case "op_9": return 9
+    case "op_10": return 10
+    case "op_11": return 11
+    case "op_12": return 12
+    case "op_13": return 13
+    case "op_14": return 14
+    case "op_15": return 15
+    default: return -1
+  end
+end
+
+local function str_chain(s)
+  switch s do
+    case "op_0": return 0
+    case "op_1": return 1
+    case "op_2": return 2
+    case "op_3": return 3
+    case "op_4": return 4
+    case "op_5": return 5
+    case "op_6": return 6
+    case "op_7": return 7
+    case "op_8": return 8
+    case "op_9": return 9
+    case "op_10": return 10
+    case "op_11": return 11
+    case "op_12": return 12
+    case "op_13": return 13
+    case "op_14": return 14
+    case "op_15": return 15
+    case NOMATCH: return -2
+    default: return -1
+  end
+end
+
+local ints, strs = {}, {}
+for i = 1, 1024 do
+  ints[i] = (i * 7) % 40
+  strs[i] = "op_" .. ((i * 5) % 20)
+end
+
+local function run(label, fn, inputs)
+  local t0 = now()
+  local acc = 0
+  for n = 1, ITER do
+    acc = acc + fn(inputs[(n & 1023) + 1])
+  end
+  local dt = now() - t0
+  print(string.format("%-10s %8.3f s %10.1f M dispatch/s", label, dt, ITER / dt / 1e6))
+  return acc
+end
+
+assert(run("int chain", int_chain, ints) == run("int table", int_table, ints))
+assert(run("str chain", str_chain, strs) == run("str table", str_table, strs))
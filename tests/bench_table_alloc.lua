@@ -0,0 +1,34 @@
+-- Benchmark: per-table memory and luaH_new/luaH_free throughput.
+-- Tables only carry an rwlock once table.share() is called on them,
+-- so plain tables should be markedly smaller than shared ones.
+
+local N = tonumber(arg and arg[1]) or 1000000
+
+local function measure(make)
+  collectgarbage()
+  collectgarbage("stop")
+  local keep = {}
+  for i = 1, N do keep[i] = false end  -- presize the holder
+  local m0 = collectgarbage("count")
+  for i = 1, N do keep[i] = make() end
+  local m1 = collectgarbage("count")
+  keep = nil
+  collectgarbage("restart")
+  collectgarbage()
+  return (m1 - m0) * 1024 / N
+end
+
+local plain = measure(function() return {} end)
+local shared = measure(function() return table.share({}) end)
+print(string.format("plain table:  %6.1f bytes", plain))
+print(string.format("shared table: %6.1f bytes", shared))
+
+local rounds = 5
+local c0 = os.clock()
+for _ = 1, rounds do
+  for _ = 1, N do local _ = {} end
+  collectgarbage()
+end
+local dt = os.clock() - c0
+print(string.format("new+free %d tables: %.3fs (%.1f ns/table)",
+                    rounds * N, dt, dt * 1e9 / (rounds * N)))
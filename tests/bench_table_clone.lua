@@ -0,0 +1,41 @@
+-- Benchmark: table.clone on config/state-snapshot shaped data: a wide
+-- record of mixed scalars, nested records and arrays of small records.
+
+local ROUNDS = tonumber(arg and arg[1]) or 200
+
+local function now()
+  return os.tickcount() / 1e6
+end
+
+local snapshot = {settings = {}, users = {}, matrix = {}}
+for i = 1, 2000 do
+  snapshot.settings["opt_" .. i] = (i % 3 == 0) and ("v" .. i) or i
+end
+for i = 1, 2000 do
+  snapshot.users[i] = {id = i, name = "user" .. i, tags = {"a", "b", "c"},
+                       limits = {rps = i % 100, burst = 10}}
+end
+for i = 1, 200 do
+  local row = {}
+  for j = 1, 200 do row[j] = i * j + 0.5 end
+  snapshot.matrix[i] = row
+end
+snapshot.self = snapshot
+
+local function run(label, fn)
+  fn()  -- warm up
+  local t0 = now()
+  for _ = 1, ROUNDS do fn() end
+  print(string.format("%-28s %8.3f s", label, now() - t0))
+end
+
+run("clone snapshot", function()
+  local c = table.clone(snapshot)
+  assert(c.self == c and c.users[7].limits.burst == 10)
+end)
+run("clone flat record", function()
+  assert(table.clone(snapshot.settings).opt_3 == "v3")
+end)
+run("clone numeric matrix", function()
+  assert(table.clone(snapshot.matrix)[200][200] == 40000.5)
+end)
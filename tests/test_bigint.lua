@@ -0,0 +1,110 @@
+-- Big integers: integer overflow promotion, exact arithmetic, division,
+-- powers, comparisons and decimal conversion
+
+local max, min = math.maxinteger, math.mininteger
+
+local function big(s)  -- build a big integer from decimal digits
+  local r = 0
+  for i = 1, #s, 18 do
+    local chunk = s:sub(i, i + 17)
+    r = r * math.tointeger(10 ^ #chunk) + tonumber(chunk)
+  end
+  return r
+end
+
+local function fact(n)
+  local r = 1
+  for i = 2, n do r = r * i end
+  return r
+end
+
+-- overflow promotes, and results that fit come back as integers
+local a = max + 1
+assert(tostring(a) == "9223372036854775808")
+assert(math.type(a - 1) == "integer" and a - 1 == max)
+assert(tostring(min - 1) == "-9223372036854775809")
+assert(min - 1 + 1 == min and math.type(min - 1 + 1) == "integer")
+assert(-(max + 1) == min and math.type(-(max + 1)) == "integer")
+assert(tostring(max * max) == "85070591730234615847396907784232501249")
+assert(tostring(a * a) == "85070591730234615865843651857942052864")
+assert(max * 2 - max == max)
+local acc = 0
+for _ = 1, 4 do acc = acc + max end
+assert(tostring(acc) == "36893488147419103228")
+assert(acc - max - max - max - max == 0)
+
+-- schoolbook and Karatsuba products against known factorials
+assert(tostring(fact(25)) == "15511210043330985984000000")
+local f100 = "93326215443944152681699238856266700490715968264381621468592963895217599993229915608941463976156518286253697920827223758251185210916864000000000000000000000000"
+assert(tostring(fact(100)) == f100)
+local f1000 = tostring(fact(1000))
+assert(#f1000 == 2568 and f1000:sub(1, 20) == "40238726007709377354" and f1000:sub(-249) == string.rep("0", 249))
+assert(fact(1000) // fact(998) == 999000)
+assert(fact(1000) % fact(999) == 0)
+assert(fact(400) * fact(600) == fact(600) * fact(400))
+
+-- floor division and modulo follow the signs of Lua integers
+local p = big("123456789012345678901234567890")
+local q = big("987654321987654321")
+assert(p // q == 124999998748 and p % q == 432099904777777782)
+assert(-p // q == -124999998749 and -p % q == 555554417209876539)
+assert(p // -q == -124999998749 and p % -q == -555554417209876539)
+assert((-p) // (-q) == p // q and (-p) % (-q) == -(p % q))
+assert(p // 7 * 7 + p % 7 == p)
+assert(5 // p == 0 and 5 % p == 5 and -5 // p == -1 and -5 % p == p - 5)
+assert(not pcall(function() return p // 0 end))
+assert(not pcall(function() return p % 0 end))
+assert(math.type(p / q) == "float" and math.abs(p / q - 124999998748.4) < 1)
+
+-- exact powers of big bases, float powers otherwise
+assert(tostring(a ^ 2) == tostring(a * a))
+assert(tostring((min - 1) ^ 3) == "-784637716923335095734685453091662149637995502242394800129")
+assert(a ^ 0 == 1 and a ^ 1 == a)
+assert(math.type(a ^ -1) == "float" and math.type(a ^ 0.5) == "float")
+assert(math.type(2 ^ 10) == "float")
+local two64 = (max + 1) * 2
+assert(tostring(two64 ^ 20):sub(1, 30) == "208158643893287981638504806547")
+assert(two64 ^ 20 < math.huge and two64 ^ 20 > 2.0 ^ 1000)
+assert(two64 ^ 20 == two64 ^ 10 * two64 ^ 10)
+
+-- comparisons with integers, floats and each other
+assert(a > max and -a == min and -a - 1 < min and a ~= max and a == max + 1)
+assert(a == 2.0 ^ 63 and 2.0 ^ 63 == a and a < 2.0 ^ 64 and a > 2.0 ^ 62)
+assert(a + 1 > 2.0 ^ 63 and a + 1 ~= 2.0 ^ 63)
+assert(a < math.huge and -a > -math.huge)
+assert(not (a < 0 / 0) and not (a >= 0 / 0) and a ~= 0 / 0)
+assert(a < 9.3e18 and a > 9.2e18 and a >= 2 ^ 63 and a <= 2 ^ 63)
+assert(fact(30) > fact(29) and fact(29) < fact(30) and -fact(30) < -fact(29))
+assert(math.max(a, 1, fact(21)) == fact(21))
+local t = {fact(22), a, -a, fact(21), max}
+table.sort(t)
+assert(t[1] == -a and t[2] == max and t[3] == a and t[5] == fact(22))
+
+-- mixed with floats and strings
+assert(math.type(a + 0.5) == "float" and a + 0.5 == 2.0 ^ 63)
+assert(a * 1.0 == 2.0 ^ 63 and a - 4096.0 < a)
+assert(a .. "" == "9223372036854775808" and "x" .. (a + 1) == "x9223372036854775809")
+assert(string.format("%s", -a) == "-9223372036854775808")
+
+-- decimal conversion around chunk and level boundaries
+for digits = 18, 1300, 37 do
+  local s = "9" .. string.rep("0", digits - 2) .. "7"
+  assert(tostring(big(s)) == s, digits)
+  assert(tostring(-big(s)) == "-" .. s, digits)
+end
+local ten = 1000000000000000000
+local pow10 = ten
+for i = 1, 60 do
+  pow10 = pow10 * ten
+  assert(tostring(pow10) == "1" .. string.rep("0", 18 * (i + 1)))
+  assert(tostring(pow10 - 1) == string.rep("9", 18 * (i + 1)))
+end
+
+-- lots of short-lived big integers
+for i = 1, 20000 do
+  local x = max + i
+  assert(x - i == max)
+end
+collectgarbage()
+
+print("test_bigint passed")
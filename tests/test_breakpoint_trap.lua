@@ -0,0 +1,155 @@
+-- Breakpoints patch the code with OP_TRAP instead of installing a line hook
+local ByteCode = require "ByteCode"
+
+local file = debug.getinfo(1, "S").source:match("[^/\\]+$")
+
+local hits = {}
+debug.setoutputcallback(function(event, src, line)
+  hits[#hits + 1] = event .. ":" .. line
+end)
+
+local function reset() hits = {} end
+
+local function opnames(f)
+  local p, names = ByteCode.GetProto(f), {}
+  for pc = 1, ByteCode.GetCodeCount(p) do
+    local _, name = ByteCode.GetOpCode(ByteCode.GetCode(p, pc))
+    names[#names + 1] = name
+  end
+  return table.concat(names, " ")
+end
+
+local function target(n)
+  local s = 0
+  for i = 1, n do s = s + i end
+  return s
+end
+local base = debug.getinfo(target, "S").linedefined
+local before = opnames(target)
+
+-- a plain breakpoint needs no hook and stops once per visit of the line
+debug.setbreakpoint(file, base + 3)
+assert(debug.gethook() == nil)
+assert(target(10) == 55)
+assert(#hits == 1 and hits[1] == "breakpoint:" .. (base + 3))
+assert(opnames(target) == before, "the side table hides the traps")
+
+-- a loop written on one line stops at every iteration
+reset()
+debug.setbreakpoint(file, base + 2)
+assert(target(4) == 10)
+assert(#hits == 6, #hits)  -- entering the loop line, 4 iterations, return
+assert(hits[1] == "breakpoint:" .. (base + 2) and hits[6] == "breakpoint:" .. (base + 3))
+
+-- disable, enable, remove
+reset()
+debug.enablebreakpoint(file, base + 2, false)
+assert(target(4) == 10 and #hits == 1)
+debug.enablebreakpoint(file, base + 2, true)
+reset()
+assert(target(1) == 1 and #hits == 3)
+assert(debug.removebreakpoint(file, base + 2))
+assert(not debug.removebreakpoint(file, base + 2))
+reset()
+assert(target(3) == 6 and #hits == 1)
+assert(debug.clearbreakpoints() == 1)
+reset()
+assert(target(3) == 6 and #hits == 0)
+
+-- conditions are compiled once and see globals
+local function cond(x)
+  local y = x * 2
+  return y
+end
+local cbase = debug.getinfo(cond, "S").linedefined
+BP_ARMED = false
+debug.setbreakpoint(file, cbase + 1, "BP_ARMED")
+reset()
+cond(1)
+assert(#hits == 0)
+BP_ARMED = true
+cond(2)
+assert(#hits == 1)
+BP_ARMED = nil
+assert(not pcall(debug.setbreakpoint, file, cbase + 2, "x ==="))
+debug.clearbreakpoints()
+
+-- chunks loaded after the breakpoint was set are patched as they load
+local src = "local t = {}\nt[1] = 1\nt[2] = 2\nreturn #t\n"
+debug.setbreakpoint("virtual/later.lua", 3)
+reset()
+local chunk = load(src, "@some/dir/later.lua")
+assert(chunk() == 2)
+assert(#hits == 1 and hits[1] == "breakpoint:3")
+reset()
+assert(load(string.dump(chunk), "dumped", "b")() == 2, "dumps keep the original code")
+assert(#hits == 1, "a loaded dump is patched again")
+reset()
+assert(load(string.dump(chunk, true), "dumped", "b")() == 2)
+assert(#hits == 0, "a stripped dump has no lines to match")
+debug.clearbreakpoints()
+
+-- traps work in every coroutine and around metamethods and iterators
+local mt = {__add = function(a, b) return a.v + b end}
+local function mixed(t)
+  local obj = setmetatable({v = 10}, mt)
+  local r = obj + 1
+  for k, v in pairs(t) do r = r + v end
+  return r
+end
+local mbase = debug.getinfo(mixed, "S").linedefined
+debug.setbreakpoint(file, mbase + 2)
+debug.setbreakpoint(file, mbase + 3)
+reset()
+local co = coroutine.wrap(function() return mixed({1, 2, 3}) end)
+assert(co() == 17)
+assert(#hits == 5, #hits)  -- the metamethod line, then the loop line 4 times
+debug.clearbreakpoints()
+
+-- stepping from a breakpoint installs a line hook only while it lasts
+local stepped = {}
+debug.setoutputcallback(function(event, src, line)
+  stepped[#stepped + 1] = event .. ":" .. line
+  if event == "breakpoint" then debug.step() end
+end)
+debug.setbreakpoint(file, base + 1)
+assert(target(2) == 3)
+assert(stepped[1] == "breakpoint:" .. (base + 1) and stepped[2] == "step:" .. (base + 2))
+assert(#stepped == 2 and debug.gethook() == nil)
+debug.clearbreakpoints()
+
+-- a user line hook still sees lines that carry a breakpoint
+local lines = {}
+debug.setoutputcallback(function() end)
+debug.sethook(function(_, line) lines[line] = (lines[line] or 0) + 1 end, "l")
+debug.setbreakpoint(file, base + 3)
+target(1)
+debug.sethook()
+assert(lines[base + 3] == 1 and lines[base + 1] == 1)
+debug.clearbreakpoints()
+
+-- translators read the original code of trapped lines
+local tcc = require("tcc")
+local vmprotect = require("vmprotect")
+local modsrc = "local M = {}\nfunction M.f(x) local y = x * 2 return y + 1 end\nreturn M\n"
+debug.setbreakpoint("bptrapmod", 2)
+local M = load(modsrc, "@bptrapmod")()
+assert(vmprotect.protect(M.f)(3) == 7)
+local c_code = tcc.compile(modsrc, "bptrapmod")
+assert(not c_code:find("TRAP", 1, true), "trap leaked into generated C")
+local cf = io.open("bptrapmod.c", "w")
+cf:write(c_code)
+cf:close()
+local built = os.execute("gcc -std=c99 -shared -fPIC -I. -o bptrapmod.so bptrapmod.c")
+os.remove("bptrapmod.c")
+assert(built == true or built == 0, "gcc failed on bptrapmod.c")
+local oldcpath = package.cpath
+package.cpath = "./?.so;" .. oldcpath
+local native = require("bptrapmod")
+package.cpath = oldcpath
+os.remove("bptrapmod.so")
+assert(native.f(3) == 7)
+debug.clearbreakpoints()
+debug.setoutputcallback(nil)
+
+print("test_breakpoint_trap passed")
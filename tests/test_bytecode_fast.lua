@@ -0,0 +1,35 @@
+-- Fast-loading bytecode container: string.dump{fast=true}
+local function f(a, b)
+  local s = "hello" .. ("x"):rep(3)
+  local long = ("abcdefgh"):rep(100)
+  local t = {1.5, 2, true, nil, "k", math.mininteger}
+  local function g(x) return x + a end
+  return g(b), s, #long, long:sub(1, 10), t[1], t[6]
+end
+
+local expected = {f(1, 2)}
+for _, strip in ipairs{false, true} do
+  for _, envelop in ipairs{false, true} do
+    local d = string.dump(f, {fast = true, strip = strip, envelop = envelop})
+    local r = {assert(load(d, "fast", "b"))(1, 2)}
+    for i = 1, #expected do assert(r[i] == expected[i], i) end
+  end
+end
+
+-- the default format still loads
+assert(select(2, load(string.dump(f, {envelop = false}), "x", "b")(1, 2)) == "helloxxx")
+
+-- debug info survives
+local d = string.dump(f, {fast = true, envelop = false})
+local h = load(d, "=fast", "b")
+assert(debug.getinfo(h, "S").linedefined == debug.getinfo(f, "S").linedefined)
+assert(debug.getlocal(h, 1) == "a")
+
+-- the whole chunk is covered by one digest
+local pos = #d - 3
+local bad = d:sub(1, pos - 1) .. string.char((d:byte(pos) + 1) % 256) .. d:sub(pos + 1)
+local ok, err = load(bad, "x", "b")
+assert(ok == nil and err:find("integrity"), err)
+assert(load(d:sub(1, #d - 10), "x", "b") == nil, "truncated chunk is rejected")
+
+print("test_bytecode_fast passed")
@@ -0,0 +1,156 @@
+-- thread channels: ring buffer, unbounded spill, batches, backpressure, pick
+
+local thread = require("thread")
+
+-- capacity rounds up to a power of two
+local ch = thread.channel(5)
+assert(ch:capacity() == 8)
+assert(thread.channel():capacity() == math.huge)
+assert(not pcall(thread.channel, 0))
+assert(not pcall(thread.channel("number"), 0))
+
+-- values of every kind survive the trip, in order
+local t = {1}
+local values = {1, 2.5, math.maxinteger, true, false, "str", t, print}
+for _, v in ipairs(values) do ch:send(v) end
+assert(ch:count() == #values)
+assert(ch:peek() == 1)
+for i, v in ipairs(values) do
+  local got = ch:receive()
+  assert(got == v and math.type(got) == math.type(v), i)
+end
+assert(ch:count() == 0 and ch:try_recv() == nil and ch:peek() == nil)
+
+-- try_send reports a full channel instead of blocking
+local small = thread.channel(2)
+assert(small:try_send("a") and small:try_send("b"))
+assert(small:try_send("c") == false)
+assert(small:receive() == "a")
+assert(small:try_send("c"))
+
+-- unbounded by default: sends past the ring never block, order is kept
+local ub = thread.channel()
+local U = 5000
+for i = 1, U do ub:send(i % 3 == 0 and {i} or i) end
+assert(ub:try_send("tail") and ub:count() == U + 1)
+assert(ub:peek() == 1)
+for i = 1, 1500 do  -- drain part of the ring, then refill while spilled
+  local v = ub:receive()
+  assert((type(v) == "table" and v[1] or v) == i, i)
+end
+ub:send_many({"m1", "m2"})
+for i = 1501, U do
+  local v = ub:receive()
+  assert((type(v) == "table" and v[1] or v) == i, i)
+end
+assert(ub:peek() == "tail" and ub:receive() == "tail")
+assert(ub:receive() == "m1" and ub:receive() == "m2")
+assert(ub:count() == 0 and ub:try_recv() == nil)
+-- spilled values still drain after close
+for i = 1, 2000 do ub:send(i) end
+ub:close()
+local drained = 0
+while ub:receive() do drained = drained + 1 end
+assert(drained == 2000)
+
+-- batches
+local batch = thread.channel(16)
+assert(batch:send_many({10, 20, 30, 40}) == 4)
+assert(batch:send_many({1, 2, 3, 4, 5}, 2, 3) == 2)
+local got, n = batch:recv_many(10)
+assert(n == 6 and #got == 6)
+assert(got[1] == 10 and got[4] == 40 and got[5] == 2 and got[6] == 3)
+local into = {}
+batch:send_many({"x", "y"})
+assert(select(2, batch:recv_many(1, into)) == 1 and into[1] == "x")
+assert(batch:receive() == "y")
+
+-- typed channels check every element of a batch
+local nums = thread.channel("number")(4)
+assert(nums:capacity() == 4)
+nums:send(1)
+assert(not pcall(nums.send, nums, "no"))
+assert(not pcall(nums.send_many, nums, {2, "no"}))
+assert(nums:try_send("no") == false)
+
+-- backpressure: a producer larger than the capacity waits for the consumer
+local bp = thread.channel(4)
+local N = 2000
+local producer = thread.create(function()
+  for i = 1, N do bp:send(i) end
+  bp:send_many({N + 1, N + 2, N + 3})
+  bp:close()
+end)
+local sum, count = 0, 0
+while true do
+  local v = bp:receive()
+  if v == nil then break end
+  sum = sum + v
+  count = count + 1
+  assert(bp:count() <= 4)
+end
+producer:join()
+assert(count == N + 3)
+assert(sum == N * (N + 1) // 2 + 3 * N + 6)
+
+-- closed channels drain, then report nil; sending fails
+local cl = thread.channel(4)
+cl:send("last")
+cl:close()
+assert(cl:receive() == "last" and cl:receive() == nil)
+assert(cl:recv_many(4) == nil)
+assert(not pcall(cl.send, cl, 1))
+
+-- many producers and consumers, bounded and unbounded
+for _, cap in ipairs{64, false} do
+  local mpmc = cap and thread.channel(cap) or thread.channel()
+  local results = thread.channel(64)
+  local P, C, M = 4, 4, 500
+  local producers, consumers = {}, {}
+  for p = 1, P do
+    producers[p] = thread.create(function()
+      for i = 1, M do mpmc:send(p * 100000 + i) end
+    end)
+  end
+  for c = 1, C do
+    consumers[c] = thread.create(function()
+      local s, k = 0, 0
+      while true do
+        local batch_, cnt = mpmc:recv_many(16)
+        if not batch_ then break end
+        for i = 1, cnt do s = s + batch_[i] end
+        k = k + cnt
+      end
+      results:send({s, k})
+    end)
+  end
+  for p = 1, P do producers[p]:join() end
+  mpmc:close()
+  local total, items = 0, 0
+  for _ = 1, C do
+    local r = results:receive()
+    total, items = total + r[1], items + r[2]
+  end
+  for c = 1, C do consumers[c]:join() end
+  assert(items == P * M)
+  local expect = 0
+  for p = 1, P do expect = expect + p * 100000 * M + M * (M + 1) // 2 end
+  assert(total == expect)
+end
+
+-- pick sees values sent after it started waiting
+local a, b = thread.channel(), thread.channel()
+local sender = thread.create(function() b:send("from b") end)
+local picked = thread.pick {
+  {thread.on(a), function(v) return "a:" .. tostring(v) end},
+  {thread.on(b), function(v) return "b:" .. tostring(v) end},
+  {thread.over(5), function() return "timeout" end},
+}
+sender:join()
+assert(picked == "b:from b", picked)
+assert(thread.pick {
+  {thread.on(a), function(v) return v end},
+  {thread.over(0.01), function() return "timeout" end},
+} == "timeout")
+
+print("test_channel passed")
@@ -0,0 +1,98 @@
+-- OP_CHECKTYPE: builtin names resolved by the parser, cached type operands
+
+local function mismatch(f, ...)
+  local ok, err = pcall(f, ...)
+  assert(not ok and err:find("Type mismatch", 1, true), err)
+  return err
+end
+
+-- builtin names that reach the run-time check (the others are hints only)
+local function th(x: thread) return x end
+local co = coroutine.create(print)
+assert(th(co) == co)
+local err = mismatch(th, 1)
+assert(err:find("argument 'x': expected thread, got number", 1, true), err)
+
+-- a local with a builtin name is a run-time type operand again
+do
+  local thread = "string"
+  local function f(x: thread) return x end
+  assert(f("s") == "s")
+  mismatch(f, co)
+end
+
+-- string type operands, including after the cache is warm
+local function typed(T)
+  return function(x: T) return x end
+end
+local num, int, str = typed("number"), typed("int"), typed("string")
+for i = 1, 100 do
+  assert(num(i) == i and num(i + 0.5) == i + 0.5)
+  assert(int(i) == i and str("s" .. i) == "s" .. i)
+end
+mismatch(num, "1")
+mismatch(int, 1.5)
+mismatch(str, 1)
+assert(typed("any")(nil) == nil and typed("nil")(nil) == nil)
+mismatch(typed("nil"), false)
+mismatch(typed("no such type"), 1)
+local ud = typed("userdata")
+assert(ud(io.stdout) == io.stdout)
+
+-- the string and table libraries stand for their types
+local slib, tlib = typed(string), typed(table)
+for _ = 1, 10 do
+  assert(slib("x") == "x")
+  assert(type(tlib({})) == "table")
+end
+mismatch(slib, {})
+mismatch(tlib, "x")
+
+-- one instruction, changing type operands
+local T = "number"
+local function dyn(x: T) return x end
+assert(dyn(1) == 1)
+T = "string"
+mismatch(dyn, 1)
+assert(dyn("a") == "a")
+T = string
+assert(dyn("b") == "b")
+mismatch(dyn, 2)
+T = function(v) return v == 42 end
+assert(dyn(42) == 42)
+mismatch(dyn, 41)
+
+-- classes and inheritance
+class Animal
+  function __init__(self, n) self.n = n end
+end
+class Dog extends Animal end
+class Cat extends Animal end
+class Rock end
+
+local function pet(a: Animal) return a.n end
+local function dog(d: Dog) return d.n end
+for i = 1, 50 do
+  assert(pet(Dog(i)) == i and pet(Cat(i)) == i and pet(Animal(i)) == i)
+  assert(dog(Dog(i)) == i)
+end
+err = mismatch(pet, Rock())
+assert(err:find("expected", 1, true))
+mismatch(dog, Cat(1))
+mismatch(dog, Animal(1))
+mismatch(pet, {n = 1})
+mismatch(pet, setmetatable({n = 1}, getmetatable(Dog(1))))
+mismatch(pet, 1)
+
+-- generic function bound to a class
+local holder = typed(Dog)
+assert(holder(Dog(7)).n == 7)
+mismatch(holder, Cat(7))
+
+-- cached operands survive collections
+for _ = 1, 3 do
+  collectgarbage()
+  assert(pet(Dog(3)) == 3 and num(3) == 3 and slib("z") == "z")
+end
+
+print("test_checktype_cache passed")
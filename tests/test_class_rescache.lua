@@ -0,0 +1,52 @@
+-- Flattened member-resolution cache for class instances
+
+class L0
+    function __init__(self) self.n = 0 end
+    function base(self) return "L0" end
+    function bump(self) self.n = self.n + 1; return self.n end
+end
+class L1 extends L0 end
+class L2 extends L1 end
+class L3 extends L2 end
+class L4 extends L3
+    private secret = 42
+    protected shared = 7
+    get twice(self) return self.n * 2 end
+    set twice(self, v) self.n = v // 2 end
+    function peek(self) return self.secret + self.shared end
+end
+
+local o = L4()
+for i = 1, 100 do assert(o:bump() == i) end
+assert(o:base() == "L0")
+assert(o.twice == 200)
+o.twice = 10
+assert(o.n == 5 and o.twice == 10)
+assert(rawget(o, "twice") == nil, "setter must not create a field")
+assert(o.missing == nil)
+
+-- the cache must not leak members past access checks
+assert(o:peek() == 49)
+for _ = 1, 3 do
+  assert(not pcall(function() return o.secret end))
+  assert(not pcall(function() return o.shared end))
+  assert(not pcall(function() o.secret = 1 end))
+end
+
+-- instance fields shadow cached class members
+o.base = function() return "own" end
+assert(o:base() == "own")
+o.base = nil
+assert(o:base() == "L0")
+
+-- redefining members through the class invalidates the cache
+L4.base = function() return "patched" end
+assert(o:base() == "patched")
+local other = L4()
+assert(other:base() == "patched")
+
+-- values replaced in place are picked up without invalidation
+rawget(L4, "__methods").base = function() return "raw" end
+assert(o:base() == "raw")
+
+print("class rescache test passed")
@@ -0,0 +1,80 @@
+-- Encrypted chunks (\x1bEnc) are decrypted a window at a time in the ZIO;
+-- string.aes_* run on the same AES engine
+
+-- NIST SP 800-38A F.2.1/F.2.2 (CBC-AES128)
+local function unhex(h)
+  return (h:gsub("%x%x", function(x) return string.char(tonumber(x, 16)) end))
+end
+local key = unhex("2b7e151628aed2a6abf7158809cf4f3c")
+local iv = unhex("000102030405060708090a0b0c0d0e0f")
+local pt = unhex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51" ..
+                 "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710")
+local ct = unhex("7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2" ..
+                 "73bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7")
+assert(string.aes_encrypt(key, pt, iv) == ct)
+assert(string.aes_decrypt(key, ct, iv) == pt)
+local long = string.rep("0123456789abcdef", 1000)
+assert(string.aes_decrypt(key, string.aes_encrypt(key, long, iv), iv) == long)
+assert(#string.aes_encrypt(key, "abc") == 16)
+
+-- enveloped sources of many sizes, around block and window boundaries
+local function source(n)
+  local parts = {"local t = {}"}
+  local i = 0
+  repeat
+    i = i + 1
+    parts[#parts + 1] = string.format("t[%d] = %q", i, string.rep(string.char(65 + i % 26), i % 40))
+  until #table.concat(parts, "\n") >= n
+  parts[#parts + 1] = "return #t, t[#t]"
+  return table.concat(parts, "\n"), i
+end
+for _, n in ipairs{0, 15, 16, 17, 4095, 4096, 4097, 8200, 100000} do
+  local src, count = source(n)
+  local env = string.envelop(src)
+  assert(env:sub(1, 9) == "Nirithy==")
+  local f = assert(load(env, "=enc"))
+  local k, last = f()
+  assert(k == count and last == string.rep(string.char(65 + count % 26), count % 40))
+end
+
+-- enveloped bytecode, the default for string.dump
+local big = assert(load((source(50000))))
+local dumped = string.dump(big)
+assert(dumped:sub(1, 9) == "Nirithy==")
+assert(select(1, load(dumped, "=dumped", "b")()) == select(1, big()))
+
+-- the raw \x1bEnc form through a reader that returns odd-sized pieces, so
+-- windows and CTR blocks straddle reader buffers
+local alphabet = "9876543210zyxwvutsrqponmlkjihgfedcbaZYXWVUTSRQPONMLKJIHGFEDCBA-_"
+local val = {}
+for i = 1, #alphabet do val[alphabet:sub(i, i)] = i - 1 end
+local function decode(s)
+  local out = {}
+  for i = 1, #s, 4 do
+    local a, b, c, d = s:byte(i, i + 3)
+    local n = val[string.char(a)] * 262144 + val[string.char(b)] * 4096
+            + (val[string.char(c)] or 0) * 64 + (val[string.char(d)] or 0)
+    out[#out + 1] = string.char(n // 65536, n // 256 % 256, n % 256)
+  end
+  local r = table.concat(out)
+  local pad = select(2, s:gsub("=", ""))
+  return r:sub(1, #r - pad)
+end
+local src, count = source(20000)
+local raw = "\27Enc" .. decode(string.envelop(src):sub(10))
+for _, step in ipairs{1, 7, 16, 4095, 4097, 65536} do
+  local pos = 1
+  local f = assert(load(function()
+    local piece = raw:sub(pos, pos + step - 1)
+    pos = pos + step
+    return piece ~= "" and piece or nil
+  end, "=pieces"))
+  assert(f() == count)
+end
+
+-- truncated ciphertext is a syntax error, not a crash
+local cut = "\27Enc" .. decode(string.envelop("return 1 + 1"):sub(10))
+assert(not load(cut:sub(1, 20)))
+assert(not load(decode(string.envelop(string.dump(big)):sub(10)):sub(1, 100)))
+
+print("test_encrypted_chunk passed")
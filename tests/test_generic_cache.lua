@@ -0,0 +1,83 @@
+-- Specialization cache of generic functions (__generic_wrap)
+
+local function stats(f)
+  local hits, misses = genericstats(f)
+  return hits, misses
+end
+
+-- one instance per inferred type, reused by later calls
+local built = 0
+function Box(T)(x: T)
+  return {T, x}
+end
+local function count()
+  built = built + 1
+  return true
+end
+function Counted(T)(x: T) requires count()
+  return T
+end
+
+assert(stats(Box) == 0)
+for i = 1, 100 do
+  assert(Box(i)[1] == "number" and Box(i + 0.5)[1] == "number")
+  assert(Box("s" .. i)[1] == "string" and Box({})[1] == "table")
+end
+local hits, misses = stats(Box)
+assert(misses == 3 and hits == 397, hits .. " " .. misses)
+
+for _ = 1, 10 do
+  assert(Counted(1) == "number" and Counted(true) == "boolean")
+end
+assert(built == 2, built)
+assert(select(2, stats(Counted)) == 2)
+
+-- several parameters, repeated parameters and non-generic arguments
+function Pair(A, B)(a: A, b: B, c: A, d)
+  return A .. "/" .. B .. "/" .. tostring(d)
+end
+for i = 1, 20 do
+  assert(Pair(1, "s", 2, i) == "number/string/" .. i)
+  assert(Pair("s", 1, "t") == "string/number/nil")
+  assert(Pair(false, nil, true) == "boolean/nil/nil")
+end
+hits, misses = stats(Pair)
+assert(misses == 3 and hits == 57)
+local ok, err = pcall(Pair, 1, "s", "x")
+assert(not ok and err:find("inconsistent types for 'A'", 1, true))
+ok, err = pcall(Pair, 1)
+assert(not ok and err:find("could not infer type for 'B'", 1, true))
+
+-- struct arguments bind the parameter to their definition
+struct Vec { int x; int y; }
+struct Tag { int id; }
+function Kind(T)(v: T) return T end
+for _ = 1, 5 do
+  assert(Kind(Vec()) == Vec and Kind(Tag()) == Tag and Kind(1) == "number")
+end
+assert(select(2, stats(Kind)) == 3)
+
+-- recursion through the wrapper
+function Sum(T)(n: T)
+  if n == 0 then return 0 end
+  return n + Sum(n - 1)
+end
+assert(Sum(100) == 5050)
+hits, misses = stats(Sum)
+assert(misses == 1 and hits == 100)
+
+-- explicit specialization still runs the factory with the given types
+assert(Box("number")(3)[1] == "number")
+assert(Box(string)("s")[1] == string)
+
+-- entries survive collections while the wrapper is alive
+collectgarbage()
+collectgarbage()
+hits, misses = stats(Box)
+assert(Box(1)[1] == "number" and select(2, stats(Box)) == misses)
+assert(Kind(Vec()) == Vec and select(2, stats(Kind)) == 3)
+
+assert(not pcall(genericstats, print))
+assert(not pcall(genericstats, {}))
+
+print("test_generic_cache passed")
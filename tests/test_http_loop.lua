@@ -0,0 +1,154 @@
+-- http.loop: non-blocking sockets driven by coroutines, keep-alive serving
+-- and timers
+
+local http = require("http")
+
+local loop = assert(http.loop())
+local srv = assert(loop:listen(0))
+local _, port = srv:getsockname()
+
+local seen = 0
+loop:serve(srv, function(req)
+  seen = seen + 1
+  if req.path == "/slow" then
+    loop:sleep(0.02)  -- handlers may suspend
+  end
+  if req.path == "/fail" then
+    error("handler failed")
+  end
+  return 200, req.method .. " " .. req.path .. " " .. (req.query or "") .. " " .. req.body,
+         {["Content-Type"] = "text/plain", ["X-Seen"] = tostring(seen)}
+end)
+
+-- reads one response from a buffered connection
+local function read_response(sock, state)
+  while true do
+    local hend = state.buf:find("\r\n\r\n", 1, true)
+    if hend then
+      local head = state.buf:sub(1, hend - 1)
+      local len = tonumber(head:match("[Cc]ontent%-[Ll]ength: (%d+)"))
+      if #state.buf >= hend + 3 + len then
+        local body = state.buf:sub(hend + 4, hend + 3 + len)
+        state.buf = state.buf:sub(hend + 4 + len)
+        return tonumber(head:match("^HTTP/1%.1 (%d+)")), body, head
+      end
+    end
+    local chunk = sock:recv(4096)
+    if not chunk then return nil end
+    state.buf = state.buf .. chunk
+  end
+end
+
+local results = {}
+
+-- keep-alive with pipelined requests, a body and a handler that sleeps
+loop:spawn(function()
+  local c = assert(loop:connect("127.0.0.1", port))
+  local st = {buf = ""}
+  c:send("GET /a?x=1 HTTP/1.1\r\nHost: t\r\n\r\nGET /slow HTTP/1.1\r\nHost: t\r\n\r\n")
+  local code, body, head = read_response(c, st)
+  assert(code == 200 and body == "GET /a x=1 ", body)
+  assert(head:find("Connection: keep-alive", 1, true))
+  assert(head:find("Content-Type: text/plain", 1, true))
+  code, body = read_response(c, st)
+  assert(code == 200 and body == "GET /slow  ", body)
+  c:send("POST /p HTTP/1.1\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello")
+  code, body, head = read_response(c, st)
+  assert(code == 200 and body == "POST /p  hello", body)
+  assert(head:find("Connection: close", 1, true))
+  assert(c:recv() == nil, "server closes after Connection: close")
+  c:close()
+  results.keepalive = true
+end)
+
+-- malformed requests and handler errors
+loop:spawn(function()
+  local c = assert(loop:connect("127.0.0.1", port))
+  c:send("garbage\r\n\r\n")
+  local code = read_response(c, {buf = ""})
+  assert(code == 400)
+  c:close()
+  -- a repeated Content-Length must agree with the first one
+  c = assert(loop:connect("127.0.0.1", port))
+  c:send("POST /d HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 30\r\n\r\nabc")
+  code = read_response(c, {buf = ""})
+  assert(code == 400)
+  c:close()
+  c = assert(loop:connect("127.0.0.1", port))
+  c:send("POST /d HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\nConnection: close\r\n\r\nabc")
+  local body
+  code, body = read_response(c, {buf = ""})
+  assert(code == 200 and body == "POST /d  abc", body)
+  c:close()
+  c = assert(loop:connect("127.0.0.1", port))
+  c:send("GET /fail HTTP/1.1\r\n\r\n")
+  code = read_response(c, {buf = ""})
+  assert(code == 500)
+  c:close()
+  results.errors = true
+end)
+
+-- many concurrent clients on one thread
+local CLIENTS = 200
+local done = 0
+for i = 1, CLIENTS do
+  loop:spawn(function()
+    local c = assert(loop:connect("127.0.0.1", port))
+    local st = {buf = ""}
+    for j = 1, 3 do
+      c:send("GET /c" .. i .. " HTTP/1.1\r\n\r\n")
+      local code, body = read_response(c, st)
+      assert(code == 200 and body == "GET /c" .. i .. "  ")
+    end
+    c:close()
+    done = done + 1
+  end)
+end
+
+-- timers fire in deadline order; a plain yield requeues the task
+local order = {}
+loop:after(0.03, function() order[#order + 1] = "late" end)
+loop:after(0.01, function() order[#order + 1] = "early" end)
+loop:spawn(function()
+  coroutine.yield()
+  order[#order + 1] = "yielded"
+end)
+
+-- task errors, including failed handlers, go to the error handler
+local reported = {}
+loop:onerror(function(err, co)
+  reported[#reported + 1] = tostring(err)
+  assert(type(co) == "thread")
+end)
+loop:spawn(function() error("task failed") end)
+
+-- stop serving once every client is done
+loop:spawn(function()
+  while done < CLIENTS or not results.keepalive or not results.errors do
+    loop:sleep(0.01)
+  end
+  srv:close()
+end)
+
+loop:run()  -- returns once nothing is left to wait for
+
+assert(results.keepalive and results.errors)
+assert(done == CLIENTS)
+local pos = {}
+for i, v in ipairs(order) do pos[v] = i end
+assert(#order == 3 and pos.yielded and pos.early < pos.late)
+local all = table.concat(reported, "\n")
+assert(#reported == 2 and all:find("handler failed", 1, true) and all:find("task failed", 1, true))
+
+-- without an error handler, task errors propagate out of loop:run
+loop:onerror(nil)
+loop:spawn(function() error("boom") end)
+local ok, err = pcall(loop.run, loop)
+assert(not ok and tostring(err):find("boom", 1, true))
+
+-- blocking sockets outside a loop are unchanged
+local s = assert(http.server(0))
+assert(s:getsockname())
+s:close()
+
+print("test_http_loop passed")
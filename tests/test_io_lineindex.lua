@@ -0,0 +1,92 @@
+-- io.readline / io.readlines / io.linecount through the cached line index
+
+local name = os.tmpname()
+
+local function put(s)
+  local f = assert(io.open(name, "wb"))
+  f:write(s)
+  f:close()
+end
+
+-- trailing newline: the empty line after it is still addressable
+put("alpha\nbeta\n\ngamma\n")
+assert(io.linecount(name) == 4)
+assert(io.readline(name, 1) == "alpha" and io.readline(name, 2) == "beta")
+assert(io.readline(name, 3) == "" and io.readline(name, 4) == "gamma")
+assert(io.readline(name, 5) == "")
+local v, err = io.readline(name, 6)
+assert(v == nil and err == "文件只有 4 行", err)
+v, err = io.readline(name, 0)
+assert(v == nil and err == "行号必须大于0")
+
+local t = io.readlines(name, 2, 4)
+assert(#t == 3 and t[1] == "beta" and t[2] == "" and t[3] == "gamma")
+t = io.readlines(name, 4, math.maxinteger)
+assert(#t == 2 and t[1] == "gamma" and t[2] == "")
+assert(next(io.readlines(name, 7, 9)) == nil)
+v, err = io.readlines(name, 3, 2)
+assert(v == nil and err == "结束行号必须大于等于起始行号")
+v, err = io.readlines(name, 0, 2)
+assert(v == nil and err == "起始行号必须大于0")
+
+-- no trailing newline, binary mode
+put("x\1y\nlast\255")
+assert(io.linecount(name) == 2)
+assert(io.readline(name, 2) == "last\255")
+local b = io.readline(name, 1, "b")
+assert(#b == 3 and b[1] == 120 and b[2] == 1 and b[3] == 121)
+t = io.readlines(name, 1, 2, "b")
+assert(#t == 2 and #t[2] == 5 and t[2][5] == 255)
+
+-- empty file
+put("")
+assert(io.linecount(name) == 0)
+assert(io.readline(name, 1) == "")
+assert(#io.readlines(name, 1, 3) == 1)
+
+-- the index follows changes to the file
+put("one\ntwo\n")
+assert(io.readline(name, 2) == "two")
+put("three\nfour\nfive\n")
+assert(io.readline(name, 2) == "four" and io.linecount(name) == 3)
+assert(io.writeline(name, 2, "FOUR"))
+assert(io.readline(name, 2) == "FOUR" and io.readline(name, 3) == "five")
+assert(io.writelines(name, 1, 1, {"3"}))
+assert(io.readline(name, 1) == "3" and io.linecount(name) == 3)
+local f = assert(io.open(name, "ab"))
+f:write("six\n")
+f:close()
+assert(io.linecount(name) == 4 and io.readline(name, 4) == "six")
+
+-- many lines, random access, more files than the cache holds
+local parts = {}
+for i = 1, 5000 do parts[i] = "line " .. i end
+put(table.concat(parts, "\n") .. "\n")
+assert(io.linecount(name) == 5000)
+for _, i in ipairs({5000, 1, 2500, 4999, 17}) do
+  assert(io.readline(name, i) == "line " .. i)
+end
+t = io.readlines(name, 4990, 6000)
+assert(#t == 12 and t[11] == "line 5000" and t[12] == "")
+local others = {}
+for i = 1, 12 do
+  others[i] = os.tmpname()
+  local g = assert(io.open(others[i], "w"))
+  g:write("file ", i, "\n")
+  g:close()
+  assert(io.readline(others[i], 1) == "file " .. i)
+end
+assert(io.readline(name, 1234) == "line 1234")
+for i = 1, 12 do
+  assert(io.readline(others[i], 1) == "file " .. i)
+  os.remove(others[i])
+end
+
+-- missing files fail like io.open
+os.remove(name)
+v, err = io.readline(name, 1)
+assert(v == nil and err:find(name, 1, true))
+assert(io.linecount(name) == nil)
+assert(io.readlines(name, 1, 2) == nil)
+
+print("test_io_lineindex passed")
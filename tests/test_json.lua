@@ -0,0 +1,125 @@
+-- Native json library: decode/encode round trips, errors and loadfile
+
+local function deep_equal(a, b)
+  if type(a) ~= type(b) then return false end
+  if type(a) ~= "table" then
+    return a == b and math.type(a) == math.type(b)
+  end
+  for k, v in pairs(a) do
+    if not deep_equal(v, b[k]) then return false end
+  end
+  for k in pairs(b) do
+    if a[k] == nil then return false end
+  end
+  return true
+end
+
+-- scalars
+assert(json.decode("1") == 1 and math.type(json.decode("1")) == "integer")
+assert(json.decode("-0") == 0)
+assert(json.decode("2.5") == 2.5)
+assert(json.decode("1e3") == 1000.0 and math.type(json.decode("1e3")) == "float")
+assert(json.decode("-9223372036854775808") == math.mininteger)
+assert(json.decode("9223372036854775807") == math.maxinteger)
+assert(math.type(json.decode("9223372036854775808")) == "float")
+assert(json.decode("1e400") == math.huge)
+assert(json.decode(" true ") == true)
+assert(json.decode("false") == false)
+assert(json.decode("null") == json.null)
+assert(json.decode('"plain"') == "plain")
+
+-- escapes
+assert(json.decode('"a\\"b\\\\c\\/d\\b\\f\\n\\r\\t"') == "a\"b\\c/d\b\f\n\r\t")
+assert(json.decode('"\\u00e9\\u4e2d"') == "\u{e9}\u{4e2d}")
+assert(json.decode('"\\ud83d\\ude00"') == "\u{1f600}")
+local long = string.rep("x", 100) .. "\\n" .. string.rep("y", 100)
+assert(json.decode('"' .. long .. '"') == string.rep("x", 100) .. "\n" .. string.rep("y", 100))
+local mixed = json.decode('[1, 2.5, "a\\u00e9\\n", {"k": null, "z": []}, "b\\t", true]')
+assert(#mixed == 6 and mixed[1] == 1 and mixed[2] == 2.5)
+assert(mixed[3] == "a\u{e9}\n" and mixed[4].k == json.null and mixed[5] == "b\t")
+assert(mixed[6] == true)
+
+-- structures, including ones larger than one batch
+local doc = json.decode([==[
+  {
+    "name": "svc",
+    "ports": [80, 443],
+    "nested": {"a": {"b": {"c": [true, false, null]}}},
+    "empty_obj": {},
+    "empty_arr": [],
+    "dup": 1, "dup": 2
+  }
+]==])
+assert(doc.name == "svc")
+assert(doc.ports[1] == 80 and doc.ports[2] == 443 and #doc.ports == 2)
+assert(doc.nested.a.b.c[1] == true and doc.nested.a.b.c[3] == json.null)
+assert(next(doc.empty_obj) == nil and next(doc.empty_arr) == nil)
+assert(doc.dup == 2, "later duplicate keys win")
+
+local parts, obj = {}, {}
+for i = 1, 1000 do
+  parts[i] = tostring(i)
+  obj[i] = string.format('"k%d": %d', i, i * 2)
+end
+local big = json.decode("[" .. table.concat(parts, ",") .. "]")
+assert(#big == 1000 and big[1] == 1 and big[1000] == 1000)
+local bigobj = json.decode("{" .. table.concat(obj, ",") .. "}")
+assert(bigobj.k1 == 2 and bigobj.k1000 == 2000)
+
+-- encoder
+assert(json.encode(1) == "1")
+assert(json.encode(2.5) == "2.5")
+assert(json.encode(3.0) == "3.0")
+assert(json.encode(0.1) == "0.1")
+assert(json.encode("a\"b\n\1") == '"a\\"b\\n\\u0001"')
+assert(json.encode(nil) == "null" and json.encode(json.null) == "null")
+assert(json.encode({}) == "{}")
+assert(json.encode(json.array()) == "[]")
+assert(json.encode({1, 2, 3}) == "[1,2,3]")
+assert(json.encode({a = {1, {b = true}}}) == '{"a":[1,{"b":true}]}')
+assert(json.encode({[1] = "x", [3] = "y"}):find('"3":"y"', 1, true))
+assert(json.encode(doc.empty_arr) == "[]")
+
+for _, v in ipairs({doc, big, bigobj, {x = 0.1, y = -1e-300, z = "\u{1f600}"}}) do
+  assert(deep_equal(json.decode(json.encode(v)), v))
+end
+
+-- errors
+local function fails(s, what)
+  local ok, err = pcall(json.decode, s)
+  assert(not ok, "expected failure for " .. s)
+  assert(err:find(what, 1, true), err)
+end
+fails("", "unexpected end")
+fails("[1,2", "unterminated array")
+fails('{"a" 1}', "expected ':'")
+fails('{a: 1}', "expected string key")
+fails('"abc', "unterminated string")
+fails('"\\q"', "invalid escape")
+fails("[01]", "expected ','")
+fails("1 2", "trailing characters")
+fails("tru", "invalid literal")
+fails(string.rep("[", 600) .. string.rep("]", 600), "too deeply nested")
+
+local cyc = {}
+cyc.self = cyc
+assert(not pcall(json.encode, cyc))
+assert(not pcall(json.encode, {f = print}))
+assert(not pcall(json.encode, 0 / 0))
+
+-- loadfile decodes JSON files directly
+local name = os.tmpname()
+local f = io.open(name, "w")
+f:write('{"service": "api", "replicas": [1, 2, 3], "tls": {"enabled": true}}\n')
+f:close()
+local chunk = assert(loadfile(name))
+local cfg = chunk()
+assert(cfg.service == "api" and #cfg.replicas == 3 and cfg.tls.enabled == true)
+cfg.service = "changed"  -- each call returns its own document
+local cfg2 = chunk()
+assert(cfg2 ~= cfg and cfg2.tls ~= cfg.tls and cfg2.service == "api")
+assert(chunk().replicas ~= cfg2.replicas)
+assert(dofile(name).replicas[3] == 3)
+os.remove(name)
+
+print("test_json passed")
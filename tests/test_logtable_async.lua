@@ -0,0 +1,48 @@
+-- logtable async ring-buffer backend
+local tmp = os.tmpname()
+
+-- text records
+assert(logtable.setasync(true, 1024, "text"))
+assert(logtable.onlog(true, tmp))
+assert(not logtable.setasync(false), "mode must not change while logging")
+local t = {}
+rawset(t, "alpha", 1)
+local _ = rawget(t, "alpha")
+rawset(t, 42, true)
+assert(logtable.onlog(false))
+
+local s = logtable.stats()
+assert(s.recorded >= 3 and s.written == s.recorded and s.dropped == 0)
+local f = assert(io.open(tmp, "r"))
+local text = f:read("a")
+f:close()
+assert(text:find("[SET]", 1, true) and text:find("[GET]", 1, true))
+assert(text:find("KEY:STRING:alpha#", 1, true), "missing string key")
+assert(text:find("KEY:INTEGER:42", 1, true), "missing integer key")
+os.remove(tmp)
+
+-- binary records, with a ring small enough to overflow
+assert(logtable.setasync(true, 4, "binary"))
+assert(logtable.onlog(true, tmp))
+for i = 1, 10000 do rawset(t, "k", i) end
+assert(logtable.onlog(false))
+s = logtable.stats()
+assert(s.recorded + s.dropped >= 20000, "every access is recorded or dropped")
+assert(s.written == s.recorded)
+f = assert(io.open(tmp, "rb"))
+local data = f:read("a")
+f:close()
+assert(data:sub(1, 8) == "LXTLOG1\0", "bad binary header")
+local recsize = string.unpack("=I4", data, 9)
+assert((#data - 12) == recsize * s.written, "binary size mismatch")
+-- tick, table, key, 4 tag bytes, keystr: past the key prefix all is zero
+for r = 0, math.min(s.written, 200) - 1 do
+  local base = 13 + r * recsize
+  local used = 28 + data:byte(base + 27)  -- keylen
+  assert(data:sub(base + used, base + recsize - 1) == string.rep("\0", recsize - used),
+         "uninitialized record bytes")
+end
+os.remove(tmp)
+
+assert(logtable.setasync(false))
+print("logtable async test passed")
@@ -0,0 +1,99 @@
+-- Cached name resolution through 'using' chains of namespaces
+
+-- names inside a namespace body resolve in that namespace, so the chain
+-- NsC -> NsB -> NsA is built from nested namespaces
+namespace NsC {
+  c = 3
+  namespace NsB {
+    b = 2
+    namespace NsA {
+      a = 1
+      b = "fromA"
+    }
+    using namespace NsA;
+  }
+  using namespace NsB;
+  namespace NsD {
+    d = 4
+  }
+  function relink()
+    using namespace NsD;
+  end
+}
+using namespace NsC;
+
+local function read()
+  return a, b, c, missing
+end
+
+for _ = 1, 100 do
+  local x, y, z, m = read()
+  assert(x == 1 and y == 2 and z == 3 and m == nil)
+end
+assert(NsC.a == 1 and NsC.b == 2 and NsB.a == 1 and NsC.missing == nil)
+
+-- value updates are seen through cached resolutions
+NsA.a = 10
+assert(a == 10 and NsC.a == 10)
+NsC.a = 11  -- assigns the existing member of NsA
+assert(NsA.a == 11 and a == 11)
+
+-- a name cached as missing appears once some namespace defines it
+assert(missing == nil)
+NsB.missing = "now"
+assert(missing == "now" and NsC.missing == "now")
+
+-- removing a member uncovers the next one in the chain
+assert(b == 2)
+NsB.b = nil
+assert(b == "fromA" and NsC.b == "fromA")
+NsB.b = 22
+assert(b == 22)
+
+-- relinking a namespace changes what its chain resolves
+assert(d == nil and a == 11)
+NsC.relink()
+assert(d == 4 and a == nil and b == nil and c == 3)
+
+-- the table's own fields still win over the namespaces
+c = "own"
+assert(c == "own" and NsC.c == 3)
+
+-- non-string keys and dynamically built names
+NsD[1] = "one"
+assert(NsC[1] == "one")
+for i = 1, 500 do
+  NsD["dyn" .. i] = i
+end
+collectgarbage()
+for round = 1, 2 do
+  for i = 1, 500 do
+    assert(NsC["dyn" .. i] == i)
+  end
+  collectgarbage()
+end
+
+-- cached slots stay valid while another thread grows (rehashes) the
+-- namespace that owns them
+local thread = require("thread")
+namespace NsGrow {
+  fixed = "here"
+}
+local readers = {}
+for r = 1, 4 do
+  readers[r] = thread.create(function()
+    for _ = 1, 20000 do
+      assert(NsGrow.fixed == "here")
+    end
+    return true
+  end)
+end
+for i = 1, 2000 do
+  NsGrow["grow" .. i] = i
+end
+for r = 1, 4 do
+  assert(readers[r]:join() == true)
+end
+assert(NsGrow.grow2000 == 2000 and NsGrow.fixed == "here")
+
+print("test_namespace_cache passed")
@@ -0,0 +1,69 @@
+-- Plain substring search shared by `in`, string.contains, string.find
+-- (plain), string.split and the string `-` operator
+
+local function naive(s, p, init)
+  for i = init or 1, #s - #p + 1 do
+    if s:sub(i, i + #p - 1) == p then return i end
+  end
+  return nil
+end
+
+-- edge cases
+assert("" in "abc" and "" in "")
+assert(not ("abcd" in "abc"))
+assert("c" in "abc" and not ("d" in "abc"))
+assert(string.contains("hello world", "o w"))
+assert(string.find("abc", "", 4, true) == 4)
+assert(string.find("abcabc", "bc", 3, true) == 5)
+assert(string.find("a.b", ".", 1, true) == 2)
+
+-- needles straddling 16- and 32-byte blocks, matches at the very end
+local hay = string.rep("0123456789abcdef", 8)
+for lp = 2, 40 do
+  for i = 1, #hay - lp + 1, 7 do
+    local p = hay:sub(i, i + lp - 1)
+    assert(string.find(hay, p, 1, true) == naive(hay, p), p)
+    assert(p in hay)
+  end
+end
+local tail = string.rep("x", 100) .. "xy"
+assert(string.find(tail, "xy", 1, true) == 101)
+assert(string.find(tail, string.rep("x", 33) .. "y", 1, true) == 69)
+
+-- periodic needles and haystacks take the linear fallback
+local aaa = string.rep("a", 200000)
+assert(not string.contains(aaa, string.rep("a", 63) .. "b"))
+assert(string.find(aaa .. "b", string.rep("a", 63) .. "b", 1, true) == 200000 - 62)
+local abab = string.rep("ab", 50000) .. "abc"
+assert(string.find(abab, string.rep("ab", 40) .. "c", 1, true) == #abab - 80)
+
+-- random strings over a small alphabet
+math.randomseed(42)
+local function rnd(n)
+  local t = {}
+  for i = 1, n do t[i] = string.char(97 + math.random(0, 2)) end
+  return table.concat(t)
+end
+for _ = 1, 300 do
+  local s, p = rnd(math.random(0, 300)), rnd(math.random(1, 40))
+  assert(string.find(s, p, 1, true) == naive(s, p))
+  assert((p in s) == (naive(s, p) ~= nil))
+end
+
+-- split keeps empty fields
+local function parts(s, sep)
+  return table.concat(string.split(s, sep), "|")
+end
+assert(#string.split("a,b,,c,", ",") == 5)
+assert(parts("a,b,,c,", ",") == "a|b||c|")
+assert(parts("", ",") == "")
+assert(#string.split("", ",") == 1)
+assert(parts("a::b::c", "::") == "a|b|c")
+assert(parts("no separator", ";") == "no separator")
+
+-- the `-` operator removes every occurrence
+assert("a-b-c" - "-" == "abc")
+assert("foofoobar" - "foo" == "bar")
+assert("abc" - "x" == "abc")
+
+print("test_strfind passed")
@@ -0,0 +1,113 @@
+-- struct.define compiles a field layout; GETFIELD/SETFIELD cache it per site
+
+struct Vec {
+  int x;
+  int y;
+  float w;
+  bool on;
+  string tag;
+}
+
+struct Box {
+  Vec lo;
+  Vec hi;
+}
+
+local layout = Vec.__layout
+assert(type(layout) == "userdata", "definition carries a compiled layout")
+
+-- every field type through the same instructions, repeated so caches fill
+local v = Vec{x = 1, y = 2, w = 0.5, on = true, tag = "a"}
+for i = 1, 100 do
+  v.x = v.x + 1
+  v.y = v.y * 1
+  v.w = v.w + 0.5
+  v.on = not v.on
+  v.tag = "t" .. i
+end
+assert(v.x == 101 and v.y == 2 and v.w == 50.5)
+assert(v.on == true and v.tag == "t100")
+
+-- integer-valued floats and float-valued integers still convert
+v.w = 3
+assert(math.type(v.w) == "float" and v.w == 3.0)
+v.x = 4.0
+assert(math.type(v.x) == "integer" and v.x == 4)
+assert(not pcall(function() v.x = 4.5 end))
+assert(not pcall(function() v.x = "no" end))
+
+-- nested views share storage with their parent
+local b = Box{lo = Vec{x = 1}, hi = Vec{x = 9}}
+for i = 1, 10 do b.hi.x = b.hi.x + b.lo.x end
+assert(b.hi.x == 19)
+local lo = b.lo
+lo.y = 7
+assert(b.lo.y == 7)
+
+-- one access site seeing several struct types (polymorphic site)
+struct A { int k; int pad; }
+struct B { int pad; int k; float z; }
+local function getk(s) return s.k end
+local function setk(s, n) s.k = n; return s end  -- structs are values
+local a, bb = A{k = 1}, B{k = 2}
+for i = 1, 50 do
+  a = setk(a, i); bb = setk(bb, -i)
+  assert(getk(a) == i and getk(bb) == -i)
+end
+assert(a.pad == 0 and bb.pad == 0)
+
+-- missing fields: reads fall back to the definition, writes fail
+assert(v.nothere == nil)
+assert(v.__name == "Vec")
+local ok, err = pcall(function() v.nothere = 1 end)
+assert(not ok and err:find("does not exist"))
+
+-- long field names and many fields
+local spec = {}
+local long = string.rep("f", 60)
+spec[#spec + 1] = long; spec[#spec + 1] = 11
+for i = 1, 200 do
+  spec[#spec + 1] = "m" .. i
+  spec[#spec + 1] = i
+end
+local Big = _ENV["struct"].define("Big", spec)
+local big = Big()
+assert(big[long] == 11)
+big[long] = 12
+assert(big[long] == 12)
+for i = 1, 200 do
+  assert(big["m" .. i] == i)
+  big["m" .. i] = -i
+end
+local sum = 0
+for i = 1, 200 do sum = sum + big["m" .. i] end
+assert(sum == -20100)
+
+-- struct arrays hand out views that use the element layout
+local arr = array(Vec)[4]
+for i = 1, 4 do arr[i].x = i * 10 end
+for i = 1, 4 do assert(arr[i].x == i * 10) end
+
+-- live structs keep their layout even when '__layout' is cleared
+struct Pt { int x; int y; string tag; }
+struct Seg { Pt a; Pt b; }
+local pt, seg = Pt(), Seg()
+pt.tag = "kept"
+seg.b.y = 5
+for round = 1, 3 do
+  pt.x = pt.x + 1  -- the same sites before and after the layout goes away
+  assert(pt.x == round)
+  if round == 1 then
+    Pt.__layout = nil
+    Seg.__layout = nil
+  end
+  collectgarbage()
+  local junk = {}
+  for i = 1, 200 do junk[i] = _ENV["struct"].define("J" .. i, {"a", 1, "b", 2}) end
+end
+assert(pt.tag == "kept")
+assert(seg.b.y == 5)
+seg.a.x = 7
+assert(seg.a.x == 7 and Pt().x == 0)
+
+print("struct layout test passed")
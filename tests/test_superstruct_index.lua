@@ -0,0 +1,89 @@
+-- SuperStruct members: hashed lookups, ordered traversal, deletion
+
+superstruct Big [
+  b: 2,
+  a: 1,
+  [10]: "ten",
+  [true]: "yes",
+  ["long key " .. string.rep("x", 60)]: "long",
+]
+
+assert(Big.a == 1 and Big.b == 2 and Big[10] == "ten" and Big[true] == "yes")
+assert(Big[10.0] == "ten", "integral floats find integer keys")
+assert(Big["long key " .. string.rep("x", 60)] == "long")
+assert(Big.c == nil and Big[11] == nil and Big[false] == nil)
+
+-- traversal is in key order: booleans, numbers, then strings by bytes
+local function keys(ss)
+  local r = {}
+  for k in pairs(ss) do r[#r + 1] = k end
+  return r
+end
+local ks = keys(Big)
+assert(#ks == 5 and ks[1] == true and ks[2] == 10 and ks[3] == "a" and ks[4] == "b")
+
+-- many members, inserted out of order
+superstruct Many []
+local N = 20000
+for i = N, 1, -1 do
+  Many["k" .. i] = i
+  Many[i * 3] = -i
+end
+for i = 1, N do
+  assert(Many["k" .. i] == i and Many[i * 3] == -i)
+end
+assert(Many["k0"] == nil and Many[1] == nil)
+
+local count, prev = 0, nil
+for k, v in pairs(Many) do
+  count = count + 1
+  if math.type(k) == "integer" then
+    assert(v == -(k // 3))
+    if math.type(prev) == "integer" then assert(prev < k) end
+  else
+    assert(v == tonumber(k:sub(2)))
+    if type(prev) == "string" then assert(prev < k) end
+  end
+  prev = k
+end
+assert(count == 2 * N)
+
+-- updates and deletions keep every other member reachable
+for i = 1, N, 2 do
+  Many["k" .. i] = nil
+  Many[i * 3] = "odd"
+end
+for i = 1, N do
+  if i % 2 == 1 then
+    assert(Many["k" .. i] == nil and Many[i * 3] == "odd")
+  else
+    assert(Many["k" .. i] == i and Many[i * 3] == -i)
+  end
+end
+count = 0
+for _ in pairs(Many) do count = count + 1 end
+assert(count == N + N // 2)
+for i = 1, N do Many["k" .. i] = i end
+count = 0
+for _ in pairs(Many) do count = count + 1 end
+assert(count == 2 * N)
+
+-- assigning existing members while traversing
+for k, v in pairs(Big) do Big[k] = v end
+assert(Big.a == 1 and #keys(Big) == 5)
+
+assert(not pcall(function() Big[0 / 0] = 1 end))
+assert(Big[0 / 0] == nil)
+
+-- members created from temporary strings survive collections
+superstruct Gc []
+for i = 1, 2000 do
+  Gc[string.format("key%05d", i)] = {i}
+  if i % 500 == 0 then collectgarbage() end
+end
+collectgarbage()
+for i = 1, 2000 do
+  assert(Gc[string.format("key%05d", i)][1] == i)
+end
+
+print("test_superstruct_index passed")
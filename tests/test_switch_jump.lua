@@ -0,0 +1,146 @@
+-- Jump-table dispatch (OP_SWITCH) for switch statements on constant labels
+local ByteCode = require "ByteCode"
+
+local function count_switch(f)
+  local p = ByteCode.GetProto(f)
+  local n = 0
+  for pc = 1, ByteCode.GetCodeCount(p) do
+    local _, name = ByteCode.GetOpCode(ByteCode.GetCode(p, pc))
+    if name == "SWITCH" then n = n + 1 end
+  end
+  return n
+end
+
+-- dense integers, comma labels, arrow bodies, default
+local function dense(x)
+  switch x do
+    case 1 -> "one"
+    case 2, 3 -> "two-three"
+    case 5 -> "five"
+    case -1 -> "minus"
+    default -> "other"
+  end
+end
+assert(count_switch(dense) == 1)
+assert(dense(1) == "one" and dense(2) == "two-three" and dense(3) == "two-three")
+assert(dense(5) == "five" and dense(-1) == "minus")
+assert(dense(4) == "other" and dense(0) == "other" and dense(99) == "other")
+assert(dense(3.0) == "two-three", "integral floats match integer labels")
+assert(dense(2.5) == "other" and dense("1") == "other" and dense(nil) == "other")
+assert(dense(math.mininteger) == "other" and dense(math.maxinteger) == "other")
+
+-- strings and sparse integers share a hashed map; fallthrough and break
+local function mixed(s)
+  local r = {}
+  switch s do
+    case "a": r[#r + 1] = "a"
+    case "b": r[#r + 1] = "b"; break
+    case "c", "d": r[#r + 1] = "cd"
+    case 100: r[#r + 1] = "100"
+    case 0x7fffffffffffffff: r[#r + 1] = "max"
+  end
+  return table.concat(r, ",")
+end
+assert(count_switch(mixed) == 1)
+assert(mixed("a") == "a,b" and mixed("b") == "b")
+assert(mixed("c") == "cd,100,max" and mixed("d") == "cd,100,max")
+assert(mixed(100) == "100,max" and mixed(100.0) == "100,max")
+assert(mixed(math.maxinteger) == "max")
+assert(mixed("e") == "" and mixed(string.rep("a", 100)) == "")
+assert(mixed(("a"):rep(1)) == "a,b", "strings built at run time still match")
+
+-- default in the middle, duplicate labels (the first one wins)
+local function middle(x)
+  switch x do
+    case 1: return "one"
+    default: return "default"
+    case 2: return "two"
+    case 1: return "dup"
+    case 3: return "three"
+  end
+end
+assert(count_switch(middle) == 1)
+assert(middle(1) == "one" and middle(2) == "two" and middle(3) == "three")
+assert(middle(7) == "default")
+
+-- nested switches each get their own table
+local function nested(a, b)
+  switch a do
+    case 1:
+      switch b do
+        case "x" -> "1x"
+        case "y" -> "1y"
+        case "z" -> "1z"
+      end
+      return "1?"
+    case 2 -> "2"
+    case 3 -> "3"
+  end
+  return "?"
+end
+assert(count_switch(nested) == 2)
+assert(nested(1, "x") == "1x" and nested(1, "z") == "1z" and nested(1, "w") == "1?")
+assert(nested(2) == "2" and nested(3) == "3" and nested(4) == "?")
+
+-- anything non-constant keeps the comparison chain only
+local function dynamic(x, y)
+  switch x do
+    case 1 -> "one"
+    case y -> "y"
+    case 3 -> "three"
+  end
+  return "none"
+end
+assert(count_switch(dynamic) == 0)
+assert(dynamic(1, 2) == "one" and dynamic(2, 2) == "y" and dynamic(3, 2) == "three")
+
+-- tables with __eq never match constant labels, with or without the table
+local weird = setmetatable({}, {__eq = function() return true end})
+assert(dense(weird) == "other" and mixed(weird) == "")
+
+-- the tables survive a dump/load round trip
+local src = [[
+  local function f(x)
+    switch x do
+      case 10 -> "ten"
+      case 20 -> "twenty"
+      case "s" -> "str"
+      default -> "d"
+    end
+  end
+  local function g(x)
+    switch x do case 1 -> "a" case 2 -> "b" case 3 -> "c" end
+    return "-"
+  end
+  return f(10) .. f(20) .. f("s") .. f(30) .. g(1) .. g(3) .. g(4)
+]]
+local direct = load(src)()
+local reloaded = load(string.dump(load(src)), "dumped", "b")()
+assert(direct == "tentwentystrdac-" and reloaded == direct)
+
+-- many cases, collected while the tables are alive
+local parts = {"local x = ... switch x do"}
+for i = 1, 300 do
+  parts[#parts + 1] = string.format("case %d: return %d case 'k%d': return -%d", i * 7, i, i, i)
+end
+parts[#parts + 1] = "end return 0"
+local big = assert(load(table.concat(parts, " ")))
+collectgarbage()
+assert(count_switch(big) == 1)
+for i = 1, 300 do
+  assert(big(i * 7) == i and big("k" .. i) == -i)
+end
+assert(big(8) == 0 and big("k0") == 0)
+
+-- chunks written before OP_SWITCH (format bytes 0/1) or before OP_TRAP
+-- (2/3) are refused up front
+for _, fast in ipairs{false, true} do
+  local d = string.dump(big, {fast = fast, envelop = false})
+  for _, fmt in ipairs{0, 2} do
+    local old = d:sub(1, 5) .. string.char(fmt + (fast and 1 or 0)) .. d:sub(7)
+    local ok, err = load(old, "old", "b")
+    assert(ok == nil and err:find("older version"), err)
+  end
+end
+
+print("test_switch_jump passed")
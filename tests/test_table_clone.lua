@@ -0,0 +1,148 @@
+-- table.clone: deep copies with shared subtables, cycles and metatables
+
+local function same(a, b, seen)
+  seen = seen or {}
+  if type(a) ~= "table" then return a == b end
+  if seen[a] then return seen[a] == b end
+  seen[a] = b
+  if getmetatable(a) ~= getmetatable(b) then return false end
+  for k, v in pairs(a) do
+    if not same(v, rawget(b, k), seen) then return false end
+  end
+  for k in pairs(b) do
+    if rawget(a, k) == nil then return false end
+  end
+  return true
+end
+
+-- plain values, array and hash parts
+local src = {1, 2.5, "three", true, x = "y", [10] = 10, [2.5] = "f"}
+local c = table.clone(src)
+assert(c ~= src and same(src, c))
+c[1] = 100
+c.x = nil
+assert(src[1] == 1 and src.x == "y")
+assert(#c == #src)
+
+-- nested tables are copied, keys are not
+local key = {}
+src = {a = {b = {c = {1, 2, 3}}}, [key] = {"k"}, list = {{1}, {2}, {3}}}
+c = table.clone(src)
+assert(same(src, c))
+assert(c.a ~= src.a and c.a.b ~= src.a.b and c.a.b.c ~= src.a.b.c)
+assert(c[key] ~= nil and c[key] ~= src[key] and c[key][1] == "k")
+for i = 1, 3 do assert(c.list[i] ~= src.list[i] and c.list[i][1] == i) end
+
+-- shared subtables stay shared, cycles are preserved
+local shared = {n = 1}
+src = {p = shared, q = shared, {shared}}
+src.self = src
+src.p.back = src
+c = table.clone(src)
+assert(c.p == c.q and c[1][1] == c.p and c.p ~= shared)
+assert(c.self == c and c.p.back == c)
+
+-- metatables are shared, __gc is honoured for the copy
+local mt = {__index = function(_, k) return k .. "!" end}
+local obj = setmetatable({v = 1}, mt)
+c = table.clone({o = obj})
+assert(getmetatable(c.o) == mt and c.o.v == 1 and c.o.missing == "missing!")
+local collected = 0
+local gcmt = {__gc = function() collected = collected + 1 end}
+do
+  local t = setmetatable({}, gcmt)
+  local copy = table.clone(t)
+  t, copy = nil, nil
+end
+collectgarbage()
+collectgarbage()
+assert(collected == 2)
+
+-- raw copy: no __index/__newindex/__pairs involved
+local proxy = setmetatable({}, {
+  __index = function() error("no __index") end,
+  __newindex = function() error("no __newindex") end,
+  __pairs = function() error("no __pairs") end,
+})
+rawset(proxy, "a", 1)
+c = table.clone(proxy)
+assert(rawget(c, "a") == 1)
+
+-- keep: listed subtables are shared instead of copied
+local frozen = {limit = 10}
+local cfg = {rules = frozen, nested = {rules = frozen}, own = {1}}
+c = table.clone(cfg, {[frozen] = true})
+assert(c.rules == frozen and c.nested.rules == frozen and c.own ~= cfg.own)
+assert(c.nested ~= cfg.nested)
+c = table.clone(cfg, {[frozen] = false})
+assert(c.rules ~= frozen and c.rules == c.nested.rules)
+local root = table.clone(frozen, {[frozen] = true})
+assert(root ~= frozen and root.limit == 10, "the root is always copied")
+
+-- deep nesting without recursion, big tables, tables with holes
+local deep = {}
+local node = deep
+for i = 1, 100000 do
+  node.next = {i = i}
+  node = node.next
+end
+c = table.clone(deep)
+node = c
+for i = 1, 100000 do
+  node = node.next
+  assert(node.i == i)
+end
+local big = {}
+for i = 1, 50000 do big[i] = {i} ; big["k" .. i] = i end
+for i = 1, 50000, 3 do big[i] = nil ; big["k" .. i] = nil end
+c = table.clone(big)
+collectgarbage()
+for i = 1, 50000 do
+  if i % 3 == 1 then
+    assert(c[i] == nil and c["k" .. i] == nil)
+  else
+    assert(c[i][1] == i and c[i] ~= big[i] and c["k" .. i] == i)
+  end
+end
+c.newkey = 1
+for i = 1, 1000 do c["n" .. i] = i end
+assert(c.n1000 == 1000 and big.newkey == nil)
+
+-- clones stay valid across collections while being built
+collectgarbage("incremental")
+collectgarbage("step", 0)
+for _ = 1, 20 do
+  local t = table.clone(big)
+  assert(t[2][1] == 2)
+end
+
+-- cloned tables work as metatables: their metamethods are not cached absent
+local mt = table.clone({__index = function() return 42 end})
+assert(setmetatable({}, mt).x == 42)
+local seen = {}
+local ops = table.clone({
+  __newindex = function(t, k, v) seen[k] = v end,
+  __len = function() return 7 end,
+  __eq = function() return true end,
+})
+local a, b = setmetatable({}, ops), setmetatable({}, ops)
+a.q = 1
+assert(seen.q == 1 and rawget(a, "q") == nil)
+assert(#a == 7 and a == b)
+local weak = setmetatable({}, table.clone({__mode = "k"}))
+weak[{}] = true
+collectgarbage()
+assert(next(weak) == nil)
+local finalized = false
+do
+  local gcmt = table.clone({__gc = function() finalized = true end})
+  setmetatable({}, gcmt)
+end
+collectgarbage()
+collectgarbage()
+assert(finalized)
+
+assert(not pcall(table.clone, 1))
+assert(not pcall(table.clone, {}, 1))
+
+print("test_table_clone passed")
@@ -0,0 +1,166 @@
+-- Typed register tier of the tcc translator ({typed = true})
+local tcc = require("tcc")
+
+local function compile_and_load(name, code, opts)
+    local c_code = tcc.compile(code, name, opts)
+    local c_file = name .. ".c"
+    local so_file = name .. ".so"
+
+    local f = io.open(c_file, "w")
+    f:write(c_code)
+    f:close()
+
+    local cmd = string.format("gcc -std=c99 -shared -o %s %s -I. -fPIC", so_file, c_file)
+    local ret = os.execute(cmd)
+    if ret ~= 0 and ret ~= true then
+        error("GCC compilation failed for " .. name)
+    end
+
+    package.loaded[name] = nil
+    local old_path = package.cpath
+    package.cpath = "./?.so;" .. old_path
+    local ok, mod = pcall(require, name)
+    package.cpath = old_path
+    os.remove(c_file)
+    os.remove(so_file)
+
+    if not ok then
+        error("Failed to load module " .. name .. ": " .. tostring(mod))
+    end
+    return mod, c_code
+end
+
+local code = [[
+    local M = {}
+
+    function M.sum(n)
+        local s = 0
+        for i = 1, n do
+            s = s + i * 3 - (i // 2) + (i % 7)
+        end
+        return s
+    end
+
+    function M.fixed()
+        local s = 0
+        for i = 10, 1, -2 do
+            s = s + (i << 3) ~ (i >> 1)
+        end
+        local f = 0.5
+        for i = 1, 100 do
+            f = f * 1.01 + 0.25
+        end
+        return s, f
+    end
+
+    function M.count_even()
+        local c = 0
+        for i = 1, 1000 do
+            if i % 2 == 0 then c = c + 1 end
+        end
+        return c
+    end
+
+    function M.step(a, b, st)
+        local t = {}
+        for i = a, b, st do
+            t[#t + 1] = i
+        end
+        return #t, t[1], t[#t]
+    end
+
+    function M.to_max(lim, st)
+        local c, last = 0, 0
+        for i = 0x7ffffffffffffffd, lim, st do
+            c = c + 1
+            last = i
+        end
+        return c, last
+    end
+
+    function M.to_min(lim, st)
+        local c, last = 0, 0
+        for i = -0x7ffffffffffffffe, lim, st do
+            c = c + 1
+            last = i
+        end
+        return c, last
+    end
+
+    function M.nested()
+        local s = 0
+        for i = 1, 30 do
+            for j = i, 30 do
+                s = s + i * j
+            end
+        end
+        return s
+    end
+
+    function M.wrap()
+        local x = 0x7fffffffffffffff
+        local y = x + 1
+        local z = -7 // 2
+        local w = -7 % 3
+        return y, z, w, 2 ^ 10, 7 / 2
+    end
+
+    function M.divzero()
+        local a = 1
+        local b = 0
+        return a // b
+    end
+
+    return M
+]]
+
+local interp = load(code)()
+local typed, c_code = compile_and_load("tcc_typed_mod", code, {typed = true})
+
+assert(c_code:find("lua_Integer tr", 1, true), "no unboxed integer registers emitted")
+assert(c_code:find("Typed_", 1, true), "typed tier not emitted")
+
+assert(typed.sum(1000) == interp.sum(1000))
+assert(typed.sum(0) == 0)
+local s1, f1 = typed.fixed()
+local _, f2 = interp.fixed()
+assert(s1 == 241 and math.type(s1) == "integer")
+assert(f1 == f2)
+assert(typed.count_even() == 500)
+assert(typed.nested() == interp.nested())
+
+-- loop bounds arrive boxed: the guard deoptimizes to the generic body
+assert(select("#", typed.step(1, 10, 1)) == 3)
+local n, first, last = typed.step(1, 10, 3)
+assert(n == 4 and first == 1 and last == 10)
+n, first, last = typed.step(1, 2, 0.5)
+assert(n == 3 and first == 1 and last == 2, "float step deopt")
+n = typed.step(5, 1, 1)
+assert(n == 0)
+
+-- typed loops near the integer bounds stop instead of wrapping
+local maxi, mini = math.maxinteger, math.mininteger
+n, last = typed.to_max(maxi, 1)
+assert(n == 3 and last == maxi)
+n, last = typed.to_max(maxi, maxi)
+assert(n == 1 and last == maxi - 2)
+n, last = typed.to_min(mini, -1)
+assert(n == 3 and last == mini)
+n, last = typed.to_min(maxi, mini)
+assert(n == 0 and last == 0)
+local ok, err = pcall(typed.to_max, maxi, 0)
+assert(not ok and tostring(err):find("'for' step is zero", 1, true))
+
+local y, z, w, p, q = typed.wrap()
+-- integer overflow wraps like the generic tier does
+assert(y == math.mininteger and z == -4 and w == 2 and p == 1024.0 and q == 3.5)
+assert(math.type(y) == "integer" and math.type(p) == "float")
+
+ok, err = pcall(typed.divzero)
+assert(not ok and tostring(err):find("n//0", 1, true))
+
+-- without the option the output is unchanged
+local _, plain = compile_and_load("tcc_plain_mod", code)
+assert(not plain:find("Typed_", 1, true))
+
+print("test_tcc_typed passed")
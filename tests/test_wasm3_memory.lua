@@ -0,0 +1,82 @@
+-- Zero-copy views over wasm3 linear memory
+-- (module
+--   (memory 1 4)
+--   (func (export "store") (param i32 i32) local.get 0 local.get 1 i32.store)
+--   (func (export "load") (param i32) (result i32) local.get 0 i32.load)
+--   (func (export "grow") (param i32) (result i32) local.get 0 memory.grow))
+local wasm_bytes = string.char(
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x0b, 0x02, 0x60, 0x02, 0x7f, 0x7f, 0x00,
+    0x60, 0x01, 0x7f, 0x01, 0x7f, 0x03, 0x04, 0x03, 0x00, 0x01, 0x01, 0x05, 0x04, 0x01, 0x01, 0x01,
+    0x04, 0x07, 0x17, 0x03, 0x05, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x00, 0x00, 0x04, 0x6c, 0x6f, 0x61,
+    0x64, 0x00, 0x01, 0x04, 0x67, 0x72, 0x6f, 0x77, 0x00, 0x02, 0x0a, 0x1a, 0x03, 0x09, 0x00, 0x20,
+    0x00, 0x20, 0x01, 0x36, 0x02, 0x00, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x28, 0x02, 0x00, 0x0b, 0x06,
+    0x00, 0x20, 0x00, 0x40, 0x00, 0x0b
+)
+
+local wasm3 = require("wasm3")
+local env = wasm3.newEnvironment()
+local runtime = env:newRuntime(64 * 1024)
+runtime:loadModule(env:parseModule(wasm_bytes))
+
+local store = runtime:findFunction("store")
+local load = runtime:findFunction("load")
+local grow = runtime:findFunction("grow")
+
+local mem = runtime:memory()
+assert(mem:size() == 65536 and #mem == 65536)
+
+-- typed reads see what wasm wrote, and wasm sees typed writes
+store:call(16, 0x12345678)
+assert(mem:read("i32", 16) == 0x12345678)
+assert(mem:read("u8", 16) == 0x78, "little-endian")
+assert(mem:read("u16", 18) == 0x1234)
+mem:write("i32", 32, -2)
+assert(load:call(32) == -2)
+assert(mem:read("u32", 32) == 0xfffffffe)
+assert(mem:read("i8", 32) == -2 and mem:read("u8", 32) == 254)
+mem:write("u8", 40, 0x1ff)
+assert(mem:read("u8", 40) == 0xff, "stores truncate")
+mem:write("i64", 48, math.mininteger)
+assert(mem:read("i64", 48) == math.mininteger)
+mem:write("f64", 64, 0.1)
+assert(mem:read("f64", 64) == 0.1)
+mem:write("f32", 72, 2.5)
+assert(mem:read("f32", 72) == 2.5)
+
+-- bulk transfers
+mem:writeBuffer(100, "hello, wasm")
+assert(mem:readString(100, 11) == "hello, wasm")
+assert(runtime:getMemory(100, 5) == "hello")
+mem:writeBuffer(200, "abcdef", 3)
+assert(mem:readString(200, 4) == "abc\0")
+local p = mem:pointer(100)
+assert(ptr.string(p, 5) == "hello")
+mem:writeBuffer(300, p, 5)
+assert(mem:readString(300, 5) == "hello")
+
+-- bounds are checked against the current size
+assert(not pcall(mem.read, mem, "i32", 65533))
+assert(not pcall(mem.read, mem, "u8", -1))
+assert(not pcall(mem.readString, mem, 65000, 1000))
+assert(not pcall(mem.write, mem, "i64", 65529, 0))
+assert(not pcall(mem.read, mem, "i128", 0), "unknown type")
+assert(pcall(mem.read, mem, "u8", 65535))
+assert(mem:readString(65536, 0) == "")
+
+-- views follow memory.grow
+assert(grow:call(1) == 1)
+assert(mem:size() == 131072)
+mem:write("i32", 100000, 7)
+assert(load:call(100000) == 7)
+assert(mem:readString(100, 5) == "hello", "contents survive growth")
+
+-- the view keeps its runtime alive
+local v = env:newRuntime(64 * 1024)
+v:loadModule(env:parseModule(wasm_bytes))
+v = v:memory()
+collectgarbage()
+collectgarbage()
+v:write("i32", 0, 5)
+assert(v:read("i32", 0) == 5)
+
+print("test_wasm3_memory passed")
@@ -0,0 +1,50 @@
+-- Typed argument/result marshalling and fn:callMany for wasm3 functions
+-- (module
+--   (func (export "add")   (param i32 i32) (result i32) local.get 0 local.get 1 i32.add)
+--   (func (export "add64") (param i64 i64) (result i64) local.get 0 local.get 1 i64.add)
+--   (func (export "mulf")  (param f64 f64) (result f64) local.get 0 local.get 1 f64.mul)
+--   (func (export "negf")  (param f32) (result f32) local.get 0 f32.neg))
+local wasm_bytes = string.char(
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x18, 0x04, 0x60, 0x02, 0x7f, 0x7f, 0x01,
+    0x7f, 0x60, 0x02, 0x7e, 0x7e, 0x01, 0x7e, 0x60, 0x02, 0x7c, 0x7c, 0x01, 0x7c, 0x60, 0x01, 0x7d,
+    0x01, 0x7d, 0x03, 0x05, 0x04, 0x00, 0x01, 0x02, 0x03, 0x07, 0x1d, 0x04, 0x03, 0x61, 0x64, 0x64,
+    0x00, 0x00, 0x05, 0x61, 0x64, 0x64, 0x36, 0x34, 0x00, 0x01, 0x04, 0x6d, 0x75, 0x6c, 0x66, 0x00,
+    0x02, 0x04, 0x6e, 0x65, 0x67, 0x66, 0x00, 0x03, 0x0a, 0x1f, 0x04, 0x07, 0x00, 0x20, 0x00, 0x20,
+    0x01, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x20, 0x01, 0x7c, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x20,
+    0x01, 0xa2, 0x0b, 0x05, 0x00, 0x20, 0x00, 0x8c, 0x0b
+)
+
+local wasm3 = require("wasm3")
+local env = wasm3.newEnvironment()
+local runtime = env:newRuntime(64 * 1024)
+runtime:loadModule(env:parseModule(wasm_bytes))
+
+local add = runtime:findFunction("add")
+local add64 = runtime:findFunction("add64")
+local mulf = runtime:findFunction("mulf")
+local negf = runtime:findFunction("negf")
+
+-- values keep their full width and type
+assert(add:call(2147483647, 1) == -2147483648, "i32 wraps")
+assert(add:call(-5, 3) == -2)
+assert(add:call("40", 2) == 42, "numeric strings still convert")
+assert(add64:call(1 << 40, 1 << 40) == 1 << 41)
+assert(add64:call(math.maxinteger, 0) == math.maxinteger)
+local p = mulf:call(1.5, 0.1)
+assert(math.type(p) == "float" and p == 1.5 * 0.1, "f64 is passed exactly")
+assert(negf:call(2.5) == -2.5)
+assert(not pcall(add.call, add, 1), "argument count is checked")
+assert(not pcall(add.call, add, {}, 1), "non-numbers are rejected")
+
+-- batched calls: flat argument list and list of tuples
+local flat = add:callMany({1, 2, 3, 4, 5, 6})
+assert(#flat == 3 and flat[1] == 3 and flat[2] == 7 and flat[3] == 11)
+local tuples = mulf:callMany({{2, 3}, {0.5, 4}})
+assert(tuples[1] == 6.0 and tuples[2] == 2.0)
+local out = {}
+assert(negf:callMany({1, -2, 3}, out) == out)
+assert(out[1] == -1 and out[2] == 2 and out[3] == -3)
+assert(#add:callMany({}) == 0)
+assert(not pcall(add.callMany, add, {1, 2, 3}), "partial tuple is an error")
+
+print("wasm3 typed call test passed")